@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Hal.h>
+#include <Log.h>
+
+enum APP_STATE
+{
+    SETUP,
+    PAIRING,
+    IDLE,
+    RUNNING,
+    END
+};
+
+// Utilities for memory and logging (LOG, LOGL, LOGE, LOGW, LOGD: see Log.h)
+#define FREE(ptr)        do { if (ptr) { delete((ptr)); (ptr) = NULL; } } while (0);
+#define FREE_ARRAY(ptr)  do { if (ptr) { delete[] ((ptr)); (ptr) = NULL; } } while (0);
+
+void App_SetState(APP_STATE state);
+APP_STATE App_GetState(void);
+const char *App_ToString(APP_STATE state);
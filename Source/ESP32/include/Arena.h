@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Config.h>
+
+/*
+Per-turn memory arena:
+    All buffers of a turn come from one region reserved at link time instead of the heap, so long
+    uptimes cannot fragment the heap and a turn never fails because the largest free block shrank.
+    - Block pool: ARENA_BLOCK_COUNT blocks of ARENA_BLOCK_SIZE bytes (I2S capture blocks).
+      Arena_AllocBlock/Arena_FreeBlock are lock-free and may be called from any task. The blocks
+      belong to the capture and the voice task, which checks for leaks (Arena_CheckBlocks) at the
+      end of each recording, once the capture is stopped.
+    - Bump region: ARENA_BUMP_SIZE bytes of scratch memory (response buffers), handed out by
+      Arena_Alloc to the task that answers the turns and released all at once by Arena_Reset once
+      the response played. That is the voice task, or the turn worker while the turn queue is
+      active (TurnQueue.h): the recording of the next turn does not use the region.
+*/
+
+struct ArenaStats
+{
+    uint32_t blocksInUse;
+    uint32_t blocksHighWater;   // Most blocks in use at the same time
+    size_t bumpUsed;
+    size_t bumpHighWater;       // Most bump bytes used by one turn
+    uint32_t failedAllocations; // Requests that did not fit
+    uint32_t leakedBlocks;      // Blocks still in use at the last Arena_CheckBlocks
+};
+
+uint8_t *Arena_AllocBlock();
+void Arena_FreeBlock(uint8_t *block);
+uint32_t Arena_FreeBlocks();
+void *Arena_Alloc(size_t size, size_t align = 4);
+void Arena_Reset();
+void Arena_CheckBlocks();
+const ArenaStats &Arena_GetStats();
+void Arena_Logging();
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Config.h>
+
+/*
+Audio formats and WAV headers:
+    AudioFormat<Rate, Bits, Channels> describes linear PCM at compile time. Its sizes are constants
+    and its canonical 44-byte WAV header is built by constexpr functions, so a header with known
+    sizes (StreamingHeader) is plain data in flash and Header() only fills in the two sizes.
+    CaptureFormat is what the microphone records, PlaybackFormat what the DAC plays; the device
+    advertises PlaybackFormat (X-Accept-Format) so the server can answer in it and the player has
+    nothing to convert.
+    Incoming headers are read by WavParser, fed in pieces of any size: it walks the RIFF chunks
+    (fmt, LIST, fact...) up to the data chunk, so headers other than the canonical 44 bytes work.
+*/
+
+#define WAV_HEADER_SIZE 44                 // Canonical header: RIFF, fmt (16 bytes), data
+#define WAV_SIZE_UNKNOWN 0xFFFFFFFF        // RIFF and data size of a stream (streaming WAV convention)
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE       // Sub-format GUID in the fmt extension
+#define WAV_FMT_MAX 40                     // fmt bytes kept by the parser (WAVE_FORMAT_EXTENSIBLE)
+#ifndef WAV_MAX_HEADER
+#define WAV_MAX_HEADER 4096                // Bytes before the data chunk, a larger header is rejected
+#endif
+
+struct WavHeader
+{
+    uint8_t bytes[WAV_HEADER_SIZE];
+};
+
+/**
+ * @brief Byte `index` (0 = least significant) of a little-endian field.
+ */
+constexpr uint8_t Wav_Byte(uint32_t value, int index)
+{
+    return (uint8_t)((value >> (8 * index)) & 0xFF);
+}
+
+/**
+ * @brief Canonical PCM WAV header.
+ *
+ * @param riffSize RIFF chunk size (file size minus 8).
+ * @param dataSize data chunk size.
+ */
+constexpr WavHeader Wav_MakeHeader(uint32_t rate, uint16_t bits, uint16_t channels, uint32_t riffSize, uint32_t dataSize)
+{
+    return WavHeader{{
+        'R', 'I', 'F', 'F',
+        Wav_Byte(riffSize, 0), Wav_Byte(riffSize, 1), Wav_Byte(riffSize, 2), Wav_Byte(riffSize, 3),
+        'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ',
+        16, 0, 0, 0,                                                   // fmt size
+        WAV_FORMAT_PCM, 0,
+        Wav_Byte(channels, 0), Wav_Byte(channels, 1),
+        Wav_Byte(rate, 0), Wav_Byte(rate, 1), Wav_Byte(rate, 2), Wav_Byte(rate, 3),
+        Wav_Byte(rate * channels * (bits / 8), 0), Wav_Byte(rate * channels * (bits / 8), 1), // ByteRate
+        Wav_Byte(rate * channels * (bits / 8), 2), Wav_Byte(rate * channels * (bits / 8), 3),
+        Wav_Byte(channels * (bits / 8), 0), Wav_Byte(channels * (bits / 8), 1),              // BlockAlign
+        Wav_Byte(bits, 0), Wav_Byte(bits, 1),
+        'd', 'a', 't', 'a',
+        Wav_Byte(dataSize, 0), Wav_Byte(dataSize, 1), Wav_Byte(dataSize, 2), Wav_Byte(dataSize, 3)}};
+}
+
+/**
+ * @brief Linear PCM format known at compile time.
+ */
+template <uint32_t Rate, uint16_t Bits, uint16_t Channels>
+struct AudioFormat
+{
+    static_assert(Rate > 0, "Sample rate must be set");
+    static_assert(Bits == 8 || Bits == 16, "Samples are unsigned 8-bit or signed 16-bit");
+    static_assert(Channels >= 1, "At least one channel");
+
+    static constexpr uint32_t SampleRate = Rate;
+    static constexpr uint16_t SampleBits = Bits;
+    static constexpr uint16_t ChannelCount = Channels;
+    static constexpr uint16_t BlockAlign = Channels * (Bits / 8);   // Bytes per frame
+    static constexpr uint32_t ByteRate = Rate * BlockAlign;
+
+    /**
+     * @brief Bytes of `ms` milliseconds of audio, whole frames.
+     */
+    static constexpr uint32_t Bytes(uint32_t ms)
+    {
+        return (uint32_t)((uint64_t)Rate * ms / 1000) * BlockAlign;
+    }
+
+    /**
+     * @brief Header of `dataBytes` bytes of audio (not samples).
+     */
+    static constexpr WavHeader Header(uint32_t dataBytes)
+    {
+        return Wav_MakeHeader(Rate, Bits, Channels, WAV_HEADER_SIZE - 8 + dataBytes, dataBytes);
+    }
+
+    static constexpr WavHeader StreamingHeader = Wav_MakeHeader(Rate, Bits, Channels, WAV_SIZE_UNKNOWN, WAV_SIZE_UNKNOWN);
+};
+
+template <uint32_t Rate, uint16_t Bits, uint16_t Channels>
+constexpr WavHeader AudioFormat<Rate, Bits, Channels>::StreamingHeader;
+
+typedef AudioFormat<I2S_SAMPLE_RATE, I2S_SAMPLE_BITS, I2S_CHANNEL_NUM> CaptureFormat;
+typedef AudioFormat<PLAYER_OUTPUT_RATE, 8, 1> PlaybackFormat;   // Built-in DAC: unsigned 8-bit mono
+
+static_assert(FLASH_RECORD_SIZE == CaptureFormat::Bytes(RECORD_TIME * 1000), "Recording size is whole frames");
+static_assert(CaptureFormat::StreamingHeader.bytes[34] == I2S_SAMPLE_BITS, "Header is built at compile time");
+
+struct WavInfo
+{
+    uint16_t encoding;      // WAV_FORMAT_PCM, also for WAVE_FORMAT_EXTENSIBLE with a PCM sub-format
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint16_t sampleBits;
+    uint32_t dataSize;      // data chunk size, WAV_SIZE_UNKNOWN or 0 for a stream
+    uint32_t headerSize;    // Bytes before the audio
+};
+
+enum WAV_PARSE_STATE
+{
+    WAV_PARSE_RIFF,         // Reading "RIFF" size "WAVE"
+    WAV_PARSE_CHUNK,        // Reading a chunk id and size
+    WAV_PARSE_FMT,          // Reading the fmt chunk
+    WAV_PARSE_SKIP,         // Skipping a chunk (or the end of a long fmt chunk)
+    WAV_PARSE_DONE,         // At the first audio byte
+    WAV_PARSE_FAILED        // Not a PCM WAV header
+};
+
+struct WavParser
+{
+    WAV_PARSE_STATE state;
+    uint8_t buffer[WAV_FMT_MAX];    // Item being assembled
+    uint32_t fill;                  // Bytes of the item received
+    uint32_t need;                  // Bytes of the item
+    uint32_t skip;                  // Bytes left to skip
+    bool haveFormat;                // fmt chunk seen
+    WavInfo info;
+};
+
+void Wav_ParserReset(WavParser &parser);
+size_t Wav_Parse(WavParser &parser, const uint8_t *data, size_t len);
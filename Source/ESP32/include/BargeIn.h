@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Hal.h>
+#include <Config.h>
+#include <Capture.h>
+
+/*
+Barge-in (full duplex):
+    While a response is on its way and playing, the microphone keeps running: the capture task is
+    put in monitor mode (Capture_Monitor) and hands every read (one DMA buffer, 16ms) to
+    BargeIn_Monitor() while it keeps the last BARGE_IN_PREROLL_BLOCKS blocks. A read is speech
+    when its energy is BARGE_IN_ENERGY_RATIO above the noise floor and BARGE_IN_ECHO_MARGIN above
+    the echo expected from the speaker:
+        - the response samples are reported with BargeIn_Reference() as they are written to the
+          speaker, their energy is kept per BARGE_IN_REF_CHUNK samples of the stream
+        - AudioOutput::Position() tells which of them are playing, the loudest chunk of the last
+          BARGE_IN_ECHO_MS is what the microphone may hear
+        - the echo gain (microphone energy per playback energy) is the highest ratio seen over the
+          first BARGE_IN_TRAIN_MS of playback, when nobody is expected to talk yet
+    BARGE_IN_START_FRAMES speech reads in a row, or a press of the record button, interrupt the
+    response from the capture task (AudioOutput::Interrupt, the writer stops waiting for ring
+    space) and end the monitoring: the capture queues the next turn, with the kept blocks after
+    speech (the start of the utterance is in them), from the press on after the button. The voice
+    task sees it in BargeIn_Check(), stops the speaker and starts the next turn on the queued
+    blocks (hands-free after speech, held button after a press).
+*/
+
+#define BARGE_IN_ENERGY_RATIO 4     // Speech energy above the noise floor (+6dB)
+#define BARGE_IN_ECHO_MARGIN 4      // Speech energy above the expected echo (+6dB)
+#define BARGE_IN_MIN_ENERGY 4096    // Absolute energy floor, as VAD_MIN_ENERGY
+#define BARGE_IN_START_FRAMES 6     // Consecutive speech reads that interrupt the response (96ms)
+#define BARGE_IN_TRAIN_MS 500       // Playback heard before the echo gain is trusted
+#define BARGE_IN_ECHO_MS 150        // Playback that may still be heard: DMA, DAC and room delay
+#define BARGE_IN_REF_CHUNK 64       // Stream samples per reference energy
+#define BARGE_IN_REF_SLOTS 512      // Reference energies kept (power of two), more than PLAYER_RING_SIZE
+#define BARGE_IN_REF_MIN 16         // Playback energy (8-bit samples) below which nothing is heard
+#define BARGE_IN_POLL_MS 20         // End of playback check while waiting for a barge-in
+
+enum BARGE_IN_REASON
+{
+    BARGE_IN_NONE,                  // The response played out
+    BARGE_IN_BUTTON,                // Record button pressed during the response
+    BARGE_IN_SPEECH                 // Speech heard over the echo
+};
+
+struct BargeInStats
+{
+    uint32_t frames;                // Reads checked
+    uint32_t echoFrames;            // Reads above the noise floor rejected as echo
+    uint32_t echoGain;              // Learned echo gain, Q8
+    uint32_t triggerTime;           // Hal_Millis() of the barge-in, 0 if none
+    BARGE_IN_REASON reason;
+};
+
+void BargeIn_Init(Controls &controls, AudioOutput &speaker);
+void BargeIn_Start();
+void BargeIn_Playback(uint32_t sampleRate);
+void BargeIn_Reference(const uint8_t *samples, size_t count);
+CAPTURE_MONITOR BargeIn_Monitor(const uint8_t *samples, size_t len);
+bool BargeIn_Check();
+BARGE_IN_REASON BargeIn_Stop();
+const BargeInStats &BargeIn_GetStats();
+const char *BargeIn_ToString(BARGE_IN_REASON reason);
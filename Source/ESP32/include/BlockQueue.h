@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * @brief Fixed-size single-producer/single-consumer queue of buffer pointers.
+ *
+ * Same scheme as RingBuffer: the producer only writes `head`, the consumer only writes
+ * `tail`, so both sides run without locking. Buffers are passed by pointer, the queue never
+ * copies audio.
+ *
+ * @tparam Depth Number of entries (power of two).
+ */
+template <size_t Depth>
+class BlockQueue
+{
+    static_assert((Depth & (Depth - 1)) == 0, "BlockQueue depth must be a power of two");
+
+public:
+    /**
+     * @brief Empties the queue. Only call while neither side is active.
+     */
+    void Reset()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of queued blocks.
+     */
+    size_t Size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Queues a block (producer side).
+     *
+     * @return false if the queue is full, the caller keeps ownership of the block.
+     */
+    bool Push(uint8_t *data, size_t len)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Depth) return false;
+        entries[h & (Depth - 1)] = {data, len};
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest block (consumer side).
+     *
+     * @return false if the queue is empty.
+     */
+    bool Pop(uint8_t *&data, size_t &len)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) return false;
+        data = entries[t & (Depth - 1)].data;
+        len = entries[t & (Depth - 1)].len;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Entry
+    {
+        uint8_t *data;
+        size_t len;
+    };
+    Entry entries[Depth];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
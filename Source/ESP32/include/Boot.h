@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Hal.h>
+#include <Config.h>
+#include <stdint.h>
+
+/*
+Boot orchestrator:
+    setup() describes the initialisation as steps, each with the steps it needs first. Boot_Run()
+    starts every step whose dependencies are done in a task of its own, so independent steps
+    overlap: the file system mount (which formats a blank partition), the two I2S drivers and the
+    WiFi driver start. The step starting the voice task is marked `ready`: it needs the file
+    system, the microphone and the player but not the WiFi link, so the first command can be
+    recorded while the device is still associating; a recording made to flash (RECORD_TO_FILE)
+    waits up to BOOT_LINK_WAIT_MS for the link before its upload. Diagnostic steps (file listing)
+    are only added on request (BOOT_LIST_FILES).
+
+        storage ----> clips --------+
+        microphone -----------------+--> pipeline (ready: voice task started)
+        player ---------------------+
+        wifi -------> metrics
+
+    Every step records its start and end time (Hal_Micros, from the start of the program), so
+    the boot timeline is logged after boot (Boot_Logging) and boot-to-ready is served as a
+    metric (Metrics.h). A step that fails stops the boot: the steps that need it never start and
+    Boot_Run() returns false.
+*/
+
+#define BOOT_MAX_STEPS 12
+
+struct BootStep
+{
+    const char *name;
+    bool (*run)(void *context);     // false: the step failed
+    uint32_t after;                 // Steps to finish first, bit i is the step at index i
+    bool ready;                     // The device takes commands once every ready step is done
+    int core;                       // Core of its task (ESP32)
+};
+
+struct BootRecord
+{
+    const char *name;
+    uint32_t startUs;               // Hal_Micros() when the task was started
+    uint32_t endUs;                 // ... when the step returned
+    bool started;                   // false: a step it needs failed
+    bool ended;
+    bool ok;
+};
+
+struct BootTimeline
+{
+    uint32_t beginUs;               // Boot_Run() called
+    uint32_t readyUs;               // Every ready step done, if `ready`
+    uint32_t endUs;                 // Every step done
+    uint32_t count;
+    bool ready;
+    BootRecord steps[BOOT_MAX_STEPS];
+};
+
+bool Boot_Run(const BootStep *steps, uint32_t count, void *context);
+const BootTimeline &Boot_GetTimeline();
+void Boot_Logging();
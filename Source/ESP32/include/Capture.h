@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Hal.h>
+#include <Config.h>
+
+/*
+Capture pipeline:
+    A dedicated high-priority task (pinned to CAPTURE_TASK_CORE) only drains the I2S DMA into
+    pooled blocks of I2S_READ_LEN bytes (Arena.h) and pushes them into a lock-free SPSC queue.
+    The voice task pops the blocks and does the conversion, VAD, encoding and upload or file write,
+    so a slow flash write or network send no longer backs up the DMA: the queue absorbs it.
+
+    Capture task:  Read(CAPTURE_READ_LEN) x N -> block -> BlockQueue<CAPTURE_QUEUE_DEPTH>
+    Voice task:    Capture_Pop -> scale, VAD, encode, sink -> Capture_Release
+
+    When the queue is full or the pool is empty the captured audio is dropped and counted, the
+    DMA is always drained. A source that can wait (the native WAV microphone when not paced)
+    polls Capture_Backlogged() and holds its read back instead.
+
+    Nothing polls: the capture task sleeps until Capture_Start, the voice task sleeps in
+    Capture_Pop until a block is queued or the button changes (Capture_WakeEvent).
+
+    Monitor mode (Capture_Monitor, barge-in during playback): every read is handed to a callback
+    in the capture task and the blocks are kept in a short history instead of being queued, the
+    oldest is dropped. Once the callback asks for it the history (or only the current block) is
+    queued and the capture goes on as after Capture_Start, so the queue keeps a single producer.
+*/
+
+#define CAPTURE_HISTORY_MAX 4   // Blocks kept while monitoring
+
+enum CAPTURE_MONITOR
+{
+    CAPTURE_MONITOR_CONTINUE,       // Keep monitoring
+    CAPTURE_MONITOR_QUEUE,          // Start queuing with the current block, drop the history
+    CAPTURE_MONITOR_QUEUE_HISTORY   // Start queuing with the history, the current block last
+};
+
+/**
+ * @brief Called by the capture task with every microphone read while monitoring.
+ *
+ * @param data Raw I2S samples of the read.
+ * @param len Length of the read in bytes (CAPTURE_READ_LEN).
+ */
+typedef CAPTURE_MONITOR (*CaptureMonitor)(const uint8_t *data, size_t len);
+
+struct CaptureStats
+{
+    uint32_t blocks;            // Blocks queued since Capture_Start
+    uint32_t queueOverruns;     // Blocks dropped because the queue was full
+    uint32_t poolOverruns;      // Reads dropped because no block was free
+    uint32_t maxQueueDepth;     // Highest number of queued blocks
+};
+
+void Capture_Init(AudioInput &microphone);
+void Capture_Start(size_t discardBytes);
+void Capture_Monitor(CaptureMonitor callback, size_t historyBlocks);
+void Capture_Stop();
+bool Capture_Pop(uint8_t *&block, size_t &len, uint32_t timeoutMs);
+HalEvent Capture_WakeEvent();
+void Capture_Release(uint8_t *block);
+bool Capture_Backlogged();
+const CaptureStats &Capture_GetStats();
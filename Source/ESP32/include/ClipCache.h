@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Hal.h>
+#include <Codec.h>
+#include <Server.h>
+
+/*
+Response clip cache:
+    Short responses that repeat (error prompts, confirmations) are kept on the file system and
+    replayed from flash. The server picks the ids:
+        - every turn advertises the cached ids: "X-Cached-Clips: 1f2e3d4c, 00a1b2c3"
+        - "X-Clip-Action: store" + "X-Clip-Id": play the body and keep it under that id
+        - "X-Clip-Action: play" + "X-Clip-Id": play the cached clip, no body is sent
+    A clip file holds the response body as received (WAV header and encoded payload). The
+    index file lists id, size, CRC-32, codec and last use of every clip; the least recently
+    played clips are evicted to stay within CLIP_CACHE_BUDGET. Clips whose size or CRC do not
+    match the index are dropped when the cache is loaded.
+*/
+
+struct ClipCacheStats
+{
+    uint32_t hits;              // Clips played from flash
+    uint32_t misses;            // Responses that had to be downloaded: stores and unknown ids
+    uint32_t stores;            // Clips added
+    uint32_t evictions;         // Clips removed to make room
+    uint32_t corrupt;           // Clips dropped by the integrity check
+    uint32_t bytesSaved;        // Response bytes not downloaded thanks to hits
+    uint32_t bytesUsed;         // Flash used by the clips
+    uint32_t entries;
+};
+
+/**
+ * @brief A clip being stored while the response is played.
+ */
+struct ClipWriter
+{
+    StorageFile *file;          // NULL when not storing
+    uint32_t id;
+    uint32_t size;
+    uint32_t crc;
+    AUDIO_CODEC codec;
+};
+
+void ClipCache_Init(Storage &storage);
+size_t ClipCache_FormatIds(char *buffer, size_t size);
+bool ClipCache_Play(uint32_t id, AudioOutput &speaker, TurnStats &stats);
+void ClipCache_BeginStore(ClipWriter &writer, uint32_t id, AUDIO_CODEC codec);
+void ClipCache_Write(ClipWriter &writer, const uint8_t *data, size_t len);
+void ClipCache_EndStore(ClipWriter &writer, bool complete);
+const ClipCacheStats &ClipCache_GetStats();
+void ClipCache_Logging();
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Features.h>
+
+/*
+Fixed-point audio codecs used on the wire:
+    - CODEC_PCM:       raw samples, no compression
+    - CODEC_MULAW:     G.711 mu-law, 16-bit -> 8-bit per sample (2:1)
+    - CODEC_IMA_ADPCM: IMA-ADPCM, 16-bit -> 4-bit per sample (4:1). Headerless stream: the predictor
+                       starts at 0 / step index 0 and carries over between blocks; two samples per
+                       byte, first sample in the low nibble. The code of an odd last sample waits for
+                       the next block: Codec_Flush() writes it, padded with a 0 nibble, at the end.
+    - CODEC_PHONEMES:  not audio: units of the formant synthesizer (Synth.h), rendered on the device
+                       (responses only, SYNTH_ENABLE). Encode and decode produce nothing.
+    - CODEC_LOGMEL:    not audio: log-mel frames of the front end (Features.h), FEATURE_MEL_BANDS
+                       little-endian int16 (log2 band energy, Q8) every FEATURE_HOP samples (uploads
+                       only). The frames span blocks: the last FEATURE_FRAME_LEN - FEATURE_HOP
+                       samples of a block wait for the next one.
+    - CODEC_LOGMEL8:   CODEC_LOGMEL quantized to one byte per band: CODEC_LOGMEL8_FLOOR +
+                       code * CODEC_LOGMEL8_STEP (Q8), clamped. 25x smaller than PCM at the default
+                       20 bands every 16ms, 6x smaller than IMA-ADPCM.
+The encoders may run in place (dst == src), since the output never overtakes the input. The
+log-mel encoders share one front end: a single feature stream is encoded at a time.
+The codec of a body is negotiated with the X-Audio-Codec / X-Accept-Codec HTTP headers, a log-mel
+upload describes its frames in X-Feature-Format.
+*/
+
+#define CODEC_LOGMEL8_FLOOR 0   // Q8 log2 value of code 0 (about 1 LSB of amplitude)
+#define CODEC_LOGMEL8_STEP 48   // Q8 log2 step of one code (0.56 dB), 255 codes reach 47.8
+
+enum AUDIO_CODEC
+{
+    CODEC_PCM,
+    CODEC_MULAW,
+    CODEC_IMA_ADPCM,
+    CODEC_PHONEMES,
+    CODEC_LOGMEL,
+    CODEC_LOGMEL8
+};
+
+struct CodecState
+{
+    AUDIO_CODEC codec;
+    int32_t predictor;      // IMA-ADPCM predicted sample
+    int32_t index;          // IMA-ADPCM step index
+    int8_t pendingCode;     // IMA-ADPCM code of an odd last sample, waiting for its pair (-1: none)
+    FeatureState *features; // Log-mel front end
+};
+
+void Codec_Reset(CodecState &state, AUDIO_CODEC codec);
+size_t Codec_Encode(CodecState &state, uint8_t *dst, const int16_t *src, size_t samples);
+size_t Codec_Flush(CodecState &state, uint8_t *dst);
+size_t Codec_Decode(CodecState &state, int16_t *dst, const uint8_t *src, size_t len);
+size_t Codec_DecodedSamples(AUDIO_CODEC codec, size_t len);
+bool Codec_IsFeatures(AUDIO_CODEC codec);
+const char *Codec_ToString(AUDIO_CODEC codec);
+AUDIO_CODEC Codec_FromString(const char *name);
+
+uint8_t Codec_MulawEncodeSample(int16_t sample);
+int16_t Codec_MulawDecodeSample(uint8_t value);
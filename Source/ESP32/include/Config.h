@@ -0,0 +1,156 @@
+#pragma once
+
+#include <Codec.h>
+
+// Audio capture configurations
+#define I2S_SAMPLE_RATE 16000 // 16kHz
+#define I2S_SAMPLE_BITS 16
+#define I2S_READ_LEN (4 * 1024) // Capture block: 128ms, the unit of VAD, encoding and upload
+#define RECORD_TIME 10 // Recording duration in seconds
+#define I2S_CHANNEL_NUM 1
+#define FLASH_RECORD_SIZE (I2S_CHANNEL_NUM * I2S_SAMPLE_RATE * I2S_SAMPLE_BITS / 8 * RECORD_TIME) // Max recording size is 320KB
+#define SHORT_RECORD_TIME 200 // Microphone warm-up discarded at the start of each recording, in milliseconds
+#define VAD_ENABLE 1 // 1: trim leading silence and stop on trailing silence (see Vad.h), 0: push-to-talk only
+
+// Capture task settings (see Capture.h)
+#define I2S_DMA_BUF_LEN 256     // Samples per DMA buffer (16ms)
+#define I2S_DMA_BUF_COUNT 4     // DMA only covers the capture task latency (64ms), the block queue holds the rest
+#define CAPTURE_READ_LEN (I2S_DMA_BUF_LEN * I2S_SAMPLE_BITS / 8) // Bytes per microphone read in the capture task
+#define CAPTURE_QUEUE_DEPTH 8   // Captured blocks waiting for the voice task (1s)
+#define CAPTURE_TASK_STACK (1024 * 2)
+#define CAPTURE_TASK_PRIORITY 10
+#define CAPTURE_TASK_CORE 1
+#define CAPTURE_IDLE_WAIT_MS 1000  // Capture task sleep between recordings, Capture_Start wakes it right away
+#define VOICE_IDLE_WAKE_MS 1000    // Voice task wake-up period while idle (session heartbeat), the button wakes it right away
+
+// Upload settings
+#ifndef STREAM_UPLOAD
+#define STREAM_UPLOAD 1           // 1: stream I2S blocks to the server while recording, 0: record to file then upload
+#endif
+#define SERVER_PATH "/upload"
+#define SERVER_TIMEOUT 15000      // Response timeout in milliseconds
+#define UPLOAD_CODEC CODEC_IMA_ADPCM            // Codec of the uploaded recording (see Codec.h), CODEC_LOGMEL8 sends log-mel frames for a feature recognizer
+#define ACCEPT_CODECS SYNTH_ACCEPT "ima-adpcm, mulaw, pcm" // Response codecs the device can decode, in order of preference
+#define RESPONSE_READ_LEN 256                   // Bytes read from the response per block
+#define RECORD_FILE_NAME "/recording.wav"       // Recording file used when STREAM_UPLOAD is 0
+
+// Session settings (see Session.h)
+#ifndef SERVER_SESSION
+#define SERVER_SESSION 1                // 1: persistent framed session on SESSION_PORT, 0: one HTTP request per turn
+#endif
+#define SESSION_PORT 5001
+#define SESSION_HEARTBEAT_MS 5000       // Idle time before a PING is sent
+#define SESSION_HEARTBEAT_TIMEOUT 3000  // Time to wait for the PONG before the session is dropped
+#define SESSION_RETRY_MS 2000           // Delay between connection attempts while idle
+#define SESSION_MAX_FRAME 1024          // Largest frame payload in both directions
+#define RECORD_TO_FILE (!SERVER_SESSION && !STREAM_UPLOAD) // e.g. -DSERVER_SESSION=0 -DSTREAM_UPLOAD=0
+
+// Recording log settings (RECORD_TO_FILE or TURN_QUEUE_ENABLE, see RecordLog.h)
+#ifndef RECORD_LOG_ENABLE
+#define RECORD_LOG_ENABLE 1               // 1: record to the raw RECORD_LOG_PARTITION, 0: to RECORD_FILE_NAME on the file system
+#endif
+#define RECORD_LOG_PARTITION "reclog"     // Data partition of partitions.csv
+#define RECORD_LOG_SUBTYPE 0x40           // Its custom data subtype
+#define RECORD_LOG_NATIVE_SIZE 0x100000   // Size of the file standing in for the partition in the native build
+#define RECORD_LOG_BENCHMARK 0            // 1: compare the write throughput and latency with the file system at boot
+
+// Turn queue settings (with the recording log, see TurnQueue.h)
+#ifndef TURN_QUEUE_ENABLE
+#define TURN_QUEUE_ENABLE 1               // 1: the next command is recorded while the previous ones are answered
+#endif
+#define TURN_QUEUE_DEPTH 4                // Recordings queued or being answered
+#define TURN_QUEUE_MIN_SPACE (64 * 1024)  // Free log space needed to start a recording (8s of IMA-ADPCM)
+#define TURN_QUEUE_BUTTON_FIRST 0         // 1: turns started with the button are answered before queued wake-word turns
+#define TURN_WORKER_STACK (1024 * 4)
+#define TURN_WORKER_PRIORITY 5
+#define TURN_WORKER_CORE 0                // Same core as the WiFi stack
+
+// Response clip cache (see ClipCache.h)
+#define CLIP_CACHE_ENABLE 1
+#define CLIP_CACHE_ENTRIES 16            // Clips kept, their ids are advertised in every turn
+#define CLIP_CACHE_BUDGET (128 * 1024)   // Flash used by the clips, least recently played are evicted first
+#define CLIP_CACHE_MAX_CLIP (32 * 1024)  // Larger responses are played but not stored
+
+// Connectivity settings (ESP32, see Connectivity.h)
+#define CONNECTIVITY_FAST_TIMEOUT 1500      // Fast connect (cached BSSID, channel and IP) before falling back to a full scan
+#define CONNECTIVITY_CONNECT_TIMEOUT 10000  // Full connect (scan and DHCP)
+#define CONNECTIVITY_RETRY_MS 2000          // Delay between full connect attempts
+#define CONNECTIVITY_RSSI_MS 1000           // RSSI sample period while connected
+#define CONNECTIVITY_CACHE_IP 1             // 1: reuse the last DHCP lease as a static IP on fast connect
+#define CONNECTIVITY_TASK_STACK (1024 * 3)
+#define CONNECTIVITY_TASK_PRIORITY 3
+#define CONNECTIVITY_TASK_CORE 0            // Same core as the WiFi stack
+
+// Boot settings (see Boot.h)
+#define BOOT_LIST_FILES 0                   // 1: log the file system listing at boot (diagnostic step)
+#define BOOT_TASK_STACK (1024 * 6)          // Stack of a boot step task, freed when the step ends
+#define BOOT_TASK_PRIORITY 3
+#define BOOT_WAIT_MS 1000                   // Longest wait of Boot_Run() between two checks of the steps
+#define BOOT_LINK_WAIT_MS CONNECTIVITY_CONNECT_TIMEOUT // A recording made while WiFi is down waits this long for the link before its upload (RECORD_TO_FILE)
+#define BOOT_LINK_POLL_MS 50
+
+// Metrics settings (see Metrics.h, MetricsServer.h)
+#define METRICS_SERVER 1                    // 1: serve the metrics on http://<device>:METRICS_PORT/metrics (ESP32)
+#define METRICS_PORT 80
+#define METRICS_BUCKETS_MS {100, 250, 500, 1000, 2000, 4000, 8000} // Latency histogram bounds, METRIC_BUCKETS - 1 of them
+#define METRICS_BUFFER_SIZE (8 * 1024)      // Largest /metrics response
+#define METRICS_MAX_TASKS 24                // Tasks reported with their stack high-water mark
+
+// Keyword spotting settings (see Kws.h)
+#define KWS_ENABLE 1                  // 1: listen for the wake word when templates are enrolled, the button still works
+#define KWS_TEMPLATE_FILE "/kws.bin"  // Enrolled templates, written by `program kws enroll` on the PC
+#define KWS_PREROLL_BLOCKS 3          // Blocks heard before the turn starts that are kept for it (384ms)
+
+// Barge-in settings (see BargeIn.h)
+#define BARGE_IN_ENABLE 1             // 1: the microphone keeps running during the response, speech or the button interrupts it
+#define BARGE_IN_PREROLL_BLOCKS 2     // Blocks heard before the speech is detected that are kept for the next turn (256ms)
+
+// Speech synthesis settings (see Synth.h)
+#define SYNTH_ENABLE 0                // 1: ask for phoneme responses (a few hundred bytes), rendered by the formant synthesizer
+#define SYNTH_FRAME_MS 5              // Period of the formant, amplitude and pitch updates
+#define SYNTH_TRANSITION_MS 30        // Formant glide into each phoneme
+#if SYNTH_ENABLE
+#define SYNTH_ACCEPT "phonemes, "     // Preferred in ACCEPT_CODECS, servers without it send audio
+#else
+#define SYNTH_ACCEPT ""
+#endif
+
+// Memory settings (per-turn arena, see Arena.h)
+#define ARENA_BLOCK_SIZE I2S_READ_LEN  // Capture block size
+#define ARENA_BLOCK_COUNT (8 + KWS_ENABLE * KWS_PREROLL_BLOCKS) // Capture blocks: queue, one being filled, two held by the voice task, preroll
+#define ARENA_BUMP_SIZE (4 * 1024)     // Per-turn scratch memory (response buffers)
+
+// Diagnostics
+#define TRACE_DUMP 1 // 1: log the latency trace of every turn as TRACE lines (see Trace.h)
+#define CPU_IDLE_STATS 1 // 1: measure the idle time of both cores (ESP32, sampled by the tick hook of each core)
+
+// Log settings (see Log.h)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO  // Most verbose level compiled in: LOG_LEVEL_NONE, _ERROR, _WARN, _INFO or _DEBUG
+#endif
+#ifndef LOG_BINARY
+#define LOG_BINARY 0              // 1: write binary events for Source/PC/log_decode.py instead of text lines
+#endif
+#define LOG_ASYNC 1               // 1: events are written by the log task, 0: formatted and written by the caller (text only)
+#define LOG_RING_SLOTS 64         // Events waiting for the log task (power of two)
+#define LOG_ARGS_SIZE 48          // Bytes of arguments kept per event, longer strings are cut
+#define LOG_LINE_SIZE 256         // Longest text line
+#define LOG_FORMAT_CACHE 64       // Formats remembered as sent in binary mode (power of two)
+#define LOG_DRAIN_MS 50           // Log task period, it also wakes up when half of the ring is used
+#define LOG_TASK_STACK (1024 * 3)
+#define LOG_TASK_PRIORITY 1       // Below every pipeline task
+#define LOG_TASK_CORE 0
+
+// Playback settings
+#ifndef PLAYER_RING_SIZE
+#define PLAYER_RING_SIZE (16 * 1024)  // Ring buffer between the network reader and the DAC (power of two)
+#endif
+#ifndef PLAYER_PREBUFFER
+#define PLAYER_PREBUFFER (4 * 1024)   // Default watermark: bytes buffered before playback starts (250ms at the 16kHz DAC rate)
+#endif
+#define PLAYER_OUTPUT_RATE I2S_SAMPLE_RATE  // DAC rate, responses are resampled to it (see Resampler.h)
+#define PLAYER_DMA_BUF_LEN 256              // Frames per DMA buffer (16ms)
+#define PLAYER_DMA_BUF_COUNT 4              // Audio queued in the DMA (64ms), the ring holds the rest
+#define PLAYER_TASK_STACK (1024 * 3)
+#define PLAYER_TASK_PRIORITY 9
+#define PLAYER_TASK_CORE 0                  // Not the capture core: playback and capture run at the same time
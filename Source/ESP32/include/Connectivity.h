@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Config.h>
+
+/*
+WiFi connectivity manager (ESP32):
+    A low priority task owns the WiFi connection, the rest of the program only reads the link
+    state and never waits for it. WiFi events (connected, got IP, disconnected) wake the task.
+    After every connection the BSSID, channel and IP lease are stored in NVS; the next connect
+    (boot or reconnect) joins that access point directly on its channel with the cached IP,
+    skipping the scan and DHCP. If it fails within CONNECTIVITY_FAST_TIMEOUT, a full connect
+    follows, retried every CONNECTIVITY_RETRY_MS.
+*/
+
+enum LINK_STATE
+{
+    LINK_DOWN,
+    LINK_CONNECTING,
+    LINK_UP
+};
+
+struct ConnectivityStats
+{
+    uint32_t connects;          // Connections that got an IP
+    uint32_t fastConnects;      // ... of which used the cache
+    uint32_t fastFailures;      // Fast connects that fell back to a full connect
+    uint32_t disconnects;       // Link lost after being up
+    uint32_t lastConnectTime;   // Milliseconds from the start of the last connect to the IP
+    uint32_t maxConnectTime;
+    int8_t rssi;                // Last sample, dBm
+    int8_t minRssi;
+    int8_t maxRssi;
+    int32_t rssiSum;            // Average is rssiSum / rssiSamples
+    uint32_t rssiSamples;
+};
+
+void Connectivity_Init(const char *ssid, const char *password);
+LINK_STATE Connectivity_GetState();
+ConnectivityStats Connectivity_GetStats();
+void Connectivity_Logging();
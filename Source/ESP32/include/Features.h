@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Fixed-point log-mel / MFCC front end:
+    Samples are pre-emphasized (1 - 31/32 z^-1) and cut into FEATURE_FRAME_LEN frames every
+    FEATURE_HOP samples. Each frame is Hamming windowed, normalized to the int16 range and
+    transformed by a 512-point real FFT in 32-bit integers: the even and odd samples are the real
+    and imaginary parts of a 256-point radix-2 FFT, split into the spectrum of the real frame in
+    one more pass, half the work of a complex FFT of the frame. The power spectrum is summed into
+    FEATURE_MEL_BANDS triangular mel bands; the log2 of every band (Q8, normalization undone) is
+    the log-mel feature and its DCT-II gives FEATURE_MFCC cepstral coefficients (c1.., Q8).
+    Only table construction uses floating point, once at init.
+
+    Frames whose mean energy is below `gateEnergy` are reported without being transformed, so a
+    caller watching for speech (Kws.h) only pays for the FFT while something is heard.
+
+    The two kernels, Features_PowerSpectrum() and Features_MelBands(), are also used alone by the
+    host check against a float reference (`program features`, FeatureTool.h). The log-mel frames
+    are the payload of the feature upload codecs (Codec.h).
+*/
+
+#define FEATURE_FFT_BITS 9
+#define FEATURE_FRAME_LEN (1 << FEATURE_FFT_BITS)  // 32ms at 16kHz
+#ifndef FEATURE_HOP
+#define FEATURE_HOP (FEATURE_FRAME_LEN / 2)        // 16ms at 16kHz
+#endif
+#ifndef FEATURE_MEL_BANDS
+#define FEATURE_MEL_BANDS 20
+#endif
+#ifndef FEATURE_MFCC
+#define FEATURE_MFCC 12                            // c1..c12, c0 (loudness) is left out
+#endif
+#define FEATURE_BINS (FEATURE_FRAME_LEN / 2 + 1)
+#define FEATURE_LOW_HZ 125
+#define FEATURE_HIGH_HZ 7000
+
+struct FeatureFrame
+{
+    uint32_t energy;                     // Mean energy of the pre-emphasized frame
+    bool computed;                       // false: below the gate, the features are not set
+    int16_t logMel[FEATURE_MEL_BANDS];   // log2 band energy, Q8
+    int16_t mfcc[FEATURE_MFCC];          // Cepstral coefficients c1.., Q8
+};
+
+struct FeatureState
+{
+    uint32_t sampleRate;
+    int16_t frame[FEATURE_FRAME_LEN];    // Pre-emphasized samples of the current frame
+    size_t fill;
+    int16_t lastSample;                  // Pre-emphasis memory
+    uint32_t gateEnergy;                 // Frames below this mean energy are not transformed
+};
+
+typedef void (*FeatureCallback)(const FeatureFrame &frame, void *context);
+
+void Features_Init(FeatureState &state, uint32_t sampleRate);
+void Features_Process(FeatureState &state, const int16_t *samples, size_t count, FeatureCallback callback, void *context);
+int32_t Features_PowerSpectrum(const int16_t *frame, uint64_t *power);
+void Features_MelBands(const uint64_t *power, int32_t scale, int16_t *logMel);
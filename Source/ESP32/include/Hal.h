@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Hardware abstraction layer:
+    The voice pipeline (VoiceAssistant.cpp, Server.cpp) only talks to the interfaces below.
+    - ESP32 (src/hal/esp32):  I2S microphone, SPIFFS, WiFiClient, GPIO button/LED, DAC player,
+                               raw flash partition
+    - Native (src/hal/native): WAV-file microphone, POSIX files, POSIX sockets, scripted button,
+                               null/recording speaker, memory-mapped file. Built with `pio run -e native`.
+*/
+
+/**
+ * @brief Wake-up signal for a waiting task (FreeRTOS binary semaphore, condition variable on the host).
+ *
+ * Signals do not accumulate: several signals before a wait wake it once. Hal_SignalEvent may be
+ * called from an interrupt on the ESP32.
+ */
+typedef void *HalEvent;
+
+#define FLASH_SECTOR_SIZE 4096  // Erase unit of a FlashRegion
+
+/**
+ * @brief Audio source delivering 16-bit I2S-format samples at I2S_SAMPLE_RATE.
+ */
+class AudioInput
+{
+public:
+    virtual ~AudioInput() {}
+    virtual bool Begin() = 0;
+    virtual size_t Read(uint8_t *buffer, size_t len) = 0; // Blocks until `len` bytes are captured
+    virtual void End() = 0;
+};
+
+/**
+ * @brief An open file of a Storage backend.
+ */
+class StorageFile
+{
+public:
+    virtual ~StorageFile() {}
+    virtual size_t Write(const uint8_t *data, size_t len) = 0;
+    virtual size_t Read(uint8_t *data, size_t len) = 0;
+    virtual bool Seek(uint32_t position) = 0;
+    virtual size_t Size() = 0;
+    virtual void Close() = 0;
+};
+
+/**
+ * @brief File storage for recordings.
+ */
+class Storage
+{
+public:
+    virtual ~Storage() {}
+    virtual bool Begin() = 0;
+    virtual StorageFile *Open(const char *path, bool write) = 0; // NULL on failure, delete after Close()
+    virtual bool Exists(const char *path) = 0;
+    virtual bool Remove(const char *path) = 0;
+    virtual void List(void (*callback)(const char *name, size_t size)) = 0;
+};
+
+/**
+ * @brief Raw flash area with NOR flash semantics, used by the recording log (RecordLog.h).
+ *
+ * Erase() sets whole sectors to 0xFF and Write() can only clear bits, so erased bytes are
+ * written once. The whole area is mapped read-only by Begin(): Map() reads it in place.
+ */
+class FlashRegion
+{
+public:
+    virtual ~FlashRegion() {}
+    virtual bool Begin() = 0;
+    virtual uint32_t Size() = 0;                                          // Bytes, a multiple of FLASH_SECTOR_SIZE
+    virtual bool Erase(uint32_t offset, uint32_t len) = 0;                // Offset and length in whole sectors
+    virtual bool Write(uint32_t offset, const uint8_t *data, size_t len) = 0;
+    virtual const uint8_t *Map() = 0;                                     // NULL before Begin()
+};
+
+/**
+ * @brief Byte stream connection to the server.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() {}
+    virtual bool Connect(const char *host, uint16_t port) = 0;
+    virtual size_t Write(const uint8_t *data, size_t len) = 0;
+    // Waits up to `timeoutMs` for data: returns the bytes read, 0 on timeout, -1 once closed and drained
+    virtual int Read(uint8_t *buffer, size_t len, uint32_t timeoutMs) = 0;
+    virtual bool Connected() = 0;
+    virtual void Stop() = 0;
+    // Network link state, never blocks: while it is down Connect() fails without waiting
+    virtual bool LinkUp() = 0;
+};
+
+/**
+ * @brief Record button and recording LED.
+ */
+class Controls
+{
+public:
+    virtual ~Controls() {}
+    virtual bool ButtonPressed() = 0;                 // Debounced state
+    // Waits up to `timeoutMs` for the button to be pressed (or released), true once it is
+    virtual bool WaitButton(bool pressed, uint32_t timeoutMs) = 0;
+    virtual uint64_t ButtonEdgeTime() = 0;            // Hal_Micros() of the last debounced edge
+    virtual void SetButtonEvent(HalEvent event) = 0;  // Signaled on every debounced edge as well
+    virtual void SetLed(bool on) = 0;
+};
+
+struct PlayerStats
+{
+    uint32_t samplesPlayed;     // Stream samples played (before resampling to the DAC rate)
+    uint32_t underruns;         // Times the ring ran empty before the end of the stream
+    uint32_t bufferedTime;      // Milliseconds from Begin to the first sample
+    size_t maxFill;             // Highest ring fill level observed by the writer
+};
+
+/**
+ * @brief Streaming audio output of unsigned 8-bit samples (see Player.h).
+ */
+class AudioOutput
+{
+public:
+    virtual ~AudioOutput() {}
+    virtual void Begin(uint32_t sampleRate) = 0;
+    virtual size_t Write(const uint8_t *data, size_t len) = 0;
+    virtual void End() = 0;
+    virtual void WaitDone() = 0;
+    virtual void Stop() = 0;
+    virtual const PlayerStats &GetStats() = 0;
+    virtual bool Playing() = 0;           // Audio buffered or still on its way to the DAC
+    virtual uint32_t Position() = 0;      // Stream samples played so far, from any task
+    // Stops playback from any task: Write() returns early, the writer then calls Stop()
+    virtual void Interrupt() = 0;
+};
+
+struct Hal
+{
+    AudioInput *microphone;
+    Storage *storage;
+    Transport *transport;
+    Controls *controls;
+    AudioOutput *speaker;
+    FlashRegion *recordFlash;   // Recording log partition, NULL to record to a Storage file
+};
+
+// Platform services
+unsigned long Hal_Millis();
+uint64_t Hal_Micros();
+void Hal_DelayMs(uint32_t ms);
+bool Hal_StartTask(void (*task)(void *), const char *name, uint32_t stackSize, void *arg, uint8_t priority, int core);
+void Hal_EndTask(); // Last call of a task that returns (Boot.h)
+void Hal_Log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void Hal_LogWrite(const void *data, size_t len); // Raw log output, written by the log task (Log.h)
+HalEvent Hal_CreateEvent();
+void Hal_SignalEvent(HalEvent event);
+bool Hal_WaitEvent(HalEvent event, uint32_t timeoutMs);
+int Hal_CpuIdle(int core); // Idle time of `core` since the previous call, in tenths of a percent, -1 if not measured
+bool Hal_CpuTicks(int core, uint32_t &ticks, uint32_t &idle); // Ticks of `core` so far and those spent idle, false if not measured
+void Heap_Record();
+void Heap_Logging(uint8_t index = 0);
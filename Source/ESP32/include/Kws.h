@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Hal.h>
+#include <Features.h>
+
+/*
+Keyword spotting:
+    The wake word is matched against a few enrolled templates (MFCC sequences, see Features.h)
+    with a streaming subsequence DTW: every frame extends the best path ending on each template
+    frame, a path may start on any input frame, and the keyword is detected when a path through
+    the whole template costs less than `threshold` per step (mean L1 distance, Q8).
+
+    To keep the duty cycle low, the FFT and DTW only run while the input is above an adaptive
+    noise floor (plus KWS_GATE_HANGOVER frames); silent frames cost one energy sum. After a
+    detection the spotter is deaf for KWS_REFRACTORY_MS.
+
+    Templates are enrolled on the PC from recordings of the keyword (`program kws enroll`, see
+    src/hal/native/KwsTool.cpp) and stored as:
+        KwsFileHeader, then for every template: uint16 frames, uint16 reserved,
+        frames x FEATURE_MFCC int16 (little-endian)
+*/
+
+#ifndef KWS_MAX_TEMPLATES
+#define KWS_MAX_TEMPLATES 4
+#endif
+#ifndef KWS_MAX_FRAMES
+#define KWS_MAX_FRAMES 80             // Longest template, 1.28s at 16ms per frame
+#endif
+#ifndef KWS_REFRACTORY_MS
+#define KWS_REFRACTORY_MS 1000        // No detection this long after the last one
+#endif
+#define KWS_GATE_RATIO 4              // Frames are analyzed above this ratio of the noise floor (+6dB)
+#define KWS_GATE_MIN 4096             // Absolute gate, as VAD_MIN_ENERGY
+#define KWS_GATE_HANGOVER 16          // Frames still analyzed after the input falls under the gate
+#define KWS_CALIBRATION_FRAMES 8      // Frames used to seed the noise floor
+#define KWS_MAGIC 0x3153574B          // "KWS1"
+#define KWS_VERSION 1
+
+struct KwsTemplate
+{
+    uint16_t frames;
+    int16_t features[KWS_MAX_FRAMES][FEATURE_MFCC];
+};
+
+struct KwsModel
+{
+    uint16_t count;
+    int32_t threshold;                // Detection threshold, mean L1 MFCC distance per path step (Q8)
+    KwsTemplate templates[KWS_MAX_TEMPLATES];
+};
+
+struct KwsFileHeader
+{
+    uint32_t magic;                   // KWS_MAGIC
+    uint16_t version;                 // KWS_VERSION
+    uint16_t coefficients;            // FEATURE_MFCC the templates were enrolled with
+    uint16_t count;
+    uint16_t reserved;
+    int32_t threshold;
+};
+
+struct KwsDetection
+{
+    uint32_t timeMs;                  // End of the keyword, from Kws_Init
+    int32_t score;                    // Path cost per step, below the threshold
+    uint8_t index;                    // Matched template
+};
+
+struct KwsStats
+{
+    uint32_t frames;                  // Frames seen
+    uint32_t framesComputed;          // Frames above the gate (features and DTW computed)
+    uint32_t detections;
+    int32_t bestScore;                // Lowest score seen, for threshold tuning
+    uint64_t samples;                 // Audio processed
+    uint64_t busyUs;                  // Time spent in Kws_Process
+};
+
+struct KwsState
+{
+    const KwsModel *model;
+    FeatureState features;
+    int32_t cost[KWS_MAX_TEMPLATES][KWS_MAX_FRAMES];    // Best path cost ending on each template frame
+    uint16_t steps[KWS_MAX_TEMPLATES][KWS_MAX_FRAMES];  // ... and its length
+    uint32_t noiseFloor;
+    uint32_t hangover;
+    uint32_t refractory;
+    bool detected;
+    KwsDetection detection;
+    KwsStats stats;
+};
+
+bool Kws_Load(KwsModel &model, Storage &storage, const char *path);
+bool Kws_Save(const KwsModel &model, Storage &storage, const char *path);
+int32_t Kws_Compare(const KwsTemplate &a, const KwsTemplate &b);
+void Kws_Init(KwsState &state, const KwsModel &model);
+bool Kws_Process(KwsState &state, const int16_t *samples, size_t count, KwsDetection &detection);
+void Kws_Logging(const KwsState &state);
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <Config.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+/*
+Logging pipeline:
+    A LOG call stores a binary event in a lock-free ring: the address of the format string, the
+    application state, a timestamp and the raw arguments (strings are copied, cut to what fits).
+    Nothing is formatted or allocated by the caller, and a full ring drops the event (counted)
+    instead of waiting for the serial port. The log task (low priority) drains the ring and
+    writes either text lines, the format applied to the arguments as printf would, or with
+    LOG_BINARY the events themselves, turned back into text on the PC by Source/PC/log_decode.py.
+
+    Levels above LOG_LEVEL are removed at compile time, their arguments are not evaluated.
+    The formats are still checked against their arguments by the compiler.
+
+    Binary stream: frames of LOG_FRAME_SYNC, type, 16-bit length, payload, little-endian
+        'F' format:  id (32-bit), format string; written before the first event of an id
+        'E' event:   id, time (32-bit microseconds), level, state (APP_STATE), argument count,
+                     arguments (LogEvent::args)
+        'D' dropped: events lost since the previous 'D' frame (32-bit)
+    Bytes outside the frames (boot messages, Hal_Log) are passed through by the decoder.
+*/
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#define LOG_FRAME_SYNC 0x1E      // ASCII record separator, not found in log text
+
+// Argument tags of LogEvent::args, each followed by its value
+#define LOG_ARG_INT 'i'          // 32-bit integer
+#define LOG_ARG_LONG 'l'         // 64-bit integer
+#define LOG_ARG_DOUBLE 'd'       // double
+#define LOG_ARG_STRING 's'       // 8-bit length, then the characters without terminator
+
+struct LogEvent
+{
+    const char *format;          // String literal, its address is the id of the format
+    uint32_t timeUs;             // Hal_Micros() at the call, low 32 bits
+    uint8_t level;               // LOG_LEVEL_*
+    uint8_t state;               // APP_STATE at the call
+    uint8_t argc;                // Arguments stored, the ones that did not fit are printed as '?'
+    uint8_t size;                // Bytes of args used
+    uint8_t args[LOG_ARGS_SIZE]; // Tagged arguments, in format order
+};
+
+struct LogStats
+{
+    uint32_t events;             // Events stored since boot
+    uint32_t dropped;            // Events lost because the ring was full
+    uint32_t maxDepth;           // Most events waiting for the log task
+};
+
+void Log_Init();
+void Log_Push(LogEvent &event);
+size_t Log_Format(const LogEvent &event, char *line, size_t size);
+void Log_Flush();
+const LogStats &Log_GetStats();
+
+/**
+ * @brief Appends one tagged argument, the event keeps the arguments that fit.
+ */
+inline void Log_Put(LogEvent &event, char tag, const void *value, size_t len)
+{
+    if (!(event.argc & 0x80) && event.size + 1 + len <= sizeof(event.args))
+    {
+        event.args[event.size] = (uint8_t)tag;
+        memcpy(&event.args[event.size + 1], value, len);
+        event.size += 1 + len;
+        event.argc++;
+    }
+    else
+    {
+        event.argc |= 0x80; // the following arguments are not stored either
+    }
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type Log_Arg(LogEvent &event, T value)
+{
+    if (sizeof(T) > 4)
+    {
+        int64_t wide = (int64_t)value;
+        Log_Put(event, LOG_ARG_LONG, &wide, sizeof(wide));
+    }
+    else
+    {
+        int32_t narrow = (int32_t)value;
+        Log_Put(event, LOG_ARG_INT, &narrow, sizeof(narrow));
+    }
+}
+
+inline void Log_Arg(LogEvent &event, double value)
+{
+    Log_Put(event, LOG_ARG_DOUBLE, &value, sizeof(value));
+}
+
+inline void Log_Arg(LogEvent &event, const char *value)
+{
+    size_t room = sizeof(event.args) - event.size;
+    if ((event.argc & 0x80) || room < 2)
+    {
+        event.argc |= 0x80;
+        return;
+    }
+    value = value ? value : "(null)";
+    size_t len = strnlen(value, room - 2);
+    event.args[event.size] = LOG_ARG_STRING;
+    event.args[event.size + 1] = (uint8_t)len;
+    memcpy(&event.args[event.size + 2], value, len);
+    event.size += 2 + len;
+    event.argc++;
+}
+
+inline void Log_Args(LogEvent &event)
+{
+    (void)event;
+}
+
+template <typename T, typename... Rest>
+inline void Log_Args(LogEvent &event, T value, Rest... rest)
+{
+    Log_Arg(event, value);
+    Log_Args(event, rest...);
+}
+
+/**
+ * @brief Stores a log event, called through the LOG macros.
+ */
+template <typename... Args>
+inline void Log_Write(uint8_t level, const char *format, Args... args)
+{
+    LogEvent event;
+    event.format = format;
+    event.level = level;
+    event.argc = 0;
+    event.size = 0;
+    Log_Args(event, args...);
+    event.argc &= 0x7F;
+    Log_Push(event);
+}
+
+// Never called: lets the compiler check the format of a LOG call against its arguments
+inline void Log_CheckFormat(const char *format, ...) __attribute__((format(printf, 1, 2)));
+inline void Log_CheckFormat(const char *format, ...)
+{
+    (void)format;
+}
+
+#define LOG_AT(level, format, ...) do { if ((level) <= LOG_LEVEL) { if (0) { Log_CheckFormat(format, ##__VA_ARGS__); } Log_Write((level), format, ##__VA_ARGS__); } } while (0)
+#define LOG(format, ...)  LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOGL(format, ...) LOG_AT(LOG_LEVEL_INFO, format "\n", ##__VA_ARGS__)   // Log with newline
+#define LOGE(format, ...) LOG_AT(LOG_LEVEL_ERROR, format "\n", ##__VA_ARGS__)
+#define LOGW(format, ...) LOG_AT(LOG_LEVEL_WARN, format "\n", ##__VA_ARGS__)
+#define LOGD(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format "\n", ##__VA_ARGS__)
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Config.h>
+#include <Server.h>
+#include <Capture.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Device metrics (Prometheus text format):
+    The pipeline adds to counters and latency histograms once per turn (Metrics_RecordCapture,
+    Metrics_RecordTurn), from the statistics it already collects: nothing is added to the audio
+    path and an update is a few relaxed atomic additions. Metrics_Format() writes them as
+    Prometheus text, with the boot-to-ready time and the boot steps (Boot.h); the ESP32 serves it
+    on /metrics (MetricsServer.h) with the heap, task and WiFi gauges, the native build writes it
+    to a file (--metrics).
+
+    Counters restart at boot, Prometheus rate() handles the reset.
+
+    Device series of the ESP32 endpoint:
+    - voice_cpu_ticks_total / voice_cpu_idle_ticks_total{core}: tick interrupts of each core and
+      those that found its idle task running (CPU_IDLE_STATS). The endpoint keeps no state between
+      scrapes, the idle share is rate(voice_cpu_idle_ticks_total) / rate(voice_cpu_ticks_total).
+    - voice_task_runtime_us_total{task}: only with configGENERATE_RUN_TIME_STATS, which is off in
+      the FreeRTOS prebuilt into stock Arduino-ESP32 (it needs an ESP-IDF build with
+      CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS). Without it the series is not served.
+*/
+
+enum METRIC_COUNTER
+{
+    METRIC_TURNS,               // Turns answered (playback ended, played or not)
+    METRIC_TURNS_PLAYED,        // ... with audio played
+    METRIC_RECORDINGS_DROPPED,  // Recordings that could not be queued (TurnQueue.h)
+    METRIC_TURNS_EMPTY,         // Turns without speech, not uploaded
+    METRIC_CAPTURE_BLOCKS,      // I2S blocks captured for recordings
+    METRIC_CAPTURE_QUEUE_OVERRUNS,
+    METRIC_CAPTURE_POOL_OVERRUNS,
+    METRIC_UPLOAD_BYTES,
+    METRIC_RESPONSE_BYTES,
+    METRIC_HTTP_ERROR,          // No status: connection failed or lost
+    METRIC_HTTP_2XX,
+    METRIC_HTTP_3XX,
+    METRIC_HTTP_4XX,
+    METRIC_HTTP_5XX,
+    METRIC_PLAYBACK_UNDERRUNS,
+    METRIC_BARGE_INS,
+    METRIC_COUNTER_COUNT
+};
+
+enum METRIC_HISTOGRAM
+{
+    METRIC_FIRST_AUDIO,         // End of recording to first sample played, played turns
+    METRIC_SERVER_WAIT,         // Last byte sent to first response byte
+    METRIC_TURNAROUND,          // End of recording to end of playback
+    METRIC_HISTOGRAM_COUNT
+};
+
+#define METRIC_BUCKETS 8        // Bounds of METRICS_BUCKETS_MS and +Inf
+
+/**
+ * @brief Text being written by Metrics_Format(), cut at the size of the buffer.
+ */
+struct MetricsText
+{
+    char *buffer;
+    size_t size;
+    size_t length;
+};
+
+void Metrics_Count(METRIC_COUNTER counter, uint32_t value = 1);
+uint32_t Metrics_Counter(METRIC_COUNTER counter);
+void Metrics_Observe(METRIC_HISTOGRAM histogram, uint32_t ms);
+void Metrics_RecordCapture(const CaptureStats &capture);
+void Metrics_RecordTurn(const TurnStats &stats);
+void Metrics_Printf(MetricsText &text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void Metrics_Header(MetricsText &text, const char *name, const char *type, const char *help);
+void Metrics_Format(MetricsText &text);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Config.h>
+
+/*
+Metrics endpoint (ESP32, METRICS_SERVER):
+    GET http://<device>:METRICS_PORT/metrics answers the Prometheus text format: the pipeline
+    counters and latency histograms (Metrics.h), then gauges read when the scrape arrives: heap,
+    task stacks and run time, CPU tick counters, WiFi link and RSSI. The request is handled in the AsyncTCP task,
+    the pipeline tasks do nothing for it.
+*/
+
+void MetricsServer_Init();
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Hal.h>
+#include <Config.h>
+
+#include <driver/i2s.h>
+
+#define PLAYER_PORT I2S_NUM_0         // The only I2S port wired to the built-in DAC
+
+/*
+Streaming playback engine:
+    The network reader pushes unsigned 8-bit samples into a fixed-size ring with Player_Write().
+    The player task converts them from the stream rate to PLAYER_OUTPUT_RATE (Resampler.h) and
+    writes them to the DMA of PLAYER_PORT, which clocks them into the built-in DAC (GPIO25) with
+    I2S timing. The task blocks in i2s_write() while the DMA buffers are full and sleeps while
+    nothing is playing; the CPU never touches individual samples on a timer.
+    Playback starts once the ring holds `watermark` bytes (or the stream has ended). If the ring
+    runs dry while playing, the underrun is counted and the engine re-buffers up to the watermark
+    before resuming, so response length is not limited by memory. Between streams the DMA is
+    drained with mid-scale silence and stopped, the DAC holds mid-scale.
+*/
+
+void Player_Init();
+void Player_Begin(uint32_t sampleRate, size_t watermark = PLAYER_PREBUFFER);
+size_t Player_Write(const uint8_t *data, size_t len);
+void Player_End();
+void Player_WaitDone();
+void Player_Stop();
+void Player_Interrupt();
+bool Player_IsPlaying();
+bool Player_IsActive();
+uint32_t Player_Position();
+const PlayerStats &Player_GetStats();
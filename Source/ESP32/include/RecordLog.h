@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Hal.h>
+#include <Config.h>
+
+/*
+Recording log (RECORD_LOG_ENABLE, with RECORD_TO_FILE or the turn queue):
+    Recordings are appended to a raw data partition (RECORD_LOG_PARTITION in partitions.csv)
+    instead of a SPIFFS file, so a flash write is a page program and never waits for the file
+    system (garbage collection, metadata updates, erases in the middle of the recording).
+
+    The partition is a circular log of records, each starting on a sector boundary:
+        RecordHeader | WAV header | encoded audio | unused up to the next sector
+    A record is written once, front to back. Its header and the WAV header are written with
+    0xFFFFFFFF sizes and the sizes are written over them when the record is closed: NOR flash
+    clears bits without an erase, so nothing is rewritten. A record cut by a reset keeps the
+    0xFFFFFFFF sizes and is overwritten by the next one.
+
+    Sectors are erased ahead of the write head while the device is idle (RecordLog_EraseAhead,
+    one sector per call), so the recording itself only programs pages. If a recording outruns the
+    erased area the next sector is erased inline and counted in the stats.
+
+    The partition is memory-mapped once: a closed record is uploaded straight from the mapping
+    (RecordView, two parts when it wraps around the end of the partition) without a copy
+    through RAM. The flash driver flushes the cache of a range it writes, so the mapping reads
+    the new contents.
+
+    Records still needed (queued turns, TurnQueue.h) are kept with RecordLog_Retain: the write head
+    stops a sector before the oldest of them, RecordLog_Available tells how much can be recorded.
+*/
+
+#define RECORD_LOG_SECTOR FLASH_SECTOR_SIZE
+#define RECORD_LOG_MAGIC 0x474F4C52 // "RLOG"
+#define RECORD_LOG_OPEN 0xFFFFFFFF  // Size of a record that was not closed
+
+struct RecordHeader
+{
+    uint32_t magic;
+    uint32_t sequence;          // Increments with every record, the highest is the newest
+    uint32_t size;              // Bytes after this header (WAV header and audio), RECORD_LOG_OPEN until closed
+    uint32_t check;             // ~size, written with it
+};
+
+/**
+ * @brief A closed record, in place in the mapped partition.
+ */
+struct RecordView
+{
+    const uint8_t *parts[2];    // WAV file, the second part is at the start of the partition when it wraps
+    size_t lengths[2];          // 0 for an unused part
+    size_t size;                // Total bytes
+    uint32_t offset;            // Start of the record in the partition
+};
+
+struct RecordLogStats
+{
+    uint32_t records;           // Records closed since boot
+    uint32_t bytes;             // Bytes written to the last record
+    uint32_t writeUs;           // Time spent writing the last record
+    uint32_t maxWriteUs;        // Longest single write of the last record, erases included
+    uint32_t inlineErases;      // Sectors erased while writing the last record
+    uint32_t aheadErases;       // Sectors erased ahead while idle since boot
+    uint32_t maxEraseUs;        // Longest sector erase since boot
+};
+
+bool RecordLog_Init(FlashRegion &flash);
+bool RecordLog_EraseAhead(uint32_t bytes);
+bool RecordLog_Begin();
+bool RecordLog_Write(const uint8_t *data, size_t len);
+bool RecordLog_End(uint32_t totalAudioLen, RecordView &view);
+void RecordLog_Abandon();
+void RecordLog_Retain(const RecordView *oldest);
+uint32_t RecordLog_Available();
+const RecordLogStats &RecordLog_GetStats();
+void RecordLog_Logging();
+void RecordLog_Benchmark(Storage &storage, uint32_t bytes);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Fixed-point polyphase resampler:
+    Converts a stream of signed 16-bit samples from one rate to another. The ratio is reduced to
+    up/down and the output position advances by exactly down/up input samples, so nothing drifts
+    however long the stream is. Each output sample is the dot product of the last RESAMPLER_TAPS
+    input samples with one phase of a Kaiser-windowed sinc low-pass (cut off below the lower of the
+    two Nyquist frequencies). The table holds RESAMPLER_PHASES phases in Q14; positions between
+    two phases interpolate the two dot products linearly. Ratios whose up divides RESAMPLER_PHASES
+    (8kHz -> 16kHz, 24kHz -> 16kHz...) only ever hit exact phases. Equal rates (a response already
+    in the DAC format) skip the filter: the samples are only delayed.
+    The stream is delayed by RESAMPLER_TAPS / 2 input samples. Only table construction uses
+    floating point, once per Resampler_Init().
+*/
+
+#ifndef RESAMPLER_TAPS
+#define RESAMPLER_TAPS 32       // Input samples per output sample (even)
+#endif
+#ifndef RESAMPLER_PHASES
+#define RESAMPLER_PHASES 64     // Filter phases in the table (power of two)
+#endif
+#define RESAMPLER_ROLLOFF 0.90f // Cut-off as a fraction of the lower Nyquist frequency
+#define RESAMPLER_KAISER_BETA 7.0f // About -70dB ripple and stopband
+
+struct ResamplerState
+{
+    uint32_t up;                // Output rate / gcd
+    uint32_t down;              // Input rate / gcd
+    uint32_t position;          // Position of the next output after the newest input, in 1/up input samples
+    uint32_t next;              // Ring slot of the next input sample
+    int16_t history[2 * RESAMPLER_TAPS];                       // Last inputs, stored twice so the window is contiguous
+    int16_t coeffs[RESAMPLER_PHASES + 1][RESAMPLER_TAPS];      // Q14, the extra phase is phase 0 shifted by one sample
+};
+
+void Resampler_Init(ResamplerState &state, uint32_t inRate, uint32_t outRate);
+size_t Resampler_MaxOutput(const ResamplerState &state, size_t inCount);
+size_t Resampler_MaxInput(const ResamplerState &state, size_t outCapacity);
+size_t Resampler_Process(ResamplerState &state, const int16_t *in, size_t inCount, int16_t *out);
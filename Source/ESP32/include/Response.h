@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Hal.h>
+#include <Codec.h>
+#include <Server.h>
+#include <ClipCache.h>
+#include <AudioFormat.h>
+#include <Synth.h>
+
+/*
+Response audio decoder, shared by the HTTP client (Server.cpp) and the session (Session.cpp):
+    The body is fed in pieces of any size as they arrive. The WAV header is parsed as it arrives
+    (WavParser, AudioFormat.h, any chunk layout) and sets the stream sample rate: a response in
+    PlaybackFormat plays without conversion, other rates are resampled by the player. The body
+    must be mono. A PCM body must be unsigned 8-bit; an encoded body
+    (mu-law or IMA-ADPCM, header describes the decoded 16-bit audio) is decoded piece by piece
+    and reduced to unsigned 8-bit for the DAC. A phoneme body (SYNTH_ENABLE) is rendered by the
+    synthesizer (Synth.h) unit by unit as it arrives. With "X-Clip-Action: store" the body is also
+    written to the clip cache (ClipCache.h) as it arrives.
+*/
+
+struct ResponseStream
+{
+    AUDIO_CODEC codec;
+    CodecState codecState;
+    WavParser wav;              // Header parser, the format once it is done
+    uint32_t dataLeft;          // Audio bytes left in the data chunk, trailing chunks are not played
+    uint32_t received;          // Body bytes received, header included
+    int expected;               // Content-Length, -1 if unknown
+    int16_t *decodeBuff;        // Turn scratch memory (Arena.h)
+    bool playing;               // Header accepted, speaker started
+    bool failed;                // Unsupported format or playback stopped, the rest is dropped
+    ClipWriter clip;            // Clip being stored, if any
+#if SYNTH_ENABLE
+    SynthState synth;           // Phoneme body
+#endif
+};
+
+bool Response_Begin(ResponseStream &stream, const ResponseInfo &info);
+bool Response_Write(ResponseStream &stream, uint8_t *data, size_t len, AudioOutput &speaker, TurnStats &stats);
+void Response_End(ResponseStream &stream, AudioOutput &speaker, TurnStats &stats);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+/**
+ * @brief Fixed-size single-producer/single-consumer byte ring.
+ *
+ * One task writes and one task reads without locking (the player: the response stream writes,
+ * Task_Player reads). The head index is only
+ * written by the producer and the tail index only by the consumer; both run freely and
+ * are masked on access, so `Capacity` must be a power of two.
+ *
+ * @tparam Capacity Size of the ring in bytes.
+ */
+template <size_t Capacity>
+class RingBuffer
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+public:
+    /**
+     * @brief Empties the ring. Only call while neither side is active.
+     */
+    void Reset()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of bytes ready to be read.
+     */
+    size_t Available() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of bytes that can be written without overwriting unread data.
+     */
+    size_t Free() const
+    {
+        return Capacity - Available();
+    }
+
+    /**
+     * @brief Copies up to `len` bytes into the ring (producer side).
+     *
+     * @return Number of bytes written, limited by the free space.
+     */
+    size_t Write(const uint8_t *src, size_t len)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        size_t n = Capacity - (h - t);
+        if (len < n) n = len;
+        size_t offset = h & (Capacity - 1);
+        size_t first = Capacity - offset;
+        if (first > n) first = n;
+        memcpy(data + offset, src, first);
+        memcpy(data, src + first, n - first);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief Copies up to `len` bytes out of the ring (consumer side).
+     *
+     * @return Number of bytes read, limited by the available data.
+     */
+    size_t Read(uint8_t *dst, size_t len)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        size_t n = h - t;
+        if (len < n) n = len;
+        size_t offset = t & (Capacity - 1);
+        size_t first = Capacity - offset;
+        if (first > n) first = n;
+        memcpy(dst, data + offset, first);
+        memcpy(dst + first, data, n - first);
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief Reads a single byte (consumer side).
+     *
+     * @return false if the ring is empty.
+     */
+    inline __attribute__((always_inline)) bool Pop(uint8_t &value)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) return false;
+        value = data[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    uint8_t data[Capacity];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Codec.h>
+
+/*
+Sample conversion kernels for the formats used by the pipeline:
+    - Kernel_DacScale:     16-bit I2S capture -> 16-bit recording (legacy I2S_DACScale, bit-exact)
+    - Kernel_Pcm16ToDac:   signed 16-bit -> unsigned 8-bit DAC
+    - Kernel_MulawToDac:   G.711 mu-law -> unsigned 8-bit DAC (table lookup)
+Gain is a template parameter so the shifts and masks are constants. The 16-bit kernels process
+two or four samples per 32-bit word; buffers must be 4-byte aligned (true for new[] and static
+arrays declared alignas(4)). Every kernel may run in place (dst == src). `program kernels`
+(KernelTool.h) checks them against the per-sample formulas and measures their throughput.
+*/
+
+/**
+ * @brief Scales 16-bit I2S samples for the recording, in place or into `dst`.
+ *
+ * Keeps bits [Shift, Shift + 7] of each sample and moves them to the high byte, the low byte is 0.
+ * With Shift = 3 this is bit-exact with the former byte-wise I2S_DACScale (low 12 bits * 256 / 2048).
+ * Two samples are handled per word: one shift and one mask.
+ *
+ * @tparam Shift Right shift applied to the input sample (0..8), lower values mean more gain.
+ * @param dst Output buffer, may be `src`.
+ * @param src 16-bit samples as read from I2S.
+ * @param len Length of the buffer in bytes.
+ */
+template <unsigned Shift>
+inline void Kernel_DacScale(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    static_assert(Shift <= 8, "Kernel_DacScale shift must be within 0..8");
+    const uint32_t *in = (const uint32_t *)src;
+    uint32_t *out = (uint32_t *)dst;
+    size_t words = len / 4;
+    for (size_t i = 0; i < words; i++)
+    {
+        out[i] = (in[i] << (8 - Shift)) & 0xFF00FF00;
+    }
+    if (len & 2)
+    {
+        const uint16_t *in16 = (const uint16_t *)src;
+        uint16_t *out16 = (uint16_t *)dst;
+        size_t last = len / 2 - 1;
+        out16[last] = (in16[last] << (8 - Shift)) & 0xFF00;
+    }
+}
+
+/**
+ * @brief Converts signed 16-bit samples to unsigned 8-bit DAC values.
+ *
+ * Keeps the high byte and flips its sign bit, four samples per iteration (two words in, one out).
+ *
+ * @param dst Output DAC values, may alias `src`.
+ * @param src Signed 16-bit samples.
+ * @param samples Number of samples.
+ */
+inline void Kernel_Pcm16ToDac(uint8_t *dst, const int16_t *src, size_t samples)
+{
+    const uint32_t *in = (const uint32_t *)src;
+    uint32_t *out = (uint32_t *)dst;
+    size_t quads = samples / 4;
+    for (size_t i = 0; i < quads; i++)
+    {
+        uint32_t w0 = in[2 * i];
+        uint32_t w1 = in[2 * i + 1];
+        out[i] = (((w0 >> 8) & 0x000000FF) | ((w0 >> 16) & 0x0000FF00) |
+                  ((w1 << 8) & 0x00FF0000) | (w1 & 0xFF000000)) ^ 0x80808080;
+    }
+    for (size_t i = quads * 4; i < samples; i++)
+    {
+        dst[i] = (uint8_t)(((uint16_t)src[i] >> 8) ^ 0x80);
+    }
+}
+
+/**
+ * @brief Lookup table from G.711 mu-law to unsigned 8-bit DAC values, built on first use.
+ */
+inline const uint8_t *Kernel_MulawDacTable()
+{
+    static uint8_t table[256];
+    static bool ready = false;
+    if (!ready)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            table[i] = (uint8_t)(((uint16_t)Codec_MulawDecodeSample(i) >> 8) ^ 0x80);
+        }
+        ready = true;
+    }
+    return table;
+}
+
+/**
+ * @brief Decodes G.711 mu-law straight to unsigned 8-bit DAC values with one lookup per sample.
+ *
+ * Same result as Codec_Decode followed by Kernel_Pcm16ToDac, without the 16-bit intermediate.
+ *
+ * @param dst Output DAC values, may alias `src`.
+ * @param src Mu-law codes.
+ * @param samples Number of samples.
+ */
+inline void Kernel_MulawToDac(uint8_t *dst, const uint8_t *src, size_t samples)
+{
+    const uint8_t *table = Kernel_MulawDacTable();
+    for (size_t i = 0; i < samples; i++)
+    {
+        dst[i] = table[src[i]];
+    }
+}
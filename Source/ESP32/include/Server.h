@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Hal.h>
+#include <Codec.h>
+
+/*
+HTTP client for the voice server, written against the Transport interface:
+    - Streaming upload: POST with chunked transfer encoding, one chunk per I2S block. The WAV
+      header carries 0xFFFFFFFF sizes (streaming WAV convention), the server patches them.
+    - File upload: POST of a recording file, or of a record of the recording log read in place
+      from flash (RecordLog.h), with Content-Length.
+    - Response: WAV audio, streamed to the AudioOutput while it is being received, or a
+      reference to a clip cached on the device (ClipCache.h).
+*/
+
+struct RecordView;
+
+struct TurnStats
+{
+    unsigned long pressTime;          // Button press
+    unsigned long releaseTime;        // End of recording (button release or end of utterance)
+    unsigned long lastByteSentTime;   // Last byte of the upload written
+    unsigned long firstResponseTime;  // First byte of the response received
+    unsigned long lastResponseTime;   // Last byte of the response received
+    unsigned long playbackEndTime;    // Last sample played
+    uint32_t pressLatencyUs;          // Button edge to start of the turn (0: started by the wake word)
+    uint32_t releaseLatencyUs;        // Button edge to end of recording (0: ended by the VAD or the time limit)
+    uint32_t recordedBytes;           // Captured PCM bytes
+    uint32_t uploadedBytes;           // Bytes of audio sent (after VAD and encoding)
+    uint32_t responseBytes;           // Bytes of the response body
+    int httpStatus;
+    int bargeIn;                      // BARGE_IN_REASON that interrupted the response (BargeIn.h), 0 if it played out
+    PlayerStats playback;
+};
+
+enum CLIP_ACTION
+{
+    CLIP_NONE,                        // Play the body
+    CLIP_PLAY,                        // Play the cached clip, the body is empty
+    CLIP_STORE                        // Play the body and cache it (see ClipCache.h)
+};
+
+struct ResponseInfo
+{
+    int status;                       // HTTP status (Status header of a session response)
+    int contentLength;                // -1 if unknown
+    AUDIO_CODEC codec;                // X-Audio-Codec
+    uint32_t clipId;                  // X-Clip-Id
+    CLIP_ACTION clipAction;           // X-Clip-Action
+};
+
+void Server_Init(const char *host, uint16_t port);
+size_t Server_FormatTurnHeaders(char *buffer, size_t size);
+void Server_ParseHeaderLine(char *line, ResponseInfo &info);
+bool Server_ReadExact(Transport &transport, uint8_t *buffer, size_t len, uint32_t timeoutMs);
+void Buffer_WriteWavHeader(uint8_t *buffer, uint32_t totalAudioLen);
+void Buffer_WriteStreamingWavHeader(uint8_t *buffer);
+bool Server_StreamBegin(Transport &transport);
+bool Server_StreamWrite(Transport &transport, const uint8_t *data, size_t len);
+bool Server_StreamEnd(Transport &transport);
+void Server_StreamReceive(Transport &transport, AudioOutput &speaker, TurnStats &stats);
+void Server_UploadFile(Transport &transport, Storage &storage, const char *filePath, AudioOutput &speaker, TurnStats &stats);
+void Server_UploadRecording(Transport &transport, const RecordView &recording, AudioOutput &speaker, TurnStats &stats);
+void Server_ReceiveAudio(Transport &transport, const ResponseInfo &info, AudioOutput &speaker, TurnStats &stats);
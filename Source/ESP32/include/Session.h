@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Hal.h>
+#include <Server.h>
+#include <RecordLog.h>
+
+/*
+Persistent framed session with the voice server (SERVER_SESSION):
+    One TCP connection is opened at boot and kept across turns, so a turn starts without a
+    TCP handshake or HTTP headers. Both directions carry frames:
+        type (1 byte) | flags (1 byte) | payload length (2 bytes, little-endian) | payload
+    Control payloads are "Key: value\r\n" lines using the HTTP header names (Server.h).
+
+    Device -> server: HELLO, PING, TURN_BEGIN, AUDIO_UP..., TURN_END (or TURN_CANCEL: no response)
+    Server -> device: HELLO, PONG, RESPONSE_BEGIN, AUDIO_DOWN..., RESPONSE_END
+    Either side answers a PING with a PONG. While idle the device pings every
+    SESSION_HEARTBEAT_MS and reconnects when the PONG is missing or the connection drops.
+    Incoming frames are drained while the audio is uploaded, so a response can start before
+    the upload is complete.
+*/
+
+enum SESSION_FRAME
+{
+    FRAME_HELLO = 1,      // X-Max-Frame
+    FRAME_PING,
+    FRAME_PONG,
+    FRAME_TURN_BEGIN,     // X-Audio-Codec, X-Accept-Codec
+    FRAME_AUDIO_UP,       // Uploaded WAV bytes, streaming header first
+    FRAME_TURN_END,
+    FRAME_RESPONSE_BEGIN, // Status, X-Audio-Codec, Content-Length
+    FRAME_AUDIO_DOWN,     // Response WAV bytes
+    FRAME_RESPONSE_END,
+    FRAME_TURN_CANCEL     // The upload is dropped, the server does not answer
+};
+
+struct SessionStats
+{
+    uint32_t connects;          // Successful connections
+    uint32_t drops;             // Connections lost or closed after a missed heartbeat
+    uint32_t missedHeartbeats;  // PINGs without a PONG in time
+    uint32_t coldTurns;         // Turns that had to open the connection first
+};
+
+void Session_Init(Transport &transport, const char *host, uint16_t port);
+void Session_Poll();
+bool Session_TurnBegin(AudioOutput &speaker, TurnStats &stats);
+bool Session_SendAudio(const uint8_t *data, size_t len);
+bool Session_TurnEnd();
+void Session_TurnCancel();
+void Session_Receive(TurnStats &stats);
+void Session_UploadRecording(const RecordView &recording, AudioOutput &speaker, TurnStats &stats);
+const SessionStats &Session_GetStats();
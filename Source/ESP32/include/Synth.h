@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Config.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Formant speech synthesizer for phoneme responses (SYNTH_ENABLE, codec "phonemes"):
+    Instead of audio the server sends units of 4 bytes after the WAV header, which describes the
+    audio rendered here (16-bit mono at the X-Accept-Format rate):
+        symbol (ASCII, see the table in Synth.cpp) | duration (5 ms) | start pitch | end pitch (2 Hz)
+    A reply of a few hundred bytes replaces tens of kilobytes of audio. Source/PC/phonemes.py
+    turns the reply text into units.
+
+    Each unit is rendered as soon as its 4 bytes have arrived, in blocks written straight to
+    the player, so a long reply streams like an audio one and needs no buffer. The voice is a
+    polynomial glottal pulse (KLGLOTT88 flow derivative) and noise, through a cascade of four
+    formant resonators (vowels, nasals, approximants, aspiration) or a parallel frication
+    resonator (fricatives, stop bursts). Resonators run in fixed point; their coefficients are
+    recomputed every SYNTH_FRAME_MS while the formants glide into the targets of each unit over
+    SYNTH_TRANSITION_MS. Stops are a closure (silent or voiced) ending with a burst. The pitch
+    moves linearly over each unit, a pitch of 0 keeps the previous one.
+
+    `program synth` measures the rendering speed against real time on the host (SynthTool.h).
+*/
+
+#define SYNTH_UNIT_SIZE 4
+#define SYNTH_UNIT_MS 5              // Duration step of a unit
+#define SYNTH_PITCH_STEP 2           // Pitch step of a unit (Hz)
+
+struct SynthPhoneme;
+
+struct SynthResonator
+{
+    int32_t a, b, c;                 // y = a*x + b*y1 + c*y2, Q14
+    int32_t y1, y2;
+};
+
+struct SynthState
+{
+    uint32_t sampleRate;
+    uint32_t frameSamples;           // Samples between parameter updates
+    uint8_t pending[SYNTH_UNIT_SIZE]; // Unit being received
+    uint8_t pendingFill;
+    const SynthPhoneme *phoneme;     // Unit being rendered
+    uint32_t unitSamples;
+    uint32_t unitPos;
+    uint32_t frameLeft;              // Samples left before the next parameter update
+    float pitchStart, pitchEnd;      // Hz
+    float from[3];                   // Formants at the start of the unit (Hz)
+    float formants[3];               // Current formants
+    int32_t voiceAmp;                // Current amplitudes, 0-64, slewed towards the unit targets
+    int32_t fricationAmp;
+    int32_t aspirationAmp;
+    uint32_t phase;                  // Glottal cycle, a period is 2^32
+    uint32_t phaseStep;
+    uint32_t noise;                  // xorshift32 state
+    SynthResonator cascade[4];
+    SynthResonator frication;
+    uint32_t units;                  // Units rendered
+};
+
+void Synth_Begin(SynthState &state, uint32_t sampleRate);
+size_t Synth_Feed(SynthState &state, const uint8_t *data, size_t len);
+size_t Synth_Render(SynthState &state, int16_t *dst, size_t samples);
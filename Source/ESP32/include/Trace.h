@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Per-turn latency tracer:
+    Trace_Mark() stores a microsecond timestamp (Hal_Micros) and an event id into a preallocated
+    ring, nothing is formatted or allocated while a turn is running. After the turn the records are
+    exported, either as text lines on the log (Trace_Dump) or as a binary blob (Trace_Export), and
+    turned into per-stage p50/p95/p99 on the PC by Source/PC/trace_report.py.
+
+    Dump line:   TRACE <turn> <event> <microseconds> <value>
+    Binary blob: TraceBlobHeader followed by `count` TraceRecord, little-endian
+*/
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 128       // Records kept in the ring (power of two), about 12 turns
+#endif
+#define TRACE_MAGIC 0x43525456   // "VTRC"
+#define TRACE_VERSION 1
+
+enum TRACE_EVENT
+{
+    TRACE_BUTTON_PRESS,          // Start of the turn (value: 0 record button, 1 wake word, 2 speech over the response)
+    TRACE_FIRST_BLOCK,           // First I2S block of the recording captured
+    TRACE_RECORD_END,            // Button released or end of utterance
+    TRACE_FIRST_BYTE_SENT,       // Request headers written (value: body size, -1 if chunked)
+    TRACE_LAST_BYTE_SENT,        // End of the request body (value: uploaded bytes)
+    TRACE_FIRST_RESPONSE_BYTE,   // Status line of the response received (value: HTTP status)
+    TRACE_LAST_RESPONSE_BYTE,    // End of the response body (value: response bytes)
+    TRACE_PLAYBACK_START,        // First sample played (value: buffered bytes)
+    TRACE_PLAYBACK_END,          // Last sample played (value: underruns)
+    TRACE_BARGE_IN,              // Response interrupted by the next turn (value: BARGE_IN_REASON)
+    TRACE_EVENT_COUNT
+};
+
+struct TraceRecord
+{
+    uint64_t timeUs;             // Hal_Micros() at the event
+    uint16_t turn;
+    uint8_t event;               // TRACE_EVENT
+    uint8_t reserved;
+    int32_t value;               // Event argument, see TRACE_EVENT
+};
+
+struct TraceBlobHeader
+{
+    uint32_t magic;              // TRACE_MAGIC
+    uint16_t version;            // TRACE_VERSION
+    uint16_t recordSize;         // sizeof(TraceRecord)
+    uint32_t count;              // Records following the header
+    uint32_t dropped;            // Records overwritten before the export
+};
+
+#if TRACE_ENABLE
+uint16_t Trace_BeginTurn(int32_t source = 0);
+void Trace_SetResponseTurn(uint16_t turn);
+void Trace_Mark(TRACE_EVENT event, int32_t value = 0);
+#else
+inline uint16_t Trace_BeginTurn(int32_t = 0) { return 0; }
+inline void Trace_SetResponseTurn(uint16_t) {}
+inline void Trace_Mark(TRACE_EVENT, int32_t = 0) {}
+#endif
+void Trace_Dump(uint16_t turn);
+size_t Trace_Export(uint8_t *buffer, size_t size);
+const char *Trace_ToString(TRACE_EVENT event);
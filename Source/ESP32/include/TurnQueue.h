@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Hal.h>
+#include <Config.h>
+#include <Server.h>
+#include <RecordLog.h>
+
+/*
+Turn queue (TURN_QUEUE_ENABLE with the recording log):
+    A finished recording becomes a job and the voice task goes back to waiting for the next
+    command right away. The turn worker task answers the jobs one after the other: upload from
+    the recording log, server wait, playback of the response. The user can record the next
+    command while the previous ones are in flight.
+
+    Voice task:   record -> RecordLog_End -> TurnQueue_Submit -> next recording
+    Turn worker:  oldest job (highest priority first) -> upload -> response -> playback -> slot freed
+
+    With SERVER_SESSION or STREAM_UPLOAD the server connection belongs to the voice task while
+    no job is in flight, and to the worker otherwise. A turn started with the queue empty is
+    streamed while it is recorded, as without the queue, and its job (without a recording) only
+    receives and plays the response. A turn started while a job is in flight is recorded to
+    the log and uploaded by the worker.
+
+    The responses play one at a time, in submission order or by priority (TURN_QUEUE_BUTTON_FIRST).
+    The recording of a job stays in the recording log until the job is done (RecordLog_Retain), so
+    the free job slots and the free log space both bound the queue: when either runs out, the
+    next recording waits for a response (TurnQueue_Stall) and is limited to the free space.
+
+    A slot is written by the voice task while it is free and by the worker while it is active,
+    the atomic slot state hands it over.
+*/
+
+struct TurnJob
+{
+    uint16_t id;                // Trace turn of the recording (Trace.h)
+    uint8_t priority;           // Higher is answered first
+    uint32_t number;            // Submission order
+    RecordView recording;       // In the recording log, retained until the job is done (size 0: streamed)
+    TurnStats stats;            // Recording part filled by the voice task, the rest by the worker
+    unsigned long queuedTime;   // Hal_Millis() at TurnQueue_Submit
+    unsigned long startTime;    // Hal_Millis() when the worker took it
+};
+
+struct TurnQueueStats
+{
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t maxDepth;          // Most jobs queued or being answered at once
+    uint32_t maxWaitMs;         // Longest time a job waited for the worker
+    uint32_t stalls;            // Recordings that waited for a free slot or log space
+    uint32_t stallMs;           // Total time of those waits
+};
+
+/**
+ * @brief Answers a job, called by the turn worker.
+ */
+typedef void (*TurnHandler)(TurnJob &job);
+
+bool TurnQueue_Init(TurnHandler handler);
+void TurnQueue_SetListener(void (*listener)(const TurnJob &job));
+bool TurnQueue_Active();
+bool TurnQueue_Submit(const RecordView &recording, const TurnStats &turnStats, uint16_t id, uint8_t priority);
+bool TurnQueue_Full();
+uint32_t TurnQueue_Pending();
+const RecordView *TurnQueue_Oldest();
+void TurnQueue_Stall(bool (*busy)());
+void TurnQueue_WaitIdle();
+const TurnQueueStats &TurnQueue_GetStats();
+void TurnQueue_Logging();
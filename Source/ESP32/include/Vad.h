@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Energy-based voice activity detection:
+    Samples are cut into fixed frames (VAD_FRAME_MS). For each frame the DC offset of the previous
+    frame is removed, then the mean energy and the zero-crossing count are computed. A frame is
+    speech when its energy is VAD_ENERGY_RATIO times above the adaptive noise floor, or half of that
+    with a high zero-crossing count (unvoiced consonants). The noise floor follows the energy of
+    silent frames. Speech decisions are held for VAD_HANGOVER_MS to bridge short pauses.
+
+    Vad_Process() works on blocks of any size; frames may span blocks. For each block it reports
+    the sample range to keep: leading silence is trimmed (keeping VAD_PREROLL_MS before the first
+    speech frame when it lies in the same block) and the utterance ends after VAD_END_SILENCE_MS of
+    trailing silence. `program vad` (VadTool.h) runs it over labelled WAV fixtures on the host.
+*/
+
+#ifndef VAD_FRAME_MS
+#define VAD_FRAME_MS 20           // Analysis frame length
+#endif
+#ifndef VAD_HANGOVER_MS
+#define VAD_HANGOVER_MS 200       // Speech decision is held this long after the last speech frame
+#endif
+#ifndef VAD_END_SILENCE_MS
+#define VAD_END_SILENCE_MS 800    // Trailing silence that ends the utterance
+#endif
+#ifndef VAD_PREROLL_MS
+#define VAD_PREROLL_MS 100        // Audio kept before the first speech frame
+#endif
+#define VAD_ENERGY_RATIO 4        // Speech energy threshold relative to the noise floor (+6dB)
+#define VAD_MIN_ENERGY 4096       // Absolute energy floor, avoids triggering on a near-silent input
+#define VAD_ZCR_HIGH 30           // Zero crossings per 10ms above which a frame looks like a fricative
+#define VAD_START_FRAMES 2        // Consecutive speech frames needed to start the utterance
+#define VAD_CALIBRATION_FRAMES 5  // Frames used to seed the noise floor
+
+struct VadConfig
+{
+    uint32_t sampleRate;
+    uint16_t frameMs;
+    uint16_t hangoverMs;
+    uint16_t endSilenceMs;
+    uint16_t prerollMs;
+};
+
+struct VadState
+{
+    VadConfig config;
+    uint32_t frameSamples;
+    uint32_t hangoverFrames;
+    uint32_t endSilenceFrames;
+    uint32_t prerollSamples;
+
+    // Current frame accumulators
+    uint32_t frameCount;      // Samples accumulated in the current frame
+    int64_t frameSum;         // Sum of raw samples, gives the DC offset of the next frame
+    uint64_t frameEnergy;     // Sum of squared DC-free samples
+    uint32_t frameCrossings;  // Zero crossings
+    int32_t dcOffset;
+    bool lastPositive;
+
+    // Decision state
+    uint32_t noiseFloor;
+    uint32_t framesSeen;
+    uint32_t hangover;
+    uint32_t speechRun;
+    uint32_t silenceRun;
+    bool started;
+    bool ended;
+
+    // Statistics
+    uint32_t speechFrames;
+    uint32_t silenceFrames;
+};
+
+struct VadResult
+{
+    size_t keepStart; // First sample of the block to keep
+    size_t keepEnd;   // One past the last sample to keep (keepStart == keepEnd: drop the whole block)
+    bool ended;       // The utterance ended in this block
+    size_t carryOver; // Samples at the end of the previous block that belong to the utterance (preroll)
+};
+
+VadConfig Vad_DefaultConfig(uint32_t sampleRate);
+void Vad_Init(VadState &state, const VadConfig &config);
+void Vad_Restart(VadState &state);
+void Vad_Process(VadState &state, const int16_t *samples, size_t count, VadResult &result);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <Hal.h>
+#include <Server.h>
+
+void VoiceAssistant_Init(const Hal &hal);
+bool VoiceAssistant_RunTurn(TurnStats &stats);
@@ -0,0 +1,57 @@
+#include <App.h>
+
+static APP_STATE appState;
+
+/**
+ * @brief Sets the current state of the application.
+ *
+ * This function updates the global variable that tracks the
+ * current state of the app to the specified state.
+ *
+ * @param state The new state to set for the application.
+ * @return None
+ */
+void App_SetState(APP_STATE state){
+    appState = state;
+}
+
+/**
+ * @brief Retrieves the current state of the application.
+ *
+ * This function returns the current state of the app as
+ * stored in the global variable.
+ *
+ * @return The current state of the application.
+ */
+APP_STATE App_GetState(void){
+    return appState;
+}
+
+/**
+ * @brief Converts the application state to a string representation.
+ *
+ * This function takes an application state enum value and
+ * returns a corresponding string that indicates the state.
+ * If the state does not match any known values, it returns an
+ * empty string.
+ *
+ * @param state The state of the application to convert.
+ * @return A string representation of the app state.
+ */
+const char *App_ToString(APP_STATE state)
+{
+    switch (state)
+    {
+    case SETUP:
+        return "Setup";
+    case PAIRING:
+        return "Pairing";
+    case RUNNING:
+        return "Running";
+    case IDLE:
+        return "IDLE";
+    case END:
+        return "End";
+    }
+    return "";
+}
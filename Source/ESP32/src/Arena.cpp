@@ -0,0 +1,129 @@
+#include <Arena.h>
+#include <App.h>
+#include <atomic>
+
+static_assert(ARENA_BLOCK_COUNT >= 1 && ARENA_BLOCK_COUNT <= 32, "The block pool is tracked in a 32-bit mask");
+static_assert(ARENA_BLOCK_SIZE % 4 == 0, "Blocks hold 32-bit words");
+
+alignas(8) static uint8_t arenaBlocks[ARENA_BLOCK_COUNT][ARENA_BLOCK_SIZE];
+alignas(8) static uint8_t arenaBump[ARENA_BUMP_SIZE];
+static std::atomic<uint32_t> freeMask(ARENA_BLOCK_COUNT == 32 ? 0xFFFFFFFFu : (1u << ARENA_BLOCK_COUNT) - 1);
+static size_t bumpOffset = 0;
+static ArenaStats stats;
+
+/**
+ * @brief Takes a block of ARENA_BLOCK_SIZE bytes from the pool.
+ *
+ * @return The block, or NULL when all blocks are in use.
+ */
+uint8_t *Arena_AllocBlock()
+{
+    uint32_t mask = freeMask.load(std::memory_order_relaxed);
+    uint32_t bit;
+    do
+    {
+        if (mask == 0)
+        {
+            stats.failedAllocations++;
+            return NULL;
+        }
+        bit = mask & (~mask + 1); // lowest free block
+    } while (!freeMask.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acquire, std::memory_order_relaxed));
+
+    uint32_t inUse = ARENA_BLOCK_COUNT - __builtin_popcount(mask & ~bit);
+    stats.blocksInUse = inUse;
+    if (inUse > stats.blocksHighWater)
+    {
+        stats.blocksHighWater = inUse;
+    }
+    return arenaBlocks[__builtin_ctz(bit)];
+}
+
+/**
+ * @brief Returns a block to the pool.
+ *
+ * @param block A block from Arena_AllocBlock(), NULL is ignored.
+ */
+void Arena_FreeBlock(uint8_t *block)
+{
+    if (block == NULL)
+    {
+        return;
+    }
+    size_t index = (block - arenaBlocks[0]) / ARENA_BLOCK_SIZE;
+    uint32_t mask = freeMask.fetch_or(1u << index, std::memory_order_release) | (1u << index);
+    stats.blocksInUse = ARENA_BLOCK_COUNT - __builtin_popcount(mask);
+}
+
+/**
+ * @brief Number of blocks left in the pool, from any task.
+ */
+uint32_t Arena_FreeBlocks()
+{
+    return __builtin_popcount(freeMask.load(std::memory_order_relaxed));
+}
+
+/**
+ * @brief Allocates scratch memory that lives until the end of the turn.
+ *
+ * Only called from the task that answers the turns: the voice task, or the turn worker while the
+ * turn queue is active (TurnQueue.h), never both.
+ *
+ * @param size Number of bytes.
+ * @param align Alignment, a power of two.
+ * @return The memory, or NULL when the bump region is exhausted.
+ */
+void *Arena_Alloc(size_t size, size_t align)
+{
+    size_t offset = (bumpOffset + align - 1) & ~(align - 1);
+    if (offset + size > ARENA_BUMP_SIZE)
+    {
+        stats.failedAllocations++;
+        LOGL("Arena: %u bytes requested, %u bytes left", (unsigned)size, (unsigned)(ARENA_BUMP_SIZE - bumpOffset));
+        return NULL;
+    }
+    bumpOffset = offset + size;
+    stats.bumpUsed = bumpOffset;
+    if (bumpOffset > stats.bumpHighWater)
+    {
+        stats.bumpHighWater = bumpOffset;
+    }
+    return arenaBump + offset;
+}
+
+/**
+ * @brief Releases the bump region once a response has played, from the task that answers the turns.
+ */
+void Arena_Reset()
+{
+    bumpOffset = 0;
+    stats.bumpUsed = 0;
+}
+
+/**
+ * @brief Counts the blocks still taken from the pool as leaked, from the voice task.
+ *
+ * Call once the capture is stopped and the voice task has released its blocks: every block
+ * should be back in the pool. Leaked blocks are not reclaimed because another task may still
+ * own them.
+ */
+void Arena_CheckBlocks()
+{
+    stats.leakedBlocks = ARENA_BLOCK_COUNT - __builtin_popcount(freeMask.load(std::memory_order_relaxed));
+}
+
+const ArenaStats &Arena_GetStats()
+{
+    return stats;
+}
+
+/**
+ * @brief Logs the arena usage, as part of Heap_Logging().
+ */
+void Arena_Logging()
+{
+    LOGL("\tArena blocks: %u/%u in use, high-water %u, leaked %u",
+         (unsigned)stats.blocksInUse, (unsigned)ARENA_BLOCK_COUNT, (unsigned)stats.blocksHighWater, (unsigned)stats.leakedBlocks);
+    LOGL("\tArena scratch: high-water %u/%u bytes, failed allocations %u",
+         (unsigned)stats.bumpHighWater, (unsigned)ARENA_BUMP_SIZE, (unsigned)stats.failedAllocations);
+}
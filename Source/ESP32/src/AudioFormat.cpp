@@ -0,0 +1,162 @@
+#include <AudioFormat.h>
+#include <string.h>
+
+#define WAV_RIFF_SIZE 12    // "RIFF" size "WAVE"
+#define WAV_CHUNK_SIZE 8    // Chunk id and size
+
+static uint32_t Wav_Read(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Starts assembling the next item of `need` bytes in the parser buffer.
+ */
+static void Wav_Expect(WavParser &parser, WAV_PARSE_STATE state, uint32_t need)
+{
+    parser.state = state;
+    parser.fill = 0;
+    parser.need = need;
+}
+
+/**
+ * @brief Prepares the parser for a new header.
+ */
+void Wav_ParserReset(WavParser &parser)
+{
+    memset(&parser, 0, sizeof(parser));
+    Wav_Expect(parser, WAV_PARSE_RIFF, WAV_RIFF_SIZE);
+}
+
+/**
+ * @brief Reads the fmt chunk, the extensible sub-format is reduced to its format tag.
+ *
+ * @return false if the format is not linear PCM.
+ */
+static bool Wav_ReadFormat(WavParser &parser)
+{
+    const uint8_t *fmt = parser.buffer;
+    WavInfo &info = parser.info;
+    info.encoding = Wav_Read(fmt, 2);
+    info.channels = Wav_Read(fmt + 2, 2);
+    info.sampleRate = Wav_Read(fmt + 4, 4);
+    info.sampleBits = Wav_Read(fmt + 14, 2);
+    if (info.encoding == WAV_FORMAT_EXTENSIBLE && parser.need >= 26)
+    {
+        info.encoding = Wav_Read(fmt + 24, 2); // first bytes of the sub-format GUID
+    }
+    parser.haveFormat = true;
+    return info.encoding == WAV_FORMAT_PCM;
+}
+
+/**
+ * @brief Handles a complete chunk header.
+ */
+static void Wav_ReadChunk(WavParser &parser)
+{
+    uint32_t size = Wav_Read(parser.buffer + 4, 4);
+    uint32_t padded = size + (size & 1); // chunks are word aligned
+    if (memcmp(parser.buffer, "data", 4) == 0)
+    {
+        parser.info.dataSize = size;
+        parser.state = parser.haveFormat ? WAV_PARSE_DONE : WAV_PARSE_FAILED;
+    }
+    else if (memcmp(parser.buffer, "fmt ", 4) == 0 && size >= 16)
+    {
+        uint32_t kept = size < WAV_FMT_MAX ? size : WAV_FMT_MAX;
+        Wav_Expect(parser, WAV_PARSE_FMT, kept);
+        parser.skip = padded - kept;
+    }
+    else
+    {
+        parser.state = WAV_PARSE_SKIP;
+        parser.skip = padded;
+    }
+}
+
+/**
+ * @brief Feeds header bytes to the parser.
+ *
+ * Stops at the first audio byte: once the state is WAV_PARSE_DONE the rest of `data` is audio
+ * described by `parser.info`.
+ *
+ * @param parser The parser state.
+ * @param data Bytes of the WAV body.
+ * @param len Number of bytes.
+ * @return Number of bytes used, less than `len` only once the parser is done or failed.
+ */
+size_t Wav_Parse(WavParser &parser, const uint8_t *data, size_t len)
+{
+    size_t used = 0;
+    while (used < len && parser.state != WAV_PARSE_DONE && parser.state != WAV_PARSE_FAILED)
+    {
+        size_t n;
+        if (parser.state == WAV_PARSE_SKIP)
+        {
+            n = len - used < parser.skip ? len - used : parser.skip;
+            parser.skip -= n;
+        }
+        else
+        {
+            n = len - used < parser.need - parser.fill ? len - used : parser.need - parser.fill;
+            memcpy(parser.buffer + parser.fill, data + used, n);
+            parser.fill += n;
+        }
+        used += n;
+        parser.info.headerSize += n;
+        if (parser.info.headerSize > WAV_MAX_HEADER)
+        {
+            parser.state = WAV_PARSE_FAILED;
+            break;
+        }
+
+        if (parser.state == WAV_PARSE_SKIP)
+        {
+            if (parser.skip == 0)
+            {
+                Wav_Expect(parser, WAV_PARSE_CHUNK, WAV_CHUNK_SIZE);
+            }
+            continue;
+        }
+        if (parser.fill < parser.need)
+        {
+            continue;
+        }
+        switch (parser.state)
+        {
+        case WAV_PARSE_RIFF:
+            if (memcmp(parser.buffer, "RIFF", 4) != 0 || memcmp(parser.buffer + 8, "WAVE", 4) != 0)
+            {
+                parser.state = WAV_PARSE_FAILED;
+                break;
+            }
+            Wav_Expect(parser, WAV_PARSE_CHUNK, WAV_CHUNK_SIZE);
+            break;
+        case WAV_PARSE_CHUNK:
+            Wav_ReadChunk(parser);
+            break;
+        case WAV_PARSE_FMT:
+            if (!Wav_ReadFormat(parser))
+            {
+                parser.state = WAV_PARSE_FAILED;
+            }
+            else if (parser.skip > 0)
+            {
+                parser.state = WAV_PARSE_SKIP;
+            }
+            else
+            {
+                Wav_Expect(parser, WAV_PARSE_CHUNK, WAV_CHUNK_SIZE);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return used;
+}
@@ -0,0 +1,281 @@
+#include <BargeIn.h>
+#include <SampleKernels.h>
+#include <Trace.h>
+#include <string.h>
+#include <atomic>
+
+#define BARGE_IN_CALIBRATION_FRAMES 5  // Reads used to seed the noise floor
+
+static_assert((BARGE_IN_REF_SLOTS & (BARGE_IN_REF_SLOTS - 1)) == 0, "BARGE_IN_REF_SLOTS must be a power of two");
+static_assert(BARGE_IN_REF_SLOTS * BARGE_IN_REF_CHUNK > PLAYER_RING_SIZE * 3 / 2, "Reference covers the ring and the echo window");
+static_assert(BARGE_IN_PREROLL_BLOCKS <= CAPTURE_HISTORY_MAX, "Kept blocks fit the capture history");
+
+static Controls *controls = NULL;
+static AudioOutput *speaker = NULL;
+static std::atomic<bool> armed(false);
+static std::atomic<int> reason(BARGE_IN_NONE);  // Set once per response by the capture task
+static bool speakerStopped = false;             // Voice task only
+static uint64_t armTime = 0;                    // Hal_Micros() of BargeIn_Start, older button edges are ignored
+static BargeInStats stats;                      // Capture task while armed
+
+// Playback reference, written by the voice task and read by the capture task
+static volatile uint32_t refEnergy[BARGE_IN_REF_SLOTS]; // Mean energy of each chunk of 8-bit samples
+static std::atomic<uint32_t> refWritten(0);             // Stream samples whose chunk energy is stored
+static std::atomic<uint32_t> refRate(0);                // Stream sample rate, 0 before the response plays
+static uint32_t refSum = 0;
+static uint32_t refFill = 0;
+
+// Detector, capture task only
+alignas(4) static uint8_t frame[CAPTURE_READ_LEN];
+static uint32_t noiseFloor = 0;
+static uint32_t framesSeen = 0;
+static uint32_t trainFrames = 0;    // Reads heard over the playback while learning the echo gain
+static uint32_t speechRun = 0;
+
+/**
+ * @brief Sets the controls and the speaker the response is played on.
+ */
+void BargeIn_Init(Controls &platformControls, AudioOutput &platformSpeaker)
+{
+    controls = &platformControls;
+    speaker = &platformSpeaker;
+}
+
+/**
+ * @brief Arms the detector for the response of a turn. Call before Capture_Monitor().
+ */
+void BargeIn_Start()
+{
+    armed = false;
+    refRate = 0;
+    refWritten = 0;
+    refSum = refFill = 0;
+    noiseFloor = framesSeen = trainFrames = speechRun = 0;
+    memset(&stats, 0, sizeof(stats));
+    speakerStopped = false;
+    armTime = Hal_Micros();
+    reason = BARGE_IN_NONE;
+    armed = true;
+}
+
+/**
+ * @brief Marks the start of the response audio: the reference timeline restarts at its first sample.
+ *
+ * @param sampleRate Rate of the samples given to BargeIn_Reference().
+ */
+void BargeIn_Playback(uint32_t sampleRate)
+{
+    refRate = 0;
+    refWritten = 0;
+    refSum = refFill = 0;
+    refRate = sampleRate;
+}
+
+/**
+ * @brief Records the energy of samples written to the speaker.
+ *
+ * @param samples Unsigned 8-bit samples, in stream order.
+ * @param count Number of samples.
+ */
+void BargeIn_Reference(const uint8_t *samples, size_t count)
+{
+    if (!armed)
+    {
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t d = (int32_t)samples[i] - 128;
+        refSum += d * d;
+        if (++refFill == BARGE_IN_REF_CHUNK)
+        {
+            uint32_t written = refWritten;
+            refEnergy[(written / BARGE_IN_REF_CHUNK) & (BARGE_IN_REF_SLOTS - 1)] = refSum / BARGE_IN_REF_CHUNK;
+            refWritten = written + BARGE_IN_REF_CHUNK; // publish after the slot
+            refSum = refFill = 0;
+        }
+    }
+}
+
+/**
+ * @brief Loudest playback energy the microphone may hear right now.
+ */
+static uint32_t BargeIn_EchoLevel()
+{
+    uint32_t rate = refRate;
+    if (rate == 0)
+    {
+        return 0;
+    }
+    uint32_t written = refWritten;
+    uint32_t position = speaker->Position();
+    if (position > written)
+    {
+        position = written; // the last partial chunk is not stored
+    }
+    uint32_t span = rate * BARGE_IN_ECHO_MS / 1000;
+    uint32_t first = position > span ? (position - span) / BARGE_IN_REF_CHUNK : 0;
+    uint32_t last = position / BARGE_IN_REF_CHUNK;
+    uint32_t level = 0;
+    for (uint32_t chunk = first; chunk <= last && chunk < written / BARGE_IN_REF_CHUNK; chunk++)
+    {
+        uint32_t energy = refEnergy[chunk & (BARGE_IN_REF_SLOTS - 1)];
+        level = energy > level ? energy : level;
+    }
+    return level;
+}
+
+/**
+ * @brief Records the barge-in and interrupts the speaker, only the first reason of a response is kept.
+ */
+static void BargeIn_Trigger(BARGE_IN_REASON why)
+{
+    reason = why;
+    stats.triggerTime = Hal_Millis();
+    stats.reason = why;
+    Trace_Mark(TRACE_BARGE_IN, why);
+    speaker->Interrupt();
+    Hal_SignalEvent(Capture_WakeEvent()); // the voice task may be waiting for the end of playback
+}
+
+/**
+ * @brief Checks one microphone read for the record button or speech over the echo. Called by
+ *        the capture task (CaptureMonitor).
+ *
+ * @param samples Raw 16-bit I2S samples, scaled as the recording (Kernel_DacScale<3>).
+ * @param len Length in bytes, at most CAPTURE_READ_LEN.
+ * @return How the capture goes on: monitoring, or queuing the next turn.
+ */
+CAPTURE_MONITOR BargeIn_Monitor(const uint8_t *samples, size_t len)
+{
+    if (!armed || reason != BARGE_IN_NONE || len > sizeof(frame) || len < 4)
+    {
+        return CAPTURE_MONITOR_CONTINUE;
+    }
+    if (controls->ButtonPressed() && controls->ButtonEdgeTime() > armTime)
+    {
+        BargeIn_Trigger(BARGE_IN_BUTTON);
+        return CAPTURE_MONITOR_QUEUE;
+    }
+    Kernel_DacScale<3>(frame, samples, len);
+    const int16_t *x = (const int16_t *)frame;
+    size_t count = len / 2;
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        sum += x[i];
+    }
+    int32_t mean = (int32_t)(sum / (int64_t)count);
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t d = x[i] - mean;
+        total += (uint64_t)((int64_t)d * d);
+    }
+    uint32_t energy = (uint32_t)(total / count);
+    stats.frames++;
+
+    uint32_t echo = BargeIn_EchoLevel();
+    bool heard = echo >= BARGE_IN_REF_MIN;
+    uint32_t frameMs = (uint32_t)(count * 1000 / I2S_SAMPLE_RATE);
+    if (heard && trainFrames * frameMs < BARGE_IN_TRAIN_MS)
+    {
+        // Learning the echo path: the loudest ratio above the noise keeps the gate conservative
+        uint32_t excess = energy > noiseFloor ? energy - noiseFloor : 0;
+        uint64_t gain = ((uint64_t)excess << 8) / echo;
+        gain = gain > UINT32_MAX ? UINT32_MAX : gain;
+        stats.echoGain = gain > stats.echoGain ? (uint32_t)gain : stats.echoGain;
+        trainFrames++;
+        speechRun = 0;
+        return CAPTURE_MONITOR_CONTINUE;
+    }
+
+    framesSeen++;
+    if (framesSeen <= BARGE_IN_CALIBRATION_FRAMES && !heard)
+    {
+        // Seed the noise floor with the quietest of the first reads after the recording
+        noiseFloor = framesSeen == 1 || energy < noiseFloor ? energy : noiseFloor;
+        return CAPTURE_MONITOR_CONTINUE;
+    }
+    uint32_t threshold = noiseFloor * BARGE_IN_ENERGY_RATIO;
+    threshold = threshold < BARGE_IN_MIN_ENERGY ? BARGE_IN_MIN_ENERGY : threshold;
+    uint64_t expected = heard ? ((uint64_t)echo * stats.echoGain) >> 8 : 0;
+    bool loud = energy > threshold;
+    bool speech = loud && energy > expected * BARGE_IN_ECHO_MARGIN;
+    if (loud && !speech)
+    {
+        stats.echoFrames++;
+    }
+    if (!speech && !heard)
+    {
+        // Follow the noise as the VAD does: fast when it drops, slow when it rises
+        if (energy < noiseFloor)
+        {
+            noiseFloor -= (noiseFloor - energy) >> 2;
+        }
+        else
+        {
+            noiseFloor += (energy - noiseFloor) >> 4;
+        }
+    }
+    speechRun = speech ? speechRun + 1 : 0;
+    if (speechRun < BARGE_IN_START_FRAMES)
+    {
+        return CAPTURE_MONITOR_CONTINUE;
+    }
+    BargeIn_Trigger(BARGE_IN_SPEECH);
+    return CAPTURE_MONITOR_QUEUE_HISTORY;
+}
+
+/**
+ * @brief Checks for a barge-in from the voice task, stops the speaker on the first one.
+ *
+ * Call it before writing to the speaker: the capture task only interrupts the speaker, the ring
+ * is emptied here by its writer.
+ *
+ * @return true once the response must not be played any further.
+ */
+bool BargeIn_Check()
+{
+    if (!armed || reason == BARGE_IN_NONE)
+    {
+        return false;
+    }
+    if (!speakerStopped)
+    {
+        speakerStopped = true;
+        speaker->Stop();
+    }
+    return true;
+}
+
+/**
+ * @brief Disarms the detector at the end of the response.
+ *
+ * @return Why the response was interrupted, BARGE_IN_NONE if it played out. With a reason, the
+ *         capture is queuing the next turn.
+ */
+BARGE_IN_REASON BargeIn_Stop()
+{
+    BargeIn_Check();
+    armed = false;
+    return (BARGE_IN_REASON)reason.load();
+}
+
+const BargeInStats &BargeIn_GetStats()
+{
+    return stats;
+}
+
+const char *BargeIn_ToString(BARGE_IN_REASON why)
+{
+    switch (why)
+    {
+    case BARGE_IN_BUTTON:
+        return "button";
+    case BARGE_IN_SPEECH:
+        return "speech";
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,145 @@
+#include <Boot.h>
+#include <Log.h>
+#include <atomic>
+#include <string.h>
+
+struct BootTask
+{
+    const BootStep *step;
+    uint32_t index;
+    void *context;
+};
+
+static BootTimeline timeline;
+static BootTask tasks[BOOT_MAX_STEPS];
+static std::atomic<uint32_t> doneMask(0);
+static std::atomic<uint32_t> failedMask(0);
+static uint32_t readyMask = 0;
+static HalEvent doneEvent = NULL;  // Step ended -> Boot_Run
+
+/**
+ * @brief Runs a step and records its end, in its task or in the caller if no task could be started.
+ */
+static void Boot_Step(BootTask &task)
+{
+    bool ok = task.step->run(task.context);
+    BootRecord &record = timeline.steps[task.index];
+    record.endUs = (uint32_t)Hal_Micros();
+    record.ok = ok;
+    record.ended = true;
+    if (ok)
+    {
+        uint32_t before = doneMask.fetch_or(1u << task.index);
+        if ((before & readyMask) != readyMask && ((before | 1u << task.index) & readyMask) == readyMask)
+        {
+            timeline.readyUs = record.endUs; // the last ready step
+            timeline.ready = true;
+        }
+    }
+    else
+    {
+        failedMask.fetch_or(1u << task.index);
+    }
+    Hal_SignalEvent(doneEvent);
+}
+
+static void Task_Boot(void *arg)
+{
+    Boot_Step(*(BootTask *)arg);
+    Hal_EndTask();
+}
+
+/**
+ * @brief Runs the boot steps, each one as soon as the steps it needs are done.
+ *
+ * @param steps At most BOOT_MAX_STEPS, `after` refers to their indexes.
+ * @param context Passed to every step.
+ * @return false if a step failed: the steps that need it were not run.
+ */
+bool Boot_Run(const BootStep *steps, uint32_t count, void *context)
+{
+    count = count < BOOT_MAX_STEPS ? count : BOOT_MAX_STEPS;
+    memset(&timeline, 0, sizeof(timeline));
+    timeline.beginUs = (uint32_t)Hal_Micros();
+    timeline.count = count;
+    doneMask = 0;
+    failedMask = 0;
+    if (!doneEvent)
+    {
+        doneEvent = Hal_CreateEvent();
+    }
+
+    readyMask = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        timeline.steps[i].name = steps[i].name;
+        readyMask |= steps[i].ready ? 1u << i : 0;
+    }
+    uint32_t started = 0;
+    for (;;)
+    {
+        uint32_t done = doneMask;
+        uint32_t failed = failedMask;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if ((started & (1u << i)) || (steps[i].after & ~done))
+            {
+                continue;
+            }
+            started |= 1u << i;
+            tasks[i] = {&steps[i], i, context};
+            timeline.steps[i].startUs = (uint32_t)Hal_Micros();
+            timeline.steps[i].started = true;
+            if (!Hal_StartTask(Task_Boot, steps[i].name, BOOT_TASK_STACK, &tasks[i], BOOT_TASK_PRIORITY, steps[i].core))
+            {
+                Boot_Step(tasks[i]); // no memory for a task: run it here
+            }
+        }
+        if ((started & ~(done | failed)) == 0)
+        {
+            break; // nothing running: every step ended or waits for one that failed
+        }
+        // A step that ended since `done` was read has signaled the event
+        Hal_WaitEvent(doneEvent, BOOT_WAIT_MS);
+    }
+    timeline.endUs = (uint32_t)Hal_Micros();
+    return failedMask == 0;
+}
+
+const BootTimeline &Boot_GetTimeline()
+{
+    return timeline;
+}
+
+/**
+ * @brief Logs the boot timeline: start, end and duration of every step (0.1 ms), then boot-to-ready.
+ */
+void Boot_Logging()
+{
+    uint32_t serial = 0;
+    LOGL("Boot timeline (ms since the program started):");
+    for (uint32_t i = 0; i < timeline.count; i++)
+    {
+        const BootRecord &step = timeline.steps[i];
+        if (!step.started)
+        {
+            LOGL("\t%-10s not run", step.name);
+            continue;
+        }
+        uint32_t end = step.ended ? step.endUs : step.startUs;
+        serial += end - step.startUs;
+        LOGL("\t%-10s %6u.%u -> %6u.%u: %5u.%u ms%s", step.name, (unsigned)(step.startUs / 1000), (unsigned)(step.startUs / 100 % 10),
+             (unsigned)(end / 1000), (unsigned)(end / 100 % 10), (unsigned)((end - step.startUs) / 1000),
+             (unsigned)((end - step.startUs) / 100 % 10), step.ok ? "" : " FAILED");
+    }
+    if (timeline.ready)
+    {
+        LOGL("Boot: setup at %u ms, ready at %u ms, all steps done at %u ms (%u ms of steps in series)",
+             (unsigned)(timeline.beginUs / 1000), (unsigned)(timeline.readyUs / 1000), (unsigned)(timeline.endUs / 1000),
+             (unsigned)(serial / 1000));
+    }
+    else
+    {
+        LOGE("Boot: not ready, a step failed");
+    }
+}
@@ -0,0 +1,277 @@
+#include <Capture.h>
+#include <Arena.h>
+#include <BlockQueue.h>
+#include <string.h>
+#include <atomic>
+
+static_assert(I2S_READ_LEN % CAPTURE_READ_LEN == 0, "A capture block holds whole DMA reads");
+static_assert(ARENA_BLOCK_SIZE >= I2S_READ_LEN, "Capture blocks come from the arena pool");
+
+static AudioInput *input = NULL;
+static BlockQueue<CAPTURE_QUEUE_DEPTH> queue;
+static std::atomic<bool> captureRequested(false); // Set by the voice task
+static std::atomic<bool> captureActive(false);    // The capture task may be inside AudioInput::Read
+static size_t discardRemaining = 0;
+static uint8_t discardBuff[CAPTURE_READ_LEN];     // Warm-up and dropped reads
+static CaptureStats stats;
+static HalEvent startEvent = NULL;  // Capture_Start -> capture task
+static HalEvent idleEvent = NULL;   // Capture task left the microphone -> Capture_Stop
+static HalEvent wakeEvent = NULL;   // Block queued (or button edge) -> Capture_Pop
+static CaptureMonitor monitor = NULL;           // Set by Capture_Monitor, cleared by the capture task once queuing
+static uint8_t *history[CAPTURE_HISTORY_MAX];   // Blocks heard while monitoring, oldest first
+static size_t historyCount = 0;
+static size_t historyLimit = 0;
+
+/**
+ * @brief Queues a full block for the voice task, drops it if the queue is full.
+ */
+static void Capture_Queue(uint8_t *block, size_t len)
+{
+    if (!queue.Push(block, len))
+    {
+        Arena_FreeBlock(block);
+        stats.queueOverruns++;
+        return;
+    }
+    Hal_SignalEvent(wakeEvent);
+    stats.blocks++;
+    uint32_t depth = queue.Size();
+    if (depth > stats.maxQueueDepth)
+    {
+        stats.maxQueueDepth = depth;
+    }
+}
+
+/**
+ * @brief Keeps a block heard while monitoring, the oldest one is dropped once the history is full.
+ */
+static void Capture_Keep(uint8_t *block)
+{
+    if (historyLimit == 0)
+    {
+        Arena_FreeBlock(block);
+        return;
+    }
+    if (historyCount == historyLimit)
+    {
+        Arena_FreeBlock(history[0]);
+        memmove(history, history + 1, (historyLimit - 1) * sizeof(history[0]));
+        historyCount--;
+    }
+    history[historyCount++] = block;
+}
+
+/**
+ * @brief Ends the monitoring: queues the history or drops it.
+ */
+static void Capture_EndMonitor(bool queueHistory)
+{
+    monitor = NULL;
+    for (size_t i = 0; i < historyCount; i++)
+    {
+        if (queueHistory)
+        {
+            Capture_Queue(history[i], I2S_READ_LEN);
+        }
+        else
+        {
+            Arena_FreeBlock(history[i]);
+        }
+    }
+    historyCount = 0;
+}
+
+/**
+ * @brief Fills one block from the microphone and queues it.
+ */
+static void Capture_Block()
+{
+    uint8_t *block = Arena_AllocBlock();
+    if (!block)
+    {
+        // Keep draining the DMA even though the audio is lost
+        input->Read(discardBuff, CAPTURE_READ_LEN);
+        stats.poolOverruns++;
+        return;
+    }
+    size_t filled = 0;
+    CAPTURE_MONITOR action = CAPTURE_MONITOR_CONTINUE;
+    while (filled < I2S_READ_LEN && captureRequested)
+    {
+        size_t n = input->Read(block + filled, CAPTURE_READ_LEN);
+        if (monitor && action == CAPTURE_MONITOR_CONTINUE)
+        {
+            action = monitor(block + filled, n);
+        }
+        filled += n;
+    }
+    if (filled < I2S_READ_LEN)
+    {
+        Arena_FreeBlock(block); // stopped in the middle of the block
+        return;
+    }
+    if (monitor)
+    {
+        if (action == CAPTURE_MONITOR_CONTINUE)
+        {
+            Capture_Keep(block);
+            return;
+        }
+        Capture_EndMonitor(action == CAPTURE_MONITOR_QUEUE_HISTORY);
+    }
+    Capture_Queue(block, filled);
+}
+
+/**
+ * @brief Capture task: drains the microphone into the queue while a capture is running.
+ */
+static void Task_Capture(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        // Announce the read before checking the request, Capture_Stop relies on this order
+        captureActive = true;
+        if (!captureRequested)
+        {
+            captureActive = false;
+            Hal_SignalEvent(idleEvent);
+            Hal_WaitEvent(startEvent, CAPTURE_IDLE_WAIT_MS);
+            continue;
+        }
+        if (discardRemaining > 0)
+        {
+            size_t len = discardRemaining < CAPTURE_READ_LEN ? discardRemaining : CAPTURE_READ_LEN;
+            discardRemaining -= input->Read(discardBuff, len);
+            continue;
+        }
+        Capture_Block();
+    }
+}
+
+/**
+ * @brief Starts the capture task.
+ *
+ * @param microphone The audio input drained by the task, started and stopped by the caller.
+ */
+void Capture_Init(AudioInput &microphone)
+{
+    input = &microphone;
+    startEvent = Hal_CreateEvent();
+    idleEvent = Hal_CreateEvent();
+    wakeEvent = Hal_CreateEvent();
+    Hal_StartTask(Task_Capture, "Task_Capture", CAPTURE_TASK_STACK, NULL, CAPTURE_TASK_PRIORITY, CAPTURE_TASK_CORE);
+}
+
+/**
+ * @brief Starts queuing blocks. The microphone must be started.
+ *
+ * @param discardBytes Bytes read and dropped first (microphone warm-up).
+ */
+void Capture_Start(size_t discardBytes)
+{
+    queue.Reset();
+    stats = CaptureStats();
+    discardRemaining = discardBytes;
+    monitor = NULL;
+    captureRequested = true;
+    Hal_SignalEvent(startEvent);
+}
+
+/**
+ * @brief Starts monitoring: reads go to `callback`, blocks are only kept until it asks for queuing.
+ *
+ * The microphone must be started and warmed up. Once queuing, the capture is the same as after
+ * Capture_Start() and is ended with Capture_Stop().
+ *
+ * @param callback Called by the capture task with every read, see CAPTURE_MONITOR.
+ * @param historyBlocks Blocks kept before the one the callback ends the monitoring in (at most
+ *                      CAPTURE_HISTORY_MAX).
+ */
+void Capture_Monitor(CaptureMonitor callback, size_t historyBlocks)
+{
+    queue.Reset();
+    stats = CaptureStats();
+    discardRemaining = 0;
+    historyCount = 0;
+    historyLimit = historyBlocks < CAPTURE_HISTORY_MAX ? historyBlocks : CAPTURE_HISTORY_MAX;
+    monitor = callback;
+    captureRequested = true;
+    Hal_SignalEvent(startEvent);
+}
+
+/**
+ * @brief Stops queuing and waits until the capture task has left the microphone.
+ *
+ * Blocks still in the queue, or kept while monitoring, are released. The wait is at most one
+ * CAPTURE_READ_LEN read, after which the microphone can be stopped safely.
+ */
+void Capture_Stop()
+{
+    captureRequested = false;
+    while (captureActive)
+    {
+        Hal_WaitEvent(idleEvent, 10);
+    }
+    uint8_t *block;
+    size_t len;
+    while (queue.Pop(block, len))
+    {
+        Arena_FreeBlock(block);
+    }
+    Capture_EndMonitor(false);
+}
+
+/**
+ * @brief Takes the oldest captured block, sleeping until one is queued.
+ *
+ * The wait also ends on a signal of Capture_WakeEvent() (a button edge), so the caller can react
+ * without waiting for the next block.
+ *
+ * @param block Set to the block, give it back with Capture_Release().
+ * @param len Set to the number of bytes in the block.
+ * @param timeoutMs Time to wait for a block.
+ * @return false if no block was captured in time, or the wait was interrupted.
+ */
+bool Capture_Pop(uint8_t *&block, size_t &len, uint32_t timeoutMs)
+{
+    if (queue.Pop(block, len))
+    {
+        return true;
+    }
+    Hal_WaitEvent(wakeEvent, timeoutMs);
+    return queue.Pop(block, len);
+}
+
+/**
+ * @brief Event that wakes Capture_Pop(), given to the controls so a button edge interrupts the wait.
+ */
+HalEvent Capture_WakeEvent()
+{
+    return wakeEvent;
+}
+
+/**
+ * @brief Returns a block from Capture_Pop() to the pool.
+ */
+void Capture_Release(uint8_t *block)
+{
+    Arena_FreeBlock(block);
+}
+
+/**
+ * @brief Tells whether the next block would be dropped: the queue is full or the pool is empty.
+ *
+ * Called by a microphone that can wait for the voice task instead of losing audio (the native
+ * WAV microphone when it is not paced), from its Read() in the capture task. Always false while
+ * monitoring, the history does not wait for the voice task, and once Capture_Stop() was called.
+ */
+bool Capture_Backlogged()
+{
+    return captureRequested && monitor == NULL && (queue.Size() >= CAPTURE_QUEUE_DEPTH || Arena_FreeBlocks() == 0);
+}
+
+const CaptureStats &Capture_GetStats()
+{
+    return stats;
+}
@@ -0,0 +1,376 @@
+#include <ClipCache.h>
+#include <App.h>
+#include <Config.h>
+#include <Arena.h>
+#include <Response.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CLIP_INDEX_FILE "/clips.idx"
+#define CLIP_INDEX_MAGIC 0x50494C43 // "CLIP"
+#define CLIP_INDEX_VERSION 1
+#define CLIP_PATH_LEN 16
+
+struct ClipEntry
+{
+    uint32_t id;
+    uint32_t size;              // Bytes of the clip file
+    uint32_t crc;               // CRC-32 of the clip file
+    uint32_t lastUse;           // Value of the use clock when last played or stored
+    uint8_t codec;
+    uint8_t reserved[3];
+};
+
+struct ClipIndexHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t useClock;
+};
+
+static Storage *clipStorage = NULL;
+static ClipEntry entries[CLIP_CACHE_ENTRIES];
+static uint16_t entryCount = 0;
+static uint32_t useClock = 0;
+static ClipCacheStats stats;
+
+/**
+ * @brief Updates a CRC-32 (IEEE 802.3) with `len` bytes, 4 bits at a time.
+ */
+static uint32_t Clip_Crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static void Clip_Path(char *path, uint32_t id)
+{
+    snprintf(path, CLIP_PATH_LEN, "/c_%08x.wav", (unsigned)id);
+}
+
+static int Clip_Find(uint32_t id)
+{
+    for (int i = 0; i < entryCount; i++)
+    {
+        if (entries[i].id == id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Rewrites the index file.
+ */
+static void Clip_SaveIndex()
+{
+    StorageFile *file = clipStorage->Open(CLIP_INDEX_FILE, true);
+    if (!file)
+    {
+        LOGE("Clip cache: cannot write the index");
+        return;
+    }
+    ClipIndexHeader header = {CLIP_INDEX_MAGIC, CLIP_INDEX_VERSION, entryCount, useClock};
+    file->Write((const uint8_t *)&header, sizeof(header));
+    file->Write((const uint8_t *)entries, entryCount * sizeof(ClipEntry));
+    file->Close();
+    FREE(file);
+}
+
+/**
+ * @brief Removes an entry and its file, the index is saved by the caller.
+ */
+static void Clip_Remove(int index)
+{
+    char path[CLIP_PATH_LEN];
+    Clip_Path(path, entries[index].id);
+    clipStorage->Remove(path);
+    stats.bytesUsed -= entries[index].size;
+    entries[index] = entries[--entryCount];
+}
+
+/**
+ * @brief Reads a clip file through, checking its size and CRC against the entry.
+ *
+ * @param buffer Scratch memory of RESPONSE_READ_LEN bytes.
+ */
+static bool Clip_Verify(const ClipEntry &entry, uint8_t *buffer)
+{
+    char path[CLIP_PATH_LEN];
+    Clip_Path(path, entry.id);
+    StorageFile *file = clipStorage->Open(path, false);
+    if (!file)
+    {
+        return false;
+    }
+    uint32_t crc = 0, size = 0;
+    size_t len;
+    while ((len = file->Read(buffer, RESPONSE_READ_LEN)) > 0)
+    {
+        crc = Clip_Crc32(crc, buffer, len);
+        size += len;
+    }
+    file->Close();
+    FREE(file);
+    return size == entry.size && crc == entry.crc;
+}
+
+/**
+ * @brief Loads the index and drops the clips that fail the integrity check.
+ *
+ * @param storage The file system holding the clips, must outlive the module.
+ */
+void ClipCache_Init(Storage &storage)
+{
+#if CLIP_CACHE_ENABLE
+    clipStorage = &storage;
+    entryCount = 0;
+    stats = ClipCacheStats();
+    StorageFile *file = storage.Open(CLIP_INDEX_FILE, false);
+    if (file)
+    {
+        ClipIndexHeader header;
+        if (file->Read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == CLIP_INDEX_MAGIC && header.version == CLIP_INDEX_VERSION && header.count <= CLIP_CACHE_ENTRIES &&
+            file->Read((uint8_t *)entries, header.count * sizeof(ClipEntry)) == header.count * sizeof(ClipEntry))
+        {
+            entryCount = header.count;
+            useClock = header.useClock;
+        }
+        file->Close();
+        FREE(file);
+    }
+
+    uint8_t buffer[RESPONSE_READ_LEN];
+    bool changed = false;
+    for (int i = entryCount - 1; i >= 0; i--)
+    {
+        stats.bytesUsed += entries[i].size;
+        if (!Clip_Verify(entries[i], buffer))
+        {
+            LOGW("Clip cache: clip %08x is corrupt, dropped", (unsigned)entries[i].id);
+            stats.corrupt++;
+            Clip_Remove(i);
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        Clip_SaveIndex();
+    }
+    stats.entries = entryCount;
+    LOGL("Clip cache: %u clips, %u bytes", (unsigned)entryCount, (unsigned)stats.bytesUsed);
+#else
+    (void)storage;
+#endif
+}
+
+/**
+ * @brief Formats the X-Cached-Clips header line advertising the cached ids.
+ *
+ * @return Length of the formatted text, 0 when the cache is empty.
+ */
+size_t ClipCache_FormatIds(char *buffer, size_t size)
+{
+    if (entryCount == 0 || size == 0)
+    {
+        return 0;
+    }
+    size_t len = snprintf(buffer, size, "X-Cached-Clips: ");
+    for (int i = 0; i < entryCount && len + 12 < size; i++)
+    {
+        len += snprintf(buffer + len, size - len, i == 0 ? "%08x" : ", %08x", (unsigned)entries[i].id);
+    }
+    if (len + 3 > size)
+    {
+        buffer[0] = '\0';
+        return 0;
+    }
+    len += snprintf(buffer + len, size - len, "\r\n");
+    return len;
+}
+
+/**
+ * @brief Plays a cached clip through the response decoder.
+ *
+ * @param id Clip id from the X-Clip-Id header.
+ * @param speaker The audio output to stream to.
+ * @param turnStats Receives the response timing, as for a downloaded response.
+ * @return false if the clip is not cached (miss).
+ */
+bool ClipCache_Play(uint32_t id, AudioOutput &speaker, TurnStats &turnStats)
+{
+    int index = clipStorage ? Clip_Find(id) : -1;
+    char path[CLIP_PATH_LEN];
+    Clip_Path(path, id);
+    StorageFile *file = index >= 0 ? clipStorage->Open(path, false) : NULL;
+    // Turn scratch memory, released by Arena_Reset() at the end of the turn
+    uint8_t *buffer = (uint8_t *)Arena_Alloc(RESPONSE_READ_LEN);
+    ResponseInfo info = {200, (int)(index >= 0 ? entries[index].size : 0), CODEC_PCM, id, CLIP_NONE};
+    ResponseStream stream;
+    if (index >= 0)
+    {
+        info.codec = (AUDIO_CODEC)entries[index].codec;
+    }
+    if (!file || !buffer || !Response_Begin(stream, info))
+    {
+        if (file)
+        {
+            file->Close();
+            FREE(file);
+        }
+        LOGL("Clip cache: miss for clip %08x", (unsigned)id);
+        stats.misses++;
+        return false;
+    }
+
+    uint32_t crc = 0;
+    size_t len;
+    while ((len = file->Read(buffer, RESPONSE_READ_LEN)) > 0)
+    {
+        crc = Clip_Crc32(crc, buffer, len); // before decoding, mu-law is decoded in place
+        if (!Response_Write(stream, buffer, len, speaker, turnStats))
+        {
+            break;
+        }
+    }
+    file->Close();
+    FREE(file);
+    Response_End(stream, speaker, turnStats);
+
+    if (len == 0 && crc != entries[index].crc)
+    {
+        LOGW("Clip cache: clip %08x failed its CRC, dropped", (unsigned)id);
+        stats.corrupt++;
+        Clip_Remove(index);
+    }
+    else
+    {
+        entries[index].lastUse = ++useClock;
+        stats.hits++;
+        stats.bytesSaved += entries[index].size;
+    }
+    stats.entries = entryCount;
+    Clip_SaveIndex();
+    return true;
+}
+
+/**
+ * @brief Starts storing a downloaded response under `id`.
+ *
+ * A clip already cached under the same id is replaced.
+ */
+void ClipCache_BeginStore(ClipWriter &writer, uint32_t id, AUDIO_CODEC codec)
+{
+    memset(&writer, 0, sizeof(writer));
+    stats.misses++;
+    if (!clipStorage)
+    {
+        return;
+    }
+    int index = Clip_Find(id);
+    if (index >= 0)
+    {
+        Clip_Remove(index);
+        Clip_SaveIndex();
+    }
+    char path[CLIP_PATH_LEN];
+    Clip_Path(path, id);
+    writer.file = clipStorage->Open(path, true);
+    writer.id = id;
+    writer.codec = codec;
+}
+
+/**
+ * @brief Appends response bytes to the clip, before they are decoded.
+ *
+ * Clips larger than CLIP_CACHE_MAX_CLIP are abandoned.
+ */
+void ClipCache_Write(ClipWriter &writer, const uint8_t *data, size_t len)
+{
+    if (!writer.file)
+    {
+        return;
+    }
+    if (writer.size + len > CLIP_CACHE_MAX_CLIP || writer.file->Write(data, len) != len)
+    {
+        ClipCache_EndStore(writer, false);
+        return;
+    }
+    writer.crc = Clip_Crc32(writer.crc, data, len);
+    writer.size += len;
+}
+
+/**
+ * @brief Adds the clip to the index, evicting the least recently played clips to make room.
+ *
+ * @param complete false if the response was cut short, the clip is discarded.
+ */
+void ClipCache_EndStore(ClipWriter &writer, bool complete)
+{
+    if (!writer.file)
+    {
+        return;
+    }
+    writer.file->Close();
+    FREE(writer.file);
+    char path[CLIP_PATH_LEN];
+    Clip_Path(path, writer.id);
+    if (!complete || writer.size == 0)
+    {
+        clipStorage->Remove(path);
+        return;
+    }
+
+    while (entryCount > 0 && (entryCount >= CLIP_CACHE_ENTRIES || stats.bytesUsed + writer.size > CLIP_CACHE_BUDGET))
+    {
+        int oldest = 0;
+        for (int i = 1; i < entryCount; i++)
+        {
+            if (entries[i].lastUse < entries[oldest].lastUse)
+            {
+                oldest = i;
+            }
+        }
+        LOGL("Clip cache: evicting clip %08x", (unsigned)entries[oldest].id);
+        Clip_Remove(oldest);
+        stats.evictions++;
+    }
+    ClipEntry &entry = entries[entryCount++];
+    memset(&entry, 0, sizeof(entry));
+    entry.id = writer.id;
+    entry.size = writer.size;
+    entry.crc = writer.crc;
+    entry.lastUse = ++useClock;
+    entry.codec = writer.codec;
+    stats.bytesUsed += writer.size;
+    stats.stores++;
+    stats.entries = entryCount;
+    Clip_SaveIndex();
+    LOGL("Clip cache: stored clip %08x, %u bytes", (unsigned)writer.id, (unsigned)writer.size);
+}
+
+const ClipCacheStats &ClipCache_GetStats()
+{
+    return stats;
+}
+
+/**
+ * @brief Logs the hit and miss counters of the cache.
+ */
+void ClipCache_Logging()
+{
+    LOGL("Clip cache: %u hits, %u misses, %u bytes saved, %u clips (%u bytes), %u evictions, %u corrupt",
+         (unsigned)stats.hits, (unsigned)stats.misses, (unsigned)stats.bytesSaved, (unsigned)stats.entries,
+         (unsigned)stats.bytesUsed, (unsigned)stats.evictions, (unsigned)stats.corrupt);
+}
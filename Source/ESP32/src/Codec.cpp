@@ -0,0 +1,358 @@
+#include <Codec.h>
+#include <Config.h>
+#include <string.h>
+#include <strings.h>
+
+#define MULAW_BIAS 0x84
+#define MULAW_CLIP 32635
+
+static FeatureState featureEncoder;  // Front end of the log-mel codecs, one stream at a time
+
+struct FeatureOutput
+{
+    AUDIO_CODEC codec;
+    uint8_t *dst;
+    size_t len;
+};
+
+static const int16_t imaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t imaIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8};
+
+/**
+ * @brief Encodes one sample to G.711 mu-law.
+ *
+ * @param sample Signed 16-bit sample.
+ * @return The 8-bit mu-law code.
+ */
+uint8_t Codec_MulawEncodeSample(int16_t sample)
+{
+    int32_t value = sample;
+    uint8_t sign = 0;
+    if (value < 0)
+    {
+        value = -value;
+        sign = 0x80;
+    }
+    if (value > MULAW_CLIP) value = MULAW_CLIP;
+    value += MULAW_BIAS;
+    // Segment = position of the highest set bit above bit 7 (value is within [0x84, 0x7FFF])
+    uint8_t exponent = (31 - __builtin_clz(value)) - 7;
+    uint8_t mantissa = (value >> (exponent + 3)) & 0x0F;
+    return ~(sign | (exponent << 4) | mantissa);
+}
+
+/**
+ * @brief Decodes one G.711 mu-law code.
+ *
+ * @param value The 8-bit mu-law code.
+ * @return Signed 16-bit sample.
+ */
+int16_t Codec_MulawDecodeSample(uint8_t value)
+{
+    value = ~value;
+    int32_t magnitude = ((((value & 0x0F) << 3) + MULAW_BIAS) << ((value & 0x70) >> 4)) - MULAW_BIAS;
+    return (value & 0x80) ? -magnitude : magnitude;
+}
+
+/**
+ * @brief Encodes one sample to a 4-bit IMA-ADPCM code and updates the predictor.
+ */
+static inline uint8_t Codec_AdpcmEncodeSample(CodecState &state, int16_t sample)
+{
+    int32_t step = imaStepTable[state.index];
+    int32_t diff = sample - state.predictor;
+    uint8_t code = 0;
+    if (diff < 0)
+    {
+        code = 8;
+        diff = -diff;
+    }
+    int32_t vpdiff = step >> 3;
+    if (diff >= step) { code |= 4; diff -= step; vpdiff += step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; vpdiff += step; }
+    step >>= 1;
+    if (diff >= step) { code |= 1; vpdiff += step; }
+
+    state.predictor += (code & 8) ? -vpdiff : vpdiff;
+    if (state.predictor > 32767) state.predictor = 32767;
+    else if (state.predictor < -32768) state.predictor = -32768;
+    state.index += imaIndexTable[code];
+    if (state.index < 0) state.index = 0;
+    else if (state.index > 88) state.index = 88;
+    return code;
+}
+
+/**
+ * @brief Decodes one 4-bit IMA-ADPCM code and updates the predictor.
+ */
+static inline int16_t Codec_AdpcmDecodeSample(CodecState &state, uint8_t code)
+{
+    int32_t step = imaStepTable[state.index];
+    int32_t vpdiff = step >> 3;
+    if (code & 4) vpdiff += step;
+    if (code & 2) vpdiff += step >> 1;
+    if (code & 1) vpdiff += step >> 2;
+
+    state.predictor += (code & 8) ? -vpdiff : vpdiff;
+    if (state.predictor > 32767) state.predictor = 32767;
+    else if (state.predictor < -32768) state.predictor = -32768;
+    state.index += imaIndexTable[code];
+    if (state.index < 0) state.index = 0;
+    else if (state.index > 88) state.index = 88;
+    return state.predictor;
+}
+
+/**
+ * @brief Writes the log-mel bands of a frame to the encoder output.
+ */
+static void Codec_FeatureFrame(const FeatureFrame &frame, void *context)
+{
+    FeatureOutput &out = *(FeatureOutput *)context;
+    for (int b = 0; b < FEATURE_MEL_BANDS; b++)
+    {
+        int32_t value = frame.logMel[b];
+        if (out.codec == CODEC_LOGMEL8)
+        {
+            int32_t code = (value - CODEC_LOGMEL8_FLOOR + CODEC_LOGMEL8_STEP / 2) / CODEC_LOGMEL8_STEP;
+            out.dst[out.len++] = (uint8_t)(value < CODEC_LOGMEL8_FLOOR ? 0 : (code > 255 ? 255 : code));
+        }
+        else
+        {
+            out.dst[out.len++] = (uint8_t)(value & 0xFF);
+            out.dst[out.len++] = (uint8_t)((value >> 8) & 0xFF);
+        }
+    }
+}
+
+/**
+ * @brief Starts a new stream with the given codec.
+ *
+ * @param state The codec state carried across blocks of the same stream.
+ * @param codec The codec of the stream.
+ */
+void Codec_Reset(CodecState &state, AUDIO_CODEC codec)
+{
+    state.codec = codec;
+    state.predictor = 0;
+    state.index = 0;
+    state.pendingCode = -1;
+    state.features = NULL;
+    if (Codec_IsFeatures(codec))
+    {
+        // Every frame is transformed: the gate is left at 0
+        Features_Init(featureEncoder, I2S_SAMPLE_RATE);
+        state.features = &featureEncoder;
+    }
+}
+
+/**
+ * @brief Encodes a block of 16-bit samples.
+ *
+ * @param state The codec state of the stream.
+ * @param dst Output buffer, may be the same memory as `src`.
+ * @param src Signed 16-bit samples.
+ * @param samples Number of samples. For IMA-ADPCM the code of an odd last sample is kept for the next
+ *                call (or Codec_Flush()), so blocks of any size make one continuous stream.
+ *                For the log-mel codecs the samples of an unfinished frame are kept for the next call.
+ * @return Number of bytes written to `dst`.
+ */
+size_t Codec_Encode(CodecState &state, uint8_t *dst, const int16_t *src, size_t samples)
+{
+    switch (state.codec)
+    {
+    case CODEC_MULAW:
+        for (size_t i = 0; i < samples; i++)
+        {
+            dst[i] = Codec_MulawEncodeSample(src[i]);
+        }
+        return samples;
+    case CODEC_IMA_ADPCM:
+    {
+        size_t i = 0;
+        size_t j = 0;
+        if (state.pendingCode >= 0 && samples > 0)
+        {
+            // Byte j is written after sample 2j is read, in place it stays behind the input
+            dst[j++] = (uint8_t)state.pendingCode | (Codec_AdpcmEncodeSample(state, src[0]) << 4);
+            state.pendingCode = -1;
+            i = 1;
+        }
+        for (; i + 1 < samples; i += 2)
+        {
+            uint8_t low = Codec_AdpcmEncodeSample(state, src[i]);
+            uint8_t high = Codec_AdpcmEncodeSample(state, src[i + 1]);
+            dst[j++] = low | (high << 4);
+        }
+        if (i < samples)
+        {
+            state.pendingCode = (int8_t)Codec_AdpcmEncodeSample(state, src[i]);
+        }
+        return j;
+    }
+    case CODEC_PHONEMES:
+        return 0;
+    case CODEC_LOGMEL:
+    case CODEC_LOGMEL8:
+    {
+        // A frame started in the previous block may end within the first samples, before its
+        // bands fit behind the input: those samples are read from a copy
+        int16_t head[FEATURE_MEL_BANDS];
+        size_t count = samples < FEATURE_MEL_BANDS ? samples : FEATURE_MEL_BANDS;
+        memcpy(head, src, count * sizeof(int16_t));
+        FeatureOutput out = {state.codec, dst, 0};
+        Features_Process(*state.features, head, count, Codec_FeatureFrame, &out);
+        Features_Process(*state.features, src + count, samples - count, Codec_FeatureFrame, &out);
+        return out.len;
+    }
+    case CODEC_PCM:
+    default:
+        memmove(dst, src, samples * sizeof(int16_t));
+        return samples * sizeof(int16_t);
+    }
+}
+
+/**
+ * @brief Ends an encoded stream: writes what Codec_Encode() still holds.
+ *
+ * @param state The codec state of the stream.
+ * @param dst Output buffer of at least 1 byte.
+ * @return Number of bytes written to `dst`: 1 for IMA-ADPCM with an odd sample count (the last code
+ *         and a 0 nibble, decoded as one extra sample), 0 otherwise.
+ */
+size_t Codec_Flush(CodecState &state, uint8_t *dst)
+{
+    if (state.codec != CODEC_IMA_ADPCM || state.pendingCode < 0)
+    {
+        return 0;
+    }
+    dst[0] = (uint8_t)state.pendingCode;
+    state.pendingCode = -1;
+    return 1;
+}
+
+/**
+ * @brief Decodes a block of encoded bytes to 16-bit samples.
+ *
+ * @param state The codec state of the stream.
+ * @param dst Output buffer with room for `Codec_DecodedSamples(codec, len)` samples.
+ * @param src Encoded bytes.
+ * @param len Number of encoded bytes. For PCM an odd trailing byte is ignored.
+ * @return Number of samples written to `dst`.
+ */
+size_t Codec_Decode(CodecState &state, int16_t *dst, const uint8_t *src, size_t len)
+{
+    switch (state.codec)
+    {
+    case CODEC_MULAW:
+        for (size_t i = 0; i < len; i++)
+        {
+            dst[i] = Codec_MulawDecodeSample(src[i]);
+        }
+        return len;
+    case CODEC_IMA_ADPCM:
+        for (size_t i = 0; i < len; i++)
+        {
+            dst[2 * i] = Codec_AdpcmDecodeSample(state, src[i] & 0x0F);
+            dst[2 * i + 1] = Codec_AdpcmDecodeSample(state, src[i] >> 4);
+        }
+        return len * 2;
+    case CODEC_PHONEMES:
+    case CODEC_LOGMEL:
+    case CODEC_LOGMEL8:
+        return 0;
+    case CODEC_PCM:
+    default:
+        memcpy(dst, src, len & ~(size_t)1);
+        return len / 2;
+    }
+}
+
+/**
+ * @brief Number of samples produced by decoding `len` bytes.
+ */
+size_t Codec_DecodedSamples(AUDIO_CODEC codec, size_t len)
+{
+    switch (codec)
+    {
+    case CODEC_MULAW:
+        return len;
+    case CODEC_IMA_ADPCM:
+        return len * 2;
+    case CODEC_PHONEMES:
+    case CODEC_LOGMEL:
+    case CODEC_LOGMEL8:
+        return 0;
+    case CODEC_PCM:
+    default:
+        return len / 2;
+    }
+}
+
+/**
+ * @brief true for the codecs that carry log-mel frames instead of audio.
+ */
+bool Codec_IsFeatures(AUDIO_CODEC codec)
+{
+    return codec == CODEC_LOGMEL || codec == CODEC_LOGMEL8;
+}
+
+/**
+ * @brief Converts a codec to the name used in the HTTP headers.
+ */
+const char *Codec_ToString(AUDIO_CODEC codec)
+{
+    switch (codec)
+    {
+    case CODEC_MULAW:
+        return "mulaw";
+    case CODEC_IMA_ADPCM:
+        return "ima-adpcm";
+    case CODEC_PHONEMES:
+        return "phonemes";
+    case CODEC_LOGMEL:
+        return "logmel";
+    case CODEC_LOGMEL8:
+        return "logmel8";
+    case CODEC_PCM:
+        return "pcm";
+    }
+    return "pcm";
+}
+
+/**
+ * @brief Converts a codec name from the HTTP headers, unknown names map to PCM.
+ */
+AUDIO_CODEC Codec_FromString(const char *name)
+{
+    if (strcasecmp(name, "mulaw") == 0)
+    {
+        return CODEC_MULAW;
+    }
+    if (strcasecmp(name, "ima-adpcm") == 0)
+    {
+        return CODEC_IMA_ADPCM;
+    }
+    if (strcasecmp(name, "phonemes") == 0)
+    {
+        return CODEC_PHONEMES;
+    }
+    if (strcasecmp(name, "logmel") == 0)
+    {
+        return CODEC_LOGMEL;
+    }
+    if (strcasecmp(name, "logmel8") == 0)
+    {
+        return CODEC_LOGMEL8;
+    }
+    return CODEC_PCM;
+}
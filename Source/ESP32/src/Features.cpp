@@ -0,0 +1,316 @@
+#include <Features.h>
+#include <string.h>
+#include <math.h>
+
+#define FEATURE_HALF (FEATURE_FRAME_LEN / 2)    // Points of the complex FFT behind the real one
+#define FEATURE_WEIGHT_SHIFT 8                  // Mel weights are Q8
+#define FEATURE_PREEMPHASIS 31                  // Pre-emphasis coefficient, in 32nds
+
+static bool tablesReady = false;
+static uint32_t tablesRate = 0;
+static int16_t window[FEATURE_FRAME_LEN];       // Hamming, Q15
+static int16_t twiddleCos[FEATURE_HALF];        // cos(2 pi k / FEATURE_FRAME_LEN), Q15
+static int16_t twiddleSin[FEATURE_HALF];        // Q15
+static uint16_t bandStart[FEATURE_MEL_BANDS + 2]; // FFT bin of the band edges
+static uint8_t bandWeight[FEATURE_BINS];        // Rising weight of a bin toward the band above it, Q8
+static int16_t dct[FEATURE_MFCC][FEATURE_MEL_BANDS]; // DCT-II rows 1.., Q15
+static uint8_t log2Fraction[256];               // log2(1 + i/256), Q8
+static int32_t re[FEATURE_HALF];
+static int32_t im[FEATURE_HALF];
+static uint64_t power[FEATURE_BINS];
+
+static float Features_HzToMel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float Features_MelToHz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+/**
+ * @brief Builds the window, twiddle, mel, DCT and log tables for a sample rate.
+ */
+static void Features_BuildTables(uint32_t sampleRate)
+{
+    const float pi = 3.14159265f;
+    for (int i = 0; i < FEATURE_FRAME_LEN; i++)
+    {
+        window[i] = (int16_t)lrintf(32767.0f * (0.54f - 0.46f * cosf(2.0f * pi * i / (FEATURE_FRAME_LEN - 1))));
+    }
+    for (int i = 0; i < FEATURE_HALF; i++)
+    {
+        twiddleCos[i] = (int16_t)lrintf(32767.0f * cosf(2.0f * pi * i / FEATURE_FRAME_LEN));
+        twiddleSin[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * pi * i / FEATURE_FRAME_LEN));
+    }
+
+    // Band edges equally spaced on the mel scale, band b spans edges b..b+2
+    float low = Features_HzToMel(FEATURE_LOW_HZ);
+    float high = Features_HzToMel(FEATURE_HIGH_HZ < sampleRate / 2 ? FEATURE_HIGH_HZ : sampleRate / 2);
+    for (int b = 0; b < FEATURE_MEL_BANDS + 2; b++)
+    {
+        float hz = Features_MelToHz(low + (high - low) * b / (FEATURE_MEL_BANDS + 1));
+        int bin = (int)lrintf(hz * FEATURE_FRAME_LEN / sampleRate);
+        // Keep every band at least one bin wide
+        if (b > 0 && bin <= bandStart[b - 1])
+        {
+            bin = bandStart[b - 1] + 1;
+        }
+        bandStart[b] = bin < FEATURE_BINS ? bin : FEATURE_BINS - 1;
+    }
+    memset(bandWeight, 0, sizeof(bandWeight));
+    for (int b = 0; b < FEATURE_MEL_BANDS + 1; b++)
+    {
+        int span = bandStart[b + 1] - bandStart[b];
+        for (int k = bandStart[b]; k < bandStart[b + 1]; k++)
+        {
+            bandWeight[k] = (uint8_t)((k - bandStart[b]) * 255 / (span > 0 ? span : 1));
+        }
+    }
+
+    for (int k = 0; k < FEATURE_MFCC; k++)
+    {
+        for (int b = 0; b < FEATURE_MEL_BANDS; b++)
+        {
+            float c = sqrtf(2.0f / FEATURE_MEL_BANDS) * cosf(pi * (k + 1) * (b + 0.5f) / FEATURE_MEL_BANDS);
+            dct[k][b] = (int16_t)lrintf(32767.0f * c);
+        }
+    }
+    for (int i = 0; i < 256; i++)
+    {
+        int value = (int)lrintf(256.0f * log2f(1.0f + i / 256.0f));
+        log2Fraction[i] = (uint8_t)(value > 255 ? 255 : value);
+    }
+    tablesRate = sampleRate;
+    tablesReady = true;
+}
+
+/**
+ * @brief log2(x) in Q8, 0 for x = 0.
+ */
+static int32_t Features_Log2(uint64_t x)
+{
+    if (x == 0)
+    {
+        return 0;
+    }
+    int msb = 63 - __builtin_clzll(x);
+    uint32_t fraction = (uint32_t)(msb >= 8 ? x >> (msb - 8) : x << (8 - msb)) & 0xFF;
+    return msb * 256 + log2Fraction[fraction];
+}
+
+/**
+ * @brief In-place radix-2 decimation-in-time FFT of the FEATURE_HALF points of re/im.
+ *
+ * No scaling: the input is at most 15 bits, so the 8 stages stay within 23 bits.
+ */
+static void Features_Fft()
+{
+    // Bit-reversal permutation
+    for (int i = 1, j = 0; i < FEATURE_HALF; i++)
+    {
+        int bit = FEATURE_HALF >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j)
+        {
+            int32_t t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (int size = 2; size <= FEATURE_HALF; size <<= 1)
+    {
+        int half = size >> 1;
+        int step = FEATURE_FRAME_LEN / size; // the twiddles are those of the full frame
+        for (int start = 0; start < FEATURE_HALF; start += size)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                int32_t c = twiddleCos[k * step];
+                int32_t s = twiddleSin[k * step];
+                int a = start + k;
+                int b = a + half;
+                // (re + j im) * (cos - j sin)
+                int32_t tr = (int32_t)(((int64_t)re[b] * c + (int64_t)im[b] * s) >> 15);
+                int32_t ti = (int32_t)(((int64_t)im[b] * c - (int64_t)re[b] * s) >> 15);
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Power spectrum of a windowed frame: real FFT kernel of the front end.
+ *
+ * The frame is shifted left until its peak uses the 15 bits and windowed, its even and odd samples
+ * go through the half-size complex FFT Z, and each bin of the real frame is rebuilt from Z[k] and
+ * Z[N/2 - k]: 2 X[k] = (Z[k] + Z*[N/2 - k]) - j W^k (Z[k] - Z*[N/2 - k]), W = e^(-2 pi j / N).
+ * The factor 2 and the normalization are not undone, the returned scale carries them.
+ *
+ * @param frame FEATURE_FRAME_LEN pre-emphasized samples.
+ * @param power Receives FEATURE_BINS bins (0 to the Nyquist frequency), |X[k]|^2 * 2^scale.
+ * @return The scale, as a power of two.
+ */
+int32_t Features_PowerSpectrum(const int16_t *frame, uint64_t *power)
+{
+    // Normalize to 15 bits before the window so quiet frames keep their precision, undone in the log domain
+    int32_t peak = 0;
+    for (int i = 0; i < FEATURE_FRAME_LEN; i++)
+    {
+        int32_t x = frame[i];
+        peak |= x < 0 ? ~x : x;
+    }
+    int shift = 0;
+    while ((peak << (shift + 1)) < 32768 && shift < 15)
+    {
+        shift++;
+    }
+    for (int i = 0; i < FEATURE_HALF; i++)
+    {
+        re[i] = ((frame[2 * i] << shift) * window[2 * i] + (1 << 14)) >> 15;
+        im[i] = ((frame[2 * i + 1] << shift) * window[2 * i + 1] + (1 << 14)) >> 15;
+    }
+    Features_Fft();
+
+    // Bins 0 and N/2 only take the sum and the difference of the two real FFTs
+    int64_t dc = (int64_t)(re[0] + im[0]) * 2;
+    int64_t nyquist = (int64_t)(re[0] - im[0]) * 2;
+    power[0] = (uint64_t)(dc * dc);
+    power[FEATURE_HALF] = (uint64_t)(nyquist * nyquist);
+    for (int k = 1; k < FEATURE_HALF; k++)
+    {
+        int32_t ar = re[k], ai = im[k];
+        int32_t br = re[FEATURE_HALF - k], bi = im[FEATURE_HALF - k];
+        // Even part Z[k] + Z*[N/2 - k], odd part -j (Z[k] - Z*[N/2 - k])
+        int32_t evenRe = ar + br, evenIm = ai - bi;
+        int32_t oddRe = ai + bi, oddIm = br - ar;
+        int32_t c = twiddleCos[k];
+        int32_t s = twiddleSin[k];
+        int64_t xr = evenRe + (int32_t)(((int64_t)oddRe * c + (int64_t)oddIm * s) >> 15);
+        int64_t xi = evenIm + (int32_t)(((int64_t)oddIm * c - (int64_t)oddRe * s) >> 15);
+        power[k] = (uint64_t)(xr * xr + xi * xi);
+    }
+    return 2 * (shift + 1);
+}
+
+/**
+ * @brief Log-mel energies of a power spectrum: filterbank kernel of the front end.
+ *
+ * @param power FEATURE_BINS bins from Features_PowerSpectrum().
+ * @param scale Its scale, removed from the result.
+ * @param logMel Receives FEATURE_MEL_BANDS values, log2 band energy in Q8.
+ */
+void Features_MelBands(const uint64_t *power, int32_t scale, int16_t *logMel)
+{
+    // Triangular mel bands: bin k rises into band b while falling out of band b-1
+    uint64_t band[FEATURE_MEL_BANDS + 1];
+    memset(band, 0, sizeof(band));
+    for (int b = 0; b < FEATURE_MEL_BANDS + 1; b++)
+    {
+        for (int k = bandStart[b]; k < bandStart[b + 1]; k++)
+        {
+            uint32_t rising = bandWeight[k];
+            band[b] += power[k] * rising;                                  // band b, centered on edge b+1
+            if (b > 0)
+            {
+                band[b - 1] += power[k] * ((1 << FEATURE_WEIGHT_SHIFT) - 1 - rising); // band b-1
+            }
+        }
+    }
+    int32_t offset = (FEATURE_WEIGHT_SHIFT + scale) * 256;
+    for (int b = 0; b < FEATURE_MEL_BANDS; b++)
+    {
+        logMel[b] = (int16_t)(Features_Log2(band[b] + 1) - offset);
+    }
+}
+
+/**
+ * @brief Computes the features of the current frame.
+ */
+static void Features_Frame(FeatureState &state, FeatureFrame &frame)
+{
+    uint64_t energy = 0;
+    for (int i = 0; i < FEATURE_FRAME_LEN; i++)
+    {
+        int32_t x = state.frame[i];
+        energy += (uint64_t)(x * x);
+    }
+    frame.energy = (uint32_t)(energy / FEATURE_FRAME_LEN);
+    frame.computed = frame.energy >= state.gateEnergy;
+    if (!frame.computed)
+    {
+        return;
+    }
+
+    int32_t scale = Features_PowerSpectrum(state.frame, power);
+    Features_MelBands(power, scale, frame.logMel);
+    for (int k = 0; k < FEATURE_MFCC; k++)
+    {
+        int32_t sum = 0;
+        for (int b = 0; b < FEATURE_MEL_BANDS; b++)
+        {
+            sum += frame.logMel[b] * dct[k][b];
+        }
+        frame.mfcc[k] = (int16_t)(sum >> 15);
+    }
+}
+
+/**
+ * @brief Resets the front end, building the tables on first use.
+ *
+ * @param state The front end state.
+ * @param sampleRate Sample rate of the processed audio.
+ */
+void Features_Init(FeatureState &state, uint32_t sampleRate)
+{
+    memset(&state, 0, sizeof(state));
+    state.sampleRate = sampleRate;
+    if (!tablesReady || tablesRate != sampleRate)
+    {
+        Features_BuildTables(sampleRate);
+    }
+}
+
+/**
+ * @brief Runs the front end over a block of samples.
+ *
+ * Frames may span blocks. The callback is called once per hop, with the features of the
+ * FEATURE_FRAME_LEN samples that end there.
+ *
+ * @param state The front end state.
+ * @param samples Signed 16-bit samples.
+ * @param count Number of samples.
+ * @param callback Receives every frame.
+ * @param context Passed to the callback.
+ */
+void Features_Process(FeatureState &state, const int16_t *samples, size_t count, FeatureCallback callback, void *context)
+{
+    FeatureFrame frame;
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t x = samples[i];
+        int32_t y = x - ((state.lastSample * FEATURE_PREEMPHASIS) >> 5);
+        state.lastSample = (int16_t)x;
+        state.frame[state.fill++] = (int16_t)(y > 32767 ? 32767 : (y < -32768 ? -32768 : y));
+        if (state.fill < FEATURE_FRAME_LEN)
+        {
+            continue;
+        }
+        Features_Frame(state, frame);
+        callback(frame, context);
+        memmove(state.frame, state.frame + FEATURE_HOP, (FEATURE_FRAME_LEN - FEATURE_HOP) * sizeof(int16_t));
+        state.fill = FEATURE_FRAME_LEN - FEATURE_HOP;
+    }
+}
@@ -0,0 +1,331 @@
+#include <Kws.h>
+#include <App.h>
+#include <Config.h>
+#include <string.h>
+
+#define KWS_INFINITY (1 << 30)
+
+/**
+ * @brief L1 distance between two MFCC vectors.
+ */
+static int32_t Kws_Distance(const int16_t *a, const int16_t *b)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < FEATURE_MFCC; i++)
+    {
+        int32_t d = a[i] - b[i];
+        sum += d < 0 ? -d : d;
+    }
+    return sum;
+}
+
+/**
+ * @brief Forgets the partial matches, a keyword cannot span a gap.
+ */
+static void Kws_ResetPaths(KwsState &state)
+{
+    for (int t = 0; t < KWS_MAX_TEMPLATES; t++)
+    {
+        for (int j = 0; j < KWS_MAX_FRAMES; j++)
+        {
+            state.cost[t][j] = KWS_INFINITY;
+            state.steps[t][j] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Extends the paths of one template with a frame.
+ *
+ * @return Cost per step of the best path through the whole template, KWS_INFINITY if none.
+ */
+static int32_t Kws_Extend(KwsState &state, int t, const int16_t *mfcc)
+{
+    const KwsTemplate &tmpl = state.model->templates[t];
+    int32_t *cost = state.cost[t];
+    uint16_t *steps = state.steps[t];
+    // Updated in place: `diagonal` keeps the previous frame's value of cost[j - 1]
+    int32_t diagonal = 0;
+    uint16_t diagonalSteps = 0;
+    for (int j = 0; j < tmpl.frames; j++)
+    {
+        int32_t best;
+        uint16_t bestSteps;
+        if (j == 0)
+        {
+            // Open begin: a path may start on any frame
+            best = 0;
+            bestSteps = 0;
+        }
+        else
+        {
+            best = cost[j];                  // input advances, template stays
+            bestSteps = steps[j];
+            if (diagonal < best)             // both advance
+            {
+                best = diagonal;
+                bestSteps = diagonalSteps;
+            }
+            if (cost[j - 1] < best)          // template advances, input stays
+            {
+                best = cost[j - 1];
+                bestSteps = steps[j - 1];
+            }
+        }
+        diagonal = cost[j];
+        diagonalSteps = steps[j];
+        if (best >= KWS_INFINITY)
+        {
+            cost[j] = KWS_INFINITY;
+            steps[j] = 0;
+            continue;
+        }
+        cost[j] = best + Kws_Distance(mfcc, tmpl.features[j]);
+        steps[j] = bestSteps < 0xFFFF ? bestSteps + 1 : bestSteps;
+    }
+    int last = tmpl.frames - 1;
+    if (cost[last] >= KWS_INFINITY || steps[last] > 2 * tmpl.frames)
+    {
+        return KWS_INFINITY; // no path, or stretched over more than twice the template
+    }
+    return cost[last] / steps[last];
+}
+
+/**
+ * @brief Frame callback: gates on energy, runs the DTW and checks the threshold.
+ */
+static void Kws_Frame(const FeatureFrame &frame, void *context)
+{
+    KwsState &state = *(KwsState *)context;
+    state.stats.frames++;
+
+    // Noise floor and gate for the next frame, as the VAD does
+    if (state.stats.frames <= KWS_CALIBRATION_FRAMES)
+    {
+        if (state.stats.frames == 1 || frame.energy < state.noiseFloor)
+        {
+            state.noiseFloor = frame.energy;
+        }
+    }
+    else
+    {
+        uint32_t gate = state.noiseFloor * KWS_GATE_RATIO;
+        if (gate < KWS_GATE_MIN)
+        {
+            gate = KWS_GATE_MIN;
+        }
+        if (frame.energy > gate)
+        {
+            state.hangover = KWS_GATE_HANGOVER;
+        }
+        else
+        {
+            if (frame.energy < state.noiseFloor)
+            {
+                state.noiseFloor -= (state.noiseFloor - frame.energy) >> 2;
+            }
+            else
+            {
+                state.noiseFloor += (frame.energy - state.noiseFloor) >> 4;
+            }
+            if (state.hangover > 0)
+            {
+                state.hangover--;
+            }
+        }
+        state.features.gateEnergy = state.hangover > 0 ? 0 : gate;
+    }
+
+    if (!frame.computed)
+    {
+        Kws_ResetPaths(state);
+        return;
+    }
+    state.stats.framesComputed++;
+    if (state.refractory > 0)
+    {
+        state.refractory--;
+        return;
+    }
+
+    int32_t bestScore = KWS_INFINITY;
+    int bestIndex = 0;
+    for (int t = 0; t < state.model->count; t++)
+    {
+        int32_t score = Kws_Extend(state, t, frame.mfcc);
+        if (score < bestScore)
+        {
+            bestScore = score;
+            bestIndex = t;
+        }
+    }
+    if (bestScore < state.stats.bestScore)
+    {
+        state.stats.bestScore = bestScore;
+    }
+    if (bestScore < state.model->threshold && !state.detected)
+    {
+        uint64_t endSample = (uint64_t)(state.stats.frames - 1) * FEATURE_HOP + FEATURE_FRAME_LEN;
+        state.detected = true;
+        state.detection.timeMs = (uint32_t)(endSample * 1000 / state.features.sampleRate);
+        state.detection.score = bestScore;
+        state.detection.index = bestIndex;
+        state.stats.detections++;
+        state.refractory = (uint32_t)((uint64_t)KWS_REFRACTORY_MS * state.features.sampleRate / 1000 / FEATURE_HOP);
+        Kws_ResetPaths(state);
+    }
+}
+
+/**
+ * @brief Reads a template file.
+ *
+ * @return false if the file is missing, malformed or enrolled with other features.
+ */
+bool Kws_Load(KwsModel &model, Storage &storage, const char *path)
+{
+    memset(&model, 0, sizeof(model));
+    StorageFile *file = storage.Open(path, false);
+    if (!file)
+    {
+        return false;
+    }
+    KwsFileHeader header;
+    bool ok = file->Read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == KWS_MAGIC && header.version == KWS_VERSION &&
+              header.coefficients == FEATURE_MFCC && header.count <= KWS_MAX_TEMPLATES;
+    for (int t = 0; ok && t < header.count; t++)
+    {
+        uint16_t frames[2];
+        KwsTemplate &tmpl = model.templates[t];
+        ok = file->Read((uint8_t *)frames, sizeof(frames)) == sizeof(frames) &&
+             frames[0] > 0 && frames[0] <= KWS_MAX_FRAMES;
+        size_t len = ok ? frames[0] * sizeof(tmpl.features[0]) : 0;
+        ok = ok && file->Read((uint8_t *)tmpl.features, len) == len;
+        tmpl.frames = frames[0];
+    }
+    file->Close();
+    FREE(file);
+    if (!ok)
+    {
+        LOGW("KWS: %s is not a template file for this build", path);
+        memset(&model, 0, sizeof(model));
+        return false;
+    }
+    model.count = header.count;
+    model.threshold = header.threshold;
+    return model.count > 0;
+}
+
+/**
+ * @brief Writes a template file.
+ */
+bool Kws_Save(const KwsModel &model, Storage &storage, const char *path)
+{
+    StorageFile *file = storage.Open(path, true);
+    if (!file)
+    {
+        return false;
+    }
+    KwsFileHeader header = {KWS_MAGIC, KWS_VERSION, FEATURE_MFCC, model.count, 0, model.threshold};
+    bool ok = file->Write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    for (int t = 0; ok && t < model.count; t++)
+    {
+        const KwsTemplate &tmpl = model.templates[t];
+        uint16_t frames[2] = {tmpl.frames, 0};
+        size_t len = tmpl.frames * sizeof(tmpl.features[0]);
+        ok = file->Write((const uint8_t *)frames, sizeof(frames)) == sizeof(frames) &&
+             file->Write((const uint8_t *)tmpl.features, len) == len;
+    }
+    file->Close();
+    FREE(file);
+    return ok;
+}
+
+/**
+ * @brief Cost per step of the best full alignment of two templates (both ends anchored).
+ *
+ * Used at enrollment to place the threshold above the spread between repetitions.
+ */
+int32_t Kws_Compare(const KwsTemplate &a, const KwsTemplate &b)
+{
+    int32_t cost[KWS_MAX_FRAMES];
+    uint16_t steps[KWS_MAX_FRAMES];
+    for (int i = 0; i < a.frames; i++)
+    {
+        int32_t diagonal = i == 0 ? 0 : KWS_INFINITY;
+        uint16_t diagonalSteps = 0;
+        for (int j = 0; j < b.frames; j++)
+        {
+            int32_t best = i == 0 ? KWS_INFINITY : cost[j];
+            uint16_t bestSteps = i == 0 ? 0 : steps[j];
+            if (diagonal < best)
+            {
+                best = diagonal;
+                bestSteps = diagonalSteps;
+            }
+            if (j > 0 && cost[j - 1] < best)
+            {
+                best = cost[j - 1];
+                bestSteps = steps[j - 1];
+            }
+            diagonal = i == 0 ? KWS_INFINITY : cost[j];
+            diagonalSteps = i == 0 ? 0 : steps[j];
+            cost[j] = best + Kws_Distance(a.features[i], b.features[j]);
+            steps[j] = bestSteps + 1;
+        }
+    }
+    return cost[b.frames - 1] / steps[b.frames - 1];
+}
+
+/**
+ * @brief Starts listening with a model.
+ *
+ * @param state The spotter state.
+ * @param model Loaded templates, must outlive the state.
+ */
+void Kws_Init(KwsState &state, const KwsModel &model)
+{
+    memset(&state, 0, sizeof(state));
+    state.model = &model;
+    Features_Init(state.features, I2S_SAMPLE_RATE);
+    state.features.gateEnergy = 0xFFFFFFFF; // nothing is analyzed while the noise floor is seeded
+    state.stats.bestScore = KWS_INFINITY;
+    Kws_ResetPaths(state);
+}
+
+/**
+ * @brief Runs the spotter over a block of samples.
+ *
+ * @param state The spotter state.
+ * @param samples Signed 16-bit samples.
+ * @param count Number of samples.
+ * @param detection Receives the first detection of the block.
+ * @return true if the keyword was detected in this block.
+ */
+bool Kws_Process(KwsState &state, const int16_t *samples, size_t count, KwsDetection &detection)
+{
+    uint64_t start = Hal_Micros();
+    state.detected = false;
+    Features_Process(state.features, samples, count, Kws_Frame, &state);
+    state.stats.samples += count;
+    state.stats.busyUs += Hal_Micros() - start;
+    if (state.detected)
+    {
+        detection = state.detection;
+    }
+    return state.detected;
+}
+
+/**
+ * @brief Logs the duty cycle and CPU time of the spotter.
+ */
+void Kws_Logging(const KwsState &state)
+{
+    const KwsStats &stats = state.stats;
+    uint32_t audioMs = (uint32_t)(stats.samples * 1000 / state.features.sampleRate);
+    LOGL("KWS: %u detections, %u/%u frames analyzed, %u us per audio second (%u.%02u%% CPU), best score %d",
+         (unsigned)stats.detections, (unsigned)stats.framesComputed, (unsigned)stats.frames,
+         (unsigned)(audioMs ? stats.busyUs * 1000 / audioMs : 0),
+         (unsigned)(audioMs ? stats.busyUs / 10 / audioMs : 0), (unsigned)(audioMs ? stats.busyUs * 10 / audioMs % 100 : 0),
+         (int)stats.bestScore);
+}
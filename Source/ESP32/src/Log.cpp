@@ -0,0 +1,313 @@
+#include <Log.h>
+#include <App.h>
+#include <stdio.h>
+#include <atomic>
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+static_assert((LOG_FORMAT_CACHE & (LOG_FORMAT_CACHE - 1)) == 0, "LOG_FORMAT_CACHE must be a power of two");
+static_assert(LOG_ARGS_SIZE <= 255, "LogEvent::size is 8-bit");
+#if LOG_BINARY && !LOG_ASYNC
+#error "LOG_BINARY needs LOG_ASYNC: the formats are sent by the log task"
+#endif
+
+/*
+Ring of LOG_RING_SLOTS events, many writers and the log task as the only reader. Each slot has
+a sequence relative to its index, zero when free for the first round, so the ring works before
+Log_Init():
+    sequence == position - slot        free for the writer claiming `position`
+    sequence == position - slot + 1    written, waiting for the log task
+    sequence == position - slot + N    read, free for the next round
+A writer claims a position with a compare-exchange on the head and gives up (drop) if the slot
+is still waiting from the previous round.
+*/
+#if LOG_ASYNC
+static LogEvent ring[LOG_RING_SLOTS];
+static uint32_t reportedDrops = 0;          // Log task
+#endif
+static std::atomic<uint32_t> sequences[LOG_RING_SLOTS];
+static std::atomic<uint32_t> head(0);       // Positions claimed by the writers
+static std::atomic<uint32_t> tail(0);       // Positions read by the log task
+static std::atomic<uint32_t> events(0);
+static std::atomic<uint32_t> dropped(0);
+static HalEvent wakeEvent = NULL;           // Ring half full -> log task
+static bool running = false;
+#if LOG_BINARY
+static uint32_t sentFormats[LOG_FORMAT_CACHE]; // Ids whose 'F' frame was written
+#endif
+static LogStats stats;
+
+/**
+ * @brief Length of a line after snprintf() wrote `written` characters at `length`, cut at its size.
+ */
+static size_t Log_Append(size_t size, size_t length, int written)
+{
+    if (written < 0)
+    {
+        return length;
+    }
+    return length + (size_t)written < size ? length + written : size - 1;
+}
+
+/**
+ * @brief Formats an event as Hal_Log() would have: state prefix, then the format applied to the arguments.
+ *
+ * @param event The event.
+ * @param line Destination, always terminated.
+ * @param size Size of the destination.
+ * @return Length of the line.
+ */
+size_t Log_Format(const LogEvent &event, char *line, size_t size)
+{
+    size_t length = Log_Append(size, 0, snprintf(line, size, "%s -> ", App_ToString((APP_STATE)event.state)));
+    const uint8_t *arg = event.args;
+    const uint8_t *end = event.args + event.size;
+    const char *p = event.format;
+    while (*p && length < size - 1)
+    {
+        if (*p != '%' || p[1] == '%')
+        {
+            line[length++] = *p;
+            p += *p == '%' ? 2 : 1;
+            continue;
+        }
+        // Flags, width and precision are kept, the length modifier follows the stored type
+        char spec[16] = "%";
+        size_t n = 1;
+        for (p++; *p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 4; p++)
+        {
+            spec[n++] = *p;
+        }
+        while (*p && strchr("hlzjtL", *p))
+        {
+            p++;
+        }
+        char conversion = *p;
+        if (!conversion)
+        {
+            break;
+        }
+        p++;
+        char tag = arg < end ? (char)*arg : 0;
+        bool integer = strchr("diouxXc", conversion) != NULL;
+        if (tag == LOG_ARG_INT && integer)
+        {
+            int32_t value;
+            memcpy(&value, arg + 1, sizeof(value));
+            arg += 1 + sizeof(value);
+            spec[n++] = conversion;
+            length = Log_Append(size, length, snprintf(line + length, size - length, spec, (int)value));
+        }
+        else if (tag == LOG_ARG_LONG && integer)
+        {
+            int64_t value;
+            memcpy(&value, arg + 1, sizeof(value));
+            arg += 1 + sizeof(value);
+            spec[n++] = 'l';
+            spec[n++] = 'l';
+            spec[n++] = conversion;
+            length = Log_Append(size, length, snprintf(line + length, size - length, spec, (long long)value));
+        }
+        else if (tag == LOG_ARG_DOUBLE && strchr("fFeEgGaA", conversion))
+        {
+            double value;
+            memcpy(&value, arg + 1, sizeof(value));
+            arg += 1 + sizeof(value);
+            spec[n++] = conversion;
+            length = Log_Append(size, length, snprintf(line + length, size - length, spec, value));
+        }
+        else if (tag == LOG_ARG_STRING && conversion == 's')
+        {
+            char text[LOG_ARGS_SIZE];
+            size_t len = arg[1];
+            memcpy(text, arg + 2, len);
+            text[len] = '\0';
+            arg += 2 + len;
+            spec[n++] = 's';
+            length = Log_Append(size, length, snprintf(line + length, size - length, spec, text));
+        }
+        else
+        {
+            line[length++] = '?'; // argument cut or of another type, the following ones are skipped
+            arg = end;
+        }
+    }
+    line[length] = '\0';
+    return length;
+}
+
+#if LOG_ASYNC
+#if LOG_BINARY
+/**
+ * @brief Writes one binary frame.
+ */
+static void Log_WriteFrame(char type, const void *payload, size_t len, const void *extra = NULL, size_t extraLen = 0)
+{
+    uint8_t header[4] = {LOG_FRAME_SYNC, (uint8_t)type, (uint8_t)(len + extraLen), (uint8_t)((len + extraLen) >> 8)};
+    Hal_LogWrite(header, sizeof(header));
+    Hal_LogWrite(payload, len);
+    if (extraLen)
+    {
+        Hal_LogWrite(extra, extraLen);
+    }
+}
+
+/**
+ * @brief Writes an event as an 'E' frame, preceded by its 'F' frame the first time its id is seen.
+ */
+static void Log_WriteBinary(const LogEvent &event)
+{
+    uint32_t id = (uint32_t)(uintptr_t)event.format;
+    uint32_t &cached = sentFormats[(id >> 2) & (LOG_FORMAT_CACHE - 1)];
+    if (cached != id)
+    {
+        cached = id;
+        Log_WriteFrame('F', &id, sizeof(id), event.format, strlen(event.format));
+    }
+    uint8_t header[11];
+    memcpy(header, &id, 4);
+    memcpy(header + 4, &event.timeUs, 4);
+    header[8] = event.level;
+    header[9] = event.state;
+    header[10] = event.argc;
+    Log_WriteFrame('E', header, sizeof(header), event.args, event.size);
+}
+#endif
+
+/**
+ * @brief Writes an event in the configured output format.
+ */
+static void Log_Output(const LogEvent &event)
+{
+#if LOG_BINARY
+    Log_WriteBinary(event);
+#else
+    char line[LOG_LINE_SIZE];
+    size_t length = Log_Format(event, line, sizeof(line));
+    Hal_LogWrite(line, length);
+#endif
+}
+
+/**
+ * @brief Writes the events waiting in the ring and reports the dropped ones. Called by the log task only.
+ */
+static void Log_Drain()
+{
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    uint32_t depth = head.load(std::memory_order_relaxed) - position;
+    stats.maxDepth = depth > stats.maxDepth ? depth : stats.maxDepth;
+    for (;;)
+    {
+        uint32_t slot = position & (LOG_RING_SLOTS - 1);
+        if (sequences[slot].load(std::memory_order_acquire) != position - slot + 1)
+        {
+            break;
+        }
+        Log_Output(ring[slot]);
+        sequences[slot].store(position - slot + LOG_RING_SLOTS, std::memory_order_release);
+        tail.store(++position, std::memory_order_relaxed);
+    }
+    uint32_t drops = dropped.load(std::memory_order_relaxed);
+    if (drops != reportedDrops)
+    {
+        uint32_t lost = drops - reportedDrops;
+        reportedDrops = drops;
+#if LOG_BINARY
+        Log_WriteFrame('D', &lost, sizeof(lost));
+#else
+        char line[48];
+        Hal_LogWrite(line, Log_Append(sizeof(line), 0, snprintf(line, sizeof(line), "Log: %u events dropped\n", (unsigned)lost)));
+#endif
+    }
+}
+
+/**
+ * @brief Log task: formats and writes the events, at low priority.
+ */
+static void Task_Log(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        Log_Drain();
+        Hal_WaitEvent(wakeEvent, LOG_DRAIN_MS);
+    }
+}
+#endif
+
+/**
+ * @brief Starts the log task. Events logged before are kept in the ring (up to LOG_RING_SLOTS).
+ */
+void Log_Init()
+{
+#if LOG_ASYNC
+    wakeEvent = Hal_CreateEvent();
+    running = Hal_StartTask(Task_Log, "Task_Log", LOG_TASK_STACK, NULL, LOG_TASK_PRIORITY, LOG_TASK_CORE);
+#endif
+}
+
+/**
+ * @brief Stores an event, called by Log_Write() from any task. Never waits: the event is dropped
+ *        if the ring is full.
+ */
+void Log_Push(LogEvent &event)
+{
+    event.timeUs = (uint32_t)Hal_Micros();
+    event.state = (uint8_t)App_GetState();
+#if LOG_ASYNC
+    uint32_t position = head.load(std::memory_order_relaxed);
+    uint32_t slot;
+    for (;;)
+    {
+        slot = position & (LOG_RING_SLOTS - 1);
+        int32_t diff = (int32_t)(sequences[slot].load(std::memory_order_acquire) - (position - slot));
+        if (diff == 0)
+        {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(&ring[slot], &event, offsetof(LogEvent, args) + event.size);
+    sequences[slot].store(position - slot + 1, std::memory_order_release);
+    events.fetch_add(1, std::memory_order_relaxed);
+    if (wakeEvent && (position & (LOG_RING_SLOTS / 2 - 1)) == 0)
+    {
+        Hal_SignalEvent(wakeEvent); // half a ring since the last wake-up
+    }
+#else
+    events.fetch_add(1, std::memory_order_relaxed);
+    char line[LOG_LINE_SIZE];
+    size_t length = Log_Format(event, line, sizeof(line));
+    Hal_LogWrite(line, length);
+#endif
+}
+
+/**
+ * @brief Waits until the log task has written the events stored so far (end of the native run).
+ */
+void Log_Flush()
+{
+    uint32_t target = head.load(std::memory_order_relaxed);
+    for (int i = 0; running && (int32_t)(tail.load(std::memory_order_relaxed) - target) < 0 && i < 1000; i++)
+    {
+        Hal_SignalEvent(wakeEvent);
+        Hal_DelayMs(1);
+    }
+}
+
+const LogStats &Log_GetStats()
+{
+    stats.events = events.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,200 @@
+#include <Metrics.h>
+#include <Log.h>
+#include <Boot.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <atomic>
+
+static const uint32_t bucketBounds[METRIC_BUCKETS - 1] = METRICS_BUCKETS_MS;
+
+struct Histogram
+{
+    std::atomic<uint32_t> buckets[METRIC_BUCKETS]; // Observations per bucket, not cumulative
+    std::atomic<uint32_t> sum;                     // Milliseconds
+};
+
+static std::atomic<uint32_t> counters[METRIC_COUNTER_COUNT];
+static Histogram histograms[METRIC_HISTOGRAM_COUNT];
+
+static const char *const histogramNames[METRIC_HISTOGRAM_COUNT] = {
+    "voice_first_audio_ms",
+    "voice_server_wait_ms",
+    "voice_turnaround_ms",
+};
+static const char *const histogramHelp[METRIC_HISTOGRAM_COUNT] = {
+    "End of recording to first sample played",
+    "Last byte sent to first response byte",
+    "End of recording to end of playback",
+};
+
+/**
+ * @brief Adds to a counter, from any task.
+ */
+void Metrics_Count(METRIC_COUNTER counter, uint32_t value)
+{
+    counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Current value of a counter, from any task.
+ */
+uint32_t Metrics_Counter(METRIC_COUNTER counter)
+{
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Adds an observation to a latency histogram, from any task.
+ */
+void Metrics_Observe(METRIC_HISTOGRAM histogram, uint32_t ms)
+{
+    int bucket = 0;
+    while (bucket < METRIC_BUCKETS - 1 && ms > bucketBounds[bucket])
+    {
+        bucket++;
+    }
+    histograms[histogram].buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histograms[histogram].sum.fetch_add(ms, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Adds the capture statistics of a recording, at its end.
+ */
+void Metrics_RecordCapture(const CaptureStats &capture)
+{
+    Metrics_Count(METRIC_CAPTURE_BLOCKS, capture.blocks);
+    Metrics_Count(METRIC_CAPTURE_QUEUE_OVERRUNS, capture.queueOverruns);
+    Metrics_Count(METRIC_CAPTURE_POOL_OVERRUNS, capture.poolOverruns);
+}
+
+/**
+ * @brief Adds a finished turn: bytes, HTTP status and latencies. Called at the end of its playback.
+ */
+void Metrics_RecordTurn(const TurnStats &stats)
+{
+    bool played = stats.playback.samplesPlayed > 0;
+    Metrics_Count(METRIC_TURNS);
+    Metrics_Count(METRIC_TURNS_PLAYED, played);
+    Metrics_Count(METRIC_UPLOAD_BYTES, stats.uploadedBytes);
+    Metrics_Count(METRIC_RESPONSE_BYTES, stats.responseBytes);
+    Metrics_Count(METRIC_PLAYBACK_UNDERRUNS, stats.playback.underruns);
+    Metrics_Count(METRIC_BARGE_INS, stats.bargeIn != 0);
+    int status = stats.httpStatus;
+    Metrics_Count(status < 200 || status > 599 ? METRIC_HTTP_ERROR : (METRIC_COUNTER)(METRIC_HTTP_2XX + status / 100 - 2));
+    if (status > 0)
+    {
+        Metrics_Observe(METRIC_SERVER_WAIT, stats.firstResponseTime - stats.lastByteSentTime);
+    }
+    if (played)
+    {
+        Metrics_Observe(METRIC_FIRST_AUDIO, stats.firstResponseTime + stats.playback.bufferedTime - stats.releaseTime);
+        Metrics_Observe(METRIC_TURNAROUND, stats.playbackEndTime - stats.releaseTime);
+    }
+}
+
+/**
+ * @brief Appends to the text, what does not fit is dropped.
+ */
+void Metrics_Printf(MetricsText &text, const char *format, ...)
+{
+    if (text.length + 1 >= text.size)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(text.buffer + text.length, text.size - text.length, format, args);
+    va_end(args);
+    if (written > 0)
+    {
+        text.length = text.length + written < text.size ? text.length + written : text.size - 1;
+    }
+}
+
+/**
+ * @brief Writes the HELP and TYPE lines of a metric.
+ */
+void Metrics_Header(MetricsText &text, const char *name, const char *type, const char *help)
+{
+    Metrics_Printf(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void Metrics_Counter(MetricsText &text, const char *name, const char *help, METRIC_COUNTER counter)
+{
+    Metrics_Header(text, name, "counter", help);
+    Metrics_Printf(text, "%s %u\n", name, (unsigned)counters[counter].load(std::memory_order_relaxed));
+}
+
+/**
+ * @brief Writes the pipeline counters and histograms.
+ */
+void Metrics_Format(MetricsText &text)
+{
+    Metrics_Counter(text, "voice_turns_total", "Turns answered", METRIC_TURNS);
+    Metrics_Counter(text, "voice_turns_played_total", "Turns whose response was played", METRIC_TURNS_PLAYED);
+    Metrics_Counter(text, "voice_recordings_dropped_total", "Recordings that could not be queued", METRIC_RECORDINGS_DROPPED);
+    Metrics_Counter(text, "voice_turns_empty_total", "Turns without speech, not uploaded", METRIC_TURNS_EMPTY);
+    Metrics_Counter(text, "voice_i2s_blocks_total", "I2S blocks captured for recordings", METRIC_CAPTURE_BLOCKS);
+    Metrics_Header(text, "voice_i2s_overruns_total", "counter", "Captured audio lost: queue full or no free block");
+    Metrics_Printf(text, "voice_i2s_overruns_total{kind=\"queue\"} %u\n",
+                   (unsigned)counters[METRIC_CAPTURE_QUEUE_OVERRUNS].load(std::memory_order_relaxed));
+    Metrics_Printf(text, "voice_i2s_overruns_total{kind=\"pool\"} %u\n",
+                   (unsigned)counters[METRIC_CAPTURE_POOL_OVERRUNS].load(std::memory_order_relaxed));
+    Metrics_Counter(text, "voice_upload_bytes_total", "Audio bytes sent to the server", METRIC_UPLOAD_BYTES);
+    Metrics_Counter(text, "voice_response_bytes_total", "Response bytes received", METRIC_RESPONSE_BYTES);
+    Metrics_Header(text, "voice_http_responses_total", "counter", "Server responses by status class, error: no response");
+    static const char *const classes[] = {"error", "2xx", "3xx", "4xx", "5xx"};
+    for (int i = 0; i < 5; i++)
+    {
+        Metrics_Printf(text, "voice_http_responses_total{code=\"%s\"} %u\n", classes[i],
+                       (unsigned)counters[METRIC_HTTP_ERROR + i].load(std::memory_order_relaxed));
+    }
+    Metrics_Counter(text, "voice_playback_underruns_total", "Times the player ran dry", METRIC_PLAYBACK_UNDERRUNS);
+    Metrics_Counter(text, "voice_barge_ins_total", "Responses interrupted by the next turn", METRIC_BARGE_INS);
+
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++)
+    {
+        const char *name = histogramNames[h];
+        Metrics_Header(text, name, "histogram", histogramHelp[h]);
+        uint32_t cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS; b++)
+        {
+            cumulative += histograms[h].buckets[b].load(std::memory_order_relaxed);
+            if (b < METRIC_BUCKETS - 1)
+            {
+                Metrics_Printf(text, "%s_bucket{le=\"%u\"} %u\n", name, (unsigned)bucketBounds[b], (unsigned)cumulative);
+            }
+            else
+            {
+                Metrics_Printf(text, "%s_bucket{le=\"+Inf\"} %u\n", name, (unsigned)cumulative);
+            }
+        }
+        Metrics_Printf(text, "%s_sum %u\n%s_count %u\n", name,
+                       (unsigned)histograms[h].sum.load(std::memory_order_relaxed), name, (unsigned)cumulative);
+    }
+
+    const LogStats &log = Log_GetStats();
+    Metrics_Header(text, "voice_log_events_total", "counter", "Log events stored");
+    Metrics_Printf(text, "voice_log_events_total %u\n", (unsigned)log.events);
+    Metrics_Header(text, "voice_log_dropped_total", "counter", "Log events lost because the ring was full");
+    Metrics_Printf(text, "voice_log_dropped_total %u\n", (unsigned)log.dropped);
+
+    const BootTimeline &boot = Boot_GetTimeline();
+    if (boot.ready)
+    {
+        Metrics_Header(text, "voice_boot_ready_ms", "gauge", "Program start to the device taking commands (Boot.h)");
+        Metrics_Printf(text, "voice_boot_ready_ms %u\n", (unsigned)(boot.readyUs / 1000));
+    }
+    if (boot.count > 0)
+    {
+        Metrics_Header(text, "voice_boot_step_ms", "gauge", "Duration of the boot steps, run in parallel where they allow it");
+    }
+    for (uint32_t i = 0; i < boot.count; i++)
+    {
+        const BootRecord &step = boot.steps[i];
+        if (step.ended)
+        {
+            Metrics_Printf(text, "voice_boot_step_ms{step=\"%s\"} %u\n", step.name, (unsigned)((step.endUs - step.startUs) / 1000));
+        }
+    }
+}
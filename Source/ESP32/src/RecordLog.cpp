@@ -0,0 +1,412 @@
+#include <RecordLog.h>
+#include <App.h>
+#include <AudioFormat.h>
+#include <string.h>
+
+#define RECORD_LOG_BENCH_WRITE (I2S_READ_LEN / 4) // Bytes per benchmark write: a capture block encoded as IMA ADPCM
+
+static_assert(sizeof(RecordHeader) == 16, "Record header layout is stored in flash");
+static_assert(RECORD_LOG_NATIVE_SIZE % RECORD_LOG_SECTOR == 0, "The native log holds whole sectors");
+
+static FlashRegion *flash = NULL;
+static const uint8_t *mapped = NULL;
+static uint32_t regionSize = 0;
+static uint32_t start = 0;      // Offset of the open (or next) record, on a sector boundary
+static uint32_t erased = 0;     // Bytes erased from `start` on, whole sectors
+static uint32_t length = 0;     // Bytes written to the open record
+static bool recordOpen = false;
+static uint32_t sequence = 0;   // Sequence number of the open (or next) record
+static bool retained = false;   // A closed record is still in use, see RecordLog_Retain()
+static uint32_t tail = 0;       // Start of the oldest record in use
+static RecordLogStats stats;
+
+static uint32_t RecordLog_Sectors(uint32_t bytes)
+{
+    return (bytes + RECORD_LOG_SECTOR - 1) / RECORD_LOG_SECTOR * RECORD_LOG_SECTOR;
+}
+
+/**
+ * @brief Bytes from `start` on that the open (or next) record may use.
+ *
+ * Without retained records it is the whole partition. A sector is left between the write head
+ * and the oldest retained record, so a full log is not mistaken for an empty one.
+ */
+static uint32_t RecordLog_Limit()
+{
+    if (!retained)
+    {
+        return regionSize;
+    }
+    uint32_t kept = (start + regionSize - tail) % regionSize;
+    return kept + RECORD_LOG_SECTOR < regionSize ? regionSize - kept - RECORD_LOG_SECTOR : 0;
+}
+
+/**
+ * @brief Erases the sector after the erased area, as long as it does not reach the open record
+ *        or a retained one.
+ */
+static bool RecordLog_EraseNext()
+{
+    if (erased + RECORD_LOG_SECTOR > RecordLog_Limit())
+    {
+        return false; // the next sector is the start of the open record or of a retained one
+    }
+    uint64_t begin = Hal_Micros();
+    bool ok = flash->Erase((start + erased) % regionSize, RECORD_LOG_SECTOR);
+    uint32_t us = (uint32_t)(Hal_Micros() - begin);
+    stats.maxEraseUs = us > stats.maxEraseUs ? us : stats.maxEraseUs;
+    if (ok)
+    {
+        erased += RECORD_LOG_SECTOR;
+    }
+    return ok;
+}
+
+/**
+ * @brief Programs bytes of the open record, split in two when they wrap around the end of the partition.
+ *
+ * @param offset Offset in the record.
+ */
+static bool RecordLog_Program(uint32_t offset, const uint8_t *data, size_t len)
+{
+    uint32_t position = (start + offset) % regionSize;
+    size_t first = len < regionSize - position ? len : regionSize - position;
+    return flash->Write(position, data, first) && (first == len || flash->Write(0, data + first, len - first));
+}
+
+/**
+ * @brief Appends to the open record, erasing the sectors it reaches that were not erased ahead.
+ */
+static bool RecordLog_Append(const uint8_t *data, size_t len)
+{
+    uint64_t begin = Hal_Micros();
+    bool ok = true;
+    while (ok && length + len > erased)
+    {
+        ok = RecordLog_EraseNext();
+        stats.inlineErases++;
+    }
+    ok = ok && RecordLog_Program(length, data, len);
+    uint32_t us = (uint32_t)(Hal_Micros() - begin);
+    stats.writeUs += us;
+    stats.maxWriteUs = us > stats.maxWriteUs ? us : stats.maxWriteUs;
+    if (ok)
+    {
+        length += len;
+        stats.bytes += len;
+    }
+    return ok;
+}
+
+/**
+ * @brief Maps the partition and finds the end of the newest record.
+ *
+ * The erased sectors already ahead of the write head are counted, so a reboot does not erase
+ * them again.
+ *
+ * @param region The recording log partition.
+ * @return false if the partition cannot be used, the recordings then go to the file system.
+ */
+bool RecordLog_Init(FlashRegion &region)
+{
+    if (!region.Begin() || !region.Map() || region.Size() < 2 * RECORD_LOG_SECTOR || region.Size() % RECORD_LOG_SECTOR)
+    {
+        LOGL("Record log: no usable " RECORD_LOG_PARTITION " partition, recording to " RECORD_FILE_NAME);
+        return false;
+    }
+    flash = &region;
+    mapped = region.Map();
+    regionSize = region.Size();
+    memset(&stats, 0, sizeof(stats));
+
+    bool found = false;
+    RecordHeader newest = {};
+    uint32_t newestOffset = 0;
+    for (uint32_t offset = 0; offset < regionSize; offset += RECORD_LOG_SECTOR)
+    {
+        RecordHeader header;
+        memcpy(&header, mapped + offset, sizeof(header));
+        bool valid = header.magic == RECORD_LOG_MAGIC &&
+                     (header.size == RECORD_LOG_OPEN || (header.check == ~header.size && header.size <= regionSize - sizeof(header)));
+        if (valid && (!found || (int32_t)(header.sequence - newest.sequence) > 0))
+        {
+            found = true;
+            newest = header;
+            newestOffset = offset;
+        }
+    }
+    start = 0;
+    sequence = 0;
+    retained = false;
+    if (found)
+    {
+        // A record cut by a reset is overwritten, a closed one is kept
+        sequence = newest.sequence + 1;
+        start = newest.size == RECORD_LOG_OPEN ? newestOffset
+                                                : (newestOffset + RecordLog_Sectors(sizeof(newest) + newest.size)) % regionSize;
+    }
+    erased = 0;
+    while (erased + RECORD_LOG_SECTOR <= regionSize)
+    {
+        const uint8_t *sector = mapped + (start + erased) % regionSize;
+        size_t i = 0;
+        while (i < RECORD_LOG_SECTOR && sector[i] == 0xFF)
+        {
+            i++;
+        }
+        if (i < RECORD_LOG_SECTOR)
+        {
+            break;
+        }
+        erased += RECORD_LOG_SECTOR;
+    }
+    LOGL("Record log: %u KB partition, record %u at 0x%x, %u KB erased ahead",
+         (unsigned)(regionSize / 1024), (unsigned)sequence, (unsigned)start, (unsigned)(erased / 1024));
+    return true;
+}
+
+/**
+ * @brief Erases one more sector ahead of the write head if fewer than `bytes` can be recorded
+ *        without an erase. Call it while idle, until it returns false.
+ *
+ * An erase stalls the flash cache of both cores for tens of milliseconds: do not call it while
+ * the capture or the playback runs.
+ *
+ * @param bytes Audio bytes of the next recording.
+ * @return true if a sector was erased and more are needed.
+ */
+bool RecordLog_EraseAhead(uint32_t bytes)
+{
+    if (!flash || recordOpen)
+    {
+        return false;
+    }
+    uint32_t needed = RecordLog_Sectors(sizeof(RecordHeader) + WAV_HEADER_SIZE + bytes);
+    uint32_t limit = RecordLog_Limit();
+    needed = needed < limit ? needed : limit;
+    if (erased >= needed || !RecordLog_EraseNext())
+    {
+        return false;
+    }
+    stats.aheadErases++;
+    return erased < needed;
+}
+
+/**
+ * @brief Opens a record at the write head, its headers carry 0xFFFFFFFF sizes until RecordLog_End().
+ */
+bool RecordLog_Begin()
+{
+    if (!flash || recordOpen)
+    {
+        return false;
+    }
+    stats.bytes = stats.writeUs = stats.maxWriteUs = stats.inlineErases = 0;
+    length = 0;
+    RecordHeader header = {RECORD_LOG_MAGIC, sequence, RECORD_LOG_OPEN, RECORD_LOG_OPEN};
+    recordOpen = RecordLog_Append((const uint8_t *)&header, sizeof(header)) &&
+                 RecordLog_Append(CaptureFormat::StreamingHeader.bytes, WAV_HEADER_SIZE);
+    if (!recordOpen)
+    {
+        erased = 0; // the written part is erased again by the next record
+    }
+    return recordOpen;
+}
+
+/**
+ * @brief Appends audio to the open record.
+ *
+ * @return false if no record is open or the flash write failed, the record is then dropped.
+ */
+bool RecordLog_Write(const uint8_t *data, size_t len)
+{
+    if (!recordOpen)
+    {
+        return false;
+    }
+    if (!RecordLog_Append(data, len))
+    {
+        LOGE("Record log: write failed after %u bytes, recording dropped", (unsigned)length);
+        recordOpen = false;
+        erased = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Drops the open record (a turn without speech): the next record starts at the same place.
+ *
+ * The sectors it reached are erased again, like those of a record whose write failed.
+ */
+void RecordLog_Abandon()
+{
+    if (recordOpen)
+    {
+        recordOpen = false;
+        erased = 0;
+    }
+}
+
+/**
+ * @brief Closes the open record: writes its sizes and moves the write head to the next sector.
+ *
+ * @param totalAudioLen Data size written to the WAV header: the encoded bytes appended to the record.
+ * @param view Receives the WAV file in place in the mapped partition, valid until the next
+ *             RecordLog_EraseAhead() or RecordLog_Begin().
+ * @return false if no record is open.
+ */
+bool RecordLog_End(uint32_t totalAudioLen, RecordView &view)
+{
+    if (!recordOpen)
+    {
+        return false;
+    }
+    recordOpen = false;
+    // The WAV sizes first, the record size last: it marks the record as complete
+    uint32_t size = length - sizeof(RecordHeader);
+    WavHeader wav = CaptureFormat::Header(totalAudioLen);
+    RecordHeader header = {RECORD_LOG_MAGIC, sequence, size, ~size};
+    if (!RecordLog_Program(sizeof(header), wav.bytes, WAV_HEADER_SIZE) ||
+        !RecordLog_Program(0, (const uint8_t *)&header, sizeof(header)))
+    {
+        erased = 0;
+        return false;
+    }
+
+    uint32_t position = (start + sizeof(header)) % regionSize;
+    view.size = size;
+    view.lengths[0] = size < regionSize - position ? size : regionSize - position;
+    view.lengths[1] = size - view.lengths[0];
+    view.parts[0] = mapped + position;
+    view.parts[1] = view.lengths[1] ? mapped : NULL;
+    view.offset = start;
+
+    uint32_t used = RecordLog_Sectors(length);
+    start = (start + used) % regionSize;
+    erased -= used;
+    sequence++;
+    stats.records++;
+    return true;
+}
+
+/**
+ * @brief Keeps the records from `oldest` on: the log does not erase them.
+ *
+ * Call it from the task that writes the log, before RecordLog_EraseAhead() and RecordLog_Begin().
+ *
+ * @param oldest The oldest record still in use, NULL once none is.
+ */
+void RecordLog_Retain(const RecordView *oldest)
+{
+    retained = oldest != NULL;
+    tail = oldest ? oldest->offset : 0;
+}
+
+/**
+ * @brief Audio bytes the next record can hold without reaching a retained record.
+ */
+uint32_t RecordLog_Available()
+{
+    uint32_t limit = flash ? RecordLog_Limit() : 0;
+    uint32_t headers = sizeof(RecordHeader) + WAV_HEADER_SIZE;
+    return limit > headers ? limit - headers : 0;
+}
+
+const RecordLogStats &RecordLog_GetStats()
+{
+    return stats;
+}
+
+/**
+ * @brief Logs the write statistics of the last record.
+ */
+void RecordLog_Logging()
+{
+    LOGL("Record log: %u bytes in %u us (%u KB/s), longest write %u us, %u sectors erased inline, longest erase %u us",
+         (unsigned)stats.bytes, (unsigned)stats.writeUs, (unsigned)(stats.writeUs ? (uint64_t)stats.bytes * 1000 / stats.writeUs : 0),
+         (unsigned)stats.maxWriteUs, (unsigned)stats.inlineErases, (unsigned)stats.maxEraseUs);
+}
+
+/**
+ * @brief Logs the throughput and the longest write of one write path of the benchmark.
+ */
+static void RecordLog_BenchResult(const char *path, uint32_t bytes, uint64_t totalUs, uint32_t maxUs)
+{
+    LOGL("\t%-12s %6u KB/s, longest write %u us", path,
+         (unsigned)(totalUs ? (uint64_t)bytes * 1000 / totalUs : 0), (unsigned)maxUs);
+}
+
+/**
+ * @brief Writes a recording of `bytes` bytes through the file system and through the log, and
+ *        logs the sustained throughput and the worst write latency of both paths.
+ *
+ * Both paths write the same WAV file in the same writes as a recording: a placeholder header,
+ * encoded capture blocks, the final header. The log is erased ahead first, as while idle. The
+ * file is removed afterwards; the log keeps the record.
+ */
+void RecordLog_Benchmark(Storage &storage, uint32_t bytes)
+{
+    if (!flash)
+    {
+        LOGL("Record log benchmark: no record log");
+        return;
+    }
+    uint8_t block[RECORD_LOG_BENCH_WRITE];
+    for (size_t i = 0; i < sizeof(block); i++)
+    {
+        block[i] = (uint8_t)(i * 7 + 1);
+    }
+    LOGL("Recording write benchmark: %u bytes in %u-byte writes", (unsigned)bytes, (unsigned)sizeof(block));
+
+    // File system: the RECORD_FILE_NAME path of the recording
+    storage.Remove(RECORD_FILE_NAME);
+    uint64_t begin = Hal_Micros();
+    uint32_t maxUs = 0;
+    StorageFile *file = storage.Open(RECORD_FILE_NAME, true);
+    if (!file)
+    {
+        LOGL("\tcannot create " RECORD_FILE_NAME);
+        return;
+    }
+    file->Write(CaptureFormat::StreamingHeader.bytes, WAV_HEADER_SIZE);
+    for (uint32_t written = 0; written < bytes; written += sizeof(block))
+    {
+        uint64_t writeBegin = Hal_Micros();
+        file->Write(block, sizeof(block));
+        uint32_t us = (uint32_t)(Hal_Micros() - writeBegin);
+        maxUs = us > maxUs ? us : maxUs;
+    }
+    WavHeader wav = CaptureFormat::Header(bytes);
+    file->Seek(0);
+    file->Write(wav.bytes, WAV_HEADER_SIZE);
+    file->Close();
+    FREE(file);
+    RecordLog_BenchResult("file system", bytes, Hal_Micros() - begin, maxUs);
+    storage.Remove(RECORD_FILE_NAME);
+
+    // Record log, erased ahead as between turns
+    begin = Hal_Micros();
+    while (RecordLog_EraseAhead(bytes))
+    {
+    }
+    LOGL("\terase ahead  %u ms", (unsigned)((Hal_Micros() - begin) / 1000));
+    begin = Hal_Micros();
+    maxUs = 0;
+    RecordView view;
+    bool ok = RecordLog_Begin();
+    for (uint32_t written = 0; ok && written < bytes; written += sizeof(block))
+    {
+        uint64_t writeBegin = Hal_Micros();
+        ok = RecordLog_Write(block, sizeof(block));
+        uint32_t us = (uint32_t)(Hal_Micros() - writeBegin);
+        maxUs = us > maxUs ? us : maxUs;
+    }
+    ok = ok && RecordLog_End(bytes, view);
+    if (!ok)
+    {
+        LOGL("\trecord log write failed");
+        return;
+    }
+    RecordLog_BenchResult("record log", bytes, Hal_Micros() - begin, maxUs);
+}
@@ -0,0 +1,178 @@
+#include <Resampler.h>
+#include <string.h>
+#include <math.h>
+
+#define RESAMPLER_COEFF_SHIFT 14
+
+static uint32_t Resampler_Gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+ */
+static float Resampler_BesselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * @brief Builds the filter phases for a cut-off frequency.
+ *
+ * @param cutoff Cut-off in cycles per input sample (below 0.5).
+ */
+static void Resampler_BuildTable(ResamplerState &state, float cutoff)
+{
+    const float pi = 3.14159265f;
+    const float half = RESAMPLER_TAPS / 2;
+    float norm = Resampler_BesselI0(RESAMPLER_KAISER_BETA);
+    for (int p = 0; p <= RESAMPLER_PHASES; p++)
+    {
+        float fraction = (float)p / RESAMPLER_PHASES;
+        float taps[RESAMPLER_TAPS];
+        float sum = 0.0f;
+        for (int k = 0; k < RESAMPLER_TAPS; k++)
+        {
+            // Distance from tap k to the output position, which lies between taps half - 1 and half
+            float d = (k - (half - 1.0f)) - fraction;
+            float x = d / half;
+            float window = x * x < 1.0f ? Resampler_BesselI0(RESAMPLER_KAISER_BETA * sqrtf(1.0f - x * x)) / norm : 0.0f;
+            float sinc = d == 0.0f ? 1.0f : sinf(2.0f * pi * cutoff * d) / (2.0f * pi * cutoff * d);
+            taps[k] = 2.0f * cutoff * sinc * window;
+            sum += taps[k];
+        }
+        // Unity gain at DC for every phase, the rounding error goes to the largest tap
+        int32_t total = 0;
+        int largest = 0;
+        for (int k = 0; k < RESAMPLER_TAPS; k++)
+        {
+            state.coeffs[p][k] = (int16_t)lrintf(taps[k] / sum * (1 << RESAMPLER_COEFF_SHIFT));
+            total += state.coeffs[p][k];
+            largest = state.coeffs[p][k] > state.coeffs[p][largest] ? k : largest;
+        }
+        state.coeffs[p][largest] += (1 << RESAMPLER_COEFF_SHIFT) - total;
+    }
+}
+
+/**
+ * @brief Dot product of the input window with one phase, Q14.
+ */
+static inline int32_t Resampler_Dot(const int16_t *window, const int16_t *coeffs)
+{
+    int32_t sum = 0;
+    for (int k = 0; k < RESAMPLER_TAPS; k++)
+    {
+        sum += (int32_t)window[k] * coeffs[k];
+    }
+    return sum;
+}
+
+/**
+ * @brief Prepares a conversion, the history starts silent.
+ *
+ * @param state The resampler state.
+ * @param inRate Rate of the samples given to Resampler_Process().
+ * @param outRate Rate of the samples it produces.
+ */
+void Resampler_Init(ResamplerState &state, uint32_t inRate, uint32_t outRate)
+{
+    memset(&state, 0, sizeof(state));
+    uint32_t gcd = Resampler_Gcd(inRate, outRate);
+    state.up = outRate / gcd;
+    state.down = inRate / gcd;
+    if (state.up == state.down)
+    {
+        return; // same rate, Resampler_Process() only delays
+    }
+    float ratio = (float)outRate / inRate;
+    Resampler_BuildTable(state, 0.5f * RESAMPLER_ROLLOFF * (ratio < 1.0f ? ratio : 1.0f));
+}
+
+/**
+ * @brief Largest number of samples produced from `inCount` inputs.
+ */
+size_t Resampler_MaxOutput(const ResamplerState &state, size_t inCount)
+{
+    return (size_t)(((uint64_t)inCount * state.up + state.down - 1) / state.down) + 1;
+}
+
+/**
+ * @brief Largest number of inputs whose output always fits in `outCapacity` samples.
+ */
+size_t Resampler_MaxInput(const ResamplerState &state, size_t outCapacity)
+{
+    if (outCapacity < 2)
+    {
+        return 0;
+    }
+    return (size_t)((uint64_t)(outCapacity - 2) * state.down / state.up);
+}
+
+/**
+ * @brief Converts a block of samples.
+ *
+ * @param state The resampler state.
+ * @param in Input samples.
+ * @param inCount Number of input samples, all are consumed.
+ * @param out Output samples, room for Resampler_MaxOutput(inCount).
+ * @return Number of output samples.
+ */
+size_t Resampler_Process(ResamplerState &state, const int16_t *in, size_t inCount, int16_t *out)
+{
+    if (state.up == state.down)
+    {
+        // Pass-through, with the same delay as the filter so the stream timing does not depend on the rate
+        for (size_t i = 0; i < inCount; i++)
+        {
+            out[i] = state.history[state.next + RESAMPLER_TAPS / 2];
+            state.history[state.next] = in[i];
+            state.history[state.next + RESAMPLER_TAPS] = in[i];
+            state.next = state.next + 1 == RESAMPLER_TAPS ? 0 : state.next + 1;
+        }
+        return inCount;
+    }
+    size_t produced = 0;
+    for (size_t i = 0; i < inCount; i++)
+    {
+        state.history[state.next] = in[i];
+        state.history[state.next + RESAMPLER_TAPS] = in[i];
+        state.next = state.next + 1 == RESAMPLER_TAPS ? 0 : state.next + 1;
+        const int16_t *window = state.history + state.next; // oldest first
+
+        // Outputs that fall before the next input sample
+        while (state.position < state.up)
+        {
+            // Phase index and the Q15 fraction toward the next phase
+            uint32_t scaled = (uint32_t)(((uint64_t)state.position * RESAMPLER_PHASES << 15) / state.up);
+            uint32_t phase = scaled >> 15;
+            int32_t mu = scaled & 0x7FFF;
+            int32_t y = Resampler_Dot(window, state.coeffs[phase]);
+            if (mu != 0)
+            {
+                int32_t y1 = Resampler_Dot(window, state.coeffs[phase + 1]);
+                y += (int32_t)(((int64_t)(y1 - y) * mu) >> 15);
+            }
+            y = (y + (1 << (RESAMPLER_COEFF_SHIFT - 1))) >> RESAMPLER_COEFF_SHIFT;
+            if (y > 32767) y = 32767;
+            else if (y < -32768) y = -32768;
+            out[produced++] = (int16_t)y;
+            state.position += state.down;
+        }
+        state.position -= state.up;
+    }
+    return produced;
+}
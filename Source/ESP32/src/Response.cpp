@@ -0,0 +1,219 @@
+#include <Response.h>
+#include <App.h>
+#include <Config.h>
+#include <Arena.h>
+#include <SampleKernels.h>
+#include <Trace.h>
+#include <BargeIn.h>
+#include <string.h>
+
+/**
+ * @brief Prepares the decoder for a new response body.
+ *
+ * @param stream The decoder state.
+ * @param info Codec (X-Audio-Codec), length and clip action of the body.
+ * @return false if the decode buffer cannot be allocated.
+ */
+bool Response_Begin(ResponseStream &stream, const ResponseInfo &info)
+{
+    memset(&stream, 0, sizeof(stream));
+    stream.codec = info.codec;
+    stream.expected = info.contentLength;
+    Wav_ParserReset(stream.wav);
+    Codec_Reset(stream.codecState, info.codec);
+    // Turn scratch memory, released by Arena_Reset() at the end of the turn
+    stream.decodeBuff = (int16_t *)Arena_Alloc(RESPONSE_READ_LEN * 2 * sizeof(int16_t)); // worst case expansion is IMA-ADPCM, 2 samples per byte
+    stream.failed = stream.decodeBuff == NULL;
+    if (!stream.failed && info.clipAction == CLIP_STORE)
+    {
+        ClipCache_BeginStore(stream.clip, info.clipId, info.codec);
+    }
+    return !stream.failed;
+}
+
+/**
+ * @brief Checks the parsed WAV header and starts the speaker.
+ */
+static bool Response_StartPlayback(ResponseStream &stream, AudioOutput &speaker, TurnStats &stats)
+{
+    const WavInfo &format = stream.wav.info;
+    stats.firstResponseTime = Hal_Millis();
+    if (format.sampleRate == 0 || format.channels != 1 || format.sampleBits != (stream.codec == CODEC_PCM ? 8 : 16) ||
+        (stream.codec == CODEC_PHONEMES && !SYNTH_ENABLE))
+    {
+        LOGL("Unsupported response format: %u Hz, %u bits, %u channels, %s", (unsigned)format.sampleRate, format.sampleBits, format.channels, Codec_ToString(stream.codec));
+        return false;
+    }
+    bool sized = format.dataSize != 0 && format.dataSize != WAV_SIZE_UNKNOWN;
+    stream.dataLeft = sized ? format.dataSize : WAV_SIZE_UNKNOWN;
+#if SYNTH_ENABLE
+    if (stream.codec == CODEC_PHONEMES)
+    {
+        Synth_Begin(stream.synth, format.sampleRate); // rendered at the rate of the header
+    }
+#endif
+    speaker.Begin(format.sampleRate);
+    BargeIn_Playback(format.sampleRate);
+    return true;
+}
+
+/**
+ * @brief Sends decoded DAC samples to the speaker, unless the next turn interrupted the response (BargeIn.h).
+ *
+ * @return false once the playback was stopped or interrupted.
+ */
+static bool Response_Play(ResponseStream &stream, const uint8_t *samples, size_t count, AudioOutput &speaker)
+{
+    if (BargeIn_Check())
+    {
+        stream.failed = true; // interrupted by the next turn
+        return false;
+    }
+    BargeIn_Reference(samples, count);
+    if (speaker.Write(samples, count) < count)
+    {
+        stream.failed = true; // playback stopped
+        return false;
+    }
+    return true;
+}
+
+#if SYNTH_ENABLE
+/**
+ * @brief Renders the phoneme units of a piece of the body, each one as soon as it is complete.
+ *
+ * The speaker applies back pressure block by block, so a unit never needs more than the decode buffer.
+ */
+static bool Response_Speak(ResponseStream &stream, const uint8_t *data, size_t len, AudioOutput &speaker)
+{
+    while (len > 0)
+    {
+        size_t used = Synth_Feed(stream.synth, data, len);
+        data += used;
+        len -= used;
+        size_t count;
+        while ((count = Synth_Render(stream.synth, stream.decodeBuff, RESPONSE_READ_LEN * 2)) > 0)
+        {
+            Kernel_Pcm16ToDac((uint8_t *)stream.decodeBuff, stream.decodeBuff, count);
+            if (!Response_Play(stream, (uint8_t *)stream.decodeBuff, count, speaker))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+#endif
+
+/**
+ * @brief Feeds a piece of the response body to the speaker.
+ *
+ * @param stream The decoder state.
+ * @param data Body bytes, decoded in place for mu-law.
+ * @param len Number of bytes.
+ * @param speaker The audio output to stream to.
+ * @param stats Receives the response timing.
+ * @return false once the format is unsupported or the playback was stopped (or interrupted, BargeIn.h).
+ */
+bool Response_Write(ResponseStream &stream, uint8_t *data, size_t len, AudioOutput &speaker, TurnStats &stats)
+{
+    stream.received += len;
+    ClipCache_Write(stream.clip, data, len); // as received, before the in-place decode
+    if (stream.failed)
+    {
+        return false;
+    }
+    if (!stream.playing)
+    {
+        size_t n = Wav_Parse(stream.wav, data, len);
+        data += n;
+        len -= n;
+        if (stream.wav.state == WAV_PARSE_FAILED)
+        {
+            LOGE("Response is not a PCM WAV file");
+            stream.failed = true;
+            return false;
+        }
+        if (stream.wav.state != WAV_PARSE_DONE)
+        {
+            return true;
+        }
+        stream.playing = Response_StartPlayback(stream, speaker, stats);
+        stream.failed = !stream.playing;
+        if (stream.failed)
+        {
+            return false;
+        }
+    }
+
+    if (len > stream.dataLeft)
+    {
+        len = stream.dataLeft;
+    }
+    stream.dataLeft -= stream.dataLeft == WAV_SIZE_UNKNOWN ? 0 : len;
+    while (len > 0)
+    {
+        size_t n = len < RESPONSE_READ_LEN ? len : RESPONSE_READ_LEN;
+        uint8_t *samples = data;
+        size_t sampleCount = n;
+#if SYNTH_ENABLE
+        if (stream.codec == CODEC_PHONEMES)
+        {
+            if (!Response_Speak(stream, data, n, speaker))
+            {
+                return false;
+            }
+            data += n;
+            len -= n;
+            continue;
+        }
+#endif
+        if (stream.codec == CODEC_MULAW)
+        {
+            Kernel_MulawToDac(data, data, n);
+        }
+        else if (stream.codec != CODEC_PCM)
+        {
+            // Decode, then reduce to unsigned 8-bit in place
+            sampleCount = Codec_Decode(stream.codecState, stream.decodeBuff, data, n);
+            samples = (uint8_t *)stream.decodeBuff;
+            Kernel_Pcm16ToDac(samples, stream.decodeBuff, sampleCount);
+        }
+        if (!Response_Play(stream, samples, sampleCount, speaker))
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Marks the end of the response body, the speaker plays out what is buffered.
+ */
+void Response_End(ResponseStream &stream, AudioOutput &speaker, TurnStats &stats)
+{
+    if (stream.playing)
+    {
+        speaker.End();
+    }
+    ClipCache_EndStore(stream.clip, stream.expected >= 0 && stream.received == (uint32_t)stream.expected);
+    Trace_Mark(TRACE_LAST_RESPONSE_BYTE, stream.received);
+    stats.lastResponseTime = Hal_Millis();
+    stats.responseBytes = stream.received;
+    if (stream.wav.state != WAV_PARSE_DONE)
+    {
+        LOGL("Response WAV header is incomplete");
+        return;
+    }
+    uint32_t rate = stream.wav.info.sampleRate;
+    LOGL("\tReceived response WAV file, size: %u bytes (%u Hz, %s, %u byte header, %s)", (unsigned)stream.received, (unsigned)rate, Codec_ToString(stream.codec),
+         (unsigned)stream.wav.info.headerSize, rate == PlaybackFormat::SampleRate ? "DAC rate" : "resampled");
+#if SYNTH_ENABLE
+    if (stream.codec == CODEC_PHONEMES)
+    {
+        LOGL("\tSynthesized %u phonemes", (unsigned)stream.synth.units);
+    }
+#endif
+}
@@ -0,0 +1,488 @@
+#include <Server.h>
+#include <AudioFormat.h>
+#include <App.h>
+#include <Config.h>
+#include <Response.h>
+#include <Trace.h>
+#include <Arena.h>
+#include <ClipCache.h>
+#include <RecordLog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *serverHost = "";
+static uint16_t serverPort = 0;
+static uint32_t bodyBytesSent = 0; // Request body bytes of the current upload
+
+/**
+ * @brief Sets the address of the voice server.
+ *
+ * @param host Server IP address or host name, must outlive the server module.
+ * @param port Server TCP port.
+ */
+void Server_Init(const char *host, uint16_t port)
+{
+    serverHost = host;
+    serverPort = port;
+}
+
+/**
+ * @brief Writes the WAV header of a recording to a specified buffer.
+ *
+ * The header is CaptureFormat's (AudioFormat.h), built at compile time; only the sizes are filled in.
+ * The format fields describe the captured PCM whatever the upload codec, which is sent in
+ * X-Audio-Codec; the sizes are those of the data that follows.
+ *
+ * @param buffer Pointer to the array where the 44-byte WAV header will be stored.
+ * @param totalAudioLen Size of the data chunk in bytes (encoded with UPLOAD_CODEC).
+ */
+void Buffer_WriteWavHeader(uint8_t *buffer, uint32_t totalAudioLen)
+{
+    WavHeader header = CaptureFormat::Header(totalAudioLen);
+    memcpy(buffer, header.bytes, WAV_HEADER_SIZE);
+}
+
+/**
+ * @brief Writes the header of a WAV stream whose length is unknown.
+ *
+ * The RIFF and data sizes are set to 0xFFFFFFFF (streaming WAV convention); the server
+ * patches them from the number of bytes received.
+ *
+ * @param buffer Pointer to the array where the 44-byte WAV header will be stored.
+ */
+void Buffer_WriteStreamingWavHeader(uint8_t *buffer)
+{
+    memcpy(buffer, CaptureFormat::StreamingHeader.bytes, WAV_HEADER_SIZE);
+}
+
+/**
+ * @brief Writes a string to the transport.
+ *
+ * @return true if the whole string was written.
+ */
+static bool Server_WriteString(Transport &transport, const char *text)
+{
+    size_t len = strlen(text);
+    return transport.Write((const uint8_t *)text, len) == len;
+}
+
+/**
+ * @brief Reads exactly `len` bytes, waiting up to `timeoutMs` for each part.
+ *
+ * @return true if all bytes were read.
+ */
+bool Server_ReadExact(Transport &transport, uint8_t *buffer, size_t len, uint32_t timeoutMs)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        int n = transport.Read(buffer + done, len - done, timeoutMs);
+        if (n <= 0)
+        {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads one header line without its line ending.
+ *
+ * Bytes are read one at a time so no part of the body is consumed.
+ *
+ * @return false on timeout or closed connection.
+ */
+static bool Server_ReadLine(Transport &transport, char *line, size_t size, uint32_t timeoutMs)
+{
+    size_t len = 0;
+    while (true)
+    {
+        uint8_t c;
+        if (transport.Read(&c, 1, timeoutMs) <= 0)
+        {
+            return false;
+        }
+        if (c == '\n')
+        {
+            break;
+        }
+        if (c != '\r' && len + 1 < size)
+        {
+            line[len++] = c;
+        }
+    }
+    line[len] = '\0';
+    return true;
+}
+
+/**
+ * @brief Formats the headers describing the audio of a turn.
+ *
+ * The same "Key: value" lines are sent in the HTTP request and in the TURN_BEGIN frame of a
+ * session (Session.h), so the server reads them the same way. X-Accept-Format advertises the
+ * DAC format (rate/bits/channels, PlaybackFormat in AudioFormat.h) so the response needs no
+ * resampling; the ids of the cached clips (ClipCache.h) are advertised as well. A log-mel upload
+ * (Codec.h) gives the layout of its frames in X-Feature-Format: bands/frame length/hop, in samples.
+ *
+ * @return Length of the formatted text.
+ */
+size_t Server_FormatTurnHeaders(char *buffer, size_t size)
+{
+    int len = snprintf(buffer, size,
+                       "X-Audio-Codec: %s\r\n"
+                       "X-Accept-Codec: " ACCEPT_CODECS "\r\n"
+                       "X-Accept-Format: %u/%u/%u\r\n",
+                       Codec_ToString(UPLOAD_CODEC),
+                       (unsigned)PlaybackFormat::SampleRate, (unsigned)PlaybackFormat::SampleBits, (unsigned)PlaybackFormat::ChannelCount);
+    if (len >= 0 && (size_t)len < size && Codec_IsFeatures(UPLOAD_CODEC))
+    {
+        len += snprintf(buffer + len, size - len, "X-Feature-Format: %u/%u/%u\r\n",
+                        (unsigned)FEATURE_MEL_BANDS, (unsigned)FEATURE_FRAME_LEN, (unsigned)FEATURE_HOP);
+    }
+    if (len < 0 || (size_t)len >= size)
+    {
+        return len < 0 ? 0 : size - 1;
+    }
+    return len + ClipCache_FormatIds(buffer + len, size - len);
+}
+
+/**
+ * @brief Parses one "Key: value" response header line.
+ *
+ * Used for the HTTP response headers and the RESPONSE_BEGIN frame of a session.
+ *
+ * @param line The header line, modified in place.
+ * @param info Receives Status, Content-Length, X-Audio-Codec, X-Clip-Id and X-Clip-Action,
+ *             other keys are ignored.
+ */
+void Server_ParseHeaderLine(char *line, ResponseInfo &info)
+{
+    char *value = strchr(line, ':');
+    if (!value)
+    {
+        return;
+    }
+    *value++ = '\0';
+    while (*value == ' ')
+    {
+        value++;
+    }
+    if (strcasecmp(line, "Status") == 0)
+    {
+        info.status = atoi(value);
+    }
+    else if (strcasecmp(line, "Content-Length") == 0)
+    {
+        info.contentLength = atoi(value);
+    }
+    else if (strcasecmp(line, "X-Audio-Codec") == 0)
+    {
+        info.codec = Codec_FromString(value);
+    }
+    else if (strcasecmp(line, "X-Clip-Id") == 0)
+    {
+        info.clipId = strtoul(value, NULL, 16);
+    }
+    else if (strcasecmp(line, "X-Clip-Action") == 0)
+    {
+        info.clipAction = strcasecmp(value, "play") == 0 ? CLIP_PLAY : (strcasecmp(value, "store") == 0 ? CLIP_STORE : CLIP_NONE);
+    }
+}
+
+/**
+ * @brief Sends the request line and headers of an upload.
+ *
+ * @param contentLength Body size, or -1 for a chunked body.
+ */
+static bool Server_SendRequestHeaders(Transport &transport, int contentLength)
+{
+    char headers[512];
+    size_t len = snprintf(headers, sizeof(headers),
+                          "POST " SERVER_PATH " HTTP/1.1\r\n"
+                          "Host: %s:%u\r\n"
+                          "Content-Type: audio/wav\r\n",
+                          serverHost, serverPort);
+    len += Server_FormatTurnHeaders(headers + len, sizeof(headers) - len);
+    if (contentLength < 0)
+    {
+        snprintf(headers + len, sizeof(headers) - len, "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n");
+    }
+    else
+    {
+        snprintf(headers + len, sizeof(headers) - len, "Content-Length: %d\r\nConnection: close\r\n\r\n", contentLength);
+    }
+    if (!Server_WriteString(transport, headers))
+    {
+        return false;
+    }
+    Trace_Mark(TRACE_FIRST_BYTE_SENT, contentLength);
+    bodyBytesSent = 0;
+    return true;
+}
+
+/**
+ * @brief Waits for the response and parses the HTTP status line and headers.
+ *
+ * @param info Receives the status (0 on timeout or malformed response), the Content-Length
+ *             (-1 if missing) and the X-Audio-Codec (PCM if missing).
+ */
+static void Server_ReadResponseHeaders(Transport &transport, ResponseInfo &info)
+{
+    char line[128];
+    int httpResponseCode = 0;
+    info.status = 0;
+    info.contentLength = -1;
+    info.codec = CODEC_PCM;
+    info.clipId = 0;
+    info.clipAction = CLIP_NONE;
+
+    if (!Server_ReadLine(transport, line, sizeof(line), SERVER_TIMEOUT))
+    {
+        LOGE("Error on HTTP request: read Timeout");
+        return;
+    }
+    if (strncmp(line, "HTTP/", 5) == 0 && strchr(line, ' '))
+    {
+        httpResponseCode = atoi(strchr(line, ' ') + 1); // "HTTP/1.1 200 OK"
+    }
+    Trace_Mark(TRACE_FIRST_RESPONSE_BYTE, httpResponseCode);
+    while (Server_ReadLine(transport, line, sizeof(line), SERVER_TIMEOUT))
+    {
+        if (line[0] == '\0')
+        {
+            info.status = httpResponseCode; // end of headers
+            return;
+        }
+        Server_ParseHeaderLine(line, info);
+    }
+    LOGE("Error on HTTP request: incomplete headers");
+}
+
+/**
+ * @brief Streams the response audio from the server into the playback engine.
+ *
+ * This function forwards the body to the response decoder (Response.h) in small blocks.
+ * Playback starts as soon as the prebuffer watermark is reached, while the rest of the
+ * response is still being received.
+ *
+ * @param transport The connection holding the response body.
+ * @param info Response headers: the body size in bytes (-1 to read until the connection
+ *             closes), its codec and the clip action.
+ * @param speaker The audio output to stream to.
+ * @param stats Receives the response size and timing.
+ */
+void Server_ReceiveAudio(Transport &transport, const ResponseInfo &info, AudioOutput &speaker, TurnStats &stats)
+{
+    ResponseStream stream;
+    // Turn scratch memory, released by Arena_Reset() at the end of the turn
+    uint8_t *buffer = (uint8_t *)Arena_Alloc(RESPONSE_READ_LEN);
+    if (!buffer || !Response_Begin(stream, info))
+    {
+        return;
+    }
+    uint32_t remaining = info.contentLength >= 0 ? info.contentLength : UINT32_MAX;
+    while (remaining > 0)
+    {
+        int bytesRead = transport.Read(buffer, remaining < RESPONSE_READ_LEN ? remaining : RESPONSE_READ_LEN, SERVER_TIMEOUT);
+        if (bytesRead <= 0)
+        {
+            break; // closed or timed out
+        }
+        remaining -= bytesRead;
+        if (!Response_Write(stream, buffer, bytesRead, speaker, stats))
+        {
+            break; // unsupported format or playback stopped
+        }
+    }
+    Response_End(stream, speaker, stats);
+}
+
+/**
+ * @brief Opens a streaming upload to the server.
+ *
+ * This function connects to the server and sends the headers of a POST request whose body
+ * uses HTTP chunked transfer encoding, followed by a streaming WAV header chunk, since the
+ * recording length is unknown at this point.
+ *
+ * @param transport The connection used for the whole upload and response.
+ * @return true if the connection is open and the header was sent.
+ */
+bool Server_StreamBegin(Transport &transport)
+{
+    if (!transport.Connect(serverHost, serverPort))
+    {
+        LOGE("Can not connect to server %s:%u", serverHost, serverPort);
+        return false;
+    }
+    if (!Server_SendRequestHeaders(transport, -1))
+    {
+        return false;
+    }
+
+    uint8_t wavHeader[WAV_HEADER_SIZE];
+    Buffer_WriteStreamingWavHeader(wavHeader);
+    LOGL("Streaming audio to server");
+    return Server_StreamWrite(transport, wavHeader, sizeof(wavHeader));
+}
+
+/**
+ * @brief Sends a block of audio as one HTTP chunk.
+ *
+ * @param transport The connection opened by `Server_StreamBegin`.
+ * @param data Pointer to the audio data.
+ * @param len Length of the audio data in bytes.
+ * @return true if the whole chunk was written to the socket.
+ */
+bool Server_StreamWrite(Transport &transport, const uint8_t *data, size_t len)
+{
+    if (len == 0)
+    {
+        return true; // a zero-size chunk would terminate the body
+    }
+    char chunkHeader[12];
+    snprintf(chunkHeader, sizeof(chunkHeader), "%X\r\n", (unsigned int)len);
+    if (!Server_WriteString(transport, chunkHeader) ||
+        transport.Write(data, len) != len ||
+        !Server_WriteString(transport, "\r\n"))
+    {
+        LOGL("Streaming upload interrupted");
+        return false;
+    }
+    bodyBytesSent += len;
+    return true;
+}
+
+/**
+ * @brief Terminates the chunked request body.
+ *
+ * @param transport The connection opened by `Server_StreamBegin`.
+ * @return true if the last chunk was written to the socket.
+ */
+bool Server_StreamEnd(Transport &transport)
+{
+    if (!Server_WriteString(transport, "0\r\n\r\n"))
+    {
+        return false;
+    }
+    Trace_Mark(TRACE_LAST_BYTE_SENT, bodyBytesSent);
+    return true;
+}
+
+/**
+ * @brief Waits for the server response of a streaming upload and receives the response audio.
+ *
+ * This function parses the HTTP status line and headers, then streams the body to the
+ * playback engine.
+ *
+ * @param transport The connection opened by `Server_StreamBegin`.
+ * @param speaker The audio output to stream to.
+ * @param stats Receives the HTTP status and response timing.
+ */
+void Server_StreamReceive(Transport &transport, AudioOutput &speaker, TurnStats &stats)
+{
+    ResponseInfo info;
+    Server_ReadResponseHeaders(transport, info);
+    stats.httpStatus = info.status;
+    Heap_Record();
+
+    if (stats.httpStatus != 200)
+    {
+        LOGE("Error on HTTP request: status %d", stats.httpStatus);
+    }
+    else if (info.clipAction == CLIP_PLAY)
+    {
+        ClipCache_Play(info.clipId, speaker, stats);
+    }
+    else
+    {
+        // Without a Content-Length the body ends when the server closes the connection
+        Server_ReceiveAudio(transport, info, speaker, stats);
+    }
+}
+
+/**
+ * @brief Ends an upload: receives the response audio if the whole body was sent, then closes the connection.
+ */
+static void Server_FinishUpload(Transport &transport, bool sent, AudioOutput &speaker, TurnStats &stats)
+{
+    stats.lastByteSentTime = Hal_Millis();
+    if (sent)
+    {
+        Trace_Mark(TRACE_LAST_BYTE_SENT, bodyBytesSent);
+    }
+
+    //handle the response
+    if (sent)
+    {
+        Server_StreamReceive(transport, speaker, stats);
+    }
+    else
+    {
+        LOGE("Error on HTTP request: connection lost");
+    }
+    transport.Stop();
+}
+
+/**
+ * @brief Uploads recorded audio to the server and receives the response audio.
+ *
+ * This function sends a POST request to the server with the audio file located at the
+ * provided file path, then streams the response audio to the playback engine. The function
+ * logs the size of the uploaded file and the received response.
+ *
+ * @param transport The connection to the server.
+ * @param storage The storage holding the recording.
+ * @param filePath The path to the audio file to be uploaded.
+ * @param speaker The audio output to stream to.
+ * @param stats Receives the HTTP status and response timing.
+ */
+void Server_UploadFile(Transport &transport, Storage &storage, const char *filePath, AudioOutput &speaker, TurnStats &stats)
+{
+    //open audio file to read
+    StorageFile *file = storage.Open(filePath, false);
+    if (!file)
+    {
+        return;
+    }
+    size_t fileSize = file->Size();
+
+    //send file to PC
+    LOGL("Sending audio to server. File size: %u", (unsigned)fileSize);
+    bool sent = transport.Connect(serverHost, serverPort) && Server_SendRequestHeaders(transport, fileSize);
+    uint8_t buffer[512];
+    size_t len;
+    while (sent && (len = file->Read(buffer, sizeof(buffer))) > 0)
+    {
+        sent = transport.Write(buffer, len) == len;
+        bodyBytesSent += len;
+    }
+    file->Close();
+    FREE(file);
+    Heap_Record();
+    Server_FinishUpload(transport, sent, speaker, stats);
+}
+
+/**
+ * @brief Uploads a recording of the recording log (RecordLog.h) and receives the response audio.
+ *
+ * The body is written straight from the memory-mapped partition, without a copy through RAM.
+ *
+ * @param transport The connection to the server.
+ * @param recording The closed record, in place in flash.
+ * @param speaker The audio output to stream to.
+ * @param stats Receives the HTTP status and response timing.
+ */
+void Server_UploadRecording(Transport &transport, const RecordView &recording, AudioOutput &speaker, TurnStats &stats)
+{
+    LOGL("Sending audio to server. Record size: %u", (unsigned)recording.size);
+    bool sent = transport.Connect(serverHost, serverPort) && Server_SendRequestHeaders(transport, recording.size);
+    for (size_t i = 0; sent && i < 2; i++)
+    {
+        sent = transport.Write(recording.parts[i], recording.lengths[i]) == recording.lengths[i];
+        bodyBytesSent += recording.lengths[i];
+    }
+    Server_FinishUpload(transport, sent, speaker, stats);
+}
@@ -0,0 +1,446 @@
+#include <Session.h>
+#include <App.h>
+#include <Config.h>
+#include <AudioFormat.h>
+#include <Response.h>
+#include <ClipCache.h>
+#include <Trace.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FRAME_HEADER_SIZE 4
+
+static Transport *transport = NULL;
+static const char *sessionHost = "";
+static uint16_t sessionPort = 0;
+static bool connected = false;
+static unsigned long lastReceiveTime = 0;  // Any frame received
+static unsigned long pingTime = 0;         // PING waiting for its PONG, 0 if none
+static unsigned long retryTime = 0;        // Next connection attempt while idle
+static SessionStats sessionStats;
+
+// Incoming frame, filled incrementally so a read never waits for the rest of a frame
+static uint8_t rxHeader[FRAME_HEADER_SIZE];
+static size_t rxHeaderFill = 0;
+static uint8_t rxPayload[SESSION_MAX_FRAME + 1]; // +1 for the terminator of control payloads
+static size_t rxPayloadFill = 0;
+static uint8_t txFrame[FRAME_HEADER_SIZE + SESSION_MAX_FRAME];
+
+// Current turn
+static AudioOutput *turnSpeaker = NULL;
+static TurnStats *turnStats = NULL;
+static ResponseStream response;
+static bool responseStarted = false;
+static bool responseDone = false;
+static uint32_t bytesSent = 0;
+
+/**
+ * @brief Closes the connection, the next Session_Poll() or turn reconnects.
+ */
+static void Session_Drop(const char *reason)
+{
+    if (connected)
+    {
+        LOGW("Session dropped: %s", reason);
+        sessionStats.drops++;
+    }
+    transport->Stop();
+    connected = false;
+    pingTime = 0;
+    rxHeaderFill = 0;
+    rxPayloadFill = 0;
+    retryTime = Hal_Millis() + SESSION_RETRY_MS;
+}
+
+/**
+ * @brief Sends one frame, header and payload in a single write.
+ *
+ * @return false if the connection was lost, it is dropped.
+ */
+static bool Session_SendFrame(SESSION_FRAME type, const uint8_t *payload, size_t len)
+{
+    if (!connected)
+    {
+        return false;
+    }
+    txFrame[0] = type;
+    txFrame[1] = 0;
+    txFrame[2] = len & 0xFF;
+    txFrame[3] = (len >> 8) & 0xFF;
+    if (len > 0)
+    {
+        memcpy(txFrame + FRAME_HEADER_SIZE, payload, len);
+    }
+    if (transport->Write(txFrame, FRAME_HEADER_SIZE + len) != FRAME_HEADER_SIZE + len)
+    {
+        Session_Drop("write failed");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Connects to the server and announces the largest frame the device accepts.
+ */
+static bool Session_Connect()
+{
+    if (!transport->Connect(sessionHost, sessionPort))
+    {
+        retryTime = Hal_Millis() + SESSION_RETRY_MS;
+        return false;
+    }
+    connected = true;
+    lastReceiveTime = Hal_Millis();
+    char hello[32];
+    int len = snprintf(hello, sizeof(hello), "X-Max-Frame: %u\r\n", (unsigned)SESSION_MAX_FRAME);
+    if (!Session_SendFrame(FRAME_HELLO, (const uint8_t *)hello, len))
+    {
+        return false;
+    }
+    sessionStats.connects++;
+    LOGL("Session open to %s:%u", sessionHost, sessionPort);
+    return true;
+}
+
+/**
+ * @brief Starts the response decoder from the RESPONSE_BEGIN headers.
+ */
+static void Session_BeginResponse(char *headers)
+{
+    ResponseInfo info = {0, -1, CODEC_PCM, 0, CLIP_NONE};
+    for (char *line = strtok(headers, "\r\n"); line; line = strtok(NULL, "\r\n"))
+    {
+        Server_ParseHeaderLine(line, info);
+    }
+    turnStats->httpStatus = info.status;
+    Trace_Mark(TRACE_FIRST_RESPONSE_BYTE, info.status);
+    if (info.status != 200)
+    {
+        LOGE("Error on session turn: status %d", info.status);
+        return;
+    }
+    if (info.clipAction == CLIP_PLAY)
+    {
+        ClipCache_Play(info.clipId, *turnSpeaker, *turnStats); // no AUDIO_DOWN follows
+        return;
+    }
+    responseStarted = Response_Begin(response, info);
+}
+
+/**
+ * @brief Handles one complete incoming frame.
+ */
+static void Session_Dispatch(uint8_t type, uint8_t *payload, size_t len)
+{
+    lastReceiveTime = Hal_Millis();
+    pingTime = 0; // any frame proves the connection is alive
+    bool inTurn = turnStats != NULL && !responseDone;
+    switch (type)
+    {
+    case FRAME_PING:
+        Session_SendFrame(FRAME_PONG, NULL, 0);
+        break;
+    case FRAME_RESPONSE_BEGIN:
+        if (inTurn)
+        {
+            payload[len] = '\0';
+            Session_BeginResponse((char *)payload);
+        }
+        break;
+    case FRAME_AUDIO_DOWN:
+        if (inTurn && responseStarted)
+        {
+            Response_Write(response, payload, len, *turnSpeaker, *turnStats);
+        }
+        break;
+    case FRAME_RESPONSE_END:
+        if (inTurn)
+        {
+            if (responseStarted)
+            {
+                Response_End(response, *turnSpeaker, *turnStats);
+            }
+            responseDone = true;
+        }
+        break;
+    default:
+        break; // HELLO, PONG, and frames of an abandoned turn
+    }
+}
+
+/**
+ * @brief Reads and dispatches incoming frames.
+ *
+ * @param timeoutMs Time to wait for the first byte, later bytes are only taken if available.
+ */
+static void Session_Pump(uint32_t timeoutMs)
+{
+    while (connected)
+    {
+        int n;
+        if (rxHeaderFill < FRAME_HEADER_SIZE)
+        {
+            n = transport->Read(rxHeader + rxHeaderFill, FRAME_HEADER_SIZE - rxHeaderFill, timeoutMs);
+            if (n > 0)
+            {
+                rxHeaderFill += n;
+            }
+        }
+        else
+        {
+            size_t len = rxHeader[2] | (rxHeader[3] << 8);
+            if (len > SESSION_MAX_FRAME)
+            {
+                Session_Drop("oversized frame");
+                return;
+            }
+            n = len > rxPayloadFill ? transport->Read(rxPayload + rxPayloadFill, len - rxPayloadFill, timeoutMs) : 0;
+            if (n > 0)
+            {
+                rxPayloadFill += n;
+            }
+            if (rxPayloadFill == len)
+            {
+                rxHeaderFill = 0;
+                rxPayloadFill = 0;
+                Session_Dispatch(rxHeader[0], rxPayload, len);
+                n = 1; // look for the next frame
+            }
+        }
+        if (n < 0)
+        {
+            Session_Drop("closed by server");
+            return;
+        }
+        if (n == 0)
+        {
+            return;
+        }
+        timeoutMs = 0;
+    }
+}
+
+/**
+ * @brief Sets the session server, the connection is opened by the first Session_Poll().
+ *
+ * @param sessionTransport The connection kept open across turns.
+ * @param host Server IP address or host name, must outlive the session module.
+ * @param port Server session port.
+ */
+void Session_Init(Transport &sessionTransport, const char *host, uint16_t port)
+{
+    transport = &sessionTransport;
+    sessionHost = host;
+    sessionPort = port;
+}
+
+/**
+ * @brief Keeps the session alive between turns, call it from the idle loop.
+ *
+ * Connects (at most every SESSION_RETRY_MS while the network link is up), drains incoming
+ * frames and sends a PING after SESSION_HEARTBEAT_MS without traffic. A PING without PONG
+ * drops the connection.
+ */
+void Session_Poll()
+{
+    unsigned long now = Hal_Millis();
+    if (!transport->LinkUp())
+    {
+        if (connected)
+        {
+            Session_Drop("network down"); // reconnect as soon as the link is back
+            retryTime = now;
+        }
+        return;
+    }
+    if (!connected)
+    {
+        if ((long)(now - retryTime) >= 0)
+        {
+            Session_Connect();
+        }
+        return;
+    }
+    Session_Pump(0);
+    if (!connected)
+    {
+        return;
+    }
+    if (pingTime != 0)
+    {
+        if (now - pingTime > SESSION_HEARTBEAT_TIMEOUT)
+        {
+            sessionStats.missedHeartbeats++;
+            Session_Drop("heartbeat timeout");
+        }
+    }
+    else if (now - lastReceiveTime > SESSION_HEARTBEAT_MS)
+    {
+        pingTime = now;
+        Session_SendFrame(FRAME_PING, NULL, 0);
+    }
+}
+
+/**
+ * @brief Sends TURN_BEGIN, connecting first if the session is closed.
+ */
+static bool Session_BeginTurn(AudioOutput &speaker, TurnStats &stats)
+{
+    turnSpeaker = &speaker;
+    turnStats = &stats;
+    responseStarted = false;
+    responseDone = false;
+    bytesSent = 0;
+    if (!connected)
+    {
+        sessionStats.coldTurns++;
+        if (!Session_Connect())
+        {
+            LOGE("Can not connect to session %s:%u", sessionHost, sessionPort);
+            return false;
+        }
+    }
+    char headers[320];
+    size_t len = Server_FormatTurnHeaders(headers, sizeof(headers));
+    return Session_SendFrame(FRAME_TURN_BEGIN, (const uint8_t *)headers, len);
+}
+
+/**
+ * @brief Starts a turn: sends TURN_BEGIN and the streaming WAV header.
+ *
+ * @param speaker The audio output the response is streamed to.
+ * @param stats Receives the status and response timing.
+ * @return false if the server cannot be reached, the turn is abandoned.
+ */
+bool Session_TurnBegin(AudioOutput &speaker, TurnStats &stats)
+{
+    uint8_t wavHeader[WAV_HEADER_SIZE];
+    Buffer_WriteStreamingWavHeader(wavHeader);
+    if (!Session_BeginTurn(speaker, stats) || !Session_SendFrame(FRAME_AUDIO_UP, wavHeader, sizeof(wavHeader)))
+    {
+        return false;
+    }
+    Trace_Mark(TRACE_FIRST_BYTE_SENT, -1);
+    LOGL("Streaming audio to session");
+    return true;
+}
+
+/**
+ * @brief Sends audio in AUDIO_UP frames, then handles the frames received meanwhile.
+ *
+ * @return false if the connection was lost.
+ */
+bool Session_SendAudio(const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = len < SESSION_MAX_FRAME ? len : SESSION_MAX_FRAME;
+        if (!Session_SendFrame(FRAME_AUDIO_UP, data, n))
+        {
+            LOGL("Session upload interrupted");
+            return false;
+        }
+        bytesSent += n;
+        data += n;
+        len -= n;
+    }
+    Session_Pump(0);
+    return connected;
+}
+
+/**
+ * @brief Ends the upload of the turn.
+ *
+ * @return false if the connection was lost.
+ */
+bool Session_TurnEnd()
+{
+    if (!Session_SendFrame(FRAME_TURN_END, NULL, 0))
+    {
+        return false;
+    }
+    Trace_Mark(TRACE_LAST_BYTE_SENT, bytesSent);
+    return true;
+}
+
+/**
+ * @brief Abandons the turn: the server drops what was uploaded and sends no response.
+ */
+void Session_TurnCancel()
+{
+    Session_SendFrame(FRAME_TURN_CANCEL, NULL, 0);
+    responseDone = true;
+    turnSpeaker = NULL;
+    turnStats = NULL;
+}
+
+/**
+ * @brief Receives the response of the turn and streams it to the speaker.
+ *
+ * Returns on RESPONSE_END, after SERVER_TIMEOUT without a frame, or when the connection is lost.
+ *
+ * @param stats Receives the rest of the response statistics: the turn's own, or the copy the turn
+ *              worker answers from (TurnQueue.h) when the turn was streamed by the voice task.
+ */
+void Session_Receive(TurnStats &stats)
+{
+    turnStats = &stats;
+    lastReceiveTime = Hal_Millis();
+    while (connected && !responseDone)
+    {
+        Session_Pump(100);
+        if (Hal_Millis() - lastReceiveTime > SERVER_TIMEOUT)
+        {
+            LOGE("Error on session turn: read Timeout");
+            Session_Drop("response timeout");
+        }
+    }
+    if (responseStarted && !responseDone)
+    {
+        Response_End(response, *turnSpeaker, *turnStats); // play what was received
+    }
+    Heap_Record();
+    turnSpeaker = NULL;
+    turnStats = NULL;
+}
+
+/**
+ * @brief Runs a turn from a recording of the recording log (RecordLog.h) and receives the response.
+ *
+ * The record is sent in AUDIO_UP frames straight from the memory-mapped partition, its WAV
+ * header included.
+ *
+ * @param recording The closed record, in place in flash.
+ * @param speaker The audio output to stream to.
+ * @param stats Receives the status and response timing.
+ */
+void Session_UploadRecording(const RecordView &recording, AudioOutput &speaker, TurnStats &stats)
+{
+    LOGL("Sending audio to session. Record size: %u", (unsigned)recording.size);
+    bool sent = Session_BeginTurn(speaker, stats);
+    if (sent)
+    {
+        Trace_Mark(TRACE_FIRST_BYTE_SENT, recording.size);
+    }
+    for (size_t i = 0; sent && i < 2; i++)
+    {
+        sent = Session_SendAudio(recording.parts[i], recording.lengths[i]);
+    }
+    sent = sent && Session_TurnEnd();
+    stats.lastByteSentTime = Hal_Millis();
+    if (sent)
+    {
+        Session_Receive(stats);
+    }
+    else
+    {
+        LOGE("Error on session turn: connection lost");
+        turnSpeaker = NULL;
+        turnStats = NULL;
+    }
+}
+
+const SessionStats &Session_GetStats()
+{
+    return sessionStats;
+}
@@ -0,0 +1,300 @@
+#include <Synth.h>
+#include <string.h>
+#include <math.h>
+
+#define SYNTH_COEFF_SHIFT 14
+#define SYNTH_AMP_MAX 64
+#define SYNTH_SLEW 24                // Amplitude change per frame, onsets and releases take ~15 ms
+#define SYNTH_BURST_MS 12            // Release burst of a stop
+#define SYNTH_ASPIRATION_MS 45       // Aspiration after the burst of an aspirated stop
+#define SYNTH_DEFAULT_PITCH 120.0f
+#define SYNTH_INPUT_SHIFT 9          // Source (Q15 x amplitude) to resonator input, peaks at -7 dBFS (program synth)
+
+enum SYNTH_KIND
+{
+    SYNTH_PAUSE,
+    SYNTH_SONORANT,                  // Voice through the cascade: vowels, nasals, approximants
+    SYNTH_FRICATIVE,                 // Frication, voiced if `voice` is set
+    SYNTH_ASPIRATE,                  // Noise through the cascade
+    SYNTH_STOP,                      // Closure (voice bar if `voice` is set), then burst
+    SYNTH_STOP_ASPIRATED             // Closure, burst, aspiration
+};
+
+struct SynthPhoneme
+{
+    char symbol;
+    uint8_t kind;                    // SYNTH_KIND
+    uint16_t formants[3];            // Targets (Hz), the locus of a stop
+    uint8_t voice;                   // Voicing amplitude, 0-64
+    uint8_t noise;                   // Frication or aspiration amplitude, 0-64
+    uint16_t noiseFreq;              // Centre of the frication (Hz)
+};
+
+// Symbols of Source/PC/phonemes.py (Vietnamese, Northern accent), male voice targets
+static const SynthPhoneme phonemes[] = {
+    {'_', SYNTH_PAUSE, {500, 1500, 2500}, 0, 0, 0},
+    {'a', SYNTH_SONORANT, {750, 1250, 2600}, 64, 0, 0},
+    {'E', SYNTH_SONORANT, {580, 1800, 2550}, 60, 0, 0},    // open e
+    {'e', SYNTH_SONORANT, {420, 2050, 2650}, 58, 0, 0},
+    {'i', SYNTH_SONORANT, {290, 2250, 3000}, 54, 0, 0},
+    {'O', SYNTH_SONORANT, {580, 900, 2500}, 62, 0, 0},     // open o
+    {'o', SYNTH_SONORANT, {430, 820, 2450}, 60, 0, 0},
+    {'u', SYNTH_SONORANT, {320, 760, 2300}, 56, 0, 0},
+    {'U', SYNTH_SONORANT, {330, 1400, 2400}, 56, 0, 0},    // unrounded u
+    {'7', SYNTH_SONORANT, {490, 1350, 2500}, 60, 0, 0},    // mid central
+    {'@', SYNTH_SONORANT, {520, 1450, 2500}, 56, 0, 0},    // second half of a diphthong
+    {'m', SYNTH_SONORANT, {280, 1000, 2300}, 36, 0, 0},
+    {'n', SYNTH_SONORANT, {280, 1600, 2600}, 36, 0, 0},
+    {'N', SYNTH_SONORANT, {280, 2000, 2600}, 36, 0, 0},    // velar nasal
+    {'J', SYNTH_SONORANT, {280, 2200, 2900}, 36, 0, 0},    // palatal nasal
+    {'l', SYNTH_SONORANT, {360, 1300, 2800}, 48, 0, 0},
+    {'w', SYNTH_SONORANT, {300, 650, 2300}, 44, 0, 0},
+    {'j', SYNTH_SONORANT, {270, 2300, 3000}, 44, 0, 0},
+    {'v', SYNTH_FRICATIVE, {300, 1100, 2300}, 36, 16, 6000},
+    {'z', SYNTH_FRICATIVE, {300, 1700, 2600}, 36, 24, 4800},
+    {'G', SYNTH_FRICATIVE, {320, 1600, 2400}, 40, 14, 1800}, // voiced velar fricative
+    {'f', SYNTH_FRICATIVE, {400, 1100, 2300}, 0, 24, 6500},
+    {'s', SYNTH_FRICATIVE, {400, 1700, 2600}, 0, 40, 5000},
+    {'x', SYNTH_FRICATIVE, {400, 1600, 2400}, 0, 30, 1900},  // velar fricative
+    {'h', SYNTH_ASPIRATE, {550, 1500, 2500}, 0, 30, 0},
+    {'p', SYNTH_STOP, {400, 900, 2200}, 0, 28, 1200},
+    {'b', SYNTH_STOP, {400, 900, 2200}, 20, 20, 1200},
+    {'t', SYNTH_STOP, {400, 1700, 2600}, 0, 32, 4000},
+    {'T', SYNTH_STOP_ASPIRATED, {400, 1700, 2600}, 0, 32, 4000},
+    {'d', SYNTH_STOP, {400, 1700, 2600}, 20, 24, 4000},
+    {'k', SYNTH_STOP, {400, 1900, 2500}, 0, 30, 2000},
+    {'c', SYNTH_STOP, {350, 2100, 2800}, 0, 34, 3200},    // palatal stop
+};
+
+static const float cascadeBandwidths[3] = {80.0f, 100.0f, 150.0f};
+
+static const SynthPhoneme *Synth_Find(char symbol)
+{
+    for (const SynthPhoneme &phoneme : phonemes)
+    {
+        if (phoneme.symbol == symbol)
+        {
+            return &phoneme;
+        }
+    }
+    return &phonemes[0]; // unknown symbols are pauses, so newer servers can add some
+}
+
+/**
+ * @brief Sets a two-pole resonator, with unity gain at DC (cascade) or at its peak (frication).
+ */
+static void Synth_SetResonator(SynthResonator &resonator, float freq, float bandwidth, float sampleRate, bool peakGain)
+{
+    const float pi = 3.14159265f;
+    float radius = expf(-pi * bandwidth / sampleRate);
+    float theta = 2.0f * pi * freq / sampleRate;
+    float b = 2.0f * radius * cosf(theta);
+    float c = -radius * radius;
+    float a = peakGain ? (1.0f - radius) * sqrtf(1.0f - 2.0f * radius * cosf(2.0f * theta) + radius * radius) : 1.0f - b - c;
+    resonator.a = (int32_t)lrintf(a * (1 << SYNTH_COEFF_SHIFT));
+    resonator.b = (int32_t)lrintf(b * (1 << SYNTH_COEFF_SHIFT));
+    resonator.c = (int32_t)lrintf(c * (1 << SYNTH_COEFF_SHIFT));
+}
+
+static inline int32_t Synth_Resonate(SynthResonator &resonator, int32_t x)
+{
+    int64_t sum = (int64_t)resonator.a * x + (int64_t)resonator.b * resonator.y1 + (int64_t)resonator.c * resonator.y2;
+    int32_t y = (int32_t)(sum >> SYNTH_COEFF_SHIFT);
+    resonator.y2 = resonator.y1;
+    resonator.y1 = y;
+    return y;
+}
+
+static int32_t Synth_Slew(int32_t current, int32_t target, int32_t step)
+{
+    if (target > current)
+    {
+        return target - current > step ? current + step : target;
+    }
+    return current - target > step ? current - step : target;
+}
+
+/**
+ * @brief Starts the response: resets the voice, rendered at `sampleRate` (rate of the WAV header).
+ */
+void Synth_Begin(SynthState &state, uint32_t sampleRate)
+{
+    memset(&state, 0, sizeof(state));
+    state.sampleRate = sampleRate;
+    state.frameSamples = sampleRate * SYNTH_FRAME_MS / 1000;
+    state.frameSamples = state.frameSamples > 0 ? state.frameSamples : 1;
+    state.phoneme = &phonemes[0];
+    state.pitchEnd = SYNTH_DEFAULT_PITCH;
+    for (int k = 0; k < 3; k++)
+    {
+        state.formants[k] = phonemes[0].formants[k];
+    }
+    state.noise = 0x2545F491;
+    float fourth = 3500.0f < 0.45f * sampleRate ? 3500.0f : 0.45f * sampleRate;
+    Synth_SetResonator(state.cascade[3], fourth, 250.0f, (float)sampleRate, false);
+}
+
+/**
+ * @brief Starts rendering the unit in `pending`.
+ */
+static void Synth_StartUnit(SynthState &state)
+{
+    state.phoneme = Synth_Find((char)state.pending[0]);
+    state.unitSamples = (uint32_t)state.pending[1] * SYNTH_UNIT_MS * state.sampleRate / 1000;
+    state.unitPos = 0;
+    state.frameLeft = 0;
+    float start = state.pending[2] ? state.pending[2] * (float)SYNTH_PITCH_STEP : state.pitchEnd;
+    state.pitchStart = start;
+    state.pitchEnd = state.pending[3] ? state.pending[3] * (float)SYNTH_PITCH_STEP : start;
+    memcpy(state.from, state.formants, sizeof(state.from));
+    state.units++;
+}
+
+/**
+ * @brief Takes response bytes until a unit is complete, to be rendered by Synth_Render().
+ *
+ * @return Bytes used: nothing while a unit is being rendered.
+ */
+size_t Synth_Feed(SynthState &state, const uint8_t *data, size_t len)
+{
+    size_t used = 0;
+    while (used < len && state.unitPos >= state.unitSamples)
+    {
+        state.pending[state.pendingFill++] = data[used++];
+        if (state.pendingFill == SYNTH_UNIT_SIZE)
+        {
+            state.pendingFill = 0;
+            Synth_StartUnit(state); // a unit of 0 ms is skipped by the loop
+        }
+    }
+    return used;
+}
+
+/**
+ * @brief Moves the formants, amplitudes and pitch to their values at the current position of the unit.
+ */
+static void Synth_UpdateFrame(SynthState &state)
+{
+    const SynthPhoneme &phoneme = *state.phoneme;
+    float rate = (float)state.sampleRate;
+    uint32_t transition = SYNTH_TRANSITION_MS * state.sampleRate / 1000;
+    transition = transition < state.unitSamples / 2 ? transition : state.unitSamples / 2;
+    float glide = transition > 0 && state.unitPos < transition ? (float)state.unitPos / transition : 1.0f;
+    if (phoneme.kind != SYNTH_PAUSE)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            state.formants[k] = state.from[k] + (phoneme.formants[k] - state.from[k]) * glide;
+        }
+    }
+
+    int32_t voice = phoneme.voice, frication = 0, aspiration = 0, fricationSlew = SYNTH_SLEW;
+    if (phoneme.kind == SYNTH_FRICATIVE)
+    {
+        frication = phoneme.noise;
+    }
+    else if (phoneme.kind == SYNTH_ASPIRATE)
+    {
+        aspiration = phoneme.noise;
+    }
+    else if (phoneme.kind == SYNTH_STOP || phoneme.kind == SYNTH_STOP_ASPIRATED)
+    {
+        // Closure, then the release in the last part of the unit (at most half of it)
+        uint32_t burst = SYNTH_BURST_MS * state.sampleRate / 1000;
+        uint32_t aspirated = phoneme.kind == SYNTH_STOP_ASPIRATED ? SYNTH_ASPIRATION_MS * state.sampleRate / 1000 : 0;
+        uint32_t release = burst + aspirated < state.unitSamples / 2 ? burst + aspirated : state.unitSamples / 2;
+        uint32_t position = state.unitPos + release - state.unitSamples; // wraps during the closure
+        if (state.unitPos + release >= state.unitSamples)
+        {
+            voice = 0;
+            if (position < burst * release / (burst + aspirated))
+            {
+                frication = phoneme.noise;
+                fricationSlew = SYNTH_AMP_MAX; // a burst has no onset
+            }
+            else
+            {
+                aspiration = phoneme.noise;
+            }
+        }
+    }
+    state.voiceAmp = Synth_Slew(state.voiceAmp, voice, SYNTH_SLEW);
+    state.fricationAmp = Synth_Slew(state.fricationAmp, frication, fricationSlew);
+    state.aspirationAmp = Synth_Slew(state.aspirationAmp, aspiration, SYNTH_SLEW);
+
+    float progress = state.unitSamples > 0 ? (float)state.unitPos / state.unitSamples : 0.0f;
+    float pitch = state.pitchStart + (state.pitchEnd - state.pitchStart) * progress;
+    state.phaseStep = (uint32_t)(pitch * 4294967296.0f / rate);
+
+    for (int k = 0; k < 3; k++)
+    {
+        float freq = state.formants[k] < 0.45f * rate ? state.formants[k] : 0.45f * rate;
+        Synth_SetResonator(state.cascade[k], freq, cascadeBandwidths[k], rate, false);
+    }
+    if (phoneme.noiseFreq > 0)
+    {
+        float freq = phoneme.noiseFreq < 0.45f * rate ? phoneme.noiseFreq : 0.45f * rate;
+        Synth_SetResonator(state.frication, freq, freq / 4.0f + 200.0f, rate, true);
+    }
+}
+
+/**
+ * @brief Renders samples with the parameters of the current frame.
+ */
+static void Synth_Generate(SynthState &state, int16_t *dst, size_t samples)
+{
+    int32_t voice = state.voiceAmp;
+    int32_t frication = state.fricationAmp;
+    int32_t aspiration = state.aspirationAmp;
+    for (size_t i = 0; i < samples; i++)
+    {
+        // Glottal flow derivative over the open half of the cycle: 2t - 3t^2, t in Q15
+        state.phase += state.phaseStep;
+        uint32_t cycle = state.phase >> 17;
+        int32_t excitation = 0;
+        if (cycle < 16384)
+        {
+            int32_t t = (int32_t)cycle << 1;
+            excitation = 2 * t - 3 * ((t * t) >> 15);
+        }
+        state.noise ^= state.noise << 13;
+        state.noise ^= state.noise >> 17;
+        state.noise ^= state.noise << 5;
+        int32_t noise = (int16_t)(state.noise >> 16);
+
+        int32_t x = (excitation * voice + noise * aspiration) >> SYNTH_INPUT_SHIFT;
+        for (int k = 0; k < 4; k++)
+        {
+            x = Synth_Resonate(state.cascade[k], x);
+        }
+        x += Synth_Resonate(state.frication, (noise * frication) >> SYNTH_INPUT_SHIFT);
+        dst[i] = (int16_t)(x > 32767 ? 32767 : (x < -32768 ? -32768 : x));
+    }
+}
+
+/**
+ * @brief Renders the current unit.
+ *
+ * @param dst Receives up to `samples` 16-bit samples.
+ * @return Samples written, 0 once the unit is done (feed the next one).
+ */
+size_t Synth_Render(SynthState &state, int16_t *dst, size_t samples)
+{
+    size_t done = 0;
+    while (done < samples && state.unitPos < state.unitSamples)
+    {
+        if (state.frameLeft == 0)
+        {
+            Synth_UpdateFrame(state);
+            state.frameLeft = state.frameSamples;
+        }
+        size_t n = samples - done;
+        n = n < state.frameLeft ? n : state.frameLeft;
+        n = n < state.unitSamples - state.unitPos ? n : state.unitSamples - state.unitPos;
+        Synth_Generate(state, dst + done, n);
+        done += n;
+        state.frameLeft -= n;
+        state.unitPos += n;
+    }
+    return done;
+}
@@ -0,0 +1,146 @@
+#include <Trace.h>
+#include <Hal.h>
+#include <Log.h>
+#include <string.h>
+#include <atomic>
+
+static_assert((TRACE_CAPACITY & (TRACE_CAPACITY - 1)) == 0, "TRACE_CAPACITY must be a power of two");
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord is exported as is");
+
+static TraceRecord traceRing[TRACE_CAPACITY];
+static std::atomic<uint32_t> traceHead(0);   // Records written since boot
+static uint16_t traceTurn = 0;
+static std::atomic<uint16_t> responseTurn(0); // Turn of the response events, 0: the current turn
+
+#if TRACE_ENABLE
+/**
+ * @brief Starts a new turn and records its button press.
+ *
+ * @param source What started the turn: 0 the record button, 1 the wake word (Kws.h).
+ * @return The id of the new turn, stored in every record until the next call.
+ */
+uint16_t Trace_BeginTurn(int32_t source)
+{
+    traceTurn++;
+    Trace_Mark(TRACE_BUTTON_PRESS, source);
+    return traceTurn;
+}
+
+/**
+ * @brief Sets the turn the response events belong to, while the next turn is already recording
+ *        (turn queue, TurnQueue.h).
+ *
+ * @param turn The turn being answered, 0 to go back to the current turn.
+ */
+void Trace_SetResponseTurn(uint16_t turn)
+{
+    responseTurn = turn;
+}
+
+/**
+ * @brief Records an event of the current turn, or of the turn set by Trace_SetResponseTurn()
+ *        for the events after the recording.
+ *
+ * Only takes a timestamp and a slot of the ring, so it can be called on the hot path and from
+ * any task. The oldest record is overwritten once the ring is full.
+ *
+ * @param event The event to record.
+ * @param value Event argument, see TRACE_EVENT.
+ */
+void Trace_Mark(TRACE_EVENT event, int32_t value)
+{
+    uint32_t slot = traceHead.fetch_add(1, std::memory_order_relaxed) & (TRACE_CAPACITY - 1);
+    TraceRecord &record = traceRing[slot];
+    record.timeUs = Hal_Micros();
+    uint16_t answering = responseTurn.load(std::memory_order_relaxed);
+    record.turn = event > TRACE_RECORD_END && answering ? answering : traceTurn;
+    record.event = (uint8_t)event;
+    record.reserved = 0;
+    record.value = value;
+}
+#endif
+
+/**
+ * @brief Logs the records of one turn as TRACE lines, for Source/PC/trace_report.py (in order with
+ *        the other log lines, see Log.h).
+ *
+ * @param turn The turn returned by Trace_BeginTurn().
+ */
+void Trace_Dump(uint16_t turn)
+{
+    uint32_t head = traceHead.load(std::memory_order_relaxed);
+    uint32_t count = head < TRACE_CAPACITY ? head : TRACE_CAPACITY;
+    for (uint32_t i = head - count; i != head; i++)
+    {
+        const TraceRecord &record = traceRing[i & (TRACE_CAPACITY - 1)];
+        if (record.turn == turn)
+        {
+            LOGL("TRACE %u %s %llu %ld", (unsigned)record.turn, Trace_ToString((TRACE_EVENT)record.event),
+                 (unsigned long long)record.timeUs, (long)record.value);
+        }
+    }
+}
+
+/**
+ * @brief Copies the ring, oldest record first, into a binary blob.
+ *
+ * @param buffer Destination of the blob.
+ * @param size Size of the destination, the newest records that fit are exported.
+ * @return Size of the blob, 0 if the buffer cannot hold the header.
+ */
+size_t Trace_Export(uint8_t *buffer, size_t size)
+{
+    if (size < sizeof(TraceBlobHeader))
+    {
+        return 0;
+    }
+    uint32_t head = traceHead.load(std::memory_order_relaxed);
+    uint32_t count = head < TRACE_CAPACITY ? head : TRACE_CAPACITY;
+    uint32_t fit = (size - sizeof(TraceBlobHeader)) / sizeof(TraceRecord);
+    if (count > fit)
+    {
+        count = fit;
+    }
+    TraceBlobHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), count, head - count};
+    memcpy(buffer, &header, sizeof(header));
+    uint8_t *out = buffer + sizeof(header);
+    for (uint32_t i = head - count; i != head; i++)
+    {
+        memcpy(out, &traceRing[i & (TRACE_CAPACITY - 1)], sizeof(TraceRecord));
+        out += sizeof(TraceRecord);
+    }
+    return out - buffer;
+}
+
+/**
+ * @brief Converts a trace event to the name used in dumps and reports.
+ */
+const char *Trace_ToString(TRACE_EVENT event)
+{
+    switch (event)
+    {
+    case TRACE_BUTTON_PRESS:
+        return "button_press";
+    case TRACE_FIRST_BLOCK:
+        return "first_block";
+    case TRACE_RECORD_END:
+        return "record_end";
+    case TRACE_FIRST_BYTE_SENT:
+        return "first_byte_sent";
+    case TRACE_LAST_BYTE_SENT:
+        return "last_byte_sent";
+    case TRACE_FIRST_RESPONSE_BYTE:
+        return "first_response_byte";
+    case TRACE_LAST_RESPONSE_BYTE:
+        return "last_response_byte";
+    case TRACE_PLAYBACK_START:
+        return "playback_start";
+    case TRACE_PLAYBACK_END:
+        return "playback_end";
+    case TRACE_BARGE_IN:
+        return "barge_in";
+    case TRACE_EVENT_COUNT:
+        break;
+    }
+    return "";
+}
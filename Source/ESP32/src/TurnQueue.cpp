@@ -0,0 +1,224 @@
+#include <TurnQueue.h>
+#include <App.h>
+#include <atomic>
+
+enum TURN_SLOT
+{
+    TURN_SLOT_FREE,             // Owned by the voice task
+    TURN_SLOT_QUEUED,           // Waiting for the worker
+    TURN_SLOT_ACTIVE            // Owned by the worker
+};
+
+static TurnJob jobs[TURN_QUEUE_DEPTH];
+static std::atomic<uint8_t> slots[TURN_QUEUE_DEPTH];
+static TurnHandler handler = NULL;
+static void (*listener)(const TurnJob &job) = NULL;
+static HalEvent workEvent = NULL;   // Job submitted -> worker
+static HalEvent doneEvent = NULL;   // Job done -> TurnQueue_Stall, TurnQueue_WaitIdle
+static uint32_t submitCount = 0;
+static TurnQueueStats stats;
+
+/**
+ * @brief Next job to answer: the highest priority, then the oldest.
+ *
+ * @return Its slot, -1 if none is queued.
+ */
+static int TurnQueue_Next()
+{
+    int next = -1;
+    for (int i = 0; i < TURN_QUEUE_DEPTH; i++)
+    {
+        if (slots[i] != TURN_SLOT_QUEUED)
+        {
+            continue;
+        }
+        if (next < 0 || jobs[i].priority > jobs[next].priority ||
+            (jobs[i].priority == jobs[next].priority && (int32_t)(jobs[i].number - jobs[next].number) < 0))
+        {
+            next = i;
+        }
+    }
+    return next;
+}
+
+/**
+ * @brief Turn worker: answers the queued jobs one at a time.
+ */
+static void Task_Turns(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        int slot = TurnQueue_Next();
+        if (slot < 0)
+        {
+            Hal_WaitEvent(workEvent, VOICE_IDLE_WAKE_MS);
+            continue;
+        }
+        slots[slot] = TURN_SLOT_ACTIVE;
+        TurnJob &job = jobs[slot];
+        job.startTime = Hal_Millis();
+        uint32_t waited = (uint32_t)(job.startTime - job.queuedTime);
+        stats.maxWaitMs = waited > stats.maxWaitMs ? waited : stats.maxWaitMs;
+        handler(job);
+        if (listener)
+        {
+            listener(job);
+        }
+        stats.completed++;
+        slots[slot] = TURN_SLOT_FREE;
+        Hal_SignalEvent(doneEvent);
+    }
+}
+
+/**
+ * @brief Starts the turn worker.
+ *
+ * @param turnHandler Answers a job: uploads the recording and plays the response.
+ * @return false if the task could not be started, the turns are then answered by the voice task.
+ */
+bool TurnQueue_Init(TurnHandler turnHandler)
+{
+    for (int i = 0; i < TURN_QUEUE_DEPTH; i++)
+    {
+        slots[i] = TURN_SLOT_FREE;
+    }
+    handler = turnHandler;
+    workEvent = Hal_CreateEvent();
+    doneEvent = Hal_CreateEvent();
+    if (!Hal_StartTask(Task_Turns, "Task_Turns", TURN_WORKER_STACK, NULL, TURN_WORKER_PRIORITY, TURN_WORKER_CORE))
+    {
+        handler = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Sets a function called by the worker after every job (native benchmark report).
+ */
+void TurnQueue_SetListener(void (*jobListener)(const TurnJob &job))
+{
+    listener = jobListener;
+}
+
+bool TurnQueue_Active()
+{
+    return handler != NULL;
+}
+
+/**
+ * @brief Queues a closed recording for the worker. Called by the voice task.
+ *
+ * @param recording The record in the recording log, retained until the job is done.
+ * @param turnStats The recording part of the turn statistics.
+ * @param id Trace turn of the recording.
+ * @param priority Higher is answered first, equal priorities in submission order.
+ * @return false if no slot is free.
+ */
+bool TurnQueue_Submit(const RecordView &recording, const TurnStats &turnStats, uint16_t id, uint8_t priority)
+{
+    int slot = -1;
+    for (int i = 0; i < TURN_QUEUE_DEPTH && slot < 0; i++)
+    {
+        slot = slots[i] == TURN_SLOT_FREE ? i : -1;
+    }
+    if (slot < 0)
+    {
+        return false;
+    }
+    TurnJob &job = jobs[slot];
+    job.id = id;
+    job.priority = priority;
+    job.number = ++submitCount;
+    job.recording = recording;
+    job.stats = turnStats;
+    job.queuedTime = Hal_Millis();
+    job.startTime = 0;
+    slots[slot] = TURN_SLOT_QUEUED; // publishes the job
+    Hal_SignalEvent(workEvent);
+
+    stats.submitted++;
+    uint32_t depth = TurnQueue_Pending();
+    stats.maxDepth = depth > stats.maxDepth ? depth : stats.maxDepth;
+    LOGL("Turn queue: turn %u queued, %u in flight", (unsigned)id, (unsigned)depth);
+    return true;
+}
+
+/**
+ * @brief true if no slot is free for the next recording.
+ */
+bool TurnQueue_Full()
+{
+    return TurnQueue_Pending() == TURN_QUEUE_DEPTH;
+}
+
+/**
+ * @brief Jobs queued or being answered.
+ */
+uint32_t TurnQueue_Pending()
+{
+    uint32_t pending = 0;
+    for (int i = 0; i < TURN_QUEUE_DEPTH; i++)
+    {
+        pending += slots[i] != TURN_SLOT_FREE;
+    }
+    return pending;
+}
+
+/**
+ * @brief Recording of the oldest job not done yet, for RecordLog_Retain(). Called by the voice task.
+ *
+ * @return NULL if no job with a recording is queued or being answered.
+ */
+const RecordView *TurnQueue_Oldest()
+{
+    int oldest = -1;
+    for (int i = 0; i < TURN_QUEUE_DEPTH; i++)
+    {
+        if (slots[i] != TURN_SLOT_FREE && jobs[i].recording.size > 0 && (oldest < 0 || (int32_t)(jobs[i].number - jobs[oldest].number) < 0))
+        {
+            oldest = i;
+        }
+    }
+    return oldest < 0 ? NULL : &jobs[oldest].recording;
+}
+
+/**
+ * @brief Sleeps while the voice task has to wait for a slot or for log space (backpressure).
+ *
+ * @param busy Checked after every job done, the wait ends when it returns false.
+ */
+void TurnQueue_Stall(bool (*busy)())
+{
+    unsigned long start = Hal_Millis();
+    stats.stalls++;
+    while (busy())
+    {
+        Hal_WaitEvent(doneEvent, VOICE_IDLE_WAKE_MS);
+    }
+    stats.stallMs += (uint32_t)(Hal_Millis() - start);
+}
+
+/**
+ * @brief Waits until every job is answered.
+ */
+void TurnQueue_WaitIdle()
+{
+    while (TurnQueue_Pending() > 0)
+    {
+        Hal_WaitEvent(doneEvent, 100);
+    }
+}
+
+const TurnQueueStats &TurnQueue_GetStats()
+{
+    return stats;
+}
+
+void TurnQueue_Logging()
+{
+    LOGL("Turn queue: %u submitted, %u answered, max depth %u, longest wait %u ms, %u stalls (%u ms)",
+         (unsigned)stats.submitted, (unsigned)stats.completed, (unsigned)stats.maxDepth,
+         (unsigned)stats.maxWaitMs, (unsigned)stats.stalls, (unsigned)stats.stallMs);
+}
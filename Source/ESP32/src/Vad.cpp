@@ -0,0 +1,188 @@
+#include <Vad.h>
+#include <string.h>
+
+/**
+ * @brief Returns the default VAD settings for a sample rate.
+ */
+VadConfig Vad_DefaultConfig(uint32_t sampleRate)
+{
+    VadConfig config;
+    config.sampleRate = sampleRate;
+    config.frameMs = VAD_FRAME_MS;
+    config.hangoverMs = VAD_HANGOVER_MS;
+    config.endSilenceMs = VAD_END_SILENCE_MS;
+    config.prerollMs = VAD_PREROLL_MS;
+    return config;
+}
+
+/**
+ * @brief Resets the detector for a new utterance.
+ *
+ * @param state The detector state.
+ * @param config Frame length, hangover, end silence and preroll settings.
+ */
+void Vad_Init(VadState &state, const VadConfig &config)
+{
+    memset(&state, 0, sizeof(state));
+    state.config = config;
+    state.frameSamples = config.sampleRate * config.frameMs / 1000;
+    state.hangoverFrames = config.hangoverMs / config.frameMs;
+    state.endSilenceFrames = config.endSilenceMs / config.frameMs;
+    state.prerollSamples = config.sampleRate * config.prerollMs / 1000;
+}
+
+/**
+ * @brief Starts a new utterance, keeping the noise floor learned so far.
+ *
+ * Lets a detector that ran over the audio before the turn (while listening for the wake word)
+ * judge speech that starts right away, without seeding the noise floor on it.
+ */
+void Vad_Restart(VadState &state)
+{
+    state.hangover = 0;
+    state.speechRun = 0;
+    state.silenceRun = 0;
+    state.started = false;
+    state.ended = false;
+    state.speechFrames = 0;
+    state.silenceFrames = 0;
+}
+
+/**
+ * @brief Classifies the completed frame and updates the noise floor.
+ *
+ * @return true if the frame is speech.
+ */
+static bool Vad_ClassifyFrame(VadState &state)
+{
+    uint32_t energy = (uint32_t)(state.frameEnergy / state.frameSamples);
+    uint32_t crossings = state.frameCrossings * 10 / state.config.frameMs; // per 10ms
+    state.framesSeen++;
+
+    if (state.framesSeen <= VAD_CALIBRATION_FRAMES)
+    {
+        // Seed the noise floor with the quietest of the first frames
+        if (state.framesSeen == 1 || energy < state.noiseFloor)
+        {
+            state.noiseFloor = energy;
+        }
+        return false;
+    }
+
+    uint32_t threshold = state.noiseFloor * VAD_ENERGY_RATIO;
+    if (threshold < VAD_MIN_ENERGY)
+    {
+        threshold = VAD_MIN_ENERGY;
+    }
+    bool speech = energy > threshold || (energy > threshold / 2 && crossings > VAD_ZCR_HIGH);
+    if (!speech)
+    {
+        // Follow the noise: fast when it drops, slow when it rises
+        if (energy < state.noiseFloor)
+        {
+            state.noiseFloor -= (state.noiseFloor - energy) >> 2;
+        }
+        else
+        {
+            state.noiseFloor += (energy - state.noiseFloor) >> 4;
+        }
+    }
+    return speech;
+}
+
+/**
+ * @brief Runs the detector over a block of samples.
+ *
+ * @param state The detector state.
+ * @param samples Signed 16-bit samples.
+ * @param count Number of samples in the block.
+ * @param result Range of the block to keep and whether the utterance ended.
+ */
+void Vad_Process(VadState &state, const int16_t *samples, size_t count, VadResult &result)
+{
+    result.keepStart = state.started ? 0 : count;
+    result.keepEnd = count;
+    result.ended = false;
+    result.carryOver = 0;
+    if (state.ended)
+    {
+        result.keepStart = result.keepEnd = 0;
+        result.ended = true;
+        return;
+    }
+
+    // Sample indexes relative to this block, negative when they lie in a previous block
+    int64_t frameStart = -(int64_t)state.frameCount;
+    int64_t lastActiveEnd = state.started ? 0 : -1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t x = samples[i] - state.dcOffset;
+        bool positive = x >= 0;
+        if (positive != state.lastPositive)
+        {
+            state.frameCrossings++;
+            state.lastPositive = positive;
+        }
+        state.frameSum += samples[i];
+        state.frameEnergy += (int64_t)x * x;
+        if (++state.frameCount < state.frameSamples)
+        {
+            continue;
+        }
+
+        // Frame complete
+        bool speech = Vad_ClassifyFrame(state);
+        if (speech)
+        {
+            state.hangover = state.hangoverFrames;
+            state.speechRun++;
+        }
+        else
+        {
+            state.speechRun = 0;
+        }
+        bool active = speech || state.hangover > 0;
+        if (!speech && state.hangover > 0)
+        {
+            state.hangover--;
+        }
+        if (active)
+        {
+            state.speechFrames++;
+            state.silenceRun = 0;
+            lastActiveEnd = i + 1;
+        }
+        else
+        {
+            state.silenceRun++;
+            state.silenceFrames++;
+        }
+
+        if (!state.started && state.speechRun >= VAD_START_FRAMES)
+        {
+            state.started = true;
+            int64_t start = frameStart - (int64_t)(VAD_START_FRAMES - 1) * state.frameSamples - state.prerollSamples;
+            result.keepStart = start > 0 ? (size_t)start : 0;
+            result.carryOver = start < 0 ? (size_t)-start : 0;
+        }
+        else if (state.started && state.silenceRun >= state.endSilenceFrames)
+        {
+            state.ended = true;
+            result.ended = true;
+            // Drop the trailing silence that is still in this block
+            result.keepEnd = lastActiveEnd > (int64_t)result.keepStart ? (size_t)lastActiveEnd : result.keepStart;
+        }
+
+        state.dcOffset = (int32_t)(state.frameSum / (int64_t)state.frameSamples);
+        state.frameSum = 0;
+        state.frameEnergy = 0;
+        state.frameCrossings = 0;
+        state.frameCount = 0;
+        frameStart = i + 1;
+        if (state.ended)
+        {
+            return;
+        }
+    }
+}
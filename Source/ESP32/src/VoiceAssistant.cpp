@@ -0,0 +1,831 @@
+#include <VoiceAssistant.h>
+#include <App.h>
+#include <Config.h>
+#include <AudioFormat.h>
+#include <Codec.h>
+#include <SampleKernels.h>
+#include <Vad.h>
+#include <Trace.h>
+#include <Capture.h>
+#include <Arena.h>
+#include <Session.h>
+#include <ClipCache.h>
+#include <Kws.h>
+#include <BargeIn.h>
+#include <RecordLog.h>
+#include <TurnQueue.h>
+#include <Metrics.h>
+#include <string.h>
+#include <inttypes.h>
+
+static Hal hal;
+#if KWS_ENABLE
+static KwsModel kwsModel;
+static KwsState kwsState;
+static bool kwsReady = false;                // Templates are enrolled, turns also start on the wake word
+static uint8_t *preroll[KWS_PREROLL_BLOCKS]; // Last blocks heard while listening, oldest first, already scaled
+static size_t prerollCount = 0;
+static size_t prerollNext = 0;               // Next preroll block fed to the recording
+static size_t prerollSkip = 0;               // Bytes of the first preroll block heard before the turn (the wake word)
+#endif
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+static bool recordLog = false; // Recordings go to the recording log partition instead of RECORD_FILE_NAME
+#endif
+#if TURN_QUEUE_ENABLE
+static bool turnQueue = false; // Recordings are answered by the turn worker (TurnQueue.h)
+#endif
+#if BARGE_IN_ENABLE
+static BARGE_IN_REASON bargeIn = BARGE_IN_NONE; // The previous response was interrupted, the capture is queuing this turn
+#endif
+
+/**
+ * @brief Waits for the end of the playback and records its statistics.
+ */
+static void VoiceAssistant_EndPlayback(TurnStats &stats)
+{
+    hal.speaker->WaitDone();
+    stats.playbackEndTime = Hal_Millis();
+    stats.playback = hal.speaker->GetStats();
+    Trace_Mark(TRACE_PLAYBACK_END, stats.playback.underruns);
+    Metrics_RecordTurn(stats);
+    LOGL("Playback: %u samples, %u underruns, first audio after %u ms, max buffer fill %u bytes",
+         (unsigned)stats.playback.samplesPlayed, (unsigned)stats.playback.underruns,
+         (unsigned)stats.playback.bufferedTime, (unsigned)stats.playback.maxFill);
+}
+
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+/**
+ * @brief Waits up to BOOT_LINK_WAIT_MS for the network link before an upload: a command recorded
+ *        while WiFi is still associating (at boot, Boot.h) or reconnecting is sent once the link is up.
+ */
+static void VoiceAssistant_WaitForLink()
+{
+    if (hal.transport->LinkUp())
+    {
+        return;
+    }
+    unsigned long start = Hal_Millis();
+    LOGL("Network link down: waiting up to %u ms before the upload", (unsigned)BOOT_LINK_WAIT_MS);
+    while (!hal.transport->LinkUp() && Hal_Millis() - start < BOOT_LINK_WAIT_MS)
+    {
+        Hal_DelayMs(BOOT_LINK_POLL_MS);
+    }
+    if (hal.transport->LinkUp())
+    {
+        LOGL("Network link up after %lu ms", Hal_Millis() - start);
+    }
+    else
+    {
+        LOGW("Network link still down after %lu ms", Hal_Millis() - start);
+    }
+}
+#endif
+
+#if TURN_QUEUE_ENABLE
+/**
+ * @brief Answers a queued turn in the turn worker: uploads the recording from the log (or receives
+ *        the response of a turn streamed while recorded) and plays the response, while the voice
+ *        task may already record the next turn.
+ */
+static void VoiceAssistant_Answer(TurnJob &job)
+{
+    TurnStats &stats = job.stats;
+    Trace_SetResponseTurn(job.id);
+    LOGL("Turn %u: answering after %lu ms in the queue", (unsigned)job.id, job.startTime - job.queuedTime);
+    if (job.recording.size == 0)
+    {
+#if SERVER_SESSION
+        Session_Receive(stats);
+#elif STREAM_UPLOAD
+        Server_StreamReceive(*hal.transport, *hal.speaker, stats);
+        hal.transport->Stop();
+#endif
+    }
+    else
+    {
+        VoiceAssistant_WaitForLink();
+#if SERVER_SESSION
+        Session_UploadRecording(job.recording, *hal.speaker, stats);
+#else
+        Server_UploadRecording(*hal.transport, job.recording, *hal.speaker, stats);
+#endif
+    }
+    unsigned long endTime = Hal_Millis();
+    LOGL("Response time: %lu", endTime - job.startTime);
+    LOGL("Button release to response: %lu ms", endTime - stats.releaseTime);
+    VoiceAssistant_EndPlayback(stats);
+    Trace_SetResponseTurn(0);
+    ClipCache_Logging();
+    TurnQueue_Logging();
+    Arena_Reset();
+#if TRACE_DUMP
+    Trace_Dump(job.id);
+#endif
+}
+
+/**
+ * @brief Keeps the records of the jobs in flight, true while the next recording has no job slot, or
+ *        little log space and a job that will free some.
+ */
+static bool VoiceAssistant_QueueBusy()
+{
+    RecordLog_Retain(TurnQueue_Oldest());
+    return TurnQueue_Full() || (TurnQueue_Pending() > 0 && RecordLog_Available() < TURN_QUEUE_MIN_SPACE);
+}
+
+/**
+ * @brief Waits until a job slot and TURN_QUEUE_MIN_SPACE of recording log are free (backpressure).
+ *        With no job in flight the whole log is free and the recording is only limited by its size.
+ */
+static void VoiceAssistant_WaitForQueue()
+{
+    if (!VoiceAssistant_QueueBusy())
+    {
+        return;
+    }
+    LOGL("Turn queue: %u turns in flight, %u KB of recording log free: waiting for a response",
+         (unsigned)TurnQueue_Pending(), (unsigned)(RecordLog_Available() / 1024));
+    TurnQueue_Stall(VoiceAssistant_QueueBusy);
+}
+#endif
+
+/**
+ * @brief true while the voice task may use the server connection: with the turn queue the turn
+ *        worker owns it while a job is in flight.
+ */
+static bool VoiceAssistant_OwnsServer()
+{
+#if TURN_QUEUE_ENABLE
+    return !turnQueue || TurnQueue_Pending() == 0;
+#else
+    return true;
+#endif
+}
+
+/**
+ * @brief Sets the hardware the voice pipeline runs on.
+ *
+ * @param platform Microphone, storage, transport, controls and speaker implementations.
+ */
+void VoiceAssistant_Init(const Hal &platform)
+{
+    hal = platform;
+#if KWS_ENABLE
+    kwsReady = Kws_Load(kwsModel, *hal.storage, KWS_TEMPLATE_FILE);
+    if (kwsReady)
+    {
+        LOGL("KWS: %u templates, threshold %d: listening for the wake word", (unsigned)kwsModel.count, (int)kwsModel.threshold);
+    }
+    else
+    {
+        LOGL("KWS: no templates in %s, turns start with the record button", KWS_TEMPLATE_FILE);
+    }
+#endif
+#if BARGE_IN_ENABLE
+    BargeIn_Init(*hal.controls, *hal.speaker);
+#endif
+#if (RECORD_TO_FILE || TURN_QUEUE_ENABLE) && RECORD_LOG_ENABLE
+    recordLog = hal.recordFlash && RecordLog_Init(*hal.recordFlash);
+#endif
+#if TURN_QUEUE_ENABLE
+    turnQueue = recordLog && TurnQueue_Init(VoiceAssistant_Answer);
+#endif
+}
+
+#if RECORD_TO_FILE
+/**
+ * @brief Writes the WAV file header to a specified file.
+ *
+ * This function constructs a WAV file header based on the total audio length
+ * and writes it into the given file object.
+ *
+ * @param file The file object where the WAV header will be written.
+ * @param totalAudioLen Size of the data chunk in bytes: the encoded recording (UPLOAD_CODEC).
+ */
+static void File_WriteWavHeader(StorageFile *file, uint32_t totalAudioLen)
+{
+    uint8_t wavHeader[WAV_HEADER_SIZE];
+
+    Buffer_WriteWavHeader(wavHeader, totalAudioLen);
+
+    file->Seek(0);
+    file->Write(wavHeader, sizeof(wavHeader));
+}
+#endif
+
+/**
+ * @brief Sends an encoded block to the server (SERVER_SESSION, STREAM_UPLOAD) or appends it to the
+ *        recording file or the recording log (also for a turn queued behind another one).
+ *
+ * @param streaming Cleared when the upload fails, later blocks are dropped.
+ * @param file The recording file, NULL when recording to the log or when it could not be created.
+ */
+static void Recording_Write(bool &streaming, StorageFile *file, const uint8_t *data, size_t len)
+{
+#if SERVER_SESSION
+    (void)file;
+    if (streaming) {
+        streaming = Session_SendAudio(data, len);
+    }
+#elif STREAM_UPLOAD
+    (void)file;
+    if (streaming) {
+        streaming = Server_StreamWrite(*hal.transport, data, len);
+    }
+#else
+    (void)streaming;
+    if (file) {
+        file->Write(data, len);
+    } else {
+        RecordLog_Write(data, len);
+    }
+#endif
+#if TURN_QUEUE_ENABLE && !RECORD_TO_FILE
+    if (!streaming) {
+        RecordLog_Write(data, len); // fails without an open record: a streamed turn whose upload broke
+    }
+#endif
+}
+
+#if KWS_ENABLE
+/**
+ * @brief Waits for the wake word or the record button with the capture running.
+ *
+ * Every block heard is scaled, run through the keyword spotter and kept in the preroll, so the
+ * turn starts with the audio captured just before it instead of a microphone warm-up.
+ *
+ * @param vad Follows the noise floor while listening, NULL without VAD.
+ * @return true if woken by the wake word, false by the button.
+ */
+static bool VoiceAssistant_Listen(VadState *vad)
+{
+    Kws_Init(kwsState, kwsModel);
+    prerollCount = prerollNext = prerollSkip = 0;
+    Capture_Start(CaptureFormat::Bytes(SHORT_RECORD_TIME));
+    LOGL("Ready to record: Listening for the wake word or the button");
+    App_SetState(IDLE);
+    while (!hal.controls->ButtonPressed())
+    {
+#if SERVER_SESSION
+        if (VoiceAssistant_OwnsServer())
+        {
+            Session_Poll();
+        }
+#endif
+        uint8_t *block;
+        size_t len;
+        if (!Capture_Pop(block, len, 100))
+        {
+            continue;
+        }
+        Kernel_DacScale<3>(block, block, len);
+        if (prerollCount == KWS_PREROLL_BLOCKS)
+        {
+            Capture_Release(preroll[0]);
+            memmove(preroll, preroll + 1, (KWS_PREROLL_BLOCKS - 1) * sizeof(preroll[0]));
+            prerollCount--;
+        }
+        preroll[prerollCount++] = block;
+
+        const int16_t *samples = (const int16_t *)block;
+        size_t count = len / 2;
+        if (vad)
+        {
+            VadResult ignored;
+            Vad_Process(*vad, samples, count, ignored);
+            Vad_Restart(*vad);
+        }
+        uint64_t blockStart = kwsState.stats.samples;
+        KwsDetection detection;
+        if (Kws_Process(kwsState, samples, count, detection))
+        {
+            // The turn starts right after the wake word: drop what was heard before it
+            uint64_t keywordEnd = (uint64_t)detection.timeMs * I2S_SAMPLE_RATE / 1000;
+            for (size_t i = 0; i + 1 < prerollCount; i++)
+            {
+                Capture_Release(preroll[i]);
+            }
+            preroll[0] = block;
+            prerollCount = 1;
+            prerollSkip = keywordEnd > blockStart ? (size_t)(keywordEnd - blockStart) * 2 : 0;
+            LOGL("Wake word detected: template %u, score %d, %u ms of audio after the keyword",
+                 (unsigned)detection.index, (int)detection.score,
+                 (unsigned)((blockStart + count - keywordEnd) * 1000 / I2S_SAMPLE_RATE));
+            Kws_Logging(kwsState);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Releases the preroll blocks the recording did not use.
+ */
+static void VoiceAssistant_DropPreroll()
+{
+    for (size_t i = prerollNext; i < prerollCount; i++)
+    {
+        Capture_Release(preroll[i]);
+    }
+    prerollCount = prerollNext = 0;
+}
+#endif
+
+/**
+ * @brief Waits for the start of a turn, the capture is running when it returns.
+ *
+ * @param vad Follows the noise floor while listening, NULL without VAD.
+ * @return true if the turn was started by the wake word (hands-free), false by the record button.
+ */
+static bool VoiceAssistant_WaitForStart(VadState *vad)
+{
+#if KWS_ENABLE
+    if (kwsReady)
+    {
+        return VoiceAssistant_Listen(vad);
+    }
+#endif
+    (void)vad;
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+    // Erase the recording log ahead of the next recording while nothing else uses the flash,
+    // a press waits for one sector erase at most (a queued response may be playing). Streaming
+    // builds only record to the log behind a turn in flight.
+    while (recordLog && (RECORD_TO_FILE || !VoiceAssistant_OwnsServer()) && !hal.controls->ButtonPressed() && !hal.speaker->Playing() && RecordLog_EraseAhead(FLASH_RECORD_SIZE))
+    {
+    }
+#endif
+    LOGL("Ready to record: Waiting for button press");
+    // Sleeps until the button interrupt, waking up periodically for the session
+    while (!hal.controls->WaitButton(true, VOICE_IDLE_WAKE_MS))
+    {
+        App_SetState(IDLE);
+#if SERVER_SESSION
+        if (VoiceAssistant_OwnsServer())
+        {
+            Session_Poll(); // connect and heartbeat while idle, so the turn starts on an open session
+        }
+#endif
+    }
+    // The capture task discards the microphone warm-up, then queues blocks
+    Capture_Start(CaptureFormat::Bytes(SHORT_RECORD_TIME));
+    return false;
+}
+
+/**
+ * @brief Microseconds from the last button edge to now: how long the voice task took to react.
+ */
+static uint32_t VoiceAssistant_ButtonLatency()
+{
+    return (uint32_t)(Hal_Micros() - hal.controls->ButtonEdgeTime());
+}
+
+/**
+ * @brief Logs the idle time of both cores since the previous call.
+ */
+static void VoiceAssistant_LogIdle(const char *phase)
+{
+    int core0 = Hal_CpuIdle(0);
+    int core1 = Hal_CpuIdle(1);
+    if (core0 >= 0 && core1 >= 0)
+    {
+        LOGL("CPU idle %s: core 0 %d.%d%%, core 1 %d.%d%%", phase, core0 / 10, core0 % 10, core1 / 10, core1 % 10);
+    }
+}
+
+/**
+ * @brief Next block of the recording: the preroll kept while listening, then the captured blocks.
+ *
+ * @param scaled Set for preroll blocks, which were already scaled while listening.
+ * @param skip Bytes at the start of the block heard before the turn.
+ */
+static bool Recording_Pop(uint8_t *&block, size_t &len, bool &scaled, size_t &skip)
+{
+#if KWS_ENABLE
+    if (prerollNext < prerollCount)
+    {
+        block = preroll[prerollNext];
+        len = I2S_READ_LEN;
+        scaled = true;
+        skip = prerollNext == 0 ? prerollSkip : 0;
+        if (++prerollNext == prerollCount)
+        {
+            prerollCount = prerollNext = 0;
+        }
+        return true;
+    }
+#endif
+    scaled = false;
+    skip = 0;
+    return Capture_Pop(block, len, 100);
+}
+
+/**
+ * @brief Runs one voice assistant turn: recording, upload, response and playback.
+ *
+ * Waits for the record button or the wake word (Kws.h), records until the button is released
+ * (or the end of the utterance with VAD_ENABLE; a hands-free turn only ends there), sends the
+ * audio to the server and plays the response. With BARGE_IN_ENABLE the microphone keeps running
+ * during the response: speech or the button interrupts it, and the next turn starts on the
+ * audio already captured instead of waiting (BargeIn.h). With the turn queue (TurnQueue.h) the
+ * turn ends with the recording: it is answered by the turn worker while the next one is recorded.
+ * The microphone is drained by the capture task (Capture.h), this task only processes the
+ * captured blocks.
+ *
+ * @param stats Receives the sizes and timestamps of the turn.
+ * @return true if a response was played (queued with the turn queue).
+ */
+bool VoiceAssistant_RunTurn(TurnStats &stats)
+{
+    memset(&stats, 0, sizeof(stats));
+#if TURN_QUEUE_ENABLE
+    if (turnQueue)
+    {
+        VoiceAssistant_WaitForQueue();
+    }
+#endif
+    App_SetState(RUNNING);
+#if BARGE_IN_ENABLE
+    bool bargedIn = bargeIn != BARGE_IN_NONE;
+#else
+    bool bargedIn = false;
+#endif
+    if (!bargedIn)
+    {
+        hal.microphone->Begin(); // after a barge-in it is still running, the capture is queuing
+    }
+    Heap_Record();
+    unsigned int flash_wr_size = 0;
+    unsigned long startTime = 0, endTime = 0;
+    CodecState codecState;
+    Codec_Reset(codecState, UPLOAD_CODEC);
+    unsigned int encoded_size = 0;
+    uint32_t encodeUs = 0; // Time spent in the encoder, the log-mel front end runs there
+    unsigned int progress = 0;
+    bool streaming = false;
+    bool live = false;     // Streamed while recorded, else recorded to the file or the log
+#if !RECORD_TO_FILE || TURN_QUEUE_ENABLE
+    bool uploaded = false;
+#endif
+    StorageFile *file = NULL;
+#if VAD_ENABLE
+    VadState vadState;
+    Vad_Init(vadState, Vad_DefaultConfig(I2S_SAMPLE_RATE));
+    uint8_t *previous = NULL; // Last block before the utterance, source of the VAD preroll
+    size_t previousCount = 0;
+    size_t previousSkip = 0;
+#endif
+#if RECORD_TO_FILE
+    if (!recordLog)
+    {
+        hal.storage->Remove(RECORD_FILE_NAME);
+        file = hal.storage->Open(RECORD_FILE_NAME, true);
+    }
+    if (file)
+    {
+        File_WriteWavHeader(file, 0); // placeholder, patched after recording
+    }
+#endif
+
+    // Wait for button press (or the wake word) to start recording
+    Hal_CpuIdle(0); // starts the idle measurement of the wait
+    Hal_CpuIdle(1);
+    bool handsFree;
+#if BARGE_IN_ENABLE
+    if (bargedIn)
+    {
+        // Speech over the response is a hands-free turn, a press is held like any other
+        LOGL("Barge-in (%s): recording the next turn", BargeIn_ToString(bargeIn));
+        handsFree = bargeIn == BARGE_IN_SPEECH;
+        bargeIn = BARGE_IN_NONE;
+    }
+    else
+#endif
+    {
+#if VAD_ENABLE
+        handsFree = VoiceAssistant_WaitForStart(&vadState);
+#else
+        handsFree = VoiceAssistant_WaitForStart(NULL);
+#endif
+    }
+    stats.pressLatencyUs = handsFree ? 0 : VoiceAssistant_ButtonLatency();
+    App_SetState(RUNNING);
+#if BARGE_IN_ENABLE
+    stats.pressTime = bargedIn ? BargeIn_GetStats().triggerTime : Hal_Millis();
+#else
+    stats.pressTime = Hal_Millis();
+#endif
+    uint16_t turn = Trace_BeginTurn(handsFree ? (bargedIn ? 2 : 1) : 0);
+    VoiceAssistant_LogIdle("while waiting");
+#if !RECORD_TO_FILE
+    live = VoiceAssistant_OwnsServer(); // else queued behind a turn in flight, recorded to the log
+#endif
+#if SERVER_SESSION
+    streaming = live && Session_TurnBegin(*hal.speaker, stats);
+#elif STREAM_UPLOAD
+    // Open the upload connection now so the first block can be sent as soon as it is captured
+    streaming = live && Server_StreamBegin(*hal.transport);
+#endif
+
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+    // Opened once the turn has started, the log is erased ahead while waiting
+    bool logging = recordLog && !live && RecordLog_Begin(); // the log writes its own placeholder header
+    uint32_t recordSpace = RecordLog_Available();
+#endif
+
+    LOGL("***Recording Start***");
+    hal.controls->SetLed(true); // Turn on LED to indicate recording
+    while (flash_wr_size < FLASH_RECORD_SIZE)
+    {
+        uint8_t *block;
+        size_t bytes_read;
+        bool scaled;
+        size_t skip;
+        if (!Recording_Pop(block, bytes_read, scaled, skip))
+        {
+            if (!handsFree && !hal.controls->ButtonPressed())
+            {
+                stats.releaseLatencyUs = VoiceAssistant_ButtonLatency();
+                break;
+            }
+            continue;
+        }
+        if (flash_wr_size == 0)
+        {
+            Trace_Mark(TRACE_FIRST_BLOCK, bytes_read);
+        }
+        if (!scaled)
+        {
+            Kernel_DacScale<3>(block, block, bytes_read);
+        }
+        bytes_read -= skip;
+        int16_t *samples = (int16_t *)(block + skip);
+        size_t sample_count = bytes_read / 2;
+#if VAD_ENABLE
+        // Keep only the part of the block that belongs to the utterance
+        VadResult vad;
+        Vad_Process(vadState, samples, sample_count, vad);
+        if (vad.carryOver > 0 && previous)
+        {
+            // The utterance started just before this block: send the preroll from the previous one
+            size_t carry = vad.carryOver < previousCount ? vad.carryOver : previousCount;
+            uint32_t encodeStart = (uint32_t)Hal_Micros();
+            size_t carry_len = Codec_Encode(codecState, previous, (int16_t *)(previous + previousSkip) + previousCount - carry, carry);
+            encodeUs += (uint32_t)Hal_Micros() - encodeStart;
+            encoded_size += carry_len;
+            Recording_Write(streaming, file, previous, carry_len);
+        }
+        samples += vad.keepStart;
+        sample_count = vad.keepEnd - vad.keepStart;
+#endif
+        // Compress in place before the block leaves the device
+        uint32_t encodeStart = (uint32_t)Hal_Micros();
+        size_t encoded_len = Codec_Encode(codecState, block, samples, sample_count);
+        encodeUs += (uint32_t)Hal_Micros() - encodeStart;
+        encoded_size += encoded_len;
+        Recording_Write(streaming, file, block, encoded_len);
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+        bool logFull = logging && encoded_size + 2 * I2S_READ_LEN > recordSpace; // room for a block and its VAD preroll
+#endif
+
+#if VAD_ENABLE
+        Capture_Release(previous);
+        previous = NULL;
+        if (!vadState.started)
+        {
+            // Still silence: keep the scaled samples for the preroll of the next block
+            previous = block;
+            previousCount = bytes_read / 2;
+            previousSkip = skip;
+            block = NULL;
+        }
+#endif
+        Capture_Release(block);
+
+        flash_wr_size += bytes_read;
+        if (flash_wr_size * 10 / FLASH_RECORD_SIZE != progress)
+        {
+            progress = flash_wr_size * 10 / FLASH_RECORD_SIZE;
+            LOGD("Sound recording %u%%", progress * 10);
+        }
+
+        // Stop recording if the button is released
+        if (!handsFree && !hal.controls->ButtonPressed())
+        {
+            stats.releaseLatencyUs = VoiceAssistant_ButtonLatency();
+            break;
+        }
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+        if (logFull)
+        {
+            LOGW("Recording log full");
+            break;
+        }
+#endif
+#if VAD_ENABLE
+        // Stop recording at the end of the utterance
+        if (vad.ended)
+        {
+            LOGL("End of utterance detected");
+            break;
+        }
+#endif
+    }
+    uint8_t tail[1];
+    size_t tail_len = Codec_Flush(codecState, tail); // an odd last sample of IMA-ADPCM
+    if (tail_len > 0)
+    {
+        encoded_size += tail_len;
+        Recording_Write(streaming, file, tail, tail_len);
+    }
+    Trace_Mark(TRACE_RECORD_END, flash_wr_size);
+    unsigned long releaseTime = Hal_Millis();
+    stats.releaseTime = releaseTime;
+    stats.recordedBytes = flash_wr_size;
+    stats.uploadedBytes = encoded_size;
+    bool empty = encoded_size == 0; // the VAD heard no speech: nothing to answer
+#if !RECORD_TO_FILE
+    // Terminate the upload right away, the capture task is stopped while the server works
+    startTime = Hal_Millis();
+#if SERVER_SESSION
+    uploaded = streaming && !empty && Session_TurnEnd();
+#else
+    uploaded = streaming && !empty && Server_StreamEnd(*hal.transport);
+#endif
+    stats.lastByteSentTime = Hal_Millis();
+#endif
+    Capture_Stop();
+#if VAD_ENABLE
+    Capture_Release(previous);
+#endif
+#if KWS_ENABLE
+    VoiceAssistant_DropPreroll();
+#endif
+    Arena_CheckBlocks(); // the capture is stopped and every block released
+
+    LOGL("***Recording Finished***");
+    LOGL("Recorded %u bytes, %u bytes encoded as %s in %u.%u ms", flash_wr_size, encoded_size, Codec_ToString(UPLOAD_CODEC),
+         (unsigned)(encodeUs / 1000), (unsigned)(encodeUs / 100 % 10));
+#if VAD_ENABLE
+    LOGL("VAD: %u speech frames, %u silence frames", (unsigned)vadState.speechFrames, (unsigned)vadState.silenceFrames);
+#endif
+    const CaptureStats &capture = Capture_GetStats();
+    LOGL("Capture: %u blocks, %u queue overruns, %u pool overruns, max queue depth %u",
+         (unsigned)capture.blocks, (unsigned)capture.queueOverruns, (unsigned)capture.poolOverruns, (unsigned)capture.maxQueueDepth);
+    Metrics_RecordCapture(capture);
+    hal.controls->SetLed(false); // Turn off LED to indicate end of recording
+
+    if (empty)
+    {
+        // Neither uploaded nor queued: the server would only answer an empty WAV
+#if SERVER_SESSION
+        if (streaming)
+        {
+            Session_TurnCancel();
+        }
+#elif STREAM_UPLOAD
+        hal.transport->Stop(); // the body is never terminated, the server drops the request
+#endif
+#if RECORD_TO_FILE || TURN_QUEUE_ENABLE
+        if (logging)
+        {
+            RecordLog_Abandon();
+        }
+#endif
+#if RECORD_TO_FILE
+        if (file)
+        {
+            file->Close();
+            FREE(file);
+            hal.storage->Remove(RECORD_FILE_NAME);
+        }
+#endif
+        hal.microphone->End();
+        LOGL("No speech recorded: turn not uploaded");
+        Metrics_Count(METRIC_TURNS_EMPTY);
+        VoiceAssistant_LogIdle("while recording");
+        Heap_Logging();
+        return false;
+    }
+
+#if TURN_QUEUE_ENABLE
+    if (turnQueue)
+    {
+        // The turn worker answers it, the next command can be recorded right away
+        hal.microphone->End();
+        RecordView recording = {}; // empty for a streamed turn, the worker only receives the response
+        bool queued = live ? uploaded : logging && RecordLog_End(encoded_size, recording);
+        if (logging)
+        {
+            RecordLog_Logging();
+        }
+        // A streamed turn goes first, its response is already on the way
+        uint8_t priority = live ? 0xFF : (TURN_QUEUE_BUTTON_FIRST && !handsFree ? 1 : 0);
+        queued = queued && TurnQueue_Submit(recording, stats, turn, priority);
+        if (!queued)
+        {
+            LOGW("Recording dropped");
+            Metrics_Count(METRIC_RECORDINGS_DROPPED);
+        }
+        VoiceAssistant_LogIdle("while recording");
+        Heap_Logging();
+        return queued;
+    }
+#endif
+
+#if BARGE_IN_ENABLE
+    // Keep listening while the response plays, the next turn may start over it
+    BargeIn_Start();
+    Capture_Monitor(BargeIn_Monitor, BARGE_IN_PREROLL_BLOCKS);
+#else
+    hal.microphone->End();
+#endif
+    Heap_Record();
+
+#if !RECORD_TO_FILE
+    // Wait for the response audio
+    if (uploaded) {
+        LOGL("Button release to last byte sent: %lu ms", stats.lastByteSentTime - releaseTime);
+#if SERVER_SESSION
+        Session_Receive(stats);
+#else
+        Server_StreamReceive(*hal.transport, *hal.speaker, stats);
+#endif
+    } else {
+        LOGE("Streaming upload failed, recording discarded");
+    }
+#if SERVER_SESSION
+    const SessionStats &session = Session_GetStats(); // the connection stays open for the next turn
+    LOGL("Session: %u connects, %u drops, %u missed heartbeats, %u cold turns",
+         (unsigned)session.connects, (unsigned)session.drops, (unsigned)session.missedHeartbeats, (unsigned)session.coldTurns);
+#else
+    hal.transport->Stop();
+#endif
+    endTime = Hal_Millis();
+#else
+    RecordView recording;
+    if (logging)
+    {
+        // Update WAV file size, then send the record straight from the mapped flash
+        logging = RecordLog_End(encoded_size, recording);
+        RecordLog_Logging();
+        startTime = Hal_Millis();
+        if (logging)
+        {
+            VoiceAssistant_WaitForLink();
+            Server_UploadRecording(*hal.transport, recording, *hal.speaker, stats);
+        }
+        endTime = Hal_Millis();
+    }
+    else if (!recordLog)
+    {
+        if (file)
+        {
+            // Update WAV file size
+            File_WriteWavHeader(file, encoded_size);
+            file->Close();
+            FREE(file);
+        }
+
+        // Send file to server
+        startTime = Hal_Millis();
+        VoiceAssistant_WaitForLink();
+        Server_UploadFile(*hal.transport, *hal.storage, RECORD_FILE_NAME, *hal.speaker, stats);
+        endTime = Hal_Millis();
+    }
+#endif
+
+    LOGL("Response time: %lu", endTime - startTime);
+    LOGL("Button release to response: %lu ms", endTime - releaseTime);
+    LOGL("Button reaction: press %u us, release %u us", (unsigned)stats.pressLatencyUs, (unsigned)stats.releaseLatencyUs);
+
+    // Play out what is still buffered before starting the next turn
+#if BARGE_IN_ENABLE
+    while (!BargeIn_Check() && hal.speaker->Playing())
+    {
+        Hal_WaitEvent(Capture_WakeEvent(), BARGE_IN_POLL_MS); // signaled by a barge-in
+    }
+    bargeIn = BargeIn_Stop();
+    stats.bargeIn = bargeIn;
+    if (bargeIn == BARGE_IN_NONE)
+    {
+        Capture_Stop();
+        hal.microphone->End();
+    }
+#endif
+    VoiceAssistant_EndPlayback(stats);
+#if BARGE_IN_ENABLE
+    const BargeInStats &barge = BargeIn_GetStats();
+    LOGL("Barge-in: %s, %u reads checked, %u rejected as echo, echo gain %u/256",
+         BargeIn_ToString(bargeIn), (unsigned)barge.frames, (unsigned)barge.echoFrames, (unsigned)barge.echoGain);
+#endif
+    ClipCache_Logging();
+    VoiceAssistant_LogIdle("during the turn");
+    Arena_Reset();
+    Heap_Logging();
+#if TRACE_DUMP
+    Trace_Dump(turn);
+#else
+    (void)turn;
+#endif
+    return stats.playback.samplesPlayed > 0;
+}
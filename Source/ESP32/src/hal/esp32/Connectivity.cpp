@@ -0,0 +1,292 @@
+#include <Connectivity.h>
+#include <App.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <freertos/event_groups.h>
+#include <string.h>
+
+#define EVENT_GOT_IP BIT0
+#define EVENT_DISCONNECTED BIT1
+
+#define CACHE_NAMESPACE "wifi"
+#define CACHE_KEY "cache"
+#define CACHE_VERSION 1
+
+/**
+ * @brief Last successful connection, persisted in NVS.
+ */
+struct LinkCache
+{
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+static const char *wifiSsid = "";
+static const char *wifiPassword = "";
+static EventGroupHandle_t events = NULL;
+static volatile LINK_STATE linkState = LINK_DOWN;
+static LinkCache cache;
+static bool cacheValid = false;
+static bool fastAttempt = false;        // The current attempt uses the cache
+static unsigned long attemptTime = 0;   // Start of the current attempt, or of the retry delay
+static unsigned long rssiTime = 0;
+static ConnectivityStats stats;
+
+/**
+ * @brief WiFi event handler, runs in the event task: only wakes the connectivity task.
+ */
+static void Connectivity_OnEvent(arduino_event_id_t event, arduino_event_info_t info)
+{
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+    {
+        xEventGroupSetBits(events, EVENT_GOT_IP);
+    }
+    else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED &&
+             info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE) // not our own disconnect
+    {
+        xEventGroupSetBits(events, EVENT_DISCONNECTED);
+    }
+    else if (event == ARDUINO_EVENT_WIFI_STA_LOST_IP)
+    {
+        xEventGroupSetBits(events, EVENT_DISCONNECTED);
+    }
+}
+
+/**
+ * @brief Loads the cached access point and lease from NVS.
+ */
+static void Connectivity_LoadCache()
+{
+    Preferences preferences;
+    preferences.begin(CACHE_NAMESPACE, true);
+    cacheValid = preferences.getBytes(CACHE_KEY, &cache, sizeof(cache)) == sizeof(cache) &&
+                 cache.version == CACHE_VERSION && cache.channel != 0;
+    preferences.end();
+}
+
+/**
+ * @brief Stores the current access point and lease in NVS, if they changed.
+ */
+static void Connectivity_SaveCache()
+{
+    LinkCache current;
+    memset(&current, 0, sizeof(current));
+    current.version = CACHE_VERSION;
+    current.channel = WiFi.channel();
+    const uint8_t *bssid = WiFi.BSSID();
+    if (bssid)
+    {
+        memcpy(current.bssid, bssid, sizeof(current.bssid));
+    }
+    current.ip = WiFi.localIP();
+    current.gateway = WiFi.gatewayIP();
+    current.subnet = WiFi.subnetMask();
+    current.dns = WiFi.dnsIP();
+    if (cacheValid && memcmp(&current, &cache, sizeof(cache)) == 0)
+    {
+        return; // unchanged, spare the flash
+    }
+    Preferences preferences;
+    preferences.begin(CACHE_NAMESPACE, false);
+    preferences.putBytes(CACHE_KEY, &current, sizeof(current));
+    preferences.end();
+    cache = current;
+    cacheValid = true;
+}
+
+/**
+ * @brief Starts a connection attempt, fast (cached BSSID, channel and IP) or full (scan and DHCP).
+ */
+static void Connectivity_Begin(bool fast)
+{
+    fastAttempt = fast && cacheValid;
+    attemptTime = millis();
+    linkState = LINK_CONNECTING;
+    xEventGroupClearBits(events, EVENT_GOT_IP | EVENT_DISCONNECTED);
+#if CONNECTIVITY_CACHE_IP
+    if (fastAttempt && cache.ip != 0)
+    {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+    }
+    else
+    {
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // DHCP
+    }
+#endif
+    if (fastAttempt)
+    {
+        WiFi.begin(wifiSsid, wifiPassword, cache.channel, cache.bssid);
+    }
+    else
+    {
+        WiFi.begin(wifiSsid, wifiPassword);
+    }
+}
+
+/**
+ * @brief Ends a failed attempt: falls back to a full connect, or waits for the next retry.
+ */
+static void Connectivity_Fail()
+{
+    if (fastAttempt)
+    {
+        stats.fastFailures++;
+        Connectivity_Begin(false);
+        return;
+    }
+    WiFi.disconnect();
+    linkState = LINK_DOWN;
+    attemptTime = millis();
+}
+
+/**
+ * @brief Records the connect time and refreshes the cache once the IP is assigned.
+ */
+static void Connectivity_OnUp()
+{
+    linkState = LINK_UP;
+    uint32_t connectTime = millis() - attemptTime;
+    stats.connects++;
+    stats.fastConnects += fastAttempt;
+    stats.lastConnectTime = connectTime;
+    if (connectTime > stats.maxConnectTime)
+    {
+        stats.maxConnectTime = connectTime;
+    }
+    LOGL("WiFi connected in %u ms (%s), IP %s", (unsigned)connectTime, fastAttempt ? "fast" : "full", WiFi.localIP().toString().c_str());
+    Connectivity_SaveCache();
+    rssiTime = 0;
+}
+
+/**
+ * @brief Samples the RSSI of the access point.
+ */
+static void Connectivity_SampleRssi()
+{
+    int8_t rssi = WiFi.RSSI();
+    if (stats.rssiSamples == 0 || rssi < stats.minRssi)
+    {
+        stats.minRssi = rssi;
+    }
+    if (stats.rssiSamples == 0 || rssi > stats.maxRssi)
+    {
+        stats.maxRssi = rssi;
+    }
+    stats.rssi = rssi;
+    stats.rssiSum += rssi;
+    stats.rssiSamples++;
+}
+
+/**
+ * @brief Connectivity task: reacts to WiFi events and drives the connection attempts.
+ */
+static void Task_Connectivity(void *arg)
+{
+    (void)arg;
+    Connectivity_LoadCache();
+    Connectivity_Begin(true);
+    for (;;)
+    {
+        EventBits_t bits = xEventGroupWaitBits(events, EVENT_GOT_IP | EVENT_DISCONNECTED, pdTRUE, pdFALSE,
+                                               pdMS_TO_TICKS(linkState == LINK_UP ? CONNECTIVITY_RSSI_MS : 100));
+        unsigned long now = millis();
+        if (bits & EVENT_DISCONNECTED)
+        {
+            if (linkState == LINK_UP)
+            {
+                // Reconnect to the same access point right away
+                stats.disconnects++;
+                LOGW("WiFi link lost");
+                Connectivity_Begin(true);
+            }
+            else if (linkState == LINK_CONNECTING)
+            {
+                Connectivity_Fail(); // access point not found or rejected
+            }
+        }
+        else if ((bits & EVENT_GOT_IP) && linkState == LINK_CONNECTING)
+        {
+            Connectivity_OnUp();
+        }
+
+        switch (linkState)
+        {
+        case LINK_UP:
+            if (now - rssiTime >= CONNECTIVITY_RSSI_MS)
+            {
+                rssiTime = now;
+                Connectivity_SampleRssi();
+            }
+            break;
+        case LINK_CONNECTING:
+            if (now - attemptTime > (fastAttempt ? CONNECTIVITY_FAST_TIMEOUT : CONNECTIVITY_CONNECT_TIMEOUT))
+            {
+                Connectivity_Fail();
+            }
+            break;
+        case LINK_DOWN:
+            if (now - attemptTime >= CONNECTIVITY_RETRY_MS)
+            {
+                Connectivity_Begin(false);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Starts the connectivity task, which connects in the background.
+ *
+ * @param ssid Access point name, must outlive the module.
+ * @param password Access point password, must outlive the module.
+ */
+void Connectivity_Init(const char *ssid, const char *password)
+{
+    wifiSsid = ssid;
+    wifiPassword = password;
+    events = xEventGroupCreate();
+    WiFi.persistent(false);        // the cache is ours, do not write the WiFi config to flash on every begin
+    WiFi.setAutoReconnect(false);  // reconnects are driven by the task
+    WiFi.mode(WIFI_STA);
+    WiFi.onEvent(Connectivity_OnEvent);
+    xTaskCreatePinnedToCore(Task_Connectivity, "Task_Connectivity", CONNECTIVITY_TASK_STACK, NULL,
+                            CONNECTIVITY_TASK_PRIORITY, NULL, CONNECTIVITY_TASK_CORE);
+}
+
+/**
+ * @brief Current link state, never blocks.
+ */
+LINK_STATE Connectivity_GetState()
+{
+    return linkState;
+}
+
+/**
+ * @brief Copy of the statistics, updated by the connectivity task.
+ */
+ConnectivityStats Connectivity_GetStats()
+{
+    return stats;
+}
+
+/**
+ * @brief Logs the connect time and RSSI statistics.
+ */
+void Connectivity_Logging()
+{
+    ConnectivityStats snapshot = stats;
+    LOGL("WiFi Log:");
+    LOGL("\t%u connects (%u fast, %u fast failures), %u disconnects",
+         (unsigned)snapshot.connects, (unsigned)snapshot.fastConnects, (unsigned)snapshot.fastFailures, (unsigned)snapshot.disconnects);
+    LOGL("\tConnect time: last %u ms, max %u ms", (unsigned)snapshot.lastConnectTime, (unsigned)snapshot.maxConnectTime);
+    if (snapshot.rssiSamples > 0)
+    {
+        LOGL("\tRSSI: %d dBm (min %d, avg %d, max %d)", snapshot.rssi, snapshot.minRssi,
+             (int)(snapshot.rssiSum / (int32_t)snapshot.rssiSamples), snapshot.maxRssi);
+    }
+}
@@ -0,0 +1,564 @@
+#include "Esp32Hal.h"
+#include <driver/i2s.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+#include <App.h>
+#include <Config.h>
+#include <Player.h>
+#include <Connectivity.h>
+#include <esp_freertos_hooks.h>
+#include <freertos/semphr.h>
+#include <lwip/sockets.h>
+#include <atomic>
+
+static volatile bool buttonState = false;        // Debounced, true while pressed
+static volatile uint64_t buttonEdgeTime = 0;     // esp_timer time of the last accepted edge
+static SemaphoreHandle_t buttonEdge = NULL;      // Given on every accepted edge, taken by WaitButton
+static HalEvent buttonListener = NULL;
+static portMUX_TYPE buttonMux = portMUX_INITIALIZER_UNLOCKED;
+
+#if CPU_IDLE_STATS
+static volatile uint32_t ticks[2];               // Tick interrupts seen by the tick hook of each core
+static volatile uint32_t idleTicks[2];           // Those that interrupted the idle task
+static uint32_t idleReportTicks[2];              // ticks at the previous Hal_CpuIdle
+static uint32_t idleReportIdle[2];               // idleTicks at the previous Hal_CpuIdle
+static bool idleStarted[2];                      // Hal_CpuIdle was called for the core
+static std::atomic<bool> idleHooked(false);      // Hal_CpuIdle (voice task) and Hal_CpuTicks (metrics) may race
+#endif
+
+/**
+ * @brief Milliseconds since boot.
+ */
+unsigned long Hal_Millis()
+{
+    return millis();
+}
+
+/**
+ * @brief Microseconds since boot, from the 64-bit esp_timer.
+ */
+uint64_t Hal_Micros()
+{
+    return esp_timer_get_time();
+}
+
+/**
+ * @brief Blocks the calling task for `ms` milliseconds.
+ */
+void Hal_DelayMs(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+/**
+ * @brief Creates a FreeRTOS task pinned to `core`.
+ *
+ * @param stackSize Stack size in bytes.
+ */
+bool Hal_StartTask(void (*task)(void *), const char *name, uint32_t stackSize, void *arg, uint8_t priority, int core)
+{
+    return xTaskCreatePinnedToCore(task, name, stackSize, arg, priority, NULL, core) == pdPASS;
+}
+
+/**
+ * @brief Deletes the calling task: a FreeRTOS task must not return from its function.
+ */
+void Hal_EndTask()
+{
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Creates a wake-up event (binary semaphore).
+ */
+HalEvent Hal_CreateEvent()
+{
+    return (HalEvent)xSemaphoreCreateBinary();
+}
+
+/**
+ * @brief Wakes the task waiting on `event`, from a task or an interrupt.
+ */
+void IRAM_ATTR Hal_SignalEvent(HalEvent event)
+{
+    if (xPortInIsrContext())
+    {
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR((SemaphoreHandle_t)event, &woken);
+        if (woken)
+        {
+            portYIELD_FROM_ISR();
+        }
+        return;
+    }
+    xSemaphoreGive((SemaphoreHandle_t)event);
+}
+
+/**
+ * @brief Blocks until `event` is signaled or `timeoutMs` expires.
+ *
+ * @return false on timeout.
+ */
+bool Hal_WaitEvent(HalEvent event, uint32_t timeoutMs)
+{
+    return xSemaphoreTake((SemaphoreHandle_t)event, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+#if CPU_IDLE_STATS
+/**
+ * @brief Tick hook of both cores: samples which task the tick interrupted.
+ *
+ * The idle task is left alone, it sleeps until the next interrupt as usual; the share of ticks
+ * that find it running is the idle share of the core, at the tick resolution.
+ *
+ * In IRAM: it runs in the tick interrupt, which keeps firing while the flash cache is disabled
+ * during the RecordLog partition erases and writes. A hook in flash would crash the core then.
+ */
+static void IRAM_ATTR Hal_TickHook()
+{
+    int core = xPortGetCoreID();
+    ticks[core]++;
+    if (xTaskGetCurrentTaskHandle() == xTaskGetIdleTaskHandleForCPU(core))
+    {
+        idleTicks[core]++;
+    }
+}
+
+/**
+ * @brief Registers the tick hook on both cores, once.
+ */
+static void Hal_HookTicks()
+{
+    if (!idleHooked.exchange(true))
+    {
+        esp_register_freertos_tick_hook_for_cpu(Hal_TickHook, 0);
+        esp_register_freertos_tick_hook_for_cpu(Hal_TickHook, 1);
+    }
+}
+#endif
+
+/**
+ * @brief Idle share of a core since the previous call, the first call starts the measurement.
+ *
+ * @param core 0 or 1.
+ * @return Tenths of a percent, -1 when CPU_IDLE_STATS is off or on the first call.
+ */
+int Hal_CpuIdle(int core)
+{
+#if CPU_IDLE_STATS
+    Hal_HookTicks();
+    if (core < 0 || core > 1)
+    {
+        return -1;
+    }
+    uint32_t total = ticks[core];
+    uint32_t idle = idleTicks[core]; // read after `total`: at most one tick ahead of it
+    uint32_t elapsed = total - idleReportTicks[core];
+    uint32_t idleElapsed = idle - idleReportIdle[core];
+    bool first = !idleStarted[core];
+    idleStarted[core] = true;
+    idleReportTicks[core] = total;
+    idleReportIdle[core] = idle;
+    if (first || elapsed == 0)
+    {
+        return -1;
+    }
+    idleElapsed = idleElapsed < elapsed ? idleElapsed : elapsed;
+    return (int)((uint64_t)idleElapsed * 1000 / elapsed);
+#else
+    (void)core;
+    return -1;
+#endif
+}
+
+/**
+ * @brief Tick counts of a core since the tick hook was registered, for rates over any window
+ *        (the metrics endpoint) without disturbing the Hal_CpuIdle() windows.
+ *
+ * @param core 0 or 1.
+ * @param ticks Tick interrupts of the core.
+ * @param idle Those that found the idle task running.
+ * @return false when CPU_IDLE_STATS is off.
+ */
+bool Hal_CpuTicks(int core, uint32_t &ticks, uint32_t &idle)
+{
+    ticks = idle = 0;
+#if CPU_IDLE_STATS
+    Hal_HookTicks();
+    if (core < 0 || core > 1)
+    {
+        return false;
+    }
+    ticks = ::ticks[core];
+    idle = idleTicks[core]; // read after the total, at most one tick ahead of it
+    idle = idle < ticks ? idle : ticks;
+    return true;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+/**
+ * @brief Formats a log line and writes it to the serial port.
+ */
+void Hal_Log(const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    Serial.print(line);
+}
+
+/**
+ * @brief Writes log output as is to the serial port (text lines or binary frames, see Log.h).
+ */
+void Hal_LogWrite(const void *data, size_t len)
+{
+    Serial.write((const uint8_t *)data, len);
+}
+
+/**
+ * @brief Initializes the I2S peripheral for audio input/output.
+ *
+ * This function configures the I2S peripheral to prepare it for handling audio
+ * data streams, enabling the necessary settings and parameters.
+ */
+bool I2SMicrophone::Begin() {
+    if (!i2sInit) {
+        i2s_config_t i2s_config = {
+            .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
+            .sample_rate = I2S_SAMPLE_RATE,
+            .bits_per_sample = i2s_bits_per_sample_t(I2S_SAMPLE_BITS),
+            .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+            .communication_format = i2s_comm_format_t(I2S_COMM_FORMAT_STAND_I2S | I2S_COMM_FORMAT_STAND_MSB),
+            .intr_alloc_flags = 0,
+            .dma_buf_count = I2S_DMA_BUF_COUNT,
+            .dma_buf_len = I2S_DMA_BUF_LEN,
+            .use_apll = 1
+        };
+        i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
+        const i2s_pin_config_t pin_config = {
+            .bck_io_num = I2S_SCK,
+            .ws_io_num = I2S_WS,
+            .data_out_num = -1,
+            .data_in_num = I2S_SD
+        };
+        i2s_set_pin(I2S_PORT, &pin_config);
+    }
+    i2sInit = true;
+    return true;
+}
+
+/**
+ * @brief Reads `len` bytes of 16-bit samples, blocking until the DMA delivers them.
+ */
+size_t I2SMicrophone::Read(uint8_t *buffer, size_t len) {
+    size_t bytes_read = 0;
+    i2s_read(I2S_PORT, (void *)buffer, len, &bytes_read, portMAX_DELAY);
+    return bytes_read;
+}
+
+/**
+ * @brief Uninstalls the I2S driver and frees associated heap memory.
+ *
+ * This function stops the I2S peripheral, releases any dynamically allocated memory
+ * used by the I2S driver, and prepares the system for safe shutdown of I2S operations.
+ */
+void I2SMicrophone::End() {
+    i2s_driver_uninstall(I2S_PORT);
+    i2sInit = false;
+}
+
+size_t FlashFile::Write(const uint8_t *data, size_t len) {
+    return file.write(data, len);
+}
+
+size_t FlashFile::Read(uint8_t *data, size_t len) {
+    return file.read(data, len);
+}
+
+bool FlashFile::Seek(uint32_t position) {
+    return file.seek(position);
+}
+
+size_t FlashFile::Size() {
+    return file.size();
+}
+
+void FlashFile::Close() {
+    file.close();
+}
+
+/**
+ * @brief Mounts the file system, formatting it if the mount fails.
+ */
+bool FlashStorage::Begin() {
+    return FILESYSTEM.begin(true);
+}
+
+/**
+ * @brief Opens a file for reading, or creates/truncates it for writing.
+ */
+StorageFile *FlashStorage::Open(const char *path, bool write) {
+    File file = FILESYSTEM.open(path, write ? FILE_WRITE : FILE_READ, write);
+    if (!file) {
+        return NULL;
+    }
+    return new FlashFile(file);
+}
+
+bool FlashStorage::Exists(const char *path) {
+    return FILESYSTEM.exists(path);
+}
+
+/**
+ * @brief Removes a file from the flash memory.
+ *
+ * This function deletes a specified file from the flash memory based on the provided file path.
+ *
+ * @param path String containing the path to the file to be removed.
+ */
+bool FlashStorage::Remove(const char *path) {
+    if (FILESYSTEM.exists(path)) {
+        return FILESYSTEM.remove(path);
+    }
+    return false;
+}
+
+/**
+ * @brief Calls `callback` for every file in the root directory.
+ */
+void FlashStorage::List(void (*callback)(const char *name, size_t size)) {
+    File root = FILESYSTEM.open("/");
+    File file = root.openNextFile();
+    while (file) {
+        callback(file.name(), file.size());
+        file = root.openNextFile();
+    }
+}
+
+/**
+ * @brief Finds the recording log partition and maps all of it read-only.
+ */
+bool PartitionFlash::Begin() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)RECORD_LOG_SUBTYPE, RECORD_LOG_PARTITION);
+    if (!partition) {
+        return false;
+    }
+    const void *address;
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &address, &mapHandle) != ESP_OK) {
+        partition = NULL;
+        return false;
+    }
+    mapped = (const uint8_t *)address;
+    return true;
+}
+
+uint32_t PartitionFlash::Size() {
+    return partition ? partition->size : 0;
+}
+
+/**
+ * @brief Erases whole sectors. The caches of both cores are disabled meanwhile (tens of ms per sector).
+ */
+bool PartitionFlash::Erase(uint32_t offset, uint32_t len) {
+    return partition && esp_partition_erase_range(partition, offset, len) == ESP_OK;
+}
+
+/**
+ * @brief Programs erased bytes, the driver flushes the cache of the range so the mapping reads them.
+ */
+bool PartitionFlash::Write(uint32_t offset, const uint8_t *data, size_t len) {
+    return partition && esp_partition_write(partition, offset, data, len) == ESP_OK;
+}
+
+const uint8_t *PartitionFlash::Map() {
+    return mapped;
+}
+
+/**
+ * @brief Connects to the server, fails right away while the WiFi link is down.
+ */
+bool WiFiTransport::Connect(const char *host, uint16_t port) {
+    if (!LinkUp()) {
+        return false;
+    }
+    if (!client.connect(host, port)) {
+        return false;
+    }
+    client.setNoDelay(true); // send every chunk immediately
+    return true;
+}
+
+size_t WiFiTransport::Write(const uint8_t *data, size_t len) {
+    return client.write(data, len);
+}
+
+/**
+ * @brief Waits up to `timeoutMs` for data and reads what is available.
+ *
+ * The task sleeps in select() until lwIP has data, the peer closes or the timeout expires.
+ */
+int WiFiTransport::Read(uint8_t *buffer, size_t len, uint32_t timeoutMs) {
+    if (!client.available()) {
+        int fd = client.fd();
+        if (fd < 0 || !client.connected()) {
+            return -1;
+        }
+        if (timeoutMs == 0) { // only take what is available
+            return 0;
+        }
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        struct timeval timeout = {(time_t)(timeoutMs / 1000), (suseconds_t)(timeoutMs % 1000) * 1000};
+        int ready = select(fd + 1, &readSet, NULL, NULL, &timeout);
+        if (ready < 0) {
+            return -1;
+        }
+        if (!client.available()) {
+            // Readable without data: closed by the peer
+            return ready == 0 || client.connected() ? 0 : -1;
+        }
+    }
+    return client.read(buffer, min(len, (size_t)client.available()));
+}
+
+bool WiFiTransport::Connected() {
+    return client.connected();
+}
+
+void WiFiTransport::Stop() {
+    client.stop();
+}
+
+bool WiFiTransport::LinkUp() {
+    return Connectivity_GetState() == LINK_UP;
+}
+
+/**
+ * @brief Button interrupt, both edges: takes the first edge, ignores the bounces after it.
+ */
+static void IRAM_ATTR Button_OnEdge() {
+    uint64_t now = esp_timer_get_time();
+    bool pressed = digitalRead(RECORD_BUTTON_PIN) == LOW;
+    portENTER_CRITICAL_ISR(&buttonMux);
+    bool accepted = pressed != buttonState && now - buttonEdgeTime >= BUTTON_DEBOUNCE_MS * 1000ULL;
+    if (accepted) {
+        buttonState = pressed;
+        buttonEdgeTime = now;
+    }
+    portEXIT_CRITICAL_ISR(&buttonMux);
+    if (!accepted) {
+        return;
+    }
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(buttonEdge, &woken);
+    if (buttonListener) {
+        xSemaphoreGiveFromISR((SemaphoreHandle_t)buttonListener, &woken);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void GpioControls::Begin() {
+    pinMode(RECORD_BUTTON_PIN, INPUT_PULLUP);
+    pinMode(RECORD_LED_PIN, OUTPUT);
+    digitalWrite(RECORD_LED_PIN, LOW);
+    buttonEdge = xSemaphoreCreateBinary();
+    buttonState = digitalRead(RECORD_BUTTON_PIN) == LOW;
+    attachInterrupt(digitalPinToInterrupt(RECORD_BUTTON_PIN), Button_OnEdge, CHANGE);
+}
+
+/**
+ * @brief Debounced button state.
+ *
+ * Once the debounce window has passed, the pin is read again to catch a change whose edge fell
+ * inside the window.
+ */
+bool GpioControls::ButtonPressed() {
+    uint64_t now = esp_timer_get_time();
+    if (now - buttonEdgeTime >= BUTTON_DEBOUNCE_MS * 1000ULL) {
+        bool pressed = digitalRead(RECORD_BUTTON_PIN) == LOW;
+        portENTER_CRITICAL(&buttonMux);
+        if (pressed != buttonState && now - buttonEdgeTime >= BUTTON_DEBOUNCE_MS * 1000ULL) {
+            buttonState = pressed;
+            buttonEdgeTime = now;
+        }
+        portEXIT_CRITICAL(&buttonMux);
+    }
+    return buttonState;
+}
+
+/**
+ * @brief Sleeps until the button interrupt reports the wanted state.
+ */
+bool GpioControls::WaitButton(bool pressed, uint32_t timeoutMs) {
+    unsigned long startTime = millis();
+    for (;;) {
+        if (ButtonPressed() == pressed) {
+            return true;
+        }
+        unsigned long elapsed = millis() - startTime;
+        if (elapsed >= timeoutMs) {
+            return false;
+        }
+        uint32_t wait = timeoutMs - elapsed;
+        if (esp_timer_get_time() - buttonEdgeTime < BUTTON_DEBOUNCE_MS * 1000ULL) {
+            wait = min(wait, (uint32_t)BUTTON_DEBOUNCE_MS); // a change within the window has no edge of its own
+        }
+        xSemaphoreTake(buttonEdge, pdMS_TO_TICKS(wait));
+    }
+}
+
+uint64_t GpioControls::ButtonEdgeTime() {
+    return buttonEdgeTime;
+}
+
+void GpioControls::SetButtonEvent(HalEvent event) {
+    buttonListener = event;
+}
+
+void GpioControls::SetLed(bool on) {
+    digitalWrite(RECORD_LED_PIN, on ? HIGH : LOW);
+}
+
+void DacSpeaker::Begin(uint32_t sampleRate) {
+    Player_Begin(sampleRate);
+}
+
+size_t DacSpeaker::Write(const uint8_t *data, size_t len) {
+    return Player_Write(data, len);
+}
+
+void DacSpeaker::End() {
+    Player_End();
+}
+
+void DacSpeaker::WaitDone() {
+    Player_WaitDone();
+}
+
+void DacSpeaker::Stop() {
+    Player_Stop();
+}
+
+const PlayerStats &DacSpeaker::GetStats() {
+    return Player_GetStats();
+}
+
+bool DacSpeaker::Playing() {
+    return Player_IsActive();
+}
+
+uint32_t DacSpeaker::Position() {
+    return Player_Position();
+}
+
+void DacSpeaker::Interrupt() {
+    Player_Interrupt();
+}
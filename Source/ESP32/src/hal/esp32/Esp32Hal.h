@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <FS.h>
+#include <esp_partition.h>
+#include <Hal.h>
+
+// Pin definitions
+#define I2S_WS 22
+#define I2S_SD 26
+#define I2S_SCK 21
+#define DAC_PIN 25
+#define RECORD_BUTTON_PIN 12
+#define RECORD_LED_PIN 14
+#define DAC1_PIN 25
+#define BUTTON_DEBOUNCE_MS 30  // Edges closer than this to the last accepted edge are bounces
+
+// I2S configurations
+#define I2S_PORT I2S_NUM_1  // I2S_NUM_0 drives the DAC (Player.h)
+
+// File system settings
+#define USE_LITTLE_FS 0
+#define USE_SPIFFS 1
+#define USE_FILESYSTEM USE_SPIFFS
+
+#if USE_FILESYSTEM == USE_SPIFFS
+    #include <SPIFFS.h>
+    #define FILESYSTEM SPIFFS
+    #define FILESYSTEM_NAME "SPIFFS"
+#elif USE_FILESYSTEM == USE_LITTLE_FS
+    #include "LittleFS.h"
+    #define FILESYSTEM MAIN_LITTLE_FS
+    #define FILESYSTEM_NAME "LittleFS"
+#endif
+
+/**
+ * @brief INMP441 microphone on I2S_PORT.
+ */
+class I2SMicrophone : public AudioInput
+{
+public:
+    bool Begin() override;
+    size_t Read(uint8_t *buffer, size_t len) override;
+    void End() override;
+
+private:
+    bool i2sInit = false;
+};
+
+/**
+ * @brief A file on FILESYSTEM.
+ */
+class FlashFile : public StorageFile
+{
+public:
+    explicit FlashFile(File f) : file(f) {}
+    size_t Write(const uint8_t *data, size_t len) override;
+    size_t Read(uint8_t *data, size_t len) override;
+    bool Seek(uint32_t position) override;
+    size_t Size() override;
+    void Close() override;
+
+private:
+    File file;
+};
+
+/**
+ * @brief SPIFFS (or LittleFS) storage, see USE_FILESYSTEM.
+ */
+class FlashStorage : public Storage
+{
+public:
+    bool Begin() override;
+    StorageFile *Open(const char *path, bool write) override;
+    bool Exists(const char *path) override;
+    bool Remove(const char *path) override;
+    void List(void (*callback)(const char *name, size_t size)) override;
+};
+
+/**
+ * @brief The RECORD_LOG_PARTITION data partition, mapped into the data address space by Begin().
+ */
+class PartitionFlash : public FlashRegion
+{
+public:
+    bool Begin() override;
+    uint32_t Size() override;
+    bool Erase(uint32_t offset, uint32_t len) override;
+    bool Write(uint32_t offset, const uint8_t *data, size_t len) override;
+    const uint8_t *Map() override;
+
+private:
+    const esp_partition_t *partition = NULL;
+    const uint8_t *mapped = NULL;
+    spi_flash_mmap_handle_t mapHandle;
+};
+
+/**
+ * @brief TCP connection over WiFi, the access point is managed by the connectivity task (Connectivity.h).
+ */
+class WiFiTransport : public Transport
+{
+public:
+    bool Connect(const char *host, uint16_t port) override;
+    size_t Write(const uint8_t *data, size_t len) override;
+    int Read(uint8_t *buffer, size_t len, uint32_t timeoutMs) override;
+    bool Connected() override;
+    void Stop() override;
+    bool LinkUp() override;
+
+private:
+    WiFiClient client;
+};
+
+/**
+ * @brief RECORD_BUTTON_PIN (active low) and RECORD_LED_PIN.
+ *
+ * The button is read by a GPIO interrupt on both edges. The first edge is taken right away and
+ * the edges within BUTTON_DEBOUNCE_MS after it are ignored; a level that changed during that
+ * window is picked up on the next read.
+ */
+class GpioControls : public Controls
+{
+public:
+    void Begin();
+    bool ButtonPressed() override;
+    bool WaitButton(bool pressed, uint32_t timeoutMs) override;
+    uint64_t ButtonEdgeTime() override;
+    void SetButtonEvent(HalEvent event) override;
+    void SetLed(bool on) override;
+};
+
+/**
+ * @brief Built-in DAC output through the streaming player (Player.h).
+ */
+class DacSpeaker : public AudioOutput
+{
+public:
+    void Begin(uint32_t sampleRate) override;
+    size_t Write(const uint8_t *data, size_t len) override;
+    void End() override;
+    void WaitDone() override;
+    void Stop() override;
+    const PlayerStats &GetStats() override;
+    bool Playing() override;
+    uint32_t Position() override;
+    void Interrupt() override;
+};
+
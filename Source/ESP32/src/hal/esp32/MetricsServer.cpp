@@ -0,0 +1,115 @@
+#include <MetricsServer.h>
+#include <Metrics.h>
+#include <Connectivity.h>
+#include <App.h>
+#include <ESPAsyncWebServer.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#if METRICS_SERVER
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4"
+
+static AsyncWebServer *server = NULL;
+static char metricsText[METRICS_BUFFER_SIZE];   // Last response, written and sent by the AsyncTCP task
+static bool scrapeInFlight = false;             // metricsText is still being sent, only used by the AsyncTCP task
+static TaskStatus_t tasks[METRICS_MAX_TASKS];
+
+/**
+ * @brief Writes the heap, task and WiFi gauges of the ESP32.
+ */
+static void MetricsServer_FormatDevice(MetricsText &text)
+{
+    Metrics_Header(text, "voice_uptime_seconds", "gauge", "Time since boot");
+    Metrics_Printf(text, "voice_uptime_seconds %u\n", (unsigned)(Hal_Micros() / 1000000));
+    Metrics_Header(text, "voice_heap_free_bytes", "gauge", "Free heap");
+    Metrics_Printf(text, "voice_heap_free_bytes %u\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    Metrics_Header(text, "voice_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+    Metrics_Printf(text, "voice_heap_min_free_bytes %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+    Metrics_Header(text, "voice_heap_largest_block_bytes", "gauge", "Largest free heap block");
+    Metrics_Printf(text, "voice_heap_largest_block_bytes %u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+
+    uint32_t totalRunTime = 0;
+    UBaseType_t count = uxTaskGetSystemState(tasks, METRICS_MAX_TASKS, &totalRunTime);
+    Metrics_Header(text, "voice_task_stack_free_bytes", "gauge", "Stack never used by the task (high-water mark)");
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        Metrics_Printf(text, "voice_task_stack_free_bytes{task=\"%s\"} %u\n", tasks[i].pcTaskName,
+                       (unsigned)tasks[i].usStackHighWaterMark);
+    }
+#if configGENERATE_RUN_TIME_STATS
+    // Off in the prebuilt Arduino-ESP32 FreeRTOS, the series is then missing (see Metrics.h).
+    // Run time clock of FreeRTOS (esp_timer microseconds), 32-bit: wraps like a counter reset
+    Metrics_Header(text, "voice_task_runtime_us_total", "counter", "CPU time used by the task");
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        Metrics_Printf(text, "voice_task_runtime_us_total{task=\"%s\"} %u\n", tasks[i].pcTaskName,
+                       (unsigned)tasks[i].ulRunTimeCounter);
+    }
+#endif
+
+    // Tick hook counts since boot, the idle share is rate(idle) / rate(ticks) over any window:
+    // scrapes keep no state and leave the per-turn Hal_CpuIdle() windows of the voice task alone
+    uint32_t ticks[2], idle[2];
+    if (Hal_CpuTicks(0, ticks[0], idle[0]) && Hal_CpuTicks(1, ticks[1], idle[1]))
+    {
+        Metrics_Header(text, "voice_cpu_ticks_total", "counter", "Tick interrupts of the core");
+        for (int core = 0; core < 2; core++)
+        {
+            Metrics_Printf(text, "voice_cpu_ticks_total{core=\"%d\"} %u\n", core, (unsigned)ticks[core]);
+        }
+        Metrics_Header(text, "voice_cpu_idle_ticks_total", "counter", "Tick interrupts that found the core idle");
+        for (int core = 0; core < 2; core++)
+        {
+            Metrics_Printf(text, "voice_cpu_idle_ticks_total{core=\"%d\"} %u\n", core, (unsigned)idle[core]);
+        }
+    }
+
+    ConnectivityStats wifi = Connectivity_GetStats();
+    Metrics_Header(text, "voice_wifi_up", "gauge", "1 while the WiFi link has an IP");
+    Metrics_Printf(text, "voice_wifi_up %d\n", Connectivity_GetState() == LINK_UP ? 1 : 0);
+    Metrics_Header(text, "voice_wifi_rssi_dbm", "gauge", "Last RSSI sample of the access point");
+    Metrics_Printf(text, "voice_wifi_rssi_dbm %d\n", (int)wifi.rssi);
+    Metrics_Header(text, "voice_wifi_connects_total", "counter", "Connections that got an IP");
+    Metrics_Printf(text, "voice_wifi_connects_total %u\n", (unsigned)wifi.connects);
+    Metrics_Header(text, "voice_wifi_disconnects_total", "counter", "Links lost after being up");
+    Metrics_Printf(text, "voice_wifi_disconnects_total %u\n", (unsigned)wifi.disconnects);
+    Metrics_Header(text, "voice_wifi_connect_ms", "gauge", "Duration of the last connect");
+    Metrics_Printf(text, "voice_wifi_connect_ms %u\n", (unsigned)wifi.lastConnectTime);
+}
+
+/**
+ * @brief GET /metrics: formats the metrics and sends them without a copy to the heap.
+ *
+ * The response points into metricsText until it is sent, so a scrape arriving meanwhile gets a
+ * 503 instead of overwriting it; the buffer is released when the connection of the first closes.
+ */
+static void MetricsServer_Handle(AsyncWebServerRequest *request)
+{
+    if (scrapeInFlight)
+    {
+        request->send(503, "text/plain", "Scrape in progress\n");
+        return;
+    }
+    scrapeInFlight = true;
+    request->onDisconnect([]() { scrapeInFlight = false; });
+    MetricsText text = {metricsText, sizeof(metricsText), 0};
+    Metrics_Format(text);
+    MetricsServer_FormatDevice(text);
+    request->send(request->beginResponse_P(200, METRICS_CONTENT_TYPE, (const uint8_t *)metricsText, text.length));
+}
+
+#endif
+
+/**
+ * @brief Starts the metrics endpoint. Call after Connectivity_Init(), it serves once the link is up.
+ */
+void MetricsServer_Init()
+{
+#if METRICS_SERVER
+    server = new AsyncWebServer(METRICS_PORT);
+    server->on("/metrics", HTTP_GET, MetricsServer_Handle);
+    server->begin();
+    LOGL("Metrics served on port %u: /metrics", (unsigned)METRICS_PORT);
+#endif
+}
@@ -0,0 +1,365 @@
+#include <Player.h>
+#include <Resampler.h>
+#include <RingBuffer.h>
+#include <Trace.h>
+#include <driver/i2s.h>
+#include <freertos/semphr.h>
+#include <atomic>
+
+#define PLAYER_BLOCK 128                         // Ring bytes converted per DMA write at most
+
+enum PLAYER_STATE
+{
+    PLAYER_IDLE,
+    PLAYER_BUFFERING,
+    PLAYER_PLAYING
+};
+
+static RingBuffer<PLAYER_RING_SIZE> ring;
+static ResamplerState resampler;
+static std::atomic<PLAYER_STATE> playerState(PLAYER_IDLE);
+static volatile bool streamEnded = false;
+static volatile uint32_t samplesPlayed = 0;
+static volatile uint32_t underruns = 0;
+static size_t playerWatermark = PLAYER_PREBUFFER;
+static unsigned long beginTime = 0;
+static PlayerStats stats;
+static SemaphoreHandle_t wakeEvent = NULL;       // Player_CheckWatermark/Player_Stop -> player task
+static SemaphoreHandle_t idleEvent = NULL;       // Player task left the ring -> Player_Stop
+static SemaphoreHandle_t doneEvent = NULL;       // Player task drained the DMA -> Player_WaitDone
+static SemaphoreHandle_t spaceEvent = NULL;      // Player task made room for a waiting writer
+static volatile bool writerWaiting = false;
+static std::atomic<bool> playerBusy(false);      // The player task may be using the ring or the resampler
+static volatile bool dmaRunning = false;         // Only changed by the player task
+static uint8_t input[PLAYER_BLOCK];
+static int16_t samples[PLAYER_BLOCK];
+static int16_t resampled[PLAYER_DMA_BUF_LEN];
+static uint32_t frames[PLAYER_DMA_BUF_LEN];      // Stereo frames, the DAC takes the high byte of the right slot
+
+/**
+ * @brief Writes resampled samples to the DMA, blocking while its buffers are full.
+ *
+ * The built-in DAC is unsigned: the sign bit is flipped, both slots carry the sample.
+ */
+static void Player_Output(const int16_t *data, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t value = (uint16_t)(data[i] ^ 0x8000);
+        frames[i] = value | (value << 16);
+    }
+    size_t written = 0;
+    i2s_write(PLAYER_PORT, frames, count * sizeof(frames[0]), &written, portMAX_DELAY);
+}
+
+/**
+ * @brief Pushes the DMA buffers out with mid-scale silence and stops the I2S clock.
+ *
+ * Returns once everything queued before has reached the DAC, which then holds the mid-scale value.
+ */
+static void Player_Park()
+{
+    if (!dmaRunning)
+    {
+        return;
+    }
+    memset(resampled, 0, sizeof(resampled));
+    for (int i = 0; i < PLAYER_DMA_BUF_COUNT; i++)
+    {
+        Player_Output(resampled, PLAYER_DMA_BUF_LEN);
+    }
+    i2s_stop(PLAYER_PORT);
+    dmaRunning = false;
+    xSemaphoreGive(doneEvent);
+}
+
+/**
+ * @brief Converts one piece of the ring (or the end of the stream) and writes it to the DMA.
+ */
+static void Player_Feed()
+{
+    size_t available = ring.Available();
+    if (available == 0)
+    {
+        if (streamEnded)
+        {
+            // Flush the resampler history, the last samples are still in it
+            memset(samples, 0, sizeof(samples));
+            size_t count = Resampler_Process(resampler, samples, RESAMPLER_TAPS, resampled);
+            playerState = PLAYER_IDLE;
+            playerBusy = false;
+            Player_Output(resampled, count);
+            return;
+        }
+        PLAYER_STATE expected = PLAYER_PLAYING;
+        if (playerState.compare_exchange_strong(expected, PLAYER_BUFFERING)) // wait for the watermark again
+        {
+            // The writer may have queued samples or ended the stream since the ring was read as
+            // empty: its Player_CheckWatermark() then saw PLAYING and will not wake the task again
+            if (streamEnded || ring.Available() > 0)
+            {
+                expected = PLAYER_BUFFERING;
+                playerState.compare_exchange_strong(expected, PLAYER_PLAYING);
+            }
+            else
+            {
+                underruns = underruns + 1;
+            }
+        }
+        playerBusy = false;
+        return;
+    }
+
+    size_t count = Resampler_MaxInput(resampler, PLAYER_DMA_BUF_LEN);
+    count = min(min(count, available), (size_t)PLAYER_BLOCK);
+    ring.Read(input, count);
+    if (writerWaiting && ring.Available() <= PLAYER_RING_SIZE / 2)
+    {
+        writerWaiting = false;
+        xSemaphoreGive(spaceEvent);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i] = (int16_t)((input[i] - 128) << 8);
+    }
+    size_t produced = Resampler_Process(resampler, samples, count, resampled);
+    samplesPlayed = samplesPlayed + count;
+    playerBusy = false; // the DMA write below only uses the task's own buffers
+
+    if (!dmaRunning)
+    {
+        i2s_start(PLAYER_PORT);
+        dmaRunning = true;
+    }
+    Player_Output(resampled, produced);
+}
+
+/**
+ * @brief Player task: feeds the DMA while playing, sleeps otherwise.
+ *
+ * i2s_write() blocks until a DMA buffer is free, so the I2S clock paces the task.
+ */
+static void Task_Player(void *arg)
+{
+    for (;;)
+    {
+        playerBusy = true;
+        if (playerState != PLAYER_PLAYING)
+        {
+            playerBusy = false;
+            xSemaphoreGive(idleEvent);
+            Player_Park();
+            xSemaphoreTake(wakeEvent, portMAX_DELAY);
+            continue;
+        }
+        Player_Feed();
+    }
+}
+
+/**
+ * @brief Starts playing once the ring reaches the watermark or the stream has ended.
+ *
+ * Called from the writer. The player task only leaves the BUFFERING state right after entering
+ * it, when samples or the end of the stream arrived in between (see Player_Feed()).
+ */
+static void Player_CheckWatermark()
+{
+    if (playerState != PLAYER_BUFFERING)
+    {
+        return;
+    }
+    size_t fill = ring.Available();
+    if (fill >= playerWatermark || streamEnded)
+    {
+        if (stats.bufferedTime == 0)
+        {
+            stats.bufferedTime = millis() - beginTime;
+        }
+        PLAYER_STATE expected = PLAYER_BUFFERING;
+        if (!playerState.compare_exchange_strong(expected, fill > 0 ? PLAYER_PLAYING : PLAYER_IDLE))
+        {
+            return; // stopped, or resumed by the player task
+        }
+        if (fill > 0)
+        {
+            Trace_Mark(TRACE_PLAYBACK_START, fill);
+        }
+        xSemaphoreGive(wakeEvent);
+    }
+}
+
+/**
+ * @brief Installs the I2S driver on the built-in DAC and starts the player task.
+ *
+ * The DAC runs at PLAYER_OUTPUT_RATE whatever the stream rate, DAC channel 1 (GPIO25) is the
+ * right slot.
+ */
+void Player_Init()
+{
+    i2s_config_t i2s_config = {
+        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN),
+        .sample_rate = PLAYER_OUTPUT_RATE,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_MSB,
+        .intr_alloc_flags = 0,
+        .dma_buf_count = PLAYER_DMA_BUF_COUNT,
+        .dma_buf_len = PLAYER_DMA_BUF_LEN,
+        .use_apll = false,
+        .tx_desc_auto_clear = false
+    };
+    i2s_driver_install(PLAYER_PORT, &i2s_config, 0, NULL);
+    i2s_set_dac_mode(I2S_DAC_CHANNEL_RIGHT_EN);
+    wakeEvent = xSemaphoreCreateBinary();
+    idleEvent = xSemaphoreCreateBinary();
+    doneEvent = xSemaphoreCreateBinary();
+    spaceEvent = xSemaphoreCreateBinary();
+    dmaRunning = true; // parked by the task: the DAC settles at mid-scale
+    xTaskCreatePinnedToCore(Task_Player, "Task_Player", PLAYER_TASK_STACK, NULL, PLAYER_TASK_PRIORITY, NULL, PLAYER_TASK_CORE);
+}
+
+/**
+ * @brief Prepares the engine for a new response stream.
+ *
+ * @param sampleRate Sample rate of the unsigned 8-bit audio that will be written.
+ * @param watermark Number of bytes to buffer before playback starts (capped to the ring size).
+ */
+void Player_Begin(uint32_t sampleRate, size_t watermark)
+{
+    Player_Stop();
+    playerWatermark = min(watermark, (size_t)PLAYER_RING_SIZE);
+    memset(&stats, 0, sizeof(stats));
+    samplesPlayed = 0;
+    underruns = 0;
+    streamEnded = false;
+    writerWaiting = false;
+    xSemaphoreTake(doneEvent, 0);
+    xSemaphoreTake(spaceEvent, 0);
+    Resampler_Init(resampler, sampleRate, PLAYER_OUTPUT_RATE);
+    beginTime = millis();
+    playerState = PLAYER_BUFFERING;
+}
+
+/**
+ * @brief Pushes samples into the ring, waiting for space while the ring is full.
+ *
+ * A full ring puts the task to sleep until the player task has drained it to half.
+ *
+ * @param data Unsigned 8-bit samples.
+ * @param len Number of samples.
+ * @return Number of samples queued (less than `len` only if playback was stopped).
+ */
+size_t Player_Write(const uint8_t *data, size_t len)
+{
+    size_t written = 0;
+    while (written < len)
+    {
+        written += ring.Write(data + written, len - written);
+        stats.maxFill = max(stats.maxFill, ring.Available());
+        Player_CheckWatermark();
+        if (written < len)
+        {
+            if (playerState == PLAYER_IDLE)
+            {
+                break;
+            }
+            writerWaiting = true;
+            if (ring.Free() > 0)
+            {
+                writerWaiting = false; // drained between the write and the flag
+                continue;
+            }
+            xSemaphoreTake(spaceEvent, pdMS_TO_TICKS(50)); // timeout only guards a stop from another task
+        }
+    }
+    return written;
+}
+
+/**
+ * @brief Marks the end of the stream: everything buffered is played, then the engine goes idle.
+ */
+void Player_End()
+{
+    streamEnded = true;
+    Player_CheckWatermark();
+}
+
+/**
+ * @brief Blocks until the buffered audio has reached the DAC.
+ *
+ * Sleeps until the player task has parked the DMA.
+ */
+void Player_WaitDone()
+{
+    while (playerState != PLAYER_IDLE || dmaRunning)
+    {
+        xSemaphoreTake(doneEvent, pdMS_TO_TICKS(100)); // timeout covers a stop from another task
+    }
+    Player_Stop();
+}
+
+/**
+ * @brief Stops playback and discards the buffered audio.
+ *
+ * What is already in the DMA (PLAYER_DMA_BUF_COUNT buffers) still plays.
+ */
+void Player_Stop()
+{
+    playerState = PLAYER_IDLE;
+    if (wakeEvent)
+    {
+        xSemaphoreGive(wakeEvent);
+    }
+    while (playerBusy)
+    {
+        xSemaphoreTake(idleEvent, pdMS_TO_TICKS(10));
+    }
+    ring.Reset();
+}
+
+/**
+ * @brief Stops playback from any task without touching the ring.
+ *
+ * The player task parks the DMA and a writer waiting for space returns early; the writer then
+ * empties the ring with Player_Stop().
+ */
+void Player_Interrupt()
+{
+    playerState = PLAYER_IDLE;
+    xSemaphoreGive(wakeEvent);
+    xSemaphoreGive(spaceEvent);
+}
+
+/**
+ * @brief Checks whether samples are currently being written to the DAC.
+ */
+bool Player_IsPlaying()
+{
+    return playerState == PLAYER_PLAYING;
+}
+
+/**
+ * @brief Checks whether audio is buffered or still in the DMA, Player_WaitDone() would block.
+ */
+bool Player_IsActive()
+{
+    return playerState != PLAYER_IDLE || dmaRunning;
+}
+
+/**
+ * @brief Stream samples handed to the DMA so far, PLAYER_DMA_BUF_COUNT buffers ahead of the DAC.
+ */
+uint32_t Player_Position()
+{
+    return samplesPlayed;
+}
+
+/**
+ * @brief Returns the statistics of the current or last stream.
+ */
+const PlayerStats &Player_GetStats()
+{
+    stats.samplesPlayed = samplesPlayed;
+    stats.underruns = underruns;
+    return stats;
+}
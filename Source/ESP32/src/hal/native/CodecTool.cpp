@@ -0,0 +1,239 @@
+#include "CodecTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Codec.h>
+#include <SampleKernels.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+struct RoundTrip
+{
+    double snrDb;
+    size_t encoded;     // Bytes of the whole stream
+    double encodeUs;    // Per capture block
+    double decodeUs;    // Per response block
+    bool exact;         // Decoded samples equal the input
+    bool splitMatches;  // Odd-sized blocks give the same stream
+};
+
+/**
+ * @brief Encodes the samples in blocks of `blockSamples`, in place as the voice task does.
+ *
+ * @return Host CPU time in microseconds.
+ */
+static uint64_t Tool_Encode(AUDIO_CODEC codec, const std::vector<int16_t> &samples, size_t blockSamples, std::vector<uint8_t> &stream)
+{
+    CodecState state;
+    Codec_Reset(state, codec);
+    std::vector<int16_t> block(blockSamples);
+    stream.clear();
+    uint64_t elapsed = 0;
+    for (size_t pos = 0; pos < samples.size(); pos += blockSamples) {
+        size_t count = samples.size() - pos < blockSamples ? samples.size() - pos : blockSamples;
+        memcpy(block.data(), &samples[pos], count * sizeof(int16_t));
+        uint8_t *bytes = (uint8_t *)block.data();
+        uint64_t start = Hal_Micros();
+        size_t len = Codec_Encode(state, bytes, block.data(), count);
+        elapsed += Hal_Micros() - start;
+        stream.insert(stream.end(), bytes, bytes + len);
+    }
+    uint8_t tail[1];
+    size_t tailLen = Codec_Flush(state, tail);
+    stream.insert(stream.end(), tail, tail + tailLen);
+    return elapsed;
+}
+
+/**
+ * @brief Decodes the stream in RESPONSE_READ_LEN blocks, as Response.cpp does.
+ *
+ * @return Host CPU time in microseconds.
+ */
+static uint64_t Tool_Decode(AUDIO_CODEC codec, const std::vector<uint8_t> &stream, std::vector<int16_t> &samples)
+{
+    CodecState state;
+    Codec_Reset(state, codec);
+    samples.resize(Codec_DecodedSamples(codec, stream.size()) + RESPONSE_READ_LEN);
+    size_t produced = 0;
+    uint64_t elapsed = 0;
+    for (size_t pos = 0; pos < stream.size(); pos += RESPONSE_READ_LEN) {
+        size_t len = stream.size() - pos < RESPONSE_READ_LEN ? stream.size() - pos : RESPONSE_READ_LEN;
+        uint64_t start = Hal_Micros();
+        produced += Codec_Decode(state, samples.data() + produced, &stream[pos], len);
+        elapsed += Hal_Micros() - start;
+    }
+    samples.resize(produced);
+    return elapsed;
+}
+
+static RoundTrip Tool_RoundTrip(AUDIO_CODEC codec, const std::vector<int16_t> &samples)
+{
+    const size_t blockSamples = I2S_READ_LEN / 2;
+    std::vector<uint8_t> stream, split;
+    std::vector<int16_t> decoded;
+    RoundTrip result;
+    uint64_t encodeUs = Tool_Encode(codec, samples, blockSamples, stream);
+    uint64_t decodeUs = Tool_Decode(codec, stream, decoded);
+    Tool_Encode(codec, samples, CODEC_ODD_BLOCK, split);
+
+    double signal = 0.0, noise = 0.0;
+    result.exact = decoded.size() >= samples.size();
+    for (size_t i = 0; i < samples.size() && i < decoded.size(); i++) {
+        double error = (double)decoded[i] - samples[i];
+        signal += (double)samples[i] * samples[i];
+        noise += error * error;
+        result.exact = result.exact && decoded[i] == samples[i];
+    }
+    size_t blocks = (samples.size() + blockSamples - 1) / blockSamples;
+    size_t responseBlocks = (stream.size() + RESPONSE_READ_LEN - 1) / RESPONSE_READ_LEN;
+    result.snrDb = noise > 0.0 ? 10.0 * log10(signal / noise) : 200.0;
+    result.encoded = stream.size();
+    result.encodeUs = blocks ? (double)encodeUs / blocks : 0.0;
+    result.decodeUs = responseBlocks ? (double)decodeUs / responseBlocks : 0.0;
+    result.splitMatches = split == stream;
+    return result;
+}
+
+static double Tool_Level(const std::vector<int16_t> &samples)
+{
+    double sum = 0.0;
+    for (int16_t s : samples) {
+        sum += (double)s * s;
+    }
+    return samples.empty() || sum == 0.0 ? -200.0 : 10.0 * log10(sum / samples.size() / (32767.0 * 32767.0));
+}
+
+/**
+ * @brief Runs every codec over one signal and prints a line per codec.
+ *
+ * @return false if a codec fails its check.
+ */
+static bool Tool_Report(const char *name, const std::vector<int16_t> &samples)
+{
+    static const AUDIO_CODEC codecs[] = {CODEC_PCM, CODEC_MULAW, CODEC_IMA_ADPCM};
+    double level = Tool_Level(samples);
+    bool checked = level >= CODEC_CHECK_MIN_DBFS;
+    printf("%s (%.1f dBFS RMS, %u samples)%s\n", name, level, (unsigned)samples.size(), checked ? "" : ", only reported");
+    bool passed = true;
+    for (AUDIO_CODEC codec : codecs) {
+        RoundTrip result = Tool_RoundTrip(codec, samples);
+        bool ok = result.splitMatches;
+        if (codec == CODEC_PCM) {
+            ok = ok && result.exact;
+        } else if (checked) {
+            ok = ok && result.snrDb >= (codec == CODEC_MULAW ? CODEC_MIN_SNR_MULAW_DB : CODEC_MIN_SNR_ADPCM_DB);
+        }
+        printf("  %-10s SNR %6.1f dB%s, %4.1f:1, encode %6.1f us per %u ms block, decode %5.2f us per %u bytes%s%s\n",
+               Codec_ToString(codec), result.snrDb, result.exact ? " (exact)" : "",
+               result.encoded ? samples.size() * 2.0 / result.encoded : 0.0,
+               result.encodeUs, (unsigned)(I2S_READ_LEN / 2 * 1000 / I2S_SAMPLE_RATE), result.decodeUs, (unsigned)RESPONSE_READ_LEN,
+               result.splitMatches ? "" : ", odd blocks differ", ok ? "" : "  FAIL");
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+static std::vector<int16_t> Tool_Tone(double hz, double dbfs, double seconds)
+{
+    std::vector<int16_t> samples((size_t)(seconds * I2S_SAMPLE_RATE));
+    double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = (int16_t)lrint(amplitude * sin(2.0 * M_PI * hz * i / I2S_SAMPLE_RATE));
+    }
+    return samples;
+}
+
+static std::vector<int16_t> Tool_Noise(double dbfs, double seconds)
+{
+    std::vector<int16_t> samples((size_t)(seconds * I2S_SAMPLE_RATE));
+    double amplitude = 32767.0 * pow(10.0, dbfs / 20.0) * sqrt(3.0); // uniform noise of that RMS
+    srand(1);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = (int16_t)lrint(amplitude * (2.0 * rand() / RAND_MAX - 1.0));
+    }
+    return samples;
+}
+
+static std::vector<int16_t> Tool_Sweep(double dbfs, double seconds)
+{
+    std::vector<int16_t> samples((size_t)(seconds * I2S_SAMPLE_RATE));
+    double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+    double low = 100.0, high = I2S_SAMPLE_RATE * 0.45, phase = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        double hz = low * pow(high / low, (double)i / samples.size());
+        phase += 2.0 * M_PI * hz / I2S_SAMPLE_RATE;
+        samples[i] = (int16_t)lrint(amplitude * sin(phase));
+    }
+    return samples;
+}
+
+/**
+ * @brief Reads a WAV file through the device sample path: raw I2S layout, then Kernel_DacScale<3>.
+ */
+static bool Tool_LoadSamples(const char *path, std::vector<int16_t> &samples)
+{
+    WavMicrophone microphone;
+    if (!microphone.Load(path)) {
+        return false;
+    }
+    microphone.SetRealtime(false);
+    microphone.Begin();
+    alignas(4) uint8_t block[I2S_READ_LEN];
+    samples.clear();
+    while (!microphone.Exhausted()) {
+        size_t len = microphone.Read(block, sizeof(block));
+        Kernel_DacScale<3>(block, block, len);
+        const int16_t *pcm = (const int16_t *)block;
+        samples.insert(samples.end(), pcm, pcm + len / 2);
+    }
+    return true;
+}
+
+/**
+ * @brief Entry point of `program codec ...`, argv[0] is "codec".
+ */
+int CodecTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    double seconds = 2.0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: codec [--seconds N] [file.wav]\n");
+            return 2;
+        }
+    }
+    if (seconds <= 0.0) {
+        fprintf(stderr, "Usage: codec [--seconds N] [file.wav]\n");
+        return 2;
+    }
+
+    bool passed = true;
+    if (path) {
+        std::vector<int16_t> samples;
+        if (!Tool_LoadSamples(path, samples)) {
+            fprintf(stderr, "%s: cannot read\n", path);
+            return 2;
+        }
+        passed = Tool_Report(path, samples);
+    } else {
+        const double levels[] = {-6.0, -30.0, -50.0};
+        char name[32];
+        for (double level : levels) {
+            snprintf(name, sizeof(name), "tone 1000 Hz %3.0f dB", level);
+            passed = Tool_Report(name, Tool_Tone(1000.0, level, seconds)) && passed;
+        }
+        passed = Tool_Report("tone 5000 Hz  -6 dB", Tool_Tone(5000.0, -6.0, seconds)) && passed;
+        passed = Tool_Report("noise -20 dB", Tool_Noise(-20.0, seconds)) && passed;
+        passed = Tool_Report("sweep -12 dB", Tool_Sweep(-12.0, seconds)) && passed;
+    }
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
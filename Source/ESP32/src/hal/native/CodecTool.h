@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+Codec check (host):
+    program codec [--seconds N] [file.wav]
+        Runs every audio codec of the wire (Codec.h: pcm, mulaw, ima-adpcm) over a round trip: the
+        signal is encoded in place in capture blocks (I2S_READ_LEN) as the voice task does, then
+        decoded in RESPONSE_READ_LEN blocks as the response stream does. Reports per codec and signal
+        the signal-to-noise ratio of the decoded samples, the compression ratio and the host CPU time
+        of each direction per block. The same signal is also encoded in odd-sized blocks (as the VAD
+        cuts them), which must give the same bytes as the capture blocks.
+        Without a file the signals are tones at several levels, white noise and a sweep, N seconds
+        each (default 2); a file is read through the device sample path (as KwsTool.h).
+        Exits with 1 if PCM is not bit-exact, a codec is below its minimum SNR on a signal above
+        CODEC_CHECK_MIN_DBFS, or the odd-sized blocks give another stream.
+*/
+
+#define CODEC_MIN_SNR_MULAW_DB 30.0
+#define CODEC_MIN_SNR_ADPCM_DB 12.0  // Worst on white noise and high tones, speech reaches about 30
+#define CODEC_CHECK_MIN_DBFS -40.0   // Quieter signals are only reported
+#define CODEC_ODD_BLOCK 1001         // Samples per block of the odd-sized encoding
+
+int CodecTool_Main(int argc, char **argv);
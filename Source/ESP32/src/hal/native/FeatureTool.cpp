@@ -0,0 +1,377 @@
+#include "FeatureTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Codec.h>
+#include <Features.h>
+#include <SampleKernels.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define TOOL_DB_PER_LOG2 3.0103  // 10 log10(2)
+
+struct Reference
+{
+    double window[FEATURE_FRAME_LEN];
+    double cosine[FEATURE_FRAME_LEN];          // cos(2 pi i / FEATURE_FRAME_LEN)
+    int edge[FEATURE_MEL_BANDS + 2];           // FFT bin of the band edges
+};
+
+struct CheckResult
+{
+    double snrDb;          // Magnitude spectrum against its error
+    double maxErrorDb;     // Log-mel bands
+    double meanErrorDb;
+    double maxCodeErrorDb; // CODEC_LOGMEL8 codes
+    uint32_t checked;      // Bands within FEATURE_CHECK_RANGE_DB and above 0 dB
+};
+
+static float Tool_HzToMel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float Tool_MelToHz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+/**
+ * @brief Builds the reference window and the band edges, placed as Features.cpp places them.
+ */
+static void Tool_InitReference(Reference &ref)
+{
+    for (int i = 0; i < FEATURE_FRAME_LEN; i++) {
+        ref.window[i] = 0.54 - 0.46 * cos(2.0 * M_PI * i / (FEATURE_FRAME_LEN - 1));
+        ref.cosine[i] = cos(2.0 * M_PI * i / FEATURE_FRAME_LEN);
+    }
+    float low = Tool_HzToMel(FEATURE_LOW_HZ);
+    float high = Tool_HzToMel(FEATURE_HIGH_HZ < I2S_SAMPLE_RATE / 2 ? FEATURE_HIGH_HZ : I2S_SAMPLE_RATE / 2);
+    for (int b = 0; b < FEATURE_MEL_BANDS + 2; b++) {
+        float hz = Tool_MelToHz(low + (high - low) * b / (FEATURE_MEL_BANDS + 1));
+        int bin = (int)lrintf(hz * FEATURE_FRAME_LEN / I2S_SAMPLE_RATE);
+        if (b > 0 && bin <= ref.edge[b - 1]) {
+            bin = ref.edge[b - 1] + 1;
+        }
+        ref.edge[b] = bin < FEATURE_BINS ? bin : FEATURE_BINS - 1;
+    }
+}
+
+/**
+ * @brief Reference power spectrum (DFT in double) and log-mel bands (dB) of a frame.
+ */
+static void Tool_Reference(const Reference &ref, const int16_t *frame, double *power, double *logMelDb)
+{
+    double x[FEATURE_FRAME_LEN];
+    for (int i = 0; i < FEATURE_FRAME_LEN; i++) {
+        x[i] = frame[i] * ref.window[i];
+    }
+    for (int k = 0; k < FEATURE_BINS; k++) {
+        double sumRe = 0.0, sumIm = 0.0;
+        for (int i = 0; i < FEATURE_FRAME_LEN; i++) {
+            int phase = (k * i) & (FEATURE_FRAME_LEN - 1);
+            sumRe += x[i] * ref.cosine[phase];
+            sumIm -= x[i] * ref.cosine[(phase + FEATURE_FRAME_LEN * 3 / 4) & (FEATURE_FRAME_LEN - 1)]; // sin
+        }
+        power[k] = sumRe * sumRe + sumIm * sumIm;
+    }
+    double band[FEATURE_MEL_BANDS + 1] = {0.0};
+    for (int b = 0; b < FEATURE_MEL_BANDS + 1; b++) {
+        int span = ref.edge[b + 1] - ref.edge[b];
+        for (int k = ref.edge[b]; k < ref.edge[b + 1]; k++) {
+            double rising = (double)(k - ref.edge[b]) / (span > 0 ? span : 1);
+            band[b] += power[k] * rising;
+            if (b > 0) {
+                band[b - 1] += power[k] * (1.0 - rising);
+            }
+        }
+    }
+    for (int b = 0; b < FEATURE_MEL_BANDS; b++) {
+        logMelDb[b] = 10.0 * log10(band[b] + 1e-9);
+    }
+}
+
+/**
+ * @brief Cuts pre-emphasized frames every FEATURE_HOP samples, as Features_Process() does.
+ */
+static void Tool_Frames(const std::vector<int16_t> &samples, std::vector<int16_t> &frames)
+{
+    std::vector<int16_t> emphasized(samples.size());
+    int32_t last = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        int32_t y = samples[i] - ((last * 31) >> 5);
+        last = samples[i];
+        emphasized[i] = (int16_t)(y > 32767 ? 32767 : (y < -32768 ? -32768 : y));
+    }
+    frames.clear();
+    for (size_t start = 0; start + FEATURE_FRAME_LEN <= emphasized.size(); start += FEATURE_HOP) {
+        frames.insert(frames.end(), emphasized.begin() + start, emphasized.begin() + start + FEATURE_FRAME_LEN);
+    }
+}
+
+/**
+ * @brief Runs the fixed-point kernels and the reference over the frames of a signal.
+ */
+static CheckResult Tool_Check(const Reference &ref, const std::vector<int16_t> &samples)
+{
+    std::vector<int16_t> frames;
+    Tool_Frames(samples, frames);
+    CheckResult result = {200.0, 0.0, 0.0, 0.0, 0};
+    double signal = 0.0, noise = 0.0, errorSum = 0.0;
+    static uint64_t power[FEATURE_BINS];
+    double refPower[FEATURE_BINS];
+    double refDb[FEATURE_MEL_BANDS];
+    int16_t logMel[FEATURE_MEL_BANDS];
+    for (size_t pos = 0; pos < frames.size(); pos += FEATURE_FRAME_LEN) {
+        const int16_t *frame = &frames[pos];
+        int32_t scale = Features_PowerSpectrum(frame, power);
+        Features_MelBands(power, scale, logMel);
+        Tool_Reference(ref, frame, refPower, refDb);
+
+        double unscale = ldexp(1.0, -scale);
+        for (int k = 0; k < FEATURE_BINS; k++) {
+            double expected = sqrt(refPower[k]);
+            double error = sqrt(power[k] * unscale) - expected;
+            signal += expected * expected;
+            noise += error * error;
+        }
+        double loudest = refDb[0];
+        for (int b = 1; b < FEATURE_MEL_BANDS; b++) {
+            loudest = refDb[b] > loudest ? refDb[b] : loudest;
+        }
+        for (int b = 0; b < FEATURE_MEL_BANDS; b++) {
+            if (refDb[b] < loudest - FEATURE_CHECK_RANGE_DB || refDb[b] < 0.0) {
+                continue; // leakage, or below one LSB of amplitude (silence)
+            }
+            double error = fabs(logMel[b] / 256.0 * TOOL_DB_PER_LOG2 - refDb[b]);
+            int32_t code = (logMel[b] - CODEC_LOGMEL8_FLOOR + CODEC_LOGMEL8_STEP / 2) / CODEC_LOGMEL8_STEP;
+            code = logMel[b] < CODEC_LOGMEL8_FLOOR ? 0 : (code > 255 ? 255 : code);
+            double decoded = (CODEC_LOGMEL8_FLOOR + code * CODEC_LOGMEL8_STEP) / 256.0 * TOOL_DB_PER_LOG2;
+            double codeError = fabs(decoded - refDb[b]);
+            result.maxErrorDb = error > result.maxErrorDb ? error : result.maxErrorDb;
+            result.maxCodeErrorDb = codeError > result.maxCodeErrorDb ? codeError : result.maxCodeErrorDb;
+            errorSum += error;
+            result.checked++;
+        }
+    }
+    result.snrDb = noise > 0.0 ? 10.0 * log10(signal / noise) : 200.0;
+    result.meanErrorDb = result.checked ? errorSum / result.checked : 0.0;
+    return result;
+}
+
+/**
+ * @brief Checks one signal and prints its line.
+ *
+ * @return false if it is outside the limits.
+ */
+static bool Tool_Report(const Reference &ref, const char *name, const std::vector<int16_t> &samples)
+{
+    CheckResult result = Tool_Check(ref, samples);
+    bool ok = result.snrDb >= FEATURE_MIN_SPECTRUM_SNR_DB && result.maxErrorDb <= FEATURE_MAX_ERROR_DB &&
+              result.maxCodeErrorDb <= FEATURE_MAX_CODE_ERROR_DB;
+    printf("  %-18s spectrum SNR %6.1f dB, log-mel error max %5.3f mean %5.3f dB, 8-bit max %5.3f dB (%u bands)%s\n", name,
+           result.snrDb, result.maxErrorDb, result.meanErrorDb, result.maxCodeErrorDb, (unsigned)result.checked,
+           ok ? "" : "  FAIL");
+    return ok;
+}
+
+static std::vector<int16_t> Tool_Tone(double hz, double dbfs, double seconds)
+{
+    std::vector<int16_t> samples((size_t)(seconds * I2S_SAMPLE_RATE));
+    double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = (int16_t)lrint(amplitude * sin(2.0 * M_PI * hz * i / I2S_SAMPLE_RATE));
+    }
+    return samples;
+}
+
+static std::vector<int16_t> Tool_Noise(double dbfs, double seconds)
+{
+    std::vector<int16_t> samples((size_t)(seconds * I2S_SAMPLE_RATE));
+    double amplitude = 32767.0 * pow(10.0, dbfs / 20.0) * sqrt(3.0); // uniform noise of that RMS
+    srand(1);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = (int16_t)lrint(amplitude * (2.0 * rand() / RAND_MAX - 1.0));
+    }
+    return samples;
+}
+
+static std::vector<int16_t> Tool_Sweep(double dbfs, double seconds)
+{
+    std::vector<int16_t> samples((size_t)(seconds * I2S_SAMPLE_RATE));
+    double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+    double low = 100.0, high = I2S_SAMPLE_RATE * 0.45, phase = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        double hz = low * pow(high / low, (double)i / samples.size());
+        phase += 2.0 * M_PI * hz / I2S_SAMPLE_RATE;
+        samples[i] = (int16_t)lrint(amplitude * sin(phase));
+    }
+    return samples;
+}
+
+/**
+ * @brief Reads a WAV file through the device sample path: raw I2S layout, then Kernel_DacScale<3>.
+ */
+static bool Tool_LoadSamples(const char *path, std::vector<int16_t> &samples)
+{
+    WavMicrophone microphone;
+    if (!microphone.Load(path)) {
+        return false;
+    }
+    microphone.SetRealtime(false);
+    microphone.Begin();
+    alignas(4) uint8_t block[I2S_READ_LEN];
+    samples.clear();
+    while (!microphone.Exhausted()) {
+        size_t len = microphone.Read(block, sizeof(block));
+        Kernel_DacScale<3>(block, block, len);
+        const int16_t *pcm = (const int16_t *)block;
+        samples.insert(samples.end(), pcm, pcm + len / 2);
+    }
+    return true;
+}
+
+static void Tool_CountFrame(const FeatureFrame &, void *context)
+{
+    (*(uint32_t *)context)++;
+}
+
+/**
+ * @brief Encodes the samples in capture blocks, as the voice task does.
+ *
+ * @return Host CPU time in microseconds.
+ */
+static uint64_t Tool_Encode(AUDIO_CODEC codec, const std::vector<int16_t> &samples, size_t &encoded)
+{
+    CodecState state;
+    Codec_Reset(state, codec);
+    alignas(4) uint8_t block[I2S_READ_LEN];
+    const size_t blockSamples = I2S_READ_LEN / 2;
+    encoded = 0;
+    uint64_t elapsed = 0;
+    for (size_t pos = 0; pos < samples.size(); pos += blockSamples) {
+        size_t count = samples.size() - pos < blockSamples ? samples.size() - pos : blockSamples;
+        memcpy(block, &samples[pos], count * sizeof(int16_t));
+        uint64_t start = Hal_Micros();
+        encoded += Codec_Encode(state, block, (const int16_t *)block, count);
+        elapsed += Hal_Micros() - start;
+    }
+    return elapsed;
+}
+
+static void Tool_PrintRate(const char *name, uint32_t frames, uint64_t us)
+{
+    double perSecond = us > 0 ? frames * 1e6 / us : 0.0;
+    double needed = (double)I2S_SAMPLE_RATE / FEATURE_HOP;
+    printf("  %-24s %9.0f frames/s (%.1f us/frame, %.0fx real time)\n", name, perSecond,
+           frames ? (double)us / frames : 0.0, perSecond / needed);
+}
+
+/**
+ * @brief Measures the kernels, the front end and the encoders over noise.
+ */
+static void Tool_Benchmark(double seconds)
+{
+    std::vector<int16_t> samples = Tool_Noise(-20.0, seconds);
+    std::vector<int16_t> frames;
+    Tool_Frames(samples, frames);
+    uint32_t frameCount = (uint32_t)(frames.size() / FEATURE_FRAME_LEN);
+    std::vector<uint64_t> powers((size_t)frameCount * FEATURE_BINS);
+    std::vector<int32_t> scales(frameCount);
+    int16_t logMel[FEATURE_MEL_BANDS];
+
+    printf("Throughput (%.0f s of noise, %u frames, %.1f frames/s needed):\n", seconds, (unsigned)frameCount,
+           (double)I2S_SAMPLE_RATE / FEATURE_HOP);
+    uint64_t start = Hal_Micros();
+    for (uint32_t f = 0; f < frameCount; f++) {
+        scales[f] = Features_PowerSpectrum(&frames[(size_t)f * FEATURE_FRAME_LEN], &powers[(size_t)f * FEATURE_BINS]);
+    }
+    Tool_PrintRate("real FFT (power)", frameCount, Hal_Micros() - start);
+    int32_t checksum = 0;
+    start = Hal_Micros();
+    for (uint32_t f = 0; f < frameCount; f++) {
+        Features_MelBands(&powers[(size_t)f * FEATURE_BINS], scales[f], logMel);
+        checksum += logMel[f % FEATURE_MEL_BANDS];
+    }
+    Tool_PrintRate("mel filterbank + log", frameCount, Hal_Micros() - start);
+
+    FeatureState state;
+    Features_Init(state, I2S_SAMPLE_RATE);
+    uint32_t processed = 0;
+    start = Hal_Micros();
+    Features_Process(state, samples.data(), samples.size(), Tool_CountFrame, &processed);
+    Tool_PrintRate("front end (+MFCC)", processed, Hal_Micros() - start);
+
+    printf("Upload size:\n");
+    const AUDIO_CODEC codecs[] = {CODEC_PCM, CODEC_IMA_ADPCM, CODEC_LOGMEL, CODEC_LOGMEL8};
+    for (AUDIO_CODEC codec : codecs) {
+        size_t encoded = 0;
+        uint64_t us = Tool_Encode(codec, samples, encoded);
+        printf("  %-10s %7.0f bytes/s (%5.1fx smaller than PCM), encoder %6.1f us per %u ms block\n", Codec_ToString(codec),
+               encoded / seconds, encoded ? samples.size() * 2.0 / encoded : 0.0,
+               us * (double)I2S_READ_LEN / 2 / samples.size(), (unsigned)(I2S_READ_LEN / 2 * 1000 / I2S_SAMPLE_RATE));
+    }
+    if (checksum == 1) {
+        printf("\n"); // keeps the filterbank loop from being optimized out
+    }
+}
+
+/**
+ * @brief Entry point of `program features ...`, argv[0] is "features".
+ */
+int FeatureTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    double seconds = 10.0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: features [--seconds N] [file.wav]\n");
+            return 2;
+        }
+    }
+    if (seconds <= 0.0) {
+        fprintf(stderr, "Usage: features [--seconds N] [file.wav]\n");
+        return 2;
+    }
+
+    FeatureState state;
+    Features_Init(state, I2S_SAMPLE_RATE); // builds the tables of the kernels
+    static Reference ref;
+    Tool_InitReference(ref);
+    printf("%d-point real FFT, %d mel bands (%d-%d Hz), hop %d samples\n", FEATURE_FRAME_LEN, FEATURE_MEL_BANDS,
+           FEATURE_LOW_HZ, FEATURE_HIGH_HZ, FEATURE_HOP);
+    printf("Agreement with the double precision reference (bands within %.0f dB of the loudest):\n", FEATURE_CHECK_RANGE_DB);
+    bool passed = true;
+    if (path) {
+        std::vector<int16_t> samples;
+        if (!Tool_LoadSamples(path, samples)) {
+            fprintf(stderr, "%s: cannot read\n", path);
+            return 2;
+        }
+        passed = Tool_Report(ref, path, samples);
+    } else {
+        const double tones[] = {250.0, 1000.0, 4000.0};
+        const double levels[] = {-6.0, -40.0};
+        char name[32];
+        for (double level : levels) {
+            for (double hz : tones) {
+                snprintf(name, sizeof(name), "tone %4.0f Hz %3.0f dB", hz, level);
+                passed = Tool_Report(ref, name, Tool_Tone(hz, level, 1.0)) && passed;
+            }
+        }
+        passed = Tool_Report(ref, "noise -20 dB", Tool_Noise(-20.0, 1.0)) && passed;
+        passed = Tool_Report(ref, "noise -60 dB", Tool_Noise(-60.0, 1.0)) && passed;
+        passed = Tool_Report(ref, "sweep -12 dB", Tool_Sweep(-12.0, 2.0)) && passed;
+    }
+    Tool_Benchmark(seconds);
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+Log-mel front end check (host):
+    program features [--seconds N] [file.wav]
+        Compares the fixed-point kernels of Features.h with a double precision reference of the same
+        front end (Hamming window, DFT, the same triangular mel bands, log) on the same pre-emphasized
+        frames, and reports per signal: the signal-to-error ratio of the magnitude spectrum
+        (Features_PowerSpectrum), the largest and mean error of the log-mel bands
+        (Features_MelBands) and of their 8-bit codes (CODEC_LOGMEL8), in dB. Only the bands within
+        FEATURE_CHECK_RANGE_DB of the loudest band of their frame and above one LSB of amplitude
+        (0 dB, the CODEC_LOGMEL8 floor) are checked: further down, the window leakage of the
+        reference is below the 15-bit resolution of the fixed-point frame, and silent frames have
+        no reference value.
+        Without a file the signals are tones at several levels, white noise and a sweep; a file is
+        read through the device sample path (as KwsTool.h).
+        Then the throughput of each kernel, of the whole front end (Features_Process) and of the
+        upload encoder is measured in frames per second of host CPU, against the FEATURE_HOP frame
+        rate of the microphone, over N seconds of noise (default 10), with the upload size of each
+        codec. Exits with 1 if a signal is below FEATURE_MIN_SPECTRUM_SNR_DB or a checked band is
+        off by more than FEATURE_MAX_ERROR_DB (FEATURE_MAX_CODE_ERROR_DB for the 8-bit codes).
+*/
+
+#define FEATURE_CHECK_RANGE_DB 50.0
+#define FEATURE_MIN_SPECTRUM_SNR_DB 50.0
+#define FEATURE_MAX_ERROR_DB 0.25
+#define FEATURE_MAX_CODE_ERROR_DB 0.5   // FEATURE_MAX_ERROR_DB and half a code step (0.28 dB)
+
+int FeatureTool_Main(int argc, char **argv);
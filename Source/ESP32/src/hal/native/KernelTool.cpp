@@ -0,0 +1,202 @@
+#include "KernelTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Codec.h>
+#include <SampleKernels.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @brief The former recording scale of main.cpp, byte by byte (low 12 bits * 256 / 2048 in the high byte).
+ */
+static void Legacy_DacScale(uint8_t *d_buff, const uint8_t *s_buff, uint32_t len)
+{
+    uint32_t j = 0;
+    uint32_t dac_value = 0;
+    for (uint32_t i = 0; i < len; i += 2)
+    {
+        dac_value = ((((uint16_t)(s_buff[i + 1] & 0xF) << 8) | ((s_buff[i]))));
+        d_buff[j++] = 0;
+        d_buff[j++] = dac_value * 256 / 2048;
+    }
+}
+
+/**
+ * @brief Per-sample signed 16-bit to unsigned 8-bit DAC value.
+ */
+static void Reference_Pcm16ToDac(uint8_t *dst, const int16_t *src, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = (uint8_t)(((uint16_t)src[i] >> 8) ^ 0x80);
+    }
+}
+
+/**
+ * @brief Per-sample mu-law decode, then the high byte as a DAC value.
+ */
+static void Reference_MulawToDac(uint8_t *dst, const uint8_t *src, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = (uint8_t)(((uint16_t)Codec_MulawDecodeSample(src[i]) >> 8) ^ 0x80);
+    }
+}
+
+/**
+ * @brief Compares two outputs and prints the first difference.
+ */
+static bool Tool_Same(const char *name, const uint8_t *actual, const uint8_t *expected, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (actual[i] != expected[i]) {
+            printf("  %-20s differs at byte %u: %02x instead of %02x  FAIL\n", name, (unsigned)i, actual[i], expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Runs Kernel_DacScale<3> and Kernel_Pcm16ToDac over every 16-bit value and the mu-law
+ *        kernel over every code, for each tail length.
+ */
+static bool Tool_CheckExact()
+{
+    const size_t values = 65536;
+    std::vector<uint16_t> input(values);
+    for (size_t i = 0; i < values; i++) {
+        input[i] = (uint16_t)i;
+    }
+    std::vector<uint16_t> expected16(values), output16(values), inPlace16(values);
+    std::vector<uint8_t> expected8(values), output8(values), inPlace8(values);
+    bool passed = true;
+
+    // Whole words, then an odd sample count: the last sample is a half word
+    const size_t counts[] = {values, values - 1, values - 3};
+    for (size_t count : counts) {
+        size_t len = count * 2;
+        Legacy_DacScale((uint8_t *)expected16.data(), (const uint8_t *)input.data(), (uint32_t)len);
+        Kernel_DacScale<3>((uint8_t *)output16.data(), (const uint8_t *)input.data(), len);
+        inPlace16 = input;
+        Kernel_DacScale<3>((uint8_t *)inPlace16.data(), (const uint8_t *)inPlace16.data(), len);
+        passed = Tool_Same("Kernel_DacScale<3>", (const uint8_t *)output16.data(), (const uint8_t *)expected16.data(), len) && passed;
+        passed = Tool_Same("Kernel_DacScale<3> (in place)", (const uint8_t *)inPlace16.data(), (const uint8_t *)expected16.data(), len) && passed;
+    }
+
+    // Four samples per iteration: every remainder of the tail loop
+    for (size_t tail = 0; tail < 4; tail++) {
+        size_t count = values - tail;
+        Reference_Pcm16ToDac(expected8.data(), (const int16_t *)input.data(), count);
+        Kernel_Pcm16ToDac(output8.data(), (const int16_t *)input.data(), count);
+        inPlace16 = input;
+        Kernel_Pcm16ToDac((uint8_t *)inPlace16.data(), (const int16_t *)inPlace16.data(), count);
+        passed = Tool_Same("Kernel_Pcm16ToDac", output8.data(), expected8.data(), count) && passed;
+        passed = Tool_Same("Kernel_Pcm16ToDac (in place)", (const uint8_t *)inPlace16.data(), expected8.data(), count) && passed;
+    }
+
+    uint8_t codes[256], mulawExpected[256], mulawOutput[256];
+    for (int i = 0; i < 256; i++) {
+        codes[i] = (uint8_t)i;
+    }
+    Reference_MulawToDac(mulawExpected, codes, 256);
+    Kernel_MulawToDac(mulawOutput, codes, 256);
+    passed = Tool_Same("Kernel_MulawToDac", mulawOutput, mulawExpected, 256) && passed;
+    Kernel_MulawToDac(codes, codes, 256);
+    passed = Tool_Same("Kernel_MulawToDac (in place)", codes, mulawExpected, 256) && passed;
+
+    printf("Bit-exact: DacScale<3> over %u values, Pcm16ToDac over %u values, MulawToDac over 256 codes%s\n",
+           (unsigned)values, (unsigned)values, passed ? "" : "  FAIL");
+    return passed;
+}
+
+typedef void (*BlockKernel)(uint8_t *buffer, size_t len);
+
+static void Block_DacScale(uint8_t *buffer, size_t len) { Kernel_DacScale<3>(buffer, buffer, len); }
+static void Block_LegacyDacScale(uint8_t *buffer, size_t len) { Legacy_DacScale(buffer, buffer, (uint32_t)len); }
+static void Block_Pcm16ToDac(uint8_t *buffer, size_t len) { Kernel_Pcm16ToDac(buffer, (const int16_t *)buffer, len / 2); }
+static void Block_ReferencePcm16ToDac(uint8_t *buffer, size_t len) { Reference_Pcm16ToDac(buffer, (const int16_t *)buffer, len / 2); }
+static void Block_MulawToDac(uint8_t *buffer, size_t len) { Kernel_MulawToDac(buffer, buffer, len); }
+static void Block_ReferenceMulawToDac(uint8_t *buffer, size_t len) { Reference_MulawToDac(buffer, buffer, len); }
+
+struct KernelRun
+{
+    const char *name;
+    BlockKernel kernel;
+    BlockKernel reference;
+    size_t bytesPerSample;  // Input bytes of one sample
+};
+
+/**
+ * @brief Runs a kernel over KERNEL_TOOL_BLOCK blocks for about `seconds`.
+ *
+ * @return Microseconds per block.
+ */
+static double Tool_Time(BlockKernel kernel, double seconds, uint32_t &checksum)
+{
+    alignas(4) static uint8_t pristine[KERNEL_TOOL_BLOCK];
+    alignas(4) static uint8_t block[KERNEL_TOOL_BLOCK];
+    srand(1);
+    for (size_t i = 0; i < sizeof(pristine); i++) {
+        pristine[i] = (uint8_t)rand();
+    }
+    uint64_t budget = (uint64_t)(seconds * 1e6);
+    uint64_t elapsed = 0;
+    uint32_t calls = 0;
+    while (elapsed < budget || calls == 0) {
+        memcpy(block, pristine, sizeof(block)); // in place: every call starts from raw input
+        uint64_t start = Hal_Micros();
+        kernel(block, sizeof(block));
+        elapsed += Hal_Micros() - start;
+        checksum += block[calls % sizeof(block)];
+        calls++;
+    }
+    return (double)elapsed / calls;
+}
+
+/**
+ * @brief Entry point of `program kernels ...`, argv[0] is "kernels".
+ */
+int KernelTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    double seconds = 1.0;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: kernels [--seconds N]\n");
+            return 2;
+        }
+    }
+    if (seconds <= 0.0) {
+        fprintf(stderr, "Usage: kernels [--seconds N]\n");
+        return 2;
+    }
+
+    bool passed = Tool_CheckExact();
+
+    static const KernelRun runs[] = {
+        {"DacScale<3>", Block_DacScale, Block_LegacyDacScale, 2},
+        {"Pcm16ToDac", Block_Pcm16ToDac, Block_ReferencePcm16ToDac, 2},
+        {"MulawToDac", Block_MulawToDac, Block_ReferenceMulawToDac, 1},
+    };
+    printf("Throughput (%u-byte blocks, in place):\n", (unsigned)KERNEL_TOOL_BLOCK);
+    printf("  %-12s %14s %10s %14s %10s %8s\n", "kernel", "samples/s", "us/block", "per-sample", "us/block", "speedup");
+    uint32_t checksum = 0;
+    for (const KernelRun &run : runs) {
+        double kernelUs = Tool_Time(run.kernel, seconds / 2, checksum);
+        double referenceUs = Tool_Time(run.reference, seconds / 2, checksum);
+        double samples = (double)KERNEL_TOOL_BLOCK / run.bytesPerSample;
+        printf("  %-12s %14.0f %10.2f %14.0f %10.2f %7.1fx\n", run.name,
+               kernelUs > 0.0 ? samples * 1e6 / kernelUs : 0.0, kernelUs,
+               referenceUs > 0.0 ? samples * 1e6 / referenceUs : 0.0, referenceUs,
+               kernelUs > 0.0 ? referenceUs / kernelUs : 0.0);
+    }
+    if (checksum == 1) {
+        printf("\n"); // keeps the timed loops from being optimized out
+    }
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+Sample kernel check (host):
+    program kernels [--seconds N]
+        Checks every kernel of SampleKernels.h against the per-sample formula it replaces, over all
+        inputs: Kernel_DacScale<3> against the former byte-wise I2S_DACScale for the 2^16 sample
+        values, Kernel_Pcm16ToDac against a per-sample high byte for the 2^16 values, and
+        Kernel_MulawToDac against Codec_MulawDecodeSample() for the 256 codes. Each is run in place
+        and into another buffer, with lengths that leave a partial word at the end.
+        Then the throughput of each kernel and of its per-sample formula is measured over I2S_READ_LEN
+        blocks for about N seconds each (default 1), in samples per second of host CPU and
+        microseconds per block. Exits with 1 if an output differs.
+*/
+
+#define KERNEL_TOOL_BLOCK I2S_READ_LEN  // Bytes per call in the throughput runs
+
+int KernelTool_Main(int argc, char **argv);
@@ -0,0 +1,290 @@
+#include "KwsTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Kws.h>
+#include <SampleKernels.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct EnrollFrame
+{
+    uint32_t energy;
+    int16_t mfcc[FEATURE_MFCC];
+};
+
+static void EnrollFrame_Collect(const FeatureFrame &frame, void *context)
+{
+    EnrollFrame entry;
+    entry.energy = frame.energy;
+    memcpy(entry.mfcc, frame.mfcc, sizeof(entry.mfcc));
+    ((std::vector<EnrollFrame> *)context)->push_back(entry);
+}
+
+/**
+ * @brief Reads a WAV fixture through the device sample path: raw I2S layout, then Kernel_DacScale<3>.
+ */
+static bool Tool_LoadSamples(const char *path, std::vector<int16_t> &samples)
+{
+    WavMicrophone microphone;
+    if (!microphone.Load(path)) {
+        return false;
+    }
+    microphone.SetRealtime(false);
+    microphone.Begin();
+    alignas(4) uint8_t block[I2S_READ_LEN];
+    samples.clear();
+    while (!microphone.Exhausted()) {
+        size_t len = microphone.Read(block, sizeof(block));
+        Kernel_DacScale<3>(block, block, len);
+        const int16_t *pcm = (const int16_t *)block;
+        samples.insert(samples.end(), pcm, pcm + len / 2);
+    }
+    return true;
+}
+
+/**
+ * @brief Builds a template from a recording of the keyword, trimming the silence around it.
+ */
+static bool Tool_MakeTemplate(const char *path, KwsTemplate &tmpl)
+{
+    std::vector<int16_t> samples;
+    if (!Tool_LoadSamples(path, samples)) {
+        return false;
+    }
+    FeatureState state;
+    Features_Init(state, I2S_SAMPLE_RATE);
+    std::vector<EnrollFrame> frames;
+    Features_Process(state, samples.data(), samples.size(), EnrollFrame_Collect, &frames);
+
+    // Keep the frames within 18dB of the loudest one
+    uint32_t peak = 0;
+    for (const EnrollFrame &frame : frames) {
+        peak = frame.energy > peak ? frame.energy : peak;
+    }
+    size_t first = frames.size(), last = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].energy >= peak / 64 && frames[i].energy > 0) {
+            first = i < first ? i : first;
+            last = i;
+        }
+    }
+    if (first > last) {
+        fprintf(stderr, "%s: no keyword found\n", path);
+        return false;
+    }
+    size_t count = last - first + 1;
+    if (count > KWS_MAX_FRAMES) {
+        fprintf(stderr, "%s: keyword too long (%u ms, at most %u ms)\n", path,
+                (unsigned)(count * FEATURE_HOP * 1000 / I2S_SAMPLE_RATE), (unsigned)(KWS_MAX_FRAMES * FEATURE_HOP * 1000 / I2S_SAMPLE_RATE));
+        return false;
+    }
+    tmpl.frames = (uint16_t)count;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(tmpl.features[i], frames[first + i].mfcc, sizeof(tmpl.features[i]));
+    }
+    return true;
+}
+
+static int Tool_Enroll(int argc, char **argv)
+{
+    const char *outPath = NULL;
+    int threshold = 0;
+    std::vector<const char *> wavs;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--out") && hasValue) {
+            outPath = argv[++i];
+        } else if (!strcmp(argv[i], "--threshold") && hasValue) {
+            threshold = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            wavs.push_back(argv[i]);
+        } else {
+            wavs.clear();
+            break;
+        }
+    }
+    if (!outPath || wavs.empty() || wavs.size() > KWS_MAX_TEMPLATES) {
+        fprintf(stderr, "Usage: kws enroll --out PATH [--threshold N] keyword.wav... (1 to %d recordings)\n", KWS_MAX_TEMPLATES);
+        return 2;
+    }
+
+    static KwsModel model;
+    memset(&model, 0, sizeof(model));
+    for (const char *path : wavs) {
+        KwsTemplate &tmpl = model.templates[model.count];
+        if (!Tool_MakeTemplate(path, tmpl)) {
+            return 1;
+        }
+        printf("template %u: %s, %u frames (%u ms)\n", (unsigned)model.count, path, (unsigned)tmpl.frames,
+               (unsigned)(tmpl.frames * FEATURE_HOP * 1000 / I2S_SAMPLE_RATE));
+        model.count++;
+    }
+
+    // The recordings of the same keyword should match each other: place the threshold above their spread
+    int32_t spread = 0;
+    for (int a = 0; a < model.count; a++) {
+        for (int b = a + 1; b < model.count; b++) {
+            int32_t score = Kws_Compare(model.templates[a], model.templates[b]);
+            printf("score %u-%u: %d\n", (unsigned)a, (unsigned)b, (int)score);
+            spread = score > spread ? score : spread;
+        }
+    }
+    if (threshold <= 0) {
+        if (model.count < 2) {
+            fprintf(stderr, "One recording: pass --threshold (see the best scores of kws eval)\n");
+            return 2;
+        }
+        threshold = spread * 5 / 4;
+    }
+    model.threshold = threshold;
+
+    PosixStorage storage("");
+    if (!Kws_Save(model, storage, outPath)) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 1;
+    }
+    printf("%s: %u templates, threshold %d\n", outPath, (unsigned)model.count, (int)model.threshold);
+    return 0;
+}
+
+static int Tool_Eval(int argc, char **argv)
+{
+    const char *modelPath = NULL;
+    const char *labelsPath = NULL;
+    int threshold = 0;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--model") && hasValue) {
+            modelPath = argv[++i];
+        } else if (!strcmp(argv[i], "--threshold") && hasValue) {
+            threshold = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !labelsPath) {
+            labelsPath = argv[i];
+        } else {
+            labelsPath = NULL;
+            break;
+        }
+    }
+    if (!modelPath || !labelsPath) {
+        fprintf(stderr, "Usage: kws eval --model PATH [--threshold N] labels.csv\n");
+        return 2;
+    }
+
+    static KwsModel model;
+    PosixStorage storage("");
+    if (!Kws_Load(model, storage, modelPath)) {
+        fprintf(stderr, "Cannot load %s\n", modelPath);
+        return 1;
+    }
+    if (threshold > 0) {
+        model.threshold = threshold;
+    }
+    FILE *labels = fopen(labelsPath, "r");
+    if (!labels) {
+        fprintf(stderr, "Cannot open %s\n", labelsPath);
+        return 1;
+    }
+    std::string baseDir(labelsPath);
+    size_t slash = baseDir.rfind('/');
+    baseDir = slash == std::string::npos ? "" : baseDir.substr(0, slash + 1);
+
+    static KwsState state;
+    unsigned positives = 0, detected = 0, negatives = 0, falseAccepts = 0, latencyCount = 0;
+    long latencySum = 0, latencyMax = 0;
+    uint64_t negativeSamples = 0, totalSamples = 0, busyUs = 0, frames = 0, framesComputed = 0;
+    printf("%-32s %5s %10s %9s %10s %10s\n", "file", "label", "detections", "first_ms", "latency_ms", "best_score");
+
+    char line[512];
+    while (fgets(line, sizeof(line), labels)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+        char *label = strchr(line, ',');
+        if (!label) {
+            fprintf(stderr, "Bad line: %s\n", line);
+            continue;
+        }
+        *label++ = '\0';
+        char *endField = strchr(label, ',');
+        long endMs = endField ? atol(endField + 1) : -1;
+        bool keyword = atoi(label) != 0;
+        std::string path = line[0] == '/' ? std::string(line) : baseDir + line;
+
+        std::vector<int16_t> samples;
+        if (!Tool_LoadSamples(path.c_str(), samples)) {
+            continue;
+        }
+        Kws_Init(state, model);
+        unsigned detections = 0;
+        long firstMs = -1;
+        for (size_t pos = 0; pos < samples.size(); pos += I2S_READ_LEN / 2) {
+            size_t count = samples.size() - pos < I2S_READ_LEN / 2 ? samples.size() - pos : I2S_READ_LEN / 2;
+            KwsDetection detection;
+            if (Kws_Process(state, samples.data() + pos, count, detection)) {
+                detections++;
+                firstMs = firstMs < 0 ? (long)detection.timeMs : firstMs;
+            }
+        }
+
+        long latency = keyword && firstMs >= 0 && endMs >= 0 ? firstMs - endMs : 0;
+        if (keyword) {
+            positives++;
+            detected += detections > 0;
+            if (firstMs >= 0 && endMs >= 0) {
+                latencySum += latency;
+                latencyMax = latencyCount == 0 || latency > latencyMax ? latency : latencyMax;
+                latencyCount++;
+            }
+        } else {
+            negatives++;
+            falseAccepts += detections;
+            negativeSamples += samples.size();
+        }
+        totalSamples += samples.size();
+        busyUs += state.stats.busyUs;
+        frames += state.stats.frames;
+        framesComputed += state.stats.framesComputed;
+        printf("%-32s %5d %10u %9ld %10ld %10d\n", line, keyword ? 1 : 0, detections, firstMs, latency, (int)state.stats.bestScore);
+    }
+    fclose(labels);
+
+    printf("\nthreshold %d, %u templates\n", (int)model.threshold, (unsigned)model.count);
+    if (positives > 0) {
+        printf("positives: %u/%u detected (%.1f%%)", detected, positives, 100.0 * detected / positives);
+        if (latencyCount > 0) {
+            printf(", latency after the keyword avg %ld ms, max %ld ms", latencySum / (long)latencyCount, latencyMax);
+        }
+        printf("\n");
+    }
+    if (negatives > 0) {
+        double hours = (double)negativeSamples / I2S_SAMPLE_RATE / 3600.0;
+        printf("negatives: %u false accepts in %.1f s of audio (%.1f per hour)\n", falseAccepts,
+               (double)negativeSamples / I2S_SAMPLE_RATE, hours > 0 ? falseAccepts / hours : 0.0);
+    }
+    if (totalSamples > 0 && frames > 0) {
+        double seconds = (double)totalSamples / I2S_SAMPLE_RATE;
+        printf("duty cycle: %.1f%% of frames analyzed, host CPU %.0f us per audio second\n",
+               100.0 * framesComputed / frames, busyUs / seconds);
+    }
+    return 0;
+}
+
+/**
+ * @brief Entry point of `program kws ...`, argv[0] is "kws".
+ */
+int KwsTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    if (argc >= 2 && !strcmp(argv[1], "enroll")) {
+        return Tool_Enroll(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "eval")) {
+        return Tool_Eval(argc - 1, argv + 1);
+    }
+    fprintf(stderr, "Usage: kws enroll|eval ... (see src/hal/native/KwsTool.h)\n");
+    return 2;
+}
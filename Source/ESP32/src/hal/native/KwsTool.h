@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+Keyword spotter tools (host):
+    program kws enroll --out kws.bin [--threshold N] keyword1.wav [keyword2.wav ...]
+        Builds the templates of Kws.h from recordings of the wake word (silence around it is
+        trimmed). Without --threshold, the threshold is placed above the spread between the
+        recordings, which needs at least two of them. Copy kws.bin to the root of the device
+        file system (KWS_TEMPLATE_FILE).
+    program kws eval --model kws.bin [--threshold N] labels.csv
+        Runs the spotter over labeled WAV fixtures, through the same sample path as the device
+        (raw I2S layout, Kernel_DacScale<3>), and reports the detection rate, the detection
+        latency, false accepts per hour and the duty cycle and CPU time of the spotter.
+        labels.csv lines: <wav path>,<1 keyword | 0 no keyword>[,<end of the keyword in ms>]
+        Paths are relative to the CSV file, lines starting with # are ignored.
+*/
+
+int KwsTool_Main(int argc, char **argv);
@@ -0,0 +1,542 @@
+#include "LoadTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Server.h>
+#include <Session.h>
+#include <RecordLog.h>
+#include <Arena.h>
+#include <Codec.h>
+#include <AudioFormat.h>
+#include <SampleKernels.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * @brief An utterance of the corpus, encoded as the device sends it.
+ */
+struct Utterance
+{
+    std::string path;
+    std::vector<uint8_t> encoded;     // UPLOAD_CODEC bytes of all blocks
+    std::vector<size_t> blockEnds;    // End of each capture block in `encoded`
+    std::vector<uint8_t> wav;         // Header and encoded audio, body of a file upload
+    uint32_t durationMs;
+};
+
+struct LoadOptions
+{
+    const char *host = "127.0.0.1";
+    int port = 5000;
+    int sessionPort = SESSION_PORT;
+    int devices = 4;
+    int turns = 10;                   // Per device, unless `duration` is set
+    double duration = 0;              // Seconds of soak
+    double thinkMs = 1000;            // Closed loop: mean think time
+    double ratePerMin = 0;            // Open loop: arrivals per device per minute
+    double ramp = 0;                  // Seconds over which the devices start
+    double report = 10;               // Seconds between progress lines of a soak
+    unsigned seed = 1;
+    bool realtime = true;
+};
+
+enum LOAD_OUTCOME
+{
+    LOAD_OK,
+    LOAD_CONNECT,                     // No connection to the server
+    LOAD_TIMEOUT,                     // SERVER_TIMEOUT without data
+    LOAD_LOST,                        // Connection closed or reset before the response
+    LOAD_HTTP,                        // Status other than 200
+    LOAD_OUTCOME_COUNT
+};
+
+static const char *const outcomeNames[LOAD_OUTCOME_COUNT] = {"ok", "connect", "timeout", "lost", "http"};
+
+enum LOAD_RECORD
+{
+    LOAD_RECORD_TURN,                 // A turn has ended
+    LOAD_RECORD_DEVICE                // The device is done, `session` holds its totals
+};
+
+/**
+ * @brief Sent by a device to the parent through the shared pipe, smaller than PIPE_BUF so writes do not interleave.
+ */
+struct LoadRecord
+{
+    uint8_t kind;                     // LOAD_RECORD
+    uint8_t outcome;                  // LOAD_OUTCOME
+    uint16_t device;
+    int32_t status;
+    uint32_t endTime;                 // Hal_Millis() at the end of the turn
+    uint32_t lateMs;                  // Start after the scheduled arrival (open loop)
+    uint32_t uploadMs;
+    uint32_t waitMs;
+    uint32_t downloadMs;
+    uint32_t totalMs;
+    uint32_t uploadedBytes;
+    uint32_t responseBytes;
+    SessionStats session;
+};
+
+/**
+ * @brief Socket transport that counts the failures the device code only logs.
+ */
+class LoadTransport : public Transport
+{
+public:
+    bool Connect(const char *host, uint16_t port) override
+    {
+        bool connected = socket.Connect(host, port);
+        connectFailures += !connected;
+        return connected;
+    }
+    size_t Write(const uint8_t *data, size_t len) override { return socket.Write(data, len); }
+    int Read(uint8_t *buffer, size_t len, uint32_t timeoutMs) override
+    {
+        int n = socket.Read(buffer, len, timeoutMs);
+        timeouts += n == 0 && timeoutMs >= SERVER_TIMEOUT; // the response waits, not the session polls
+        return n;
+    }
+    bool Connected() override { return socket.Connected(); }
+    void Stop() override { socket.Stop(); }
+    bool LinkUp() override { return socket.LinkUp(); }
+
+    uint32_t connectFailures = 0;
+    uint32_t timeouts = 0;
+
+private:
+    SocketTransport socket;
+};
+
+/**
+ * @brief Reads a WAV fixture through the device sample path and encodes it block by block, as the voice task does.
+ */
+static bool Load_Prepare(const char *path, Utterance &utterance)
+{
+    WavMicrophone microphone;
+    if (!microphone.Load(path)) {
+        return false;
+    }
+    microphone.SetRealtime(false);
+    microphone.Begin();
+    CodecState codecState;
+    Codec_Reset(codecState, UPLOAD_CODEC);
+    alignas(4) uint8_t block[I2S_READ_LEN];
+    uint32_t pcmBytes = 0;
+    utterance.path = path;
+    while (!microphone.Exhausted()) {
+        size_t len = microphone.Read(block, sizeof(block));
+        Kernel_DacScale<3>(block, block, len);
+        size_t encodedLen = Codec_Encode(codecState, block, (const int16_t *)block, len / 2);
+        utterance.encoded.insert(utterance.encoded.end(), block, block + encodedLen);
+        utterance.blockEnds.push_back(utterance.encoded.size());
+        pcmBytes += len;
+    }
+    size_t tailLen = Codec_Flush(codecState, block);
+    if (tailLen > 0 && !utterance.blockEnds.empty()) {
+        utterance.encoded.insert(utterance.encoded.end(), block, block + tailLen);
+        utterance.blockEnds.back() = utterance.encoded.size();
+    }
+    microphone.End();
+    // The header carries the encoded data size, as RecordLog_End() writes it
+    utterance.wav.resize(WAV_HEADER_SIZE);
+    Buffer_WriteWavHeader(utterance.wav.data(), (uint32_t)utterance.encoded.size());
+    utterance.wav.insert(utterance.wav.end(), utterance.encoded.begin(), utterance.encoded.end());
+    utterance.durationMs = (uint32_t)((uint64_t)pcmBytes * 1000 / (I2S_SAMPLE_RATE * I2S_SAMPLE_BITS / 8));
+    return true;
+}
+
+/**
+ * @brief Adds the WAV files of a directory to the corpus, in name order.
+ */
+static bool Load_ListCorpus(const char *dir, std::vector<std::string> &paths)
+{
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        return false;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(handle)) {
+        size_t len = strlen(entry->d_name);
+        if (len > 4 && !strcasecmp(entry->d_name + len - 4, ".wav")) {
+            names.push_back(std::string(dir) + "/" + entry->d_name);
+        }
+    }
+    closedir(handle);
+    std::sort(names.begin(), names.end());
+    paths.insert(paths.end(), names.begin(), names.end());
+    return true;
+}
+
+/**
+ * @brief Idles until `time`, keeping the session alive as the voice task does while waiting for a press.
+ */
+static void Load_WaitUntil(unsigned long time)
+{
+    for (;;) {
+#if SERVER_SESSION
+        Session_Poll();
+#endif
+        long remaining = (long)(time - Hal_Millis());
+        if (remaining <= 0) {
+            return;
+        }
+        Hal_DelayMs(remaining < VOICE_IDLE_WAKE_MS ? remaining : VOICE_IDLE_WAKE_MS);
+    }
+}
+
+static uint32_t Load_Elapsed(unsigned long from, unsigned long to)
+{
+    return to > from ? (uint32_t)(to - from) : 0;
+}
+
+/**
+ * @brief Runs one turn with the protocol of the build and classifies its outcome.
+ */
+static void Load_Turn(LoadTransport &transport, SimulatedSpeaker &speaker, const Utterance &utterance, bool realtime, LoadRecord &record)
+{
+    TurnStats stats = {};
+    uint32_t connectFailures = transport.connectFailures;
+    uint32_t timeouts = transport.timeouts;
+    stats.pressTime = Hal_Millis();
+#if SERVER_SESSION || STREAM_UPLOAD
+#if SERVER_SESSION
+    bool sent = Session_TurnBegin(speaker, stats);
+#else
+    bool sent = Server_StreamBegin(transport);
+#endif
+    size_t blockStart = 0;
+    for (size_t i = 0; sent && i < utterance.blockEnds.size(); i++) {
+        if (realtime) {
+            // A block leaves the device once it has been captured
+            Hal_DelayMs(Load_Elapsed(Hal_Millis(), stats.pressTime + (uint64_t)(i + 1) * utterance.durationMs / utterance.blockEnds.size()));
+        }
+        const uint8_t *data = utterance.encoded.data() + blockStart;
+        size_t len = utterance.blockEnds[i] - blockStart;
+#if SERVER_SESSION
+        sent = Session_SendAudio(data, len);
+#else
+        sent = Server_StreamWrite(transport, data, len);
+#endif
+        blockStart = utterance.blockEnds[i];
+    }
+    stats.releaseTime = realtime ? stats.pressTime + utterance.durationMs : stats.pressTime;
+#if SERVER_SESSION
+    sent = sent && Session_TurnEnd();
+#else
+    sent = sent && Server_StreamEnd(transport);
+#endif
+    stats.lastByteSentTime = Hal_Millis();
+    if (sent) {
+#if SERVER_SESSION
+        Session_Receive(stats);
+#else
+        Server_StreamReceive(transport, speaker, stats);
+#endif
+    }
+#if !SERVER_SESSION
+    transport.Stop();
+#endif
+#else
+    if (realtime) {
+        Hal_DelayMs(utterance.durationMs); // recorded before the upload starts
+    }
+    stats.releaseTime = Hal_Millis();
+    RecordView recording = {{utterance.wav.data(), NULL}, {utterance.wav.size(), 0}, utterance.wav.size(), 0};
+    Server_UploadRecording(transport, recording, speaker, stats);
+#endif
+    if (realtime && stats.httpStatus == 200) {
+        speaker.WaitDone(); // the device does not listen while it speaks
+    }
+    Arena_Reset();
+
+    unsigned long now = Hal_Millis();
+    record.status = stats.httpStatus;
+    record.endTime = (uint32_t)now;
+    record.responseBytes = stats.responseBytes;
+    if (stats.httpStatus == 200 && transport.timeouts == timeouts) {
+        record.outcome = LOAD_OK;
+        record.uploadMs = Load_Elapsed(stats.releaseTime, stats.lastByteSentTime);
+        // A session response may start before the upload ends
+        record.waitMs = Load_Elapsed(stats.lastByteSentTime, stats.firstResponseTime);
+        record.downloadMs = Load_Elapsed(stats.firstResponseTime, stats.lastResponseTime);
+        record.totalMs = Load_Elapsed(stats.releaseTime, stats.lastResponseTime);
+    } else if (transport.connectFailures != connectFailures) {
+        record.outcome = LOAD_CONNECT;
+    } else if (transport.timeouts != timeouts || (stats.httpStatus == 0 && now - stats.lastByteSentTime >= SERVER_TIMEOUT)) {
+        record.outcome = LOAD_TIMEOUT;
+    } else {
+        record.outcome = stats.httpStatus == 0 ? LOAD_LOST : LOAD_HTTP;
+    }
+    record.uploadedBytes = record.outcome == LOAD_CONNECT ? 0 : utterance.encoded.size();
+}
+
+/**
+ * @brief A simulated device, in its own process: the server, session and arena state of the device code is per process.
+ */
+static void Load_Device(int device, const LoadOptions &options, const std::vector<Utterance> &corpus, unsigned long origin, int out)
+{
+    NativeHal_SetLogging(false);
+    std::mt19937 random(options.seed * 7919u + device);
+    std::uniform_int_distribution<size_t> pick(0, corpus.size() - 1);
+    bool openLoop = options.ratePerMin > 0;
+    std::exponential_distribution<double> gap(openLoop ? options.ratePerMin / 60000.0 : (options.thinkMs > 0 ? 1.0 / options.thinkMs : 1.0));
+    LoadTransport transport;
+    SimulatedSpeaker speaker;
+    speaker.SetRealtime(options.realtime);
+    Server_Init(options.host, (uint16_t)options.port);
+#if SERVER_SESSION
+    Session_Init(transport, options.host, (uint16_t)options.sessionPort);
+#endif
+
+    unsigned long deadline = origin + (unsigned long)(options.duration * 1000);
+    unsigned long scheduled = origin + (unsigned long)(options.ramp * 1000 * device / options.devices);
+    // A soak ends at the deadline, the turns still due then (overload) are not started
+    for (int turn = 0; options.duration > 0 ? scheduled < deadline && Hal_Millis() < deadline : turn < options.turns; turn++) {
+        Load_WaitUntil(scheduled);
+        LoadRecord record = {};
+        record.kind = LOAD_RECORD_TURN;
+        record.device = (uint16_t)device;
+        record.lateMs = Load_Elapsed(scheduled, Hal_Millis());
+        Load_Turn(transport, speaker, corpus[pick(random)], options.realtime, record);
+        if (write(out, &record, sizeof(record)) != (ssize_t)sizeof(record)) {
+            break;
+        }
+        if (openLoop) {
+            scheduled += (unsigned long)gap(random);
+        } else {
+            scheduled = Hal_Millis() + (options.thinkMs > 0 ? (unsigned long)gap(random) : 0);
+        }
+    }
+    LoadRecord record = {};
+    record.kind = LOAD_RECORD_DEVICE;
+    record.device = (uint16_t)device;
+    record.endTime = (uint32_t)Hal_Millis();
+#if SERVER_SESSION
+    record.session = Session_GetStats();
+#endif
+    ssize_t written = write(out, &record, sizeof(record));
+    (void)written;
+}
+
+/**
+ * @brief Nearest-rank percentile of sorted values, 0 if there are none.
+ */
+static uint32_t Load_Percentile(const std::vector<uint32_t> &sorted, double percent)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t)(percent / 100.0 * sorted.size() + 0.999999);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+struct LoadStage
+{
+    const char *name;
+    std::vector<uint32_t> values;
+};
+
+static bool Load_ReadRecord(int fd, LoadRecord &record)
+{
+    size_t done = 0;
+    while (done < sizeof(record)) {
+        ssize_t n = read(fd, (uint8_t *)&record + done, sizeof(record) - done);
+        if (n <= 0) {
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+static void Load_Usage()
+{
+    fprintf(stderr, "Usage: load [--host HOST] [--port PORT] [--session-port PORT] [--devices N] [--turns N | --duration S]\n"
+                    "            [--think MS | --rate PER_MIN] [--ramp S] [--report S] [--seed N] [--fast] (--corpus DIR | utterance.wav ...)\n");
+}
+
+/**
+ * @brief Entry point of `program load ...`, argv[0] is "load".
+ */
+int LoadTool_Main(int argc, char **argv)
+{
+    LoadOptions options;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--host") && hasValue) {
+            options.host = argv[++i];
+        } else if (!strcmp(argv[i], "--port") && hasValue) {
+            options.port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--session-port") && hasValue) {
+            options.sessionPort = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--devices") && hasValue) {
+            options.devices = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--turns") && hasValue) {
+            options.turns = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration") && hasValue) {
+            options.duration = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--think") && hasValue) {
+            options.thinkMs = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--rate") && hasValue) {
+            options.ratePerMin = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--ramp") && hasValue) {
+            options.ramp = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--report") && hasValue) {
+            options.report = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && hasValue) {
+            options.seed = (unsigned)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--corpus") && hasValue) {
+            if (!Load_ListCorpus(argv[++i], paths)) {
+                fprintf(stderr, "Cannot read the corpus directory %s\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--fast")) {
+            options.realtime = false;
+        } else if (argv[i][0] != '-') {
+            paths.push_back(argv[i]);
+        } else {
+            Load_Usage();
+            return 2;
+        }
+    }
+    if (paths.empty() || options.devices <= 0 || options.devices > LOAD_MAX_DEVICES || (options.duration <= 0 && options.turns <= 0)) {
+        Load_Usage();
+        return 2;
+    }
+
+    NativeHal_SetLogging(false);
+    std::vector<Utterance> corpus(paths.size());
+    uint64_t corpusMs = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!Load_Prepare(paths[i].c_str(), corpus[i])) {
+            fprintf(stderr, "Cannot load %s\n", paths[i].c_str());
+            return 1;
+        }
+        corpusMs += corpus[i].durationMs;
+    }
+    printf("%d devices, %u utterances (%.1f s, encoded as %s), %s, %s\n", options.devices, (unsigned)corpus.size(), corpusMs / 1000.0,
+           Codec_ToString(UPLOAD_CODEC), SERVER_SESSION ? "session" : (STREAM_UPLOAD ? "streaming upload" : "file upload"),
+           options.ratePerMin > 0 ? "open loop" : "closed loop");
+    fflush(stdout);
+
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    unsigned long origin = Hal_Millis() + 100; // all devices share the clock of the parent
+    std::vector<pid_t> children;
+    for (int device = 0; device < options.devices; device++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(pipeFds[0]);
+            Load_Device(device, options, corpus, origin, pipeFds[1]);
+            _exit(0); // no atexit handlers: the log task belongs to the parent
+        }
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        children.push_back(pid);
+    }
+    close(pipeFds[1]);
+
+    LoadStage stages[] = {{"upload", {}}, {"server_wait", {}}, {"download", {}}, {"total", {}}, {"late", {}}};
+    uint32_t outcomes[LOAD_OUTCOME_COUNT] = {};
+    uint64_t uploadedBytes = 0, responseBytes = 0;
+    SessionStats session = {};
+    uint32_t turns = 0, windowTurns = 0, windowErrors = 0;
+    std::vector<uint32_t> windowTotals;
+    unsigned long nextReport = origin + (unsigned long)(options.report * 1000);
+    bool progress = options.duration > 0 && options.report > 0;
+    LoadRecord record;
+    for (;;) {
+        struct pollfd request = {pipeFds[0], POLLIN, 0};
+        int ready = poll(&request, 1, progress ? 200 : -1);
+        if (ready > 0 && !Load_ReadRecord(pipeFds[0], record)) {
+            break; // every device has exited
+        }
+        if (ready > 0 && record.kind == LOAD_RECORD_DEVICE) {
+            session.connects += record.session.connects;
+            session.drops += record.session.drops;
+            session.missedHeartbeats += record.session.missedHeartbeats;
+            session.coldTurns += record.session.coldTurns;
+        } else if (ready > 0) {
+            turns++;
+            windowTurns++;
+            outcomes[record.outcome]++;
+            uploadedBytes += record.uploadedBytes;
+            responseBytes += record.responseBytes;
+            if (options.ratePerMin > 0) {
+                stages[4].values.push_back(record.lateMs); // a closed loop is never late
+            }
+            if (record.outcome == LOAD_OK) {
+                stages[0].values.push_back(record.uploadMs);
+                stages[1].values.push_back(record.waitMs);
+                stages[2].values.push_back(record.downloadMs);
+                stages[3].values.push_back(record.totalMs);
+                windowTotals.push_back(record.totalMs);
+            } else {
+                windowErrors++;
+            }
+        }
+        if (progress && Hal_Millis() >= nextReport) {
+            std::sort(windowTotals.begin(), windowTotals.end());
+            printf("[%6.0f s] %u turns, last %.0f s: %u turns (%.2f/s), %u failed, total p95 %u ms\n",
+                   (Hal_Millis() - origin) / 1000.0, (unsigned)turns, options.report, (unsigned)windowTurns,
+                   windowTurns / options.report, (unsigned)windowErrors, (unsigned)Load_Percentile(windowTotals, 95));
+            fflush(stdout);
+            windowTurns = 0;
+            windowErrors = 0;
+            windowTotals.clear();
+            nextReport += (unsigned long)(options.report * 1000);
+        }
+    }
+    close(pipeFds[0]);
+    int crashed = 0;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        crashed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+
+    double seconds = Load_Elapsed(origin, Hal_Millis()) / 1000.0;
+    seconds = seconds > 0 ? seconds : 1e-3;
+    uint32_t failed = turns - outcomes[LOAD_OK];
+    printf("\n%u turns in %.1f s: %.2f turns/s answered, upload %.1f KB/s, response %.1f KB/s\n", (unsigned)turns, seconds,
+           outcomes[LOAD_OK] / seconds, uploadedBytes / 1024.0 / seconds, responseBytes / 1024.0 / seconds);
+    printf("failed %u:", (unsigned)failed);
+    for (int i = LOAD_OK + 1; i < LOAD_OUTCOME_COUNT; i++) {
+        printf(" %s %u", outcomeNames[i], (unsigned)outcomes[i]);
+    }
+    printf("\n");
+#if SERVER_SESSION
+    printf("session: %u connects, %u drops, %u missed heartbeats, %u cold turns\n",
+           (unsigned)session.connects, (unsigned)session.drops, (unsigned)session.missedHeartbeats, (unsigned)session.coldTurns);
+#endif
+    if (crashed) {
+        printf("%d devices exited abnormally\n", crashed);
+    }
+    if (!stages[0].values.empty()) {
+        printf("\n%-12s %8s %8s %8s %8s\n", "stage (ms)", "p50", "p95", "p99", "max");
+    }
+    for (LoadStage &stage : stages) {
+        if (stage.values.empty()) {
+            continue;
+        }
+        std::sort(stage.values.begin(), stage.values.end());
+        printf("%-12s %8u %8u %8u %8u\n", stage.name, (unsigned)Load_Percentile(stage.values, 50), (unsigned)Load_Percentile(stage.values, 95),
+               (unsigned)Load_Percentile(stage.values, 99), (unsigned)stage.values.back());
+    }
+    return failed || crashed ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+Load and soak generator (host):
+    program load [--host HOST] [--port PORT] [--session-port PORT] [--devices N]
+                 [--turns N | --duration S] [--think MS | --rate PER_MIN] [--ramp S]
+                 [--report S] [--seed N] [--fast] (--corpus DIR | utterance.wav ...)
+        Simulates N devices talking to one server: each device is a child process running the
+        upload and download code of the device (Server.cpp, Session.cpp, Response.cpp) with the
+        protocol of the build (SERVER_SESSION, STREAM_UPLOAD), so the server sees the requests,
+        frames and codec (UPLOAD_CODEC) of real devices. The utterances go through the device
+        sample path (raw I2S layout, Kernel_DacScale<3>) and are encoded once, before the fork.
+
+        Arrivals: with --think, closed loop, a device speaks again after an exponential think
+        time (mean MS, default 1000) once its previous turn has ended. With --rate, open loop,
+        Poisson arrivals of PER_MIN turns per minute per device; a turn due while the previous
+        one is still running starts late and the delay is reported. --ramp spreads the first
+        turns of the devices over S seconds.
+
+        Pacing: the audio is streamed at the capture rate and the response is played in real
+        time, as on a device (the recording is uploaded once it is complete without streaming).
+        --fast sends and consumes as fast as the server allows.
+
+        Report: throughput, percentiles (p50/p95/p99/max) of the stages of the turns answered
+        with status 200, measured from the end of the utterance:
+            upload       last byte sent
+            server_wait  last byte sent to first response byte
+            download     first to last response byte
+            total        end of the utterance to last response byte
+        and the failed turns by cause: connect (no connection), timeout (SERVER_TIMEOUT without
+        data), lost (connection closed or reset) and http (status other than 200), plus the
+        session reconnects. --duration runs a soak: devices start turns until S seconds have
+        passed, a progress line is printed every --report seconds (default 10). Exits with 1 if
+        a turn failed.
+*/
+
+#define LOAD_MAX_DEVICES 256
+
+int LoadTool_Main(int argc, char **argv);
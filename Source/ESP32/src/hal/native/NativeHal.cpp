@@ -0,0 +1,750 @@
+#include "NativeHal.h"
+#include <Config.h>
+#include <AudioFormat.h>
+#include <Trace.h>
+#include <Arena.h>
+#include <App.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+static bool loggingEnabled = true;
+
+/**
+ * @brief Milliseconds since the first call, from the monotonic clock.
+ */
+unsigned long Hal_Millis()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+/**
+ * @brief Microseconds since the first call, from the monotonic clock.
+ */
+uint64_t Hal_Micros()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+/**
+ * @brief Blocks the calling thread for `ms` milliseconds.
+ */
+void Hal_DelayMs(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/**
+ * @brief Runs `task` on a detached thread, priority and core are ignored on the host.
+ */
+bool Hal_StartTask(void (*task)(void *), const char *name, uint32_t stackSize, void *arg, uint8_t priority, int core)
+{
+    (void)name;
+    (void)stackSize;
+    (void)priority;
+    (void)core;
+    std::thread(task, arg).detach();
+    return true;
+}
+
+/**
+ * @brief Nothing to do on the host: the thread ends when the task function returns.
+ */
+void Hal_EndTask()
+{
+}
+
+/**
+ * @brief Binary event: a signal wakes one wait, signals without a waiter collapse into one.
+ */
+struct HostEvent
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool signaled = false;
+};
+
+HalEvent Hal_CreateEvent()
+{
+    return new HostEvent();
+}
+
+void Hal_SignalEvent(HalEvent event)
+{
+    HostEvent *host = (HostEvent *)event;
+    {
+        std::lock_guard<std::mutex> lock(host->mutex);
+        host->signaled = true;
+    }
+    host->condition.notify_one();
+}
+
+/**
+ * @brief Blocks until `event` is signaled or `timeoutMs` expires.
+ *
+ * @return false on timeout.
+ */
+bool Hal_WaitEvent(HalEvent event, uint32_t timeoutMs)
+{
+    HostEvent *host = (HostEvent *)event;
+    std::unique_lock<std::mutex> lock(host->mutex);
+    bool signaled = host->condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [host] { return host->signaled; });
+    host->signaled = false;
+    return signaled;
+}
+
+// The host scheduler is not measured
+int Hal_CpuIdle(int core)
+{
+    (void)core;
+    return -1;
+}
+
+bool Hal_CpuTicks(int core, uint32_t &ticks, uint32_t &idle)
+{
+    (void)core;
+    ticks = idle = 0;
+    return false;
+}
+
+/**
+ * @brief Writes a log line to stderr, keeping stdout for the benchmark report.
+ */
+void Hal_Log(const char *format, ...)
+{
+    if (!loggingEnabled) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Writes log output as is to stderr (text lines or binary frames, see Log.h).
+ */
+void Hal_LogWrite(const void *data, size_t len)
+{
+    if (!loggingEnabled) {
+        return;
+    }
+    fwrite(data, 1, len, stderr);
+}
+
+/**
+ * @brief Enables or disables the pipeline log (LOG/LOGL).
+ */
+void NativeHal_SetLogging(bool enabled)
+{
+    loggingEnabled = enabled;
+}
+
+// The heap statistics are an ESP32 concern, only the arena is reported
+void Heap_Record() {}
+
+void Heap_Logging(uint8_t index)
+{
+    (void)index;
+    Arena_Logging();
+}
+
+static uint32_t ReadLE(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Loads a 16-bit mono PCM WAV file, resampling it to I2S_SAMPLE_RATE if needed.
+ *
+ * @param path Path of the WAV fixture.
+ * @return false if the file cannot be read or is not 16-bit mono PCM.
+ */
+bool WavMicrophone::Load(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        Hal_Log("Cannot open WAV fixture %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + n);
+    }
+    fclose(file);
+
+    WavParser parser;
+    Wav_ParserReset(parser);
+    size_t headerLen = Wav_Parse(parser, data.data(), data.size());
+    const WavInfo &format = parser.info;
+    if (parser.state != WAV_PARSE_DONE) {
+        Hal_Log("%s is not a PCM WAV file\n", path);
+        return false;
+    }
+    if (format.channels != 1 || format.sampleBits != 16 || format.sampleRate == 0) {
+        Hal_Log("%s: expected 16-bit mono PCM, got %u channels, %u bits\n",
+                path, (unsigned)format.channels, (unsigned)format.sampleBits);
+        return false;
+    }
+    uint32_t sampleRate = format.sampleRate;
+    const uint8_t *pcm = data.data() + headerLen;
+    size_t pcmLen = data.size() - headerLen;
+    if (format.dataSize < pcmLen) {
+        pcmLen = format.dataSize; // trailing chunks; a streaming WAV or truncated file plays to the end
+    }
+
+    // Nearest-neighbour resampling is enough to drive the pipeline with speech
+    size_t sourceCount = pcmLen / 2;
+    size_t count = (size_t)((uint64_t)sourceCount * I2S_SAMPLE_RATE / sampleRate);
+    samples.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t source = (size_t)((uint64_t)i * sampleRate / I2S_SAMPLE_RATE);
+        samples[i] = (int16_t)ReadLE(pcm + 2 * source, 2);
+    }
+    position = samples.size();
+    return !samples.empty();
+}
+
+/**
+ * @brief Restarts the fixture from its first sample: the button is pressed.
+ */
+void WavMicrophone::Rewind()
+{
+    position = 0;
+    beginMicros = Hal_Micros();
+    for (HalEvent event : listeners) {
+        Hal_SignalEvent(event);
+    }
+}
+
+/**
+ * @brief Rewinds the fixture, the next Read() returns its first sample.
+ */
+bool WavMicrophone::Begin()
+{
+    delivered = 0;
+    beginTime = Hal_Millis();
+    Rewind();
+    return true;
+}
+
+/**
+ * @brief Reads `len` bytes of raw I2S samples, blocking until the real microphone would have captured them.
+ */
+size_t WavMicrophone::Read(uint8_t *buffer, size_t len)
+{
+    size_t count = len / 2;
+    while (!realtime && backpressure && backpressure()) {
+        // A real DMA would overrun here, an unpaced file can wait for the consumer
+        Hal_DelayMs(1);
+    }
+    bool running = !Exhausted();
+    if (!running && bargeInSamples > 0 && delivered - exhaustedAt >= bargeInSamples) {
+        Rewind();
+        running = true;
+    }
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        scratch[i] = position < samples.size() ? samples[position++] : 0;
+    }
+    if (echoSource && echoPercent > 0) {
+        echoSource->Echo(scratch.data(), count, echoPercent);
+    }
+    for (size_t i = 0; i < count; i++) {
+        // INMP441 data left-aligned in the 16-bit slot: Kernel_DacScale<3> recovers the high byte
+        uint16_t raw = (uint16_t)((((uint16_t)scratch[i] >> 8) & 0xFF) << 3);
+        buffer[2 * i] = (uint8_t)raw;
+        buffer[2 * i + 1] = (uint8_t)(raw >> 8);
+    }
+    delivered += count;
+    if (realtime) {
+        unsigned long due = beginTime + (unsigned long)(delivered * 1000 / I2S_SAMPLE_RATE);
+        unsigned long now = Hal_Millis();
+        if (due > now) {
+            Hal_DelayMs(due - now);
+        }
+    }
+    if (running && Exhausted()) {
+        // The release happens once the block holding the last sample has been captured
+        exhaustedMicros = Hal_Micros();
+        exhaustedAt = delivered;
+        for (HalEvent event : listeners) {
+            Hal_SignalEvent(event);
+        }
+    }
+    return count * 2;
+}
+
+size_t PosixFile::Write(const uint8_t *data, size_t len) {
+    return fwrite(data, 1, len, file);
+}
+
+size_t PosixFile::Read(uint8_t *data, size_t len) {
+    return fread(data, 1, len, file);
+}
+
+bool PosixFile::Seek(uint32_t position) {
+    return fseek(file, position, SEEK_SET) == 0;
+}
+
+size_t PosixFile::Size() {
+    long current = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, current, SEEK_SET);
+    return size < 0 ? 0 : (size_t)size;
+}
+
+void PosixFile::Close() {
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+/**
+ * @brief Creates the root directory if it does not exist.
+ */
+bool PosixStorage::Begin() {
+    struct stat info;
+    if (stat(root.c_str(), &info) == 0) {
+        return S_ISDIR(info.st_mode);
+    }
+    return mkdir(root.c_str(), 0755) == 0;
+}
+
+/**
+ * @brief Opens a file for reading, or creates/truncates it for writing.
+ */
+StorageFile *PosixStorage::Open(const char *path, bool write) {
+    FILE *file = fopen(Path(path).c_str(), write ? "w+b" : "rb");
+    if (!file) {
+        return NULL;
+    }
+    return new PosixFile(file);
+}
+
+bool PosixStorage::Exists(const char *path) {
+    return access(Path(path).c_str(), F_OK) == 0;
+}
+
+bool PosixStorage::Remove(const char *path) {
+    return unlink(Path(path).c_str()) == 0;
+}
+
+/**
+ * @brief Calls `callback` for every regular file in the root directory.
+ */
+void PosixStorage::List(void (*callback)(const char *name, size_t size)) {
+    DIR *dir = opendir(root.c_str());
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat info;
+        std::string path = root + "/" + entry->d_name;
+        if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            callback(entry->d_name, (size_t)info.st_size);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Maps the file, creating it erased (0xFF) if it does not have the size of the region.
+ */
+bool FileFlash::Begin() {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    bool fresh = fstat(fd, &info) != 0 || info.st_size != (off_t)size;
+    if (fresh && ftruncate(fd, size) != 0) {
+        close(fd);
+        return false;
+    }
+    void *address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    mapped = (uint8_t *)address;
+    if (fresh) {
+        memset(mapped, 0xFF, size);
+    }
+    return true;
+}
+
+FileFlash::~FileFlash() {
+    if (mapped) {
+        munmap(mapped, size);
+    }
+}
+
+bool FileFlash::Erase(uint32_t offset, uint32_t len) {
+    if (!mapped || offset % FLASH_SECTOR_SIZE || len % FLASH_SECTOR_SIZE || offset + len > size) {
+        return false;
+    }
+    memset(mapped + offset, 0xFF, len);
+    return true;
+}
+
+bool FileFlash::Write(uint32_t offset, const uint8_t *data, size_t len) {
+    if (!mapped || offset + len > size) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if ((mapped[offset + i] & data[i]) != data[i] && !reported) {
+            LOGW("FileFlash: write at 0x%x sets bits of a byte that is not erased", (unsigned)(offset + i));
+            reported = true;
+        }
+        mapped[offset + i] &= data[i];
+    }
+    return true;
+}
+
+/**
+ * @brief Resolves `host` and opens a TCP connection with Nagle disabled, like WiFiTransport.
+ */
+bool SocketTransport::Connect(const char *host, uint16_t port) {
+    Stop();
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses = NULL;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) {
+        return false;
+    }
+    for (struct addrinfo *address = addresses; address != NULL; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) {
+        return false;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return true;
+}
+
+size_t SocketTransport::Write(const uint8_t *data, size_t len) {
+    size_t sent = 0;
+    while (fd >= 0 && sent < len) {
+        ssize_t n = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        sent += (size_t)n;
+    }
+    return sent;
+}
+
+/**
+ * @brief Waits up to `timeoutMs` for data and reads what is available.
+ */
+int SocketTransport::Read(uint8_t *buffer, size_t len, uint32_t timeoutMs) {
+    if (fd < 0) {
+        return -1;
+    }
+    struct pollfd request = {fd, POLLIN, 0};
+    int ready = poll(&request, 1, (int)timeoutMs);
+    if (ready == 0) {
+        return 0;
+    }
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    ssize_t n = recv(fd, buffer, len, 0);
+    return n > 0 ? (int)n : -1;
+}
+
+bool SocketTransport::Connected() {
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t probe;
+    ssize_t n = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+void SocketTransport::Stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+ScriptedControls::ScriptedControls(WavMicrophone &mic) : microphone(mic), edge(Hal_CreateEvent()) {
+    microphone.AddListener(edge);
+}
+
+/**
+ * @brief Sleeps until the fixture is rewound (pressed) or runs out (released).
+ */
+bool ScriptedControls::WaitButton(bool pressed, uint32_t timeoutMs) {
+    unsigned long startTime = Hal_Millis();
+    while (ButtonPressed() != pressed) {
+        unsigned long elapsed = Hal_Millis() - startTime;
+        if (elapsed >= timeoutMs) {
+            return false;
+        }
+        Hal_WaitEvent(edge, timeoutMs - elapsed);
+    }
+    return true;
+}
+
+uint64_t ScriptedControls::ButtonEdgeTime() {
+    return microphone.Exhausted() ? microphone.ExhaustedTime() : microphone.BeginTime();
+}
+
+/**
+ * @brief Starts a new stream, and a new 8-bit WAV file when an output file is set.
+ */
+void SimulatedSpeaker::Begin(uint32_t sampleRate) {
+    Stop();
+    std::lock_guard<std::mutex> lock(mutex);
+    stats = {};
+    rate = sampleRate;
+    written = 0;
+    playedBase = 0;
+    playing = false;
+    interrupted = false;
+    beginTime = Hal_Millis();
+    outputWritten = 0;
+    if (!outputPath.empty()) {
+        Resampler_Init(resampler, sampleRate, PLAYER_OUTPUT_RATE);
+        output = fopen(outputPath.c_str(), "wb");
+        WavHeader header = {};
+        if (output) {
+            fwrite(header.bytes, 1, sizeof(header.bytes), output); // patched in Stop()
+        }
+    }
+}
+
+/**
+ * @brief Samples consumed by the simulated DAC at `now`. Called with the mutex held.
+ */
+uint32_t SimulatedSpeaker::Played(unsigned long now) {
+    if (!playing) {
+        return playedBase;
+    }
+    if (!realtime) {
+        return written;
+    }
+    uint64_t elapsed = (uint64_t)(now - startTime) * rate / 1000;
+    return (uint32_t)std::min<uint64_t>(written, playedBase + elapsed);
+}
+
+void SimulatedSpeaker::Start(unsigned long now) {
+    if (stats.bufferedTime == 0 && stats.underruns == 0) {
+        stats.bufferedTime = now - beginTime;
+    }
+    startTime = now;
+    playing = true;
+    Trace_Mark(TRACE_PLAYBACK_START, written - playedBase);
+}
+
+/**
+ * @brief Resamples to the DAC rate and appends to the output file, as the player task does.
+ */
+void SimulatedSpeaker::Output(const int16_t *samples, size_t count) {
+    int16_t resampled[2 * PLAYER_DMA_BUF_LEN];
+    uint8_t dac[2 * PLAYER_DMA_BUF_LEN];
+    size_t step = Resampler_MaxInput(resampler, 2 * PLAYER_DMA_BUF_LEN);
+    for (size_t pos = 0; pos < count; pos += step) {
+        size_t n = std::min(step, count - pos);
+        size_t produced = Resampler_Process(resampler, samples + pos, n, resampled);
+        for (size_t i = 0; i < produced; i++) {
+            dac[i] = (uint8_t)(((uint16_t)resampled[i] ^ 0x8000) >> 8);
+        }
+        fwrite(dac, 1, produced, output);
+        outputWritten += produced;
+    }
+}
+
+/**
+ * @brief Queues samples, blocking while the simulated ring is full.
+ *
+ * @return `len`, 0 once the playback was interrupted.
+ */
+size_t SimulatedSpeaker::Write(const uint8_t *data, size_t len) {
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned long now = Hal_Millis();
+    if (realtime && playing && Played(now) >= written) {
+        // The DAC ran dry before this block arrived: re-buffer up to the watermark. Without real
+        // time pacing the DAC drains instantly, every write would look like an underrun
+        stats.underruns++;
+        playedBase = written;
+        playing = false;
+    }
+    while (realtime && playing && !interrupted && written + len - Played(now) > PLAYER_RING_SIZE) {
+        lock.unlock();
+        Hal_DelayMs(1);
+        lock.lock();
+        now = Hal_Millis();
+    }
+    if (interrupted) {
+        return 0;
+    }
+    if (output) {
+        std::vector<int16_t> samples(len);
+        for (size_t i = 0; i < len; i++) {
+            samples[i] = (int16_t)((data[i] - 128) << 8);
+        }
+        Output(samples.data(), len);
+    }
+    for (size_t i = 0; i < len; i++) {
+        recent[(written + i) % sizeof(recent)] = data[i];
+    }
+    written += len;
+    size_t fill = written - Played(now);
+    if (fill > stats.maxFill) {
+        stats.maxFill = fill;
+    }
+    if (!playing && written - playedBase >= PLAYER_PREBUFFER) {
+        Start(now);
+    }
+    return len;
+}
+
+/**
+ * @brief Marks the end of the stream, starts playback of a stream shorter than the watermark.
+ */
+void SimulatedSpeaker::End() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!playing && !interrupted && written > playedBase) {
+        Start(Hal_Millis());
+    }
+}
+
+/**
+ * @brief Waits until the simulated DAC has played everything, then closes the output file.
+ */
+void SimulatedSpeaker::WaitDone() {
+    while (Playing()) {
+        Hal_DelayMs(1);
+    }
+    Stop();
+}
+
+/**
+ * @brief Ends the stream where the simulated DAC is, the output file keeps what was played.
+ */
+void SimulatedSpeaker::Stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    playedBase = Played(Hal_Millis());
+    playing = false;
+    stats.samplesPlayed = playedBase;
+    CloseOutput();
+}
+
+/**
+ * @brief Flushes the resampler into the output file, trims what was not played and patches the header.
+ */
+void SimulatedSpeaker::CloseOutput() {
+    if (!output) {
+        return;
+    }
+    int16_t silence[RESAMPLER_TAPS] = {};
+    Output(silence, RESAMPLER_TAPS); // the last samples are still in the resampler history
+    if (playedBase < written) {
+        // Interrupted: the samples still in the ring never reached the DAC
+        uint32_t played = (uint32_t)((uint64_t)playedBase * PLAYER_OUTPUT_RATE / rate);
+        outputWritten = std::min(outputWritten, played);
+        fflush(output);
+        if (ftruncate(fileno(output), WAV_HEADER_SIZE + outputWritten) != 0) {
+            Hal_Log("Cannot trim the speaker output\n");
+        }
+    }
+    WavHeader header = PlaybackFormat::Header(outputWritten);
+    fseek(output, 0, SEEK_SET);
+    fwrite(header.bytes, 1, sizeof(header.bytes), output);
+    fclose(output);
+    output = NULL;
+}
+
+/**
+ * @brief Checks whether samples are left to play, WaitDone() would block.
+ */
+bool SimulatedSpeaker::Playing() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return playing && realtime && Played(Hal_Millis()) < written;
+}
+
+uint32_t SimulatedSpeaker::Position() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Played(Hal_Millis());
+}
+
+/**
+ * @brief Freezes the simulated DAC where it is, later writes are dropped until the next Begin().
+ */
+void SimulatedSpeaker::Interrupt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    playedBase = Played(Hal_Millis());
+    playing = false;
+    interrupted = true;
+}
+
+/**
+ * @brief Adds what the microphone hears of the speaker to `count` samples captured just now.
+ *
+ * The samples played during the capture are stretched from the stream rate to I2S_SAMPLE_RATE
+ * (nearest neighbour) and scaled by `percent`.
+ */
+void SimulatedSpeaker::Echo(int16_t *samples, size_t count, int percent) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!playing) {
+        return;
+    }
+    uint32_t played = Played(Hal_Millis());
+    uint32_t span = (uint32_t)((uint64_t)count * rate / I2S_SAMPLE_RATE);
+    uint32_t first = played > span ? played - span : 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t index = first + (uint32_t)((uint64_t)i * rate / I2S_SAMPLE_RATE);
+        if (index >= played) {
+            break;
+        }
+        int32_t echo = ((int32_t)recent[index % sizeof(recent)] - 128) * 256 * percent / 100;
+        int32_t value = samples[i] + echo;
+        samples[i] = (int16_t)std::max<int32_t>(-32768, std::min<int32_t>(32767, value));
+    }
+}
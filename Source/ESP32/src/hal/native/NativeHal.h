@@ -0,0 +1,213 @@
+#pragma once
+
+#include <Hal.h>
+#include <Config.h>
+#include <Resampler.h>
+#include <stdio.h>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+Native host implementation of the hardware abstraction layer:
+    Runs the unmodified voice pipeline on a PC against a real server, so the end-to-end latency
+    of every stage can be measured without a device on the desk.
+    - The microphone replays a 16-bit mono WAV fixture at I2S_SAMPLE_RATE, optionally with the
+      speaker output mixed in (echo) and replayed again during the response (barge-in)
+    - The button stays pressed until the fixture has been played once
+    - The speaker drains at the response sample rate (or instantly with realtime = false)
+*/
+
+class SimulatedSpeaker;
+
+/**
+ * @brief Replays a WAV fixture as I2S samples, paced like the real microphone.
+ *
+ * Samples are emitted in the raw INMP441 layout expected by Kernel_DacScale<3>, so the pipeline
+ * sees the high byte of every fixture sample. Reads past the end return silence.
+ */
+class WavMicrophone : public AudioInput
+{
+public:
+    bool Load(const char *path);
+    void SetRealtime(bool enabled) { realtime = enabled; }
+    bool Exhausted() const { return position.load() >= samples.size(); }
+    uint64_t BeginTime() const { return beginMicros.load(); }
+    uint64_t ExhaustedTime() const { return exhaustedMicros.load(); }
+    void AddListener(HalEvent event) { listeners.push_back(event); } // Signaled at Begin() and when the fixture runs out
+    // Mixes `percent` of what the speaker is playing into the samples
+    void SetEcho(SimulatedSpeaker *source, int percent) { echoSource = source; echoPercent = percent; }
+    // Rewinds the fixture `ms` after it ran out while the capture keeps reading: a press during the response
+    void SetBargeIn(uint32_t ms) { bargeInSamples = (uint64_t)ms * I2S_SAMPLE_RATE / 1000; }
+    // When not paced, holds each read back while `backlogged` returns true instead of running ahead of the consumer
+    void SetBackpressure(bool (*backlogged)()) { backpressure = backlogged; }
+
+    bool Begin() override;
+    size_t Read(uint8_t *buffer, size_t len) override;
+    void End() override {}
+
+private:
+    std::vector<int16_t> samples;
+    std::atomic<size_t> position{0}; // Read by the scripted button from the voice task
+    std::atomic<uint64_t> beginMicros{0};
+    std::atomic<uint64_t> exhaustedMicros{0};
+    std::vector<HalEvent> listeners;
+    std::vector<int16_t> scratch;
+    uint64_t delivered = 0;       // Samples delivered since Begin(), for pacing
+    uint64_t exhaustedAt = 0;     // `delivered` when the fixture ran out
+    uint64_t bargeInSamples = 0;  // Silence before the fixture is replayed, 0: never
+    unsigned long beginTime = 0;
+    bool realtime = true;
+    SimulatedSpeaker *echoSource = NULL;
+    int echoPercent = 0;
+    bool (*backpressure)() = NULL;
+
+    void Rewind();
+};
+
+/**
+ * @brief A stdio file.
+ */
+class PosixFile : public StorageFile
+{
+public:
+    explicit PosixFile(FILE *f) : file(f) {}
+    size_t Write(const uint8_t *data, size_t len) override;
+    size_t Read(uint8_t *data, size_t len) override;
+    bool Seek(uint32_t position) override;
+    size_t Size() override;
+    void Close() override;
+
+private:
+    FILE *file;
+};
+
+/**
+ * @brief Files below a host directory, which plays the role of the flash root.
+ */
+class PosixStorage : public Storage
+{
+public:
+    explicit PosixStorage(const char *rootDir) : root(rootDir) {}
+    bool Begin() override;
+    StorageFile *Open(const char *path, bool write) override;
+    bool Exists(const char *path) override;
+    bool Remove(const char *path) override;
+    void List(void (*callback)(const char *name, size_t size)) override;
+
+private:
+    std::string Path(const char *path) const { return root + path; }
+    std::string root;
+};
+
+/**
+ * @brief A file mapped into memory that behaves like NOR flash: Erase() sets 0xFF, Write() only
+ *        clears bits. A write that would set a bit is reported, it is a bug of the writer.
+ */
+class FileFlash : public FlashRegion
+{
+public:
+    FileFlash(const char *filePath, uint32_t regionSize) : path(filePath), size(regionSize) {}
+    ~FileFlash();
+    bool Begin() override;
+    uint32_t Size() override { return size; }
+    bool Erase(uint32_t offset, uint32_t len) override;
+    bool Write(uint32_t offset, const uint8_t *data, size_t len) override;
+    const uint8_t *Map() override { return mapped; }
+
+private:
+    std::string path;
+    uint32_t size;
+    uint8_t *mapped = NULL;
+    bool reported = false;
+};
+
+/**
+ * @brief TCP connection over a POSIX socket.
+ */
+class SocketTransport : public Transport
+{
+public:
+    ~SocketTransport() { Stop(); }
+    bool Connect(const char *host, uint16_t port) override;
+    size_t Write(const uint8_t *data, size_t len) override;
+    int Read(uint8_t *buffer, size_t len, uint32_t timeoutMs) override;
+    bool Connected() override;
+    void Stop() override;
+    bool LinkUp() override { return true; } // the host network is not managed
+
+private:
+    int fd = -1;
+};
+
+/**
+ * @brief Holds the button down while the microphone has fixture audio left.
+ *
+ * The press edge is the rewind of the fixture and the release edge is its last sample, both
+ * are signaled by the microphone so the voice task sleeps as it does on the device.
+ */
+class ScriptedControls : public Controls
+{
+public:
+    explicit ScriptedControls(WavMicrophone &mic);
+    bool ButtonPressed() override { return !microphone.Exhausted(); }
+    bool WaitButton(bool pressed, uint32_t timeoutMs) override;
+    uint64_t ButtonEdgeTime() override;
+    void SetButtonEvent(HalEvent event) override { microphone.AddListener(event); }
+    void SetLed(bool on) override { (void)on; }
+
+private:
+    WavMicrophone &microphone;
+    HalEvent edge;
+};
+
+/**
+ * @brief Simulated DAC player: same watermark and ring size as Player.h, optionally writes a WAV.
+ *
+ * Playback starts once PLAYER_PREBUFFER bytes are buffered (or at End()) and then consumes
+ * samples at the stream rate. Writes block while the simulated ring is full, which applies the
+ * same back pressure to the network reader as the device. The WAV holds what the DAC receives:
+ * the stream resampled to PLAYER_OUTPUT_RATE, unsigned 8-bit.
+ */
+class SimulatedSpeaker : public AudioOutput
+{
+public:
+    void SetRealtime(bool enabled) { realtime = enabled; }
+    void SetOutputFile(const char *path) { outputPath = path ? path : ""; }
+
+    void Begin(uint32_t sampleRate) override;
+    size_t Write(const uint8_t *data, size_t len) override;
+    void End() override;
+    void WaitDone() override;
+    void Stop() override;
+    const PlayerStats &GetStats() override { return stats; }
+    bool Playing() override;
+    uint32_t Position() override;
+    void Interrupt() override;
+    void Echo(int16_t *samples, size_t count, int percent);
+
+private:
+    uint32_t Played(unsigned long now);
+    void Start(unsigned long now);
+    void Output(const int16_t *samples, size_t count);
+    void CloseOutput();
+
+    std::mutex mutex;             // The state below is also used by the capture task (Position, Echo, Interrupt)
+    std::string outputPath;
+    FILE *output = NULL;
+    ResamplerState resampler;
+    uint32_t outputWritten = 0;   // DAC samples in the output file
+    PlayerStats stats = {};
+    uint32_t rate = 8000;
+    uint32_t written = 0;         // Samples written since Begin()
+    uint32_t playedBase = 0;      // Samples consumed before the current playback run
+    unsigned long beginTime = 0;
+    unsigned long startTime = 0;
+    bool playing = false;
+    bool interrupted = false;     // Interrupt() since Begin(), writes are dropped
+    bool realtime = true;
+    uint8_t recent[2 * PLAYER_RING_SIZE]; // Last samples written, source of the echo
+};
+
+void NativeHal_SetLogging(bool enabled);
@@ -0,0 +1,163 @@
+#include "ResampleTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Resampler.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define TOOL_AMPLITUDE 16000.0  // Tone amplitude, half of full scale leaves room for the filter overshoot
+#define TOOL_BLOCK 128          // Input samples per Resampler_Process() call, as the player
+
+struct ToneResult
+{
+    double snrDb;
+    double gainDb;
+};
+
+/**
+ * @brief Resamples `input` in player-sized blocks.
+ *
+ * @return Host CPU time in microseconds.
+ */
+static uint64_t Tool_Run(ResamplerState &state, const std::vector<int16_t> &input, std::vector<int16_t> &output)
+{
+    output.resize(Resampler_MaxOutput(state, input.size()) + TOOL_BLOCK);
+    size_t produced = 0;
+    uint64_t start = Hal_Micros();
+    for (size_t pos = 0; pos < input.size(); pos += TOOL_BLOCK) {
+        size_t count = input.size() - pos < TOOL_BLOCK ? input.size() - pos : TOOL_BLOCK;
+        produced += Resampler_Process(state, input.data() + pos, count, output.data() + produced);
+    }
+    uint64_t elapsed = Hal_Micros() - start;
+    output.resize(produced);
+    return elapsed;
+}
+
+/**
+ * @brief Resamples a tone and compares the output with the exact sine at the output instants.
+ */
+static ToneResult Tool_Tone(uint32_t inRate, uint32_t outRate, double hz, double seconds)
+{
+    static ResamplerState state;
+    Resampler_Init(state, inRate, outRate);
+    std::vector<int16_t> input((size_t)(seconds * inRate));
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = (int16_t)lrint(TOOL_AMPLITUDE * sin(2.0 * M_PI * hz * i / inRate));
+    }
+    std::vector<int16_t> output;
+    Tool_Run(state, input, output);
+
+    // Output j lies RESAMPLER_TAPS / 2 input samples before input j * down / up
+    double signal = 0.0, noise = 0.0, measured = 0.0;
+    size_t first = (size_t)RESAMPLER_TAPS * outRate / inRate + RESAMPLER_TAPS; // past the silent history
+    size_t last = output.size() > (size_t)RESAMPLER_TAPS ? output.size() - RESAMPLER_TAPS : 0;
+    for (size_t j = first; j < last; j++) {
+        double t = (double)j * state.down / state.up - RESAMPLER_TAPS / 2;
+        double expected = TOOL_AMPLITUDE * sin(2.0 * M_PI * hz * t / inRate);
+        double error = output[j] - expected;
+        signal += expected * expected;
+        noise += error * error;
+        measured += (double)output[j] * output[j];
+    }
+    ToneResult result;
+    result.snrDb = noise > 0.0 ? 10.0 * log10(signal / noise) : 200.0;
+    result.gainDb = signal > 0.0 ? 10.0 * log10(measured / signal) : 0.0;
+    return result;
+}
+
+/**
+ * @brief Checks one conversion.
+ *
+ * @return false if a passband tone is below RESAMPLE_MIN_SNR_DB.
+ */
+static bool Tool_Check(uint32_t inRate, uint32_t outRate, double seconds)
+{
+    double nyquist = (inRate < outRate ? inRate : outRate) / 2.0;
+    printf("%6u -> %6u Hz\n", (unsigned)inRate, (unsigned)outRate);
+    bool passed = true;
+    const double fractions[] = {0.05, 0.25, RESAMPLE_PASSBAND, 0.75};
+    for (double fraction : fractions) {
+        double hz = nyquist * fraction;
+        ToneResult tone = Tool_Tone(inRate, outRate, hz, seconds);
+        bool checked = fraction <= RESAMPLE_PASSBAND;
+        bool ok = !checked || tone.snrDb >= RESAMPLE_MIN_SNR_DB;
+        passed = passed && ok;
+        printf("  tone %7.1f Hz: SNR %6.1f dB, gain %+6.2f dB%s\n", hz, tone.snrDb, tone.gainDb,
+               !checked ? "  (transition band)" : ok ? "" : "  FAIL");
+    }
+    if (inRate > outRate) {
+        // A tone the output cannot represent must be filtered out, not folded back
+        static ResamplerState state;
+        Resampler_Init(state, inRate, outRate);
+        double hz = (outRate / 2.0 + inRate / 2.0) / 2.0;
+        std::vector<int16_t> input((size_t)(seconds * inRate));
+        for (size_t i = 0; i < input.size(); i++) {
+            input[i] = (int16_t)lrint(TOOL_AMPLITUDE * sin(2.0 * M_PI * hz * i / inRate));
+        }
+        std::vector<int16_t> output;
+        Tool_Run(state, input, output);
+        double energy = 0.0;
+        for (size_t j = RESAMPLER_TAPS; j < output.size(); j++) {
+            energy += (double)output[j] * output[j];
+        }
+        double rms = sqrt(energy / (output.size() > RESAMPLER_TAPS ? output.size() - RESAMPLER_TAPS : 1));
+        printf("  stopband %7.1f Hz: %6.1f dB\n", hz, 20.0 * log10((rms + 1e-9) / (TOOL_AMPLITUDE / sqrt(2.0))));
+    }
+
+    // Throughput, over noise
+    static ResamplerState state;
+    Resampler_Init(state, inRate, outRate);
+    std::vector<int16_t> input((size_t)(seconds * inRate));
+    srand(1);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = (int16_t)(rand() % 32768 - 16384);
+    }
+    std::vector<int16_t> output;
+    uint64_t us = Tool_Run(state, input, output);
+    double perSecond = us > 0 ? output.size() * 1e6 / us : 0.0;
+    printf("  throughput: %.1f M output samples/s (%.0fx real time)\n", perSecond / 1e6, perSecond / outRate);
+    return passed;
+}
+
+/**
+ * @brief Entry point of `program resample ...`, argv[0] is "resample".
+ */
+int ResampleTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    uint32_t inRate = 0, outRate = 0;
+    double seconds = 2.0;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--in") && hasValue) {
+            inRate = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--out") && hasValue) {
+            outRate = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: resample [--in RATE --out RATE] [--seconds N]\n");
+            return 2;
+        }
+    }
+    if ((inRate == 0) != (outRate == 0) || seconds <= 0.0) {
+        fprintf(stderr, "Usage: resample [--in RATE --out RATE] [--seconds N]\n");
+        return 2;
+    }
+
+    printf("%d taps, %d phases\n", RESAMPLER_TAPS, RESAMPLER_PHASES);
+    bool passed = true;
+    if (inRate != 0) {
+        passed = Tool_Check(inRate, outRate, seconds);
+    } else {
+        const uint32_t rates[] = {8000, 11025, 16000, 22050, 24000, 44100};
+        for (uint32_t rate : rates) {
+            passed = Tool_Check(rate, PLAYER_OUTPUT_RATE, seconds) && passed;
+        }
+    }
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
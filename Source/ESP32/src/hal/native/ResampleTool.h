@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+Resampler check (host):
+    program resample [--in RATE --out RATE] [--seconds N]
+        Runs Resampler.h over sine tones and reports, per conversion, the signal-to-noise ratio and
+        gain of the output against the exact sine (passband tones), the level left of a tone above
+        the output Nyquist frequency (stopband, downsampling only) and the throughput in output
+        samples per second of host CPU. Without --in/--out the conversions the player meets are
+        checked (response rates to PLAYER_OUTPUT_RATE). Exits with 1 if a passband tone is below
+        RESAMPLE_MIN_SNR_DB. The tone at 3/4 of the lower Nyquist frequency is only reported: it
+        falls in the transition band when downsampling, where the filter spans fewer output samples.
+*/
+
+#define RESAMPLE_MIN_SNR_DB 60.0
+#define RESAMPLE_PASSBAND 0.5   // Checked tones, as a fraction of the lower Nyquist frequency
+
+int ResampleTool_Main(int argc, char **argv);
@@ -0,0 +1,189 @@
+#include "SynthTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <AudioFormat.h>
+#include <Synth.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define TOOL_PITCH 120          // Pitch of the built-in script (Hz)
+
+// Built-in script: every phoneme of the table between two vowels
+static const char toolSymbols[] = "aEeiOouU7@mnNJlwjvzGfsxhpbtTdkc";
+
+struct SynthRun
+{
+    uint64_t samples;
+    uint64_t us;                // Host CPU time
+    uint32_t worstUs;           // Slowest block
+    int32_t peak;
+    double energy;
+    uint64_t clipped;
+};
+
+static void Tool_AddUnit(std::vector<uint8_t> &script, char symbol, uint32_t ms, uint32_t startHz, uint32_t endHz)
+{
+    script.push_back((uint8_t)symbol);
+    script.push_back((uint8_t)(ms / SYNTH_UNIT_MS));
+    script.push_back((uint8_t)(startHz / SYNTH_PITCH_STEP));
+    script.push_back((uint8_t)(endHz / SYNTH_PITCH_STEP));
+}
+
+static void Tool_BuiltinScript(std::vector<uint8_t> &script)
+{
+    for (const char *symbol = toolSymbols; *symbol; symbol++) {
+        bool vowel = strchr("aEeiOouU7@", *symbol) != NULL;
+        Tool_AddUnit(script, 'a', 120, TOOL_PITCH, TOOL_PITCH);
+        Tool_AddUnit(script, *symbol, vowel ? 200 : 100, TOOL_PITCH, TOOL_PITCH - 6);
+        Tool_AddUnit(script, 'a', 150, TOOL_PITCH - 6, TOOL_PITCH - 20);
+        Tool_AddUnit(script, '_', 150, 0, 0);
+    }
+}
+
+/**
+ * @brief Reads the units of a phoneme response body (WAV header, then units).
+ */
+static bool Tool_LoadScript(const char *path, std::vector<uint8_t> &script)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> body;
+    uint8_t block[4096];
+    size_t len;
+    while ((len = fread(block, 1, sizeof(block), file)) > 0) {
+        body.insert(body.end(), block, block + len);
+    }
+    fclose(file);
+    WavParser parser;
+    Wav_ParserReset(parser);
+    size_t header = Wav_Parse(parser, body.data(), body.size());
+    if (parser.state != WAV_PARSE_DONE) {
+        return false;
+    }
+    script.assign(body.begin() + header, body.end());
+    return true;
+}
+
+/**
+ * @brief Renders the script once, feeding it as the response body arrives.
+ */
+static void Tool_Render(const std::vector<uint8_t> &script, uint32_t rate, SynthRun &run, std::vector<int16_t> *output)
+{
+    static SynthState state;
+    static int16_t block[SYNTH_TOOL_BLOCK];
+    Synth_Begin(state, rate);
+    size_t pos = 0;
+    while (pos < script.size()) {
+        pos += Synth_Feed(state, script.data() + pos, script.size() - pos);
+        for (;;) {
+            uint64_t start = Hal_Micros();
+            size_t count = Synth_Render(state, block, SYNTH_TOOL_BLOCK);
+            uint32_t elapsed = (uint32_t)(Hal_Micros() - start);
+            if (count == 0) {
+                break;
+            }
+            run.us += elapsed;
+            run.worstUs = elapsed > run.worstUs ? elapsed : run.worstUs;
+            run.samples += count;
+            for (size_t i = 0; i < count; i++) {
+                int32_t level = abs((int32_t)block[i]);
+                run.peak = level > run.peak ? level : run.peak;
+                run.energy += (double)block[i] * block[i];
+                run.clipped += level >= 32767;
+            }
+            if (output) {
+                output->insert(output->end(), block, block + count);
+            }
+        }
+    }
+}
+
+static bool Tool_WriteWav(const char *path, const std::vector<int16_t> &samples, uint32_t rate)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    uint32_t bytes = (uint32_t)(samples.size() * 2);
+    WavHeader header = Wav_MakeHeader(rate, 16, 1, WAV_HEADER_SIZE - 8 + bytes, bytes);
+    fwrite(header.bytes, 1, sizeof(header.bytes), file);
+    fwrite(samples.data(), 2, samples.size(), file);
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Entry point of `program synth ...`, argv[0] is "synth".
+ */
+int SynthTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    uint32_t rate = PLAYER_OUTPUT_RATE;
+    double seconds = 10.0;
+    const char *outPath = NULL;
+    const char *scriptPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--rate") && hasValue) {
+            rate = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--out") && hasValue) {
+            outPath = argv[++i];
+        } else if (argv[i][0] != '-' && !scriptPath) {
+            scriptPath = argv[i];
+        } else {
+            fprintf(stderr, "Usage: synth [--rate HZ] [--seconds N] [--out PATH] [script.wav]\n");
+            return 2;
+        }
+    }
+    if (rate == 0 || seconds <= 0.0) {
+        fprintf(stderr, "Usage: synth [--rate HZ] [--seconds N] [--out PATH] [script.wav]\n");
+        return 2;
+    }
+
+    std::vector<uint8_t> script;
+    if (scriptPath) {
+        if (!Tool_LoadScript(scriptPath, script)) {
+            fprintf(stderr, "Cannot read the phoneme response %s\n", scriptPath);
+            return 2;
+        }
+    } else {
+        Tool_BuiltinScript(script);
+    }
+    if (script.size() < SYNTH_UNIT_SIZE) {
+        fprintf(stderr, "No phoneme units\n");
+        return 2;
+    }
+
+    SynthRun run = {};
+    std::vector<int16_t> first;
+    Tool_Render(script, rate, run, &first);
+    uint64_t passes = 1;
+    while (run.samples < seconds * rate) {
+        Tool_Render(script, rate, run, NULL);
+        passes++;
+    }
+    if (outPath && !Tool_WriteWav(outPath, first, rate)) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 2;
+    }
+
+    double audioSeconds = (double)run.samples / rate;
+    double blockUs = SYNTH_TOOL_BLOCK * 1e6 / rate;
+    double rms = sqrt(run.energy / (run.samples ? run.samples : 1));
+    printf("%u units, %.2f s of audio at %u Hz, rendered %llu times\n", (unsigned)(script.size() / SYNTH_UNIT_SIZE),
+           (double)first.size() / rate, (unsigned)rate, (unsigned long long)passes);
+    printf("speed: %.0fx real time, slowest block %u us of %.0f us\n", run.us > 0 ? audioSeconds * 1e6 / run.us : 0.0,
+           (unsigned)run.worstUs, blockUs);
+    printf("level: peak %.1f dBFS, RMS %.1f dBFS, %llu clipped samples\n", 20.0 * log10((run.peak + 1e-9) / 32768.0),
+           20.0 * log10((rms + 1e-9) / 32768.0), (unsigned long long)run.clipped);
+    bool passed = run.clipped == 0 && run.us < audioSeconds * 1e6;
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
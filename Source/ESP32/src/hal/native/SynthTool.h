@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+Phoneme synthesizer check (host):
+    program synth [--rate HZ] [--seconds N] [--out PATH] [script.wav]
+        Renders a phoneme script with Synth.h in the blocks the player uses (Response.cpp) and
+        reports the speed against real time (whole script and slowest block against its duration),
+        the peak and RMS levels and the clipped samples. Without a script every phoneme of the
+        table is rendered between two vowels; a script is a phoneme response body written by
+        Source/PC/phonemes.py --out, rendered at --rate (default PLAYER_OUTPUT_RATE) rather than
+        the rate of its header. The script is repeated for the timing until N seconds of audio
+        (default 10) have been rendered. --out writes the first pass as a 16-bit WAV file to listen
+        to. Exits with 1 if a sample clipped or the rendering was slower than real time.
+*/
+
+#define SYNTH_TOOL_BLOCK (RESPONSE_READ_LEN * 2)   // Samples per Synth_Render() call, as Response.cpp
+
+int SynthTool_Main(int argc, char **argv);
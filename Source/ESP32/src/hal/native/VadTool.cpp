@@ -0,0 +1,222 @@
+#include "VadTool.h"
+#include "NativeHal.h"
+#include <Config.h>
+#include <Vad.h>
+#include <SampleKernels.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct VadRun
+{
+    bool started;
+    bool ended;
+    long keptStartMs;  // Range the voice task uploads
+    long keptEndMs;
+    long onsetMs;      // First speech frame
+    long offsetMs;     // End of the last speech frame, -1 if the utterance is still open
+    uint32_t speechFrames;
+    uint32_t silenceFrames;
+    uint64_t busyUs;
+};
+
+/**
+ * @brief Reads a WAV fixture through the device sample path: raw I2S layout, then Kernel_DacScale<3>.
+ */
+static bool Tool_LoadSamples(const char *path, std::vector<int16_t> &samples)
+{
+    WavMicrophone microphone;
+    if (!microphone.Load(path)) {
+        return false;
+    }
+    microphone.SetRealtime(false);
+    microphone.Begin();
+    alignas(4) uint8_t block[I2S_READ_LEN];
+    samples.clear();
+    while (!microphone.Exhausted()) {
+        size_t len = microphone.Read(block, sizeof(block));
+        Kernel_DacScale<3>(block, block, len);
+        const int16_t *pcm = (const int16_t *)block;
+        samples.insert(samples.end(), pcm, pcm + len / 2);
+    }
+    return true;
+}
+
+static long Tool_Ms(int64_t samples)
+{
+    return (long)(samples * 1000 / I2S_SAMPLE_RATE);
+}
+
+/**
+ * @brief Runs the detector over the fixture in blocks of `blockSamples`.
+ *
+ * @param endSample Set to one past the block in which the utterance ended.
+ */
+static VadRun Tool_Run(const std::vector<int16_t> &samples, size_t blockSamples, int64_t &endSample)
+{
+    static VadState state;
+    Vad_Init(state, Vad_DefaultConfig(I2S_SAMPLE_RATE));
+    VadRun run = {false, false, -1, -1, -1, -1, 0, 0, 0};
+    int64_t firstFrame = 0, keptStart = 0, keptEnd = 0;
+    for (size_t pos = 0; pos < samples.size(); pos += blockSamples) {
+        size_t count = samples.size() - pos < blockSamples ? samples.size() - pos : blockSamples;
+        VadResult result;
+        uint64_t start = Hal_Micros();
+        Vad_Process(state, samples.data() + pos, count, result);
+        run.busyUs += Hal_Micros() - start;
+        if (state.started && !run.started) {
+            // The preroll may reach into the previous block (carryOver)
+            run.started = true;
+            keptStart = (int64_t)(pos + result.keepStart) - (int64_t)result.carryOver;
+            firstFrame = keptStart + state.prerollSamples;
+            keptStart = keptStart > 0 ? keptStart : 0;
+        }
+        if (run.started) {
+            keptEnd = (int64_t)(pos + result.keepEnd);
+        }
+        if (result.ended) {
+            run.ended = true;
+            endSample = (int64_t)(pos + count);
+            break;
+        }
+    }
+    run.speechFrames = state.speechFrames;
+    run.silenceFrames = state.silenceFrames;
+    if (run.started) {
+        run.keptStartMs = Tool_Ms(keptStart);
+        run.keptEndMs = Tool_Ms(keptEnd);
+        run.onsetMs = Tool_Ms(firstFrame);
+    }
+    return run;
+}
+
+/**
+ * @brief Runs the detector in capture blocks, as the voice task does (kept range, CPU time), then
+ *        frame by frame to place the end of the utterance: the streamed blocks before the end are
+ *        uploaded whole, so the kept range does not show where the speech stopped.
+ */
+static VadRun Tool_Detect(const std::vector<int16_t> &samples)
+{
+    int64_t endSample = 0;
+    VadRun run = Tool_Run(samples, I2S_READ_LEN / 2, endSample);
+    if (run.ended) {
+        VadRun frames = Tool_Run(samples, (size_t)I2S_SAMPLE_RATE * VAD_FRAME_MS / 1000, endSample);
+        // The end is declared VAD_END_SILENCE_MS after the hangover of the last speech frame
+        run.offsetMs = Tool_Ms(endSample) - VAD_END_SILENCE_MS - VAD_HANGOVER_MS;
+        run.onsetMs = frames.onsetMs;
+    }
+    return run;
+}
+
+/**
+ * @brief Runs one fixture and prints its line.
+ *
+ * @param startMs Labelled speech start, -1 for a fixture without speech, -2 without a label.
+ * @return false if the fixture is labelled and fails.
+ */
+static bool Tool_Report(const char *path, long startMs, long endMs, long toleranceMs)
+{
+    std::vector<int16_t> samples;
+    if (!Tool_LoadSamples(path, samples)) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return false;
+    }
+    VadRun run = Tool_Detect(samples);
+    char offset[24] = "open";
+    if (!run.started || run.ended) {
+        snprintf(offset, sizeof(offset), "%ld", run.offsetMs);
+    }
+    bool ok = true;
+    const char *verdict = "";
+    if (startMs == -1) {
+        ok = !run.started;
+        verdict = ok ? "  ok" : "  FAIL (speech in a silent fixture)";
+    } else if (startMs >= 0) {
+        long endError = run.ended ? labs(run.offsetMs - endMs) : 0;
+        ok = run.started && labs(run.onsetMs - startMs) <= toleranceMs && endError <= toleranceMs;
+        verdict = ok ? "  ok" : "  FAIL";
+    }
+    double seconds = (double)samples.size() / I2S_SAMPLE_RATE;
+    printf("%-32s %8ld %8ld %8ld %8s", path, run.keptStartMs, run.keptEndMs, run.onsetMs, offset);
+    if (startMs >= 0) {
+        printf(" %8ld %8ld", startMs, endMs);
+    } else {
+        printf(" %8s %8s", "-", "-");
+    }
+    printf(" %6u %6u %8.1f%s\n", (unsigned)run.speechFrames, (unsigned)run.silenceFrames,
+           seconds > 0.0 ? run.busyUs / seconds : 0.0, verdict);
+    return ok;
+}
+
+/**
+ * @brief Entry point of `program vad ...`, argv[0] is "vad".
+ */
+int VadTool_Main(int argc, char **argv)
+{
+    NativeHal_SetLogging(false);
+    long toleranceMs = VAD_TOOL_TOLERANCE_MS;
+    const char *labelsPath = NULL;
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--tolerance") && hasValue) {
+            toleranceMs = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--labels") && hasValue) {
+            labelsPath = argv[++i];
+        } else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            files.clear();
+            labelsPath = NULL;
+            break;
+        }
+    }
+    if (!labelsPath && files.empty()) {
+        fprintf(stderr, "Usage: vad [--tolerance MS] [--labels labels.csv] [file.wav ...]\n");
+        return 2;
+    }
+
+    printf("%-32s %8s %8s %8s %8s %8s %8s %6s %6s %8s\n", "file", "kept_ms", "to_ms", "onset", "offset",
+           "label", "to", "speech", "silent", "us/s");
+    unsigned labelled = 0, failed = 0;
+    for (const char *path : files) {
+        Tool_Report(path, -2, -2, toleranceMs);
+    }
+    if (labelsPath) {
+        FILE *labels = fopen(labelsPath, "r");
+        if (!labels) {
+            fprintf(stderr, "Cannot open %s\n", labelsPath);
+            return 1;
+        }
+        std::string baseDir(labelsPath);
+        size_t slash = baseDir.rfind('/');
+        baseDir = slash == std::string::npos ? "" : baseDir.substr(0, slash + 1);
+        char line[512];
+        while (fgets(line, sizeof(line), labels)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '#' || line[0] == '\0') {
+                continue;
+            }
+            long startMs = -1, endMs = -1;
+            char *times = strchr(line, ',');
+            if (times) {
+                *times++ = '\0';
+                char *end = strchr(times, ',');
+                if (!end) {
+                    fprintf(stderr, "Bad line: %s\n", line);
+                    continue;
+                }
+                startMs = atol(times);
+                endMs = atol(end + 1);
+            }
+            std::string path = line[0] == '/' ? std::string(line) : baseDir + line;
+            labelled++;
+            failed += !Tool_Report(path.c_str(), startMs, endMs, toleranceMs);
+        }
+        fclose(labels);
+        printf("\n%u/%u labelled fixtures within %ld ms\n", labelled - failed, labelled, toleranceMs);
+    }
+    return failed ? 1 : 0;
+}
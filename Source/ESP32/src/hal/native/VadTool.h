@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+Voice activity detector check (host):
+    program vad [--tolerance MS] [--labels labels.csv] [file.wav ...]
+        Runs Vad.h over WAV fixtures in capture blocks (I2S_READ_LEN), through the same sample path
+        as the device (raw I2S layout, Kernel_DacScale<3>), and prints per fixture the range the
+        voice task would upload (preroll included) and the speech it found: the onset is the start
+        of the first speech frame (kept start + VAD_PREROLL_MS), the offset the end of the last
+        speech frame (kept end - VAD_HANGOVER_MS). "open" means the fixture ended before
+        VAD_END_SILENCE_MS of silence. Also prints the speech and silence frames and the host CPU
+        time per second of audio.
+        labels.csv lines: <wav path>[,<speech start ms>,<speech end ms>], without times the fixture
+        holds no speech. Paths are relative to the CSV file, lines starting with # are ignored.
+        A labelled fixture passes if the onset and offset are within --tolerance of the labels
+        (default VAD_TOOL_TOLERANCE_MS), or if no speech is found in a fixture without speech.
+        Exits with 1 if a labelled fixture fails.
+*/
+
+#define VAD_TOOL_TOLERANCE_MS (3 * VAD_FRAME_MS)
+
+int VadTool_Main(int argc, char **argv);
@@ -0,0 +1,496 @@
+#include <App.h>
+#include <Config.h>
+#include <VoiceAssistant.h>
+#include <Trace.h>
+#include <Capture.h>
+#include <Session.h>
+#include <ClipCache.h>
+#include <BargeIn.h>
+#include <RecordLog.h>
+#include <TurnQueue.h>
+#include <Metrics.h>
+#include <Boot.h>
+#include "NativeHal.h"
+#include "KwsTool.h"
+#include "ResampleTool.h"
+#include "LoadTool.h"
+#include "SynthTool.h"
+#include "FeatureTool.h"
+#include "CodecTool.h"
+#include "KernelTool.h"
+#include "VadTool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+/*
+Native benchmark harness:
+    Runs the voice pipeline of the device (VoiceAssistant.cpp, Server.cpp) on the host against a
+    real server and reports the latency of every stage, turn by turn.
+
+    pio run -e native
+    .pio/build/native/program --wav fixture.wav --host 127.0.0.1 --port 5000 --turns 10
+
+Options:
+    --wav PATH      16-bit mono WAV replayed by the microphone (required)
+    --host HOST     Server address (default 127.0.0.1)
+    --port PORT     Server HTTP port (default 5000)
+    --session-port PORT
+                    Server session port, used when SERVER_SESSION is 1 (default 5001)
+    --turns N       Number of turns (default 5)
+    --out PATH      Write the played response of each turn to PATH (8-bit WAV at PLAYER_OUTPUT_RATE, as sent to the DAC)
+    --root DIR      Directory used as the file system (default ./native_fs), DIR.reclog stands in for the
+                    recording log partition (RecordLog.h)
+    --trace PATH    Write the latency trace (Trace.h binary blob) to PATH, for trace_report.py
+    --fast          Do not pace the microphone and speaker in real time, the microphone waits for the
+                    capture queue instead (a run with capture overruns fails)
+    --echo PERCENT  Mix PERCENT of the speaker output into the microphone (acoustic echo)
+    --barge-in MS   Replay the fixture MS ms after it ran out, over the response (BARGE_IN_ENABLE)
+    --quiet         Only print the report
+
+    program kws enroll|eval ...   Keyword spotter templates and evaluation (see KwsTool.h)
+    program resample ...          Resampler accuracy and throughput (see ResampleTool.h)
+    program reclog [--root DIR] [--bytes N]
+                                  Recording write throughput and latency, file vs recording log (default
+                                  FLASH_RECORD_SIZE bytes)
+    program load ... utterance.wav ...
+                                  Simulated devices against one server: throughput, stage percentiles,
+                                  connection errors and timeouts (see LoadTool.h)
+    program synth [script.wav]    Phoneme synthesizer speed and levels (see SynthTool.h)
+    program features [file.wav]   Log-mel front end agreement with a float reference, kernel throughput and
+                                  feature upload size (see FeatureTool.h)
+    program codec [file.wav]      Round trip SNR and encode/decode time of the wire codecs (see CodecTool.h)
+    program kernels               Sample kernels against the per-sample formulas, and their throughput
+                                  (see KernelTool.h)
+    program vad [--labels labels.csv] [file.wav ...]
+                                  Speech found by the VAD in fixtures, against their labels (see VadTool.h)
+*/
+
+struct Stage
+{
+    const char *name;
+    unsigned long (*value)(const TurnStats &stats);
+};
+
+static unsigned long Stage_Capture(const TurnStats &s) { return s.releaseTime - s.pressTime; }
+static unsigned long Stage_Upload(const TurnStats &s) { return s.lastByteSentTime - s.releaseTime; }
+static unsigned long Stage_FirstByte(const TurnStats &s) { return s.firstResponseTime - s.releaseTime; }
+static unsigned long Stage_Download(const TurnStats &s) { return s.lastResponseTime - s.firstResponseTime; }
+static unsigned long Stage_Playback(const TurnStats &s) { return s.playbackEndTime - s.releaseTime; }
+
+static const Stage stages[] = {
+    {"capture", Stage_Capture},          // Button press to end of recording
+    {"upload_tail", Stage_Upload},       // End of recording to last byte sent
+    {"first_byte", Stage_FirstByte},     // End of recording to first response byte
+    {"download", Stage_Download},        // First to last response byte
+    {"turnaround", Stage_Playback},      // End of recording to end of playback
+};
+static const size_t stageCount = sizeof(stages) / sizeof(stages[0]);
+
+static std::vector<TurnStats> results;
+static int failures = 0;
+
+/**
+ * @brief Prints the row of a turn and keeps its statistics for the summary.
+ */
+static void ReportTurn(int turn, const TurnStats &stats, bool played)
+{
+    printf("%4d", turn);
+    for (size_t s = 0; s < stageCount; s++) {
+        printf(" %12lu", played ? stages[s].value(stats) : 0);
+    }
+    printf(" %9u %9u %9u %9d\n", (unsigned)stats.uploadedBytes, (unsigned)stats.responseBytes,
+           (unsigned)stats.playback.underruns, stats.httpStatus);
+    fflush(stdout);
+    if (played) {
+        results.push_back(stats);
+    } else {
+        failures++;
+    }
+}
+
+/**
+ * @brief Turn queue listener: reports a turn once the worker has answered it.
+ */
+static void ReportJob(const TurnJob &job)
+{
+    ReportTurn(job.id, job.stats, job.stats.playback.samplesPlayed > 0);
+}
+
+// Devices of the run, shared with the boot steps
+struct NativeBoot
+{
+    WavMicrophone *microphone;
+    PosixStorage *storage;
+    SocketTransport *transport;
+    ScriptedControls *controls;
+    SimulatedSpeaker *speaker;
+    FileFlash *recordFlash;
+    const char *rootDir;
+    const char *host;
+    int port;
+    int sessionPort;
+};
+
+enum NATIVE_BOOT_STEP
+{
+    NATIVE_BOOT_STORAGE,
+    NATIVE_BOOT_CLIPS,
+    NATIVE_BOOT_PIPELINE
+};
+
+static bool Boot_Storage(void *context)
+{
+    NativeBoot &boot = *(NativeBoot *)context;
+    if (!boot.storage->Begin()) {
+        LOGE("Cannot use %s as file system", boot.rootDir);
+        return false;
+    }
+    boot.storage->Remove(RECORD_FILE_NAME);
+    return true;
+}
+
+static bool Boot_Clips(void *context)
+{
+    ClipCache_Init(*((NativeBoot *)context)->storage);
+    return true;
+}
+
+static bool Boot_Pipeline(void *context)
+{
+    NativeBoot &boot = *(NativeBoot *)context;
+    Hal platform = {boot.microphone, boot.storage, boot.transport, boot.controls, boot.speaker, boot.recordFlash};
+    VoiceAssistant_Init(platform);
+    Capture_Init(*boot.microphone);
+    boot.controls->SetButtonEvent(Capture_WakeEvent()); // a release also ends the wait for the next block
+    Server_Init(boot.host, (uint16_t)boot.port);
+    Session_Init(*boot.transport, boot.host, (uint16_t)boot.sessionPort);
+    return true;
+}
+
+#if BOOT_LIST_FILES
+static void File_LogEntry(const char *name, size_t size)
+{
+    LOGL("\t%s (%u bytes)", name, (unsigned)size);
+}
+
+static bool Boot_Files(void *context)
+{
+    ((NativeBoot *)context)->storage->List(File_LogEntry);
+    return true;
+}
+#endif
+
+// The steps of setup() that exist on the host (Boot.h), the microphone fixture is loaded before
+static const BootStep bootSteps[] = {
+    {"storage", Boot_Storage, 0, false, 1},
+    {"clips", Boot_Clips, 1 << NATIVE_BOOT_STORAGE, false, 1},
+    {"pipeline", Boot_Pipeline, 1 << NATIVE_BOOT_STORAGE | 1 << NATIVE_BOOT_CLIPS, true, 1},
+#if BOOT_LIST_FILES
+    {"files", Boot_Files, 1 << NATIVE_BOOT_STORAGE | 1 << NATIVE_BOOT_PIPELINE, false, 1},
+#endif
+};
+
+static void PrintUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s --wav PATH [--host HOST] [--port PORT] [--session-port PORT] [--turns N] [--out PATH] [--root DIR] [--trace PATH] [--metrics PATH] [--fast] [--echo PERCENT] [--barge-in MS] [--quiet]\n", program);
+    fprintf(stderr, "       %s kws enroll|eval ...\n", program);
+    fprintf(stderr, "       %s resample [--in RATE --out RATE] [--seconds N]\n", program);
+    fprintf(stderr, "       %s reclog [--root DIR] [--bytes N]\n", program);
+    fprintf(stderr, "       %s log [--events N] [--interval US]\n", program);
+    fprintf(stderr, "       %s load [--devices N] [--turns N | --duration S] [--think MS | --rate PER_MIN] ... (--corpus DIR | utterance.wav ...)\n", program);
+    fprintf(stderr, "       %s synth [--rate HZ] [--seconds N] [--out PATH] [script.wav]\n", program);
+    fprintf(stderr, "       %s features [--seconds N] [file.wav]\n", program);
+    fprintf(stderr, "       %s codec [--seconds N] [file.wav]\n", program);
+    fprintf(stderr, "       %s kernels [--seconds N]\n", program);
+    fprintf(stderr, "       %s vad [--tolerance MS] [--labels labels.csv] [file.wav ...]\n", program);
+}
+
+static std::string RecordLogPath(const char *rootDir)
+{
+    return std::string(rootDir) + ".reclog";
+}
+
+/**
+ * @brief `program reclog`: runs RecordLog_Benchmark() on the host file system and the file standing in for the partition.
+ */
+static int RecordLogBenchmark(int argc, char **argv)
+{
+    const char *rootDir = "./native_fs";
+    uint32_t bytes = FLASH_RECORD_SIZE;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--root") && hasValue) {
+            rootDir = argv[++i];
+        } else if (!strcmp(argv[i], "--bytes") && hasValue) {
+            bytes = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: program reclog [--root DIR] [--bytes N]\n");
+            return 2;
+        }
+    }
+    PosixStorage storage(rootDir);
+    FileFlash flash(RecordLogPath(rootDir).c_str(), RECORD_LOG_NATIVE_SIZE);
+    if (!storage.Begin() || !RecordLog_Init(flash)) {
+        fprintf(stderr, "Cannot use %s as file system and %s as recording log\n", rootDir, RecordLogPath(rootDir).c_str());
+        return 1;
+    }
+    RecordLog_Benchmark(storage, bytes);
+    return 0;
+}
+
+/**
+ * @brief `program log`: time spent by the caller in a LOGL call, against formatting and writing the
+ *        line in place as Hal_Log() does. The log goes to stderr, redirect it to leave the terminal out.
+ */
+static int LogBenchmark(int argc, char **argv)
+{
+    uint32_t count = 10000;
+    uint32_t intervalUs = 0;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--events") && hasValue) {
+            count = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval") && hasValue) {
+            intervalUs = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: program log [--events N] [--interval US]\n");
+            return 2;
+        }
+    }
+    App_SetState(RUNNING);
+    printf("%-10s %12s %12s\n", "path", "avg (ns)", "max (ns)");
+    for (int async = 1; async >= 0; async--) {
+        uint64_t total = 0;
+        uint64_t worst = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            auto start = std::chrono::steady_clock::now();
+            if (async) {
+                LOGL("Sound recording %u%% (%u bytes, %s)", (unsigned)(i % 100), (unsigned)(i * I2S_READ_LEN), "benchmark");
+            } else {
+                Hal_Log("%s -> Sound recording %u%% (%u bytes, %s)\n", App_ToString(App_GetState()),
+                        (unsigned)(i % 100), (unsigned)(i * I2S_READ_LEN), "benchmark");
+            }
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            total += ns;
+            worst = ns > worst ? ns : worst;
+            if (intervalUs) {
+                std::this_thread::sleep_for(std::chrono::microseconds(intervalUs));
+            }
+        }
+        printf("%-10s %12llu %12llu\n", async ? "LOGL" : "Hal_Log", (unsigned long long)(count ? total / count : 0),
+               (unsigned long long)worst);
+        Log_Flush();
+    }
+    const LogStats &stats = Log_GetStats();
+    printf("%u events: %u dropped, ring depth up to %u of %u\n", (unsigned)stats.events + (unsigned)stats.dropped,
+           (unsigned)stats.dropped, (unsigned)stats.maxDepth, (unsigned)LOG_RING_SLOTS);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *wavPath = NULL;
+    const char *host = "127.0.0.1";
+    const char *outPath = NULL;
+    const char *rootDir = "./native_fs";
+    const char *tracePath = NULL;
+    const char *metricsPath = NULL;
+    int port = 5000;
+    int sessionPort = SESSION_PORT;
+    int turns = 5;
+    int echoPercent = 0;
+    int bargeInMs = 0;
+    bool realtime = true;
+
+    Log_Init();
+    atexit(Log_Flush);
+    if (argc > 1 && !strcmp(argv[1], "kws")) {
+        return KwsTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "resample")) {
+        return ResampleTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "reclog")) {
+        return RecordLogBenchmark(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "log")) {
+        return LogBenchmark(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "load")) {
+        return LoadTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "synth")) {
+        return SynthTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "features")) {
+        return FeatureTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "codec")) {
+        return CodecTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "kernels")) {
+        return KernelTool_Main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && !strcmp(argv[1], "vad")) {
+        return VadTool_Main(argc - 1, argv + 1);
+    }
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--wav") && hasValue) {
+            wavPath = argv[++i];
+        } else if (!strcmp(argv[i], "--host") && hasValue) {
+            host = argv[++i];
+        } else if (!strcmp(argv[i], "--port") && hasValue) {
+            port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--session-port") && hasValue) {
+            sessionPort = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--turns") && hasValue) {
+            turns = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--out") && hasValue) {
+            outPath = argv[++i];
+        } else if (!strcmp(argv[i], "--root") && hasValue) {
+            rootDir = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && hasValue) {
+            tracePath = argv[++i];
+        } else if (!strcmp(argv[i], "--metrics") && hasValue) {
+            metricsPath = argv[++i];
+        } else if (!strcmp(argv[i], "--echo") && hasValue) {
+            echoPercent = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--barge-in") && hasValue) {
+            bargeInMs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--fast")) {
+            realtime = false;
+        } else if (!strcmp(argv[i], "--quiet")) {
+            NativeHal_SetLogging(false);
+        } else {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (!wavPath || turns <= 0) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    App_SetState(SETUP);
+    WavMicrophone microphone;
+    if (!microphone.Load(wavPath)) {
+        return 1;
+    }
+    microphone.SetRealtime(realtime);
+    microphone.SetBackpressure(Capture_Backlogged);
+    PosixStorage storage(rootDir);
+    SocketTransport transport;
+    ScriptedControls controls(microphone);
+    SimulatedSpeaker speaker;
+    FileFlash recordFlash(RecordLogPath(rootDir).c_str(), RECORD_LOG_NATIVE_SIZE);
+    speaker.SetRealtime(realtime);
+    speaker.SetOutputFile(outPath);
+    microphone.SetEcho(&speaker, echoPercent);
+    microphone.SetBargeIn(bargeInMs > 0 ? (uint32_t)bargeInMs : 0);
+
+    NativeBoot boot = {&microphone, &storage, &transport, &controls, &speaker, &recordFlash, rootDir, host, port, sessionPort};
+    bool booted = Boot_Run(bootSteps, sizeof(bootSteps) / sizeof(bootSteps[0]), &boot);
+    Boot_Logging();
+    if (!booted) {
+        return 1;
+    }
+
+    // With the turn queue the turns are reported by the worker, in the order they are answered
+    TurnQueue_SetListener(ReportJob);
+    bool queued = TurnQueue_Active();
+    printf("turn");
+    for (size_t s = 0; s < stageCount; s++) {
+        printf(" %12s", stages[s].name);
+    }
+    printf(" %9s %9s %9s %9s\n", "uploaded", "response", "underrun", "status");
+    for (int turn = 0; turn < turns; turn++) {
+        TurnStats stats;
+        bool played = VoiceAssistant_RunTurn(stats);
+        if (!queued || !played) {
+            ReportTurn(turn + 1, stats, played && !queued);
+        }
+    }
+    if (queued) {
+        TurnQueue_WaitIdle();
+    }
+
+    // Summary over the successful turns
+    if (!results.empty()) {
+        printf("\n%-12s %8s %8s %8s\n", "stage (ms)", "min", "avg", "max");
+        for (size_t s = 0; s < stageCount; s++) {
+            unsigned long minimum = (unsigned long)-1, maximum = 0, total = 0;
+            for (const TurnStats &stats : results) {
+                unsigned long value = stages[s].value(stats);
+                minimum = value < minimum ? value : minimum;
+                maximum = value > maximum ? value : maximum;
+                total += value;
+            }
+            printf("%-12s %8lu %8lu %8lu\n", stages[s].name, minimum, total / results.size(), maximum);
+        }
+        // Only the turns ended by the button, the others ended on the VAD
+        uint64_t releaseTotal = 0;
+        uint32_t releaseMax = 0, releases = 0;
+        for (const TurnStats &stats : results) {
+            releaseTotal += stats.releaseLatencyUs;
+            releaseMax = stats.releaseLatencyUs > releaseMax ? stats.releaseLatencyUs : releaseMax;
+            releases += stats.releaseLatencyUs > 0;
+        }
+        if (releases > 0) {
+            printf("button release to end of recording: avg %lu us, max %lu us over %u turns\n",
+                   (unsigned long)(releaseTotal / releases), (unsigned long)releaseMax, (unsigned)releases);
+        }
+    }
+    int buttonBargeIns = 0, speechBargeIns = 0;
+    for (const TurnStats &stats : results) {
+        buttonBargeIns += stats.bargeIn == BARGE_IN_BUTTON;
+        speechBargeIns += stats.bargeIn == BARGE_IN_SPEECH;
+    }
+    printf("\n%d/%d turns played\n", (int)results.size(), turns);
+    printf("barge-in: %d by button, %d by speech\n", buttonBargeIns, speechBargeIns);
+    const ClipCacheStats &clips = ClipCache_GetStats();
+    printf("clip cache: %u hits, %u misses, %u bytes saved\n", (unsigned)clips.hits, (unsigned)clips.misses, (unsigned)clips.bytesSaved);
+    uint32_t queueOverruns = Metrics_Counter(METRIC_CAPTURE_QUEUE_OVERRUNS);
+    uint32_t poolOverruns = Metrics_Counter(METRIC_CAPTURE_POOL_OVERRUNS);
+    printf("capture: %u queue overruns, %u pool overruns\n", (unsigned)queueOverruns, (unsigned)poolOverruns);
+    if (!realtime && queueOverruns + poolOverruns > 0) {
+        // The unpaced microphone waits for the voice task, nothing may be dropped
+        fprintf(stderr, "Capture overruns in a --fast run\n");
+        failures++;
+    }
+    if (queued) {
+        const TurnQueueStats &queue = TurnQueue_GetStats();
+        printf("turn queue: max depth %u, longest wait %u ms, %u stalls (%u ms)\n",
+               (unsigned)queue.maxDepth, (unsigned)queue.maxWaitMs, (unsigned)queue.stalls, (unsigned)queue.stallMs);
+    }
+
+    if (tracePath) {
+        std::vector<uint8_t> blob(sizeof(TraceBlobHeader) + TRACE_CAPACITY * sizeof(TraceRecord));
+        size_t size = Trace_Export(blob.data(), blob.size());
+        FILE *file = fopen(tracePath, "wb");
+        if (!file || fwrite(blob.data(), 1, size, file) != size) {
+            fprintf(stderr, "Cannot write %s\n", tracePath);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+    if (metricsPath) {
+        // What the ESP32 serves on /metrics, without the device gauges
+        std::vector<char> buffer(METRICS_BUFFER_SIZE);
+        MetricsText text = {buffer.data(), buffer.size(), 0};
+        Metrics_Format(text);
+        FILE *file = fopen(metricsPath, "w");
+        if (!file || fwrite(buffer.data(), 1, text.length, file) != text.length) {
+            fprintf(stderr, "Cannot write %s\n", metricsPath);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -1,264 +1,176 @@
 #include <WiFi.h>
 #include <WiFiUdp.h>
 #include <WiFiManager.h>
-#include <HTTPClient.h>
 #include <Arduino.h>
-#include <driver/i2s.h>
 #include <freertos/FreeRTOS.h>
-#include <FS.h>
-#include <XT_DAC_Audio.h>
 #include "esp_system.h"
-#include "freertos/semphr.h"
 #include <Secret.h>
-
-// Pin definitions
-#define I2S_WS 22
-#define I2S_SD 26
-#define I2S_SCK 21
-#define DAC_PIN 25
-#define RECORD_BUTTON_PIN 12
-#define RECORD_LED_PIN 14
-#define DAC1_PIN 25
-
-// I2S configurations
-#define I2S_PORT I2S_NUM_0
-#define I2S_SAMPLE_RATE 16000 // 16kHz
-#define I2S_SAMPLE_BITS 16
-#define I2S_READ_LEN (16 * 1024)
-#define RECORD_TIME 10 // Recording duration in seconds
-#define I2S_CHANNEL_NUM 1
-#define FLASH_RECORD_SIZE (I2S_CHANNEL_NUM * I2S_SAMPLE_RATE * I2S_SAMPLE_BITS / 8 * RECORD_TIME) // Max recording size is 320KB
-
-// File system settings
-#define USE_LITTLE_FS 0
-#define USE_SPIFFS 1
-#define USE_FILESYSTEM USE_SPIFFS
-
-#if USE_FILESYSTEM == USE_SPIFFS
-    #include <SPIFFS.h>
-    #define FILESYSTEM SPIFFS
-    #define FILESYSTEM_NAME "SPIFFS"
-#elif USE_FILESYSTEM == USE_LITTLE_FS
-    #include "LittleFS.h"
-    #define FILESYSTEM MAIN_LITTLE_FS
-    #define FILESYSTEM_NAME "LittleFS"
-#endif
-
-// Utilities for memory and logging
-#define LOG(format, ...) (Serial.printf("%s -> " format, App_ToString(appState).c_str(), ##__VA_ARGS__))
-#define LOGL(format, ...) (LOG(format "\n", ##__VA_ARGS__))         // Log with newline
-#define FREE(ptr)        do { if (ptr) { delete((ptr)); (ptr) = NULL; } } while (0);
+#include <App.h>
+#include <Config.h>
+#include <Player.h>
+#include <VoiceAssistant.h>
+#include <Arena.h>
+#include <Capture.h>
+#include <Session.h>
+#include <Connectivity.h>
+#include <MetricsServer.h>
+#include <ClipCache.h>
+#include <RecordLog.h>
+#include <Boot.h>
+#include "hal/esp32/Esp32Hal.h"
 
 /*
 Program workflow overview:
-    1. Initialize file system, I2S, DAC, and RTOS tasks
-    2. Connect to Wi-Fi
+    1. Initialize file system, I2S, DAC, and RTOS tasks, independent steps in parallel (Boot.h)
+    2. Connect to Wi-Fi in the background (Connectivity.h: cached BSSID, channel and IP for sub-second reconnects)
     3. Wait for recording trigger (press RECORD_BUTTON_PIN to start recording)
     4. Start recording with a limit of RECORD_TIME seconds
+       (with VAD_ENABLE, leading silence is dropped and recording also stops after trailing silence)
     5. Stop recording and send the recorded audio (WAV file) to the PC
+       (with STREAM_UPLOAD, steps 4 and 5 overlap: each I2S block is sent as an HTTP chunk while recording;
+       with SERVER_SESSION, blocks are sent as frames over a connection kept open across turns, see Session.h)
     6. Receive response audio (WAV file) from the PC
-    7. Play the response audio
+    7. Play the response audio while it is being received (ring buffer drained by the DAC, see Player.h)
+       (with BARGE_IN_ENABLE, the microphone keeps running: speech or the button interrupts the response
+       and the next turn starts on the audio already captured, see BargeIn.h)
     8. Return to step 4 for continuous operation
-
-Notes: Recording audio is stored on the file system because the max recording size (320KB) exceeds heap capacity.
-       Response audio is managed in the heap directly.
+       (with the recording log and TURN_QUEUE_ENABLE, steps 6 and 7 (and 5 for a turn recorded while another
+       is answered) run in a turn worker task and step 4 starts again as soon as the recording is queued,
+       see TurnQueue.h)
+
+Notes: Recording audio is stored in flash because the max recording size (320KB) exceeds heap capacity: in a
+       raw partition written as a circular log and uploaded straight from the memory-mapped flash (RecordLog.h),
+       or in a file system file without that partition.
+       In streaming mode the file system is bypassed and the WAV header carries 0xFFFFFFFF sizes (streaming WAV
+       convention); the server patches the sizes from the number of bytes actually received.
+       Response audio is never stored as a whole, so its length is not limited by the heap.
+       The microphone is drained by a dedicated capture task into pooled blocks (Capture.h), so flash writes
+       and network sends do not stall the I2S DMA, which is sized to 4 x 256 samples instead of 64 x 1024.
+       Steps 3 to 7 are implemented on top of the hardware abstraction layer (Hal.h) in VoiceAssistant.cpp,
+       so they also run in the native host build (`pio run -e native`).
 */
 
-enum APP_STATE
-{
-    SETUP,
-    PAIRING,
-    IDLE,
-    RUNNING,
-    END
-};
-
-APP_STATE appState;
-File file;
-const char *fileName = "/recording.wav";
-XT_DAC_Audio_Class* DACAudio = NULL;
-XT_Wav_Class* Sound = NULL;
-bool i2sInit = false;
-uint8_t* audioBuffer = NULL;
-uint32_t audioSize = 0;
-SemaphoreHandle_t taskSemaphore;
+I2SMicrophone microphone;
+FlashStorage storage;
+WiFiTransport transport;
+GpioControls controls;
+DacSpeaker speaker;
+PartitionFlash recordFlash;
+String hostAddress = hostIP.toString();
 uint32_t heapSize = 0;
 uint32_t neverUseHeapSize = 0;
+uint32_t minLargestFreeBlock = 0; // Smallest "largest free block" observed, drops when the heap fragments
 
-void I2S_Init();
-void I2S_Stop();
-void I2S_DACScale(uint8_t *d_buff, uint8_t *s_buff, uint32_t len);
 void Task_VoiceAssistant(void *arg);
-void Server_UploadFile(const char *filePath);
-void App_SetState(APP_STATE state);
-APP_STATE App_GetState(void);
-String App_ToString(APP_STATE state);
 void File_ListFiles();
-void File_WriteWavHeader(File file, uint32_t totalAudioLen);
-void File_Remove(const char* path);
+void File_LogEntry(const char *name, size_t size);
 void Heap_Init();
-void Heap_Record();
-void Heap_Logging(uint8_t index = 0);
-void WiFi_reconnect(void);
 
-void setup() {
-    App_SetState(SETUP);
-    Serial.begin(115200);
-    Serial.setDebugOutput(false);
-    pinMode(RECORD_BUTTON_PIN, INPUT_PULLUP);
-    pinMode(RECORD_LED_PIN, OUTPUT);
-    digitalWrite(RECORD_LED_PIN, LOW);
-    Heap_Init();
+enum BOOT_STEP_ID
+{
+    BOOT_STORAGE,
+    BOOT_CLIPS,
+    BOOT_MICROPHONE,
+    BOOT_PLAYER,
+    BOOT_WIFI,
+    BOOT_METRICS,
+    BOOT_PIPELINE,
+    BOOT_FILES
+};
 
-    if (!FILESYSTEM.begin(true)) {
-        LOGL(FILESYSTEM_NAME " mount failed. Program stopping. Please reset.");
-        while (1) yield();
+static bool Boot_Storage(void *context) {
+    if (!storage.Begin()) {
+        LOGE(FILESYSTEM_NAME " mount failed. Program stopping. Please reset.");
+        return false;
     }
     LOGL(FILESYSTEM_NAME " mounted successfully.");
-    File_Remove(fileName);
-    File_ListFiles();
-
-    I2S_Init();
-    LOGL("INMP441 Microphone initialized successfully.");
-
-    WiFi_reconnect();
-
-    taskSemaphore = xSemaphoreCreateBinary();
-    xTaskCreate(Task_VoiceAssistant, "Task_VoiceAssistant", 1024 * 3, NULL, 5, NULL);
-    xSemaphoreGive(taskSemaphore);
+    storage.Remove(RECORD_FILE_NAME);
+    return true;
+}
 
-    DACAudio = new XT_DAC_Audio_Class(DAC1_PIN, 0);
-    App_SetState(IDLE);
-    delay(1);
+static bool Boot_Clips(void *context) {
+    ClipCache_Init(storage);
+    return true;
 }
 
-void loop() {
-    //play sound whenever the sound is allocated
-    if (Sound && !Sound->Playing) {
-        if (audioBuffer) {
-            DACAudio->StopAllSounds();
-            FREE(Sound);
-            FREE(audioBuffer);
-            xSemaphoreGive(taskSemaphore);
-            Heap_Logging();
-        }
-    }
-    if (Sound) DACAudio->FillBuffer();
+static bool Boot_Microphone(void *context) {
+    microphone.Begin();
+    LOGL("INMP441 Microphone initialized successfully.");
+    return true;
 }
 
-/**
- * @brief Initializes the I2S peripheral for audio input/output.
- * 
- * This function configures the I2S peripheral to prepare it for handling audio
- * data streams, enabling the necessary settings and parameters.
- */
-void I2S_Init() {
-    if (!i2sInit) {
-        i2s_config_t i2s_config = {
-            .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-            .sample_rate = I2S_SAMPLE_RATE,
-            .bits_per_sample = i2s_bits_per_sample_t(I2S_SAMPLE_BITS),
-            .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-            .communication_format = i2s_comm_format_t(I2S_COMM_FORMAT_STAND_I2S | I2S_COMM_FORMAT_STAND_MSB),
-            .intr_alloc_flags = 0,
-            .dma_buf_count = 64,
-            .dma_buf_len = 1024,
-            .use_apll = 1
-        };
-        i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
-        const i2s_pin_config_t pin_config = {
-            .bck_io_num = I2S_SCK,
-            .ws_io_num = I2S_WS,
-            .data_out_num = -1,
-            .data_in_num = I2S_SD
-        };
-        i2s_set_pin(I2S_PORT, &pin_config);
-    }
-    i2sInit = true;
+static bool Boot_Player(void *context) {
+    Player_Init();
+    LOGL("DAC playback (I2S DMA) initialized successfully.");
+    return true;
 }
 
-/**
- * @brief Uninstalls the I2S driver and frees associated heap memory.
- * 
- * This function stops the I2S peripheral, releases any dynamically allocated memory
- * used by the I2S driver, and prepares the system for safe shutdown of I2S operations.
- */
-void I2S_Stop(){
-    i2s_driver_uninstall(I2S_PORT);
-    i2sInit = false;
+static bool Boot_Wifi(void *context) {
+    Connectivity_Init(ssid, password); // connects in the background, uploads wait for the link
+    return true;
 }
 
-/**
- * @brief Writes the WAV file header to a specified buffer.
- * 
- * This function constructs a WAV file header with the specified audio length 
- * and writes it into the given buffer.
- * 
- * @param buffer Pointer to the array where the WAV header will be stored.
- * @param totalAudioLen Total size of the audio data (in bytes) to include in the WAV header.
- */
-void Buffer_WriteWavHeader(uint8_t *buffer, uint32_t totalAudioLen)
-{
-    uint32_t dataChunkSize = totalAudioLen * I2S_CHANNEL_NUM * (I2S_SAMPLE_BITS / 8); // Number of audio bytes (each sample has a size based on the specified bits)
-    uint32_t size = 36 + dataChunkSize;
+static bool Boot_Metrics(void *context) {
+    MetricsServer_Init();
+    return true;
+}
 
-    byte wavHeader[44] = {
-        'R', 'I', 'F', 'F',                                                                                                        // ChunkID "RIFF"
-        (byte)(size & 0xff), (byte)((size >> 8) & 0xff), (byte)((size >> 16) & 0xff), (byte)((size >> 24) & 0xff), // ChunkSize (file size minus 8 bytes of RIFF and file size)
-        'W', 'A', 'V', 'E',                                                                                                        // Format "WAVE"
-        'f', 'm', 't', ' ',                                                                                                        // Subchunk1ID "fmt "
-        16, 0, 0, 0,                                                                                                               // Subchunk1Size (16 bytes for PCM format)
-        1, 0,                                                                                                                      // AudioFormat (1 for PCM)
-        (byte)(I2S_CHANNEL_NUM & 0xff), 0,                                                                                         // NumChannels (number of audio channels, 1 for mono)
-        (byte)(I2S_SAMPLE_RATE & 0xff),                                                                                            // SampleRate
-        (byte)((I2S_SAMPLE_RATE >> 8) & 0xff),
-        (byte)((I2S_SAMPLE_RATE >> 16) & 0xff),
-        (byte)((I2S_SAMPLE_RATE >> 24) & 0xff),
-        (byte)((I2S_SAMPLE_RATE * I2S_CHANNEL_NUM * (I2S_SAMPLE_BITS / 8)) & 0xff), // ByteRate = SampleRate * NumChannels * BitsPerSample/8
-        (byte)(((I2S_SAMPLE_RATE * I2S_CHANNEL_NUM * (I2S_SAMPLE_BITS / 8)) >> 8) & 0xff),
-        (byte)(((I2S_SAMPLE_RATE * I2S_CHANNEL_NUM * (I2S_SAMPLE_BITS / 8)) >> 16) & 0xff),
-        (byte)(((I2S_SAMPLE_RATE * I2S_CHANNEL_NUM * (I2S_SAMPLE_BITS / 8)) >> 24) & 0xff),
-        (byte)((I2S_CHANNEL_NUM * (I2S_SAMPLE_BITS / 8)) & 0xff), 0, // BlockAlign = NumChannels * BitsPerSample/8
-        (byte)(I2S_SAMPLE_BITS & 0xff), 0,                           // BitsPerSample (number of bits per sample, 16 bits)
-        'd', 'a', 't', 'a',                                          // Subchunk2ID "data"
-        (byte)(dataChunkSize & 0xff),                                // Subchunk2Size (number of bytes in the data section)
-        (byte)((dataChunkSize >> 8) & 0xff),
-        (byte)((dataChunkSize >> 16) & 0xff),
-        (byte)((dataChunkSize >> 24) & 0xff)};
+static bool Boot_Pipeline(void *context) {
+    Hal platform = {&microphone, &storage, &transport, &controls, &speaker, &recordFlash};
+    VoiceAssistant_Init(platform);
+#if RECORD_LOG_BENCHMARK
+    RecordLog_Benchmark(storage, FLASH_RECORD_SIZE);
+#endif
+    Capture_Init(microphone);
+    controls.SetButtonEvent(Capture_WakeEvent()); // a release also ends the wait for the next block
+    Server_Init(hostAddress.c_str(), atoi(hostPort));
+    Session_Init(transport, hostAddress.c_str(), SESSION_PORT);
+    App_SetState(IDLE); // before the voice task sets its own states
+    return xTaskCreate(Task_VoiceAssistant, "Task_VoiceAssistant", 1024 * 4, NULL, 5, NULL) == pdPASS;
+}
 
-    memcpy(buffer, wavHeader, 44); // Write header to buffer
+#if BOOT_LIST_FILES
+static bool Boot_Files(void *context) {
+    File_ListFiles();
+    return true;
 }
+#endif
 
-/**
- * @brief Writes the WAV file header to a specified file.
- * 
- * This function constructs a WAV file header based on the total audio length
- * and writes it into the given file object.
- * 
- * @param file Reference to the file object where the WAV header will be written.
- * @param totalAudioLen Total size of the audio data (in bytes) to include in the WAV header.
- */
-void File_WriteWavHeader(File file, uint32_t totalAudioLen)
-{
-    uint8_t wavHeader[44];
+// WiFi and the player on core 0 next to their tasks, the flash steps on core 1. The voice task
+// does not wait for WiFi: the first command can be recorded while the device associates.
+static const BootStep bootSteps[] = {
+    {"storage", Boot_Storage, 0, false, 1},
+    {"clips", Boot_Clips, 1 << BOOT_STORAGE, false, 1},
+    {"microphone", Boot_Microphone, 0, false, 1},
+    {"player", Boot_Player, 0, false, 0},
+    {"wifi", Boot_Wifi, 0, false, 0},
+    {"metrics", Boot_Metrics, 1 << BOOT_WIFI, false, 0},
+    {"pipeline", Boot_Pipeline, 1 << BOOT_STORAGE | 1 << BOOT_CLIPS | 1 << BOOT_MICROPHONE | 1 << BOOT_PLAYER, true, 1},
+#if BOOT_LIST_FILES
+    {"files", Boot_Files, 1 << BOOT_STORAGE | 1 << BOOT_PIPELINE, false, 1}, // diagnostic, after the device is ready
+#endif
+};
 
-    Buffer_WriteWavHeader(wavHeader, totalAudioLen);
+void setup() {
+    App_SetState(SETUP);
+    Serial.begin(115200);
+    Serial.setDebugOutput(false);
+    Log_Init();
+    controls.Begin();
+    Heap_Init();
 
-    file.seek(0);
-    file.write(wavHeader, sizeof(wavHeader));
+    if (!Boot_Run(bootSteps, sizeof(bootSteps) / sizeof(bootSteps[0]), NULL)) {
+        Boot_Logging();
+        LOGE("Boot failed. Program stopping. Please reset.");
+        while (1) yield();
+    }
+    Boot_Logging();
+    delay(1);
 }
 
-/**
- * @brief Removes a file from the flash memory.
- * 
- * This function deletes a specified file from the flash memory based on the provided file path.
- * 
- * @param path String containing the path to the file to be removed.
- */
-void File_Remove(const char* path){
-    if(FILESYSTEM.exists(path)){
-        FILESYSTEM.remove(path);
-    }
+void loop() {
+    // Playback is clocked by the I2S DMA and the tasks wake on events, nothing to do here
+    vTaskDelay(portMAX_DELAY);
 }
 
 /**
@@ -270,176 +182,27 @@ void File_Remove(const char* path){
  */
 void Task_VoiceAssistant(void *arg)
 {
-    while (true) // To loop the task continuously
+    TurnStats stats;
+    while (true) // To loop the task continuously, a barged-in turn starts right away
     {
-        if(xSemaphoreTake(taskSemaphore, portMAX_DELAY) == pdTRUE){
-            App_SetState(RUNNING);
-            vTaskDelay(pdMS_TO_TICKS(100)); // Allow time for initialization
-            I2S_Init();
-            Heap_Record();
-            const unsigned int i2s_read_len = I2S_READ_LEN;
-            unsigned int flash_wr_size = 0;
-            size_t bytes_read = 0;
-            unsigned long startTime = 0, endTime = 0;
-            uint8_t *i2s_read_buff = new uint8_t[i2s_read_len];
-            uint8_t* flash_wr_buff = new uint8_t[i2s_read_len];
-
-            File_Remove(fileName);
-            file = FILESYSTEM.open(fileName, FILE_WRITE, true);
-
-            // Wait for button press to start recording
-            LOGL("Ready to record: Waiting for button press");
-            while (digitalRead(RECORD_BUTTON_PIN) == HIGH)
-            {
-                App_SetState(IDLE);
-                vTaskDelay(pdMS_TO_TICKS(200));
-            }
-            App_SetState(RUNNING);
-            // Short record to reduce latency (200ms)
-            const uint8_t SHORT_RECORD_TIME = 200;
-            unsigned long startRecordingTime = millis();
-            while (millis() - startRecordingTime < SHORT_RECORD_TIME) {
-                i2s_read(I2S_PORT, (void *)i2s_read_buff, i2s_read_len, &bytes_read, portMAX_DELAY);
-            }
-
-            LOGL("***Recording Start***");
-            digitalWrite(RECORD_LED_PIN, HIGH); // Turn on LED to indicate recording
-            while (flash_wr_size < FLASH_RECORD_SIZE)
-            {
-                i2s_read(I2S_PORT, (void *)i2s_read_buff, i2s_read_len, &bytes_read, portMAX_DELAY);
-                I2S_DACScale(flash_wr_buff, (uint8_t *)i2s_read_buff, i2s_read_len);
-
-                file.write((byte *)flash_wr_buff, i2s_read_len);
-
-                flash_wr_size += bytes_read;
-                LOGL("Sound recording %u%%", flash_wr_size * 100 / FLASH_RECORD_SIZE);
-
-                // Stop recording if the button is released
-                if (digitalRead(RECORD_BUTTON_PIN) == HIGH)
-                {
-                    break;
-                }
-            }
-
-            LOGL("***Recording Finished***");
-            digitalWrite(RECORD_LED_PIN, LOW); // Turn off LED to indicate end of recording
-            
-            I2S_Stop();
-            Heap_Record();
-
-            // Update WAV file size
-            file.seek(0);
-            File_WriteWavHeader(file, flash_wr_size);
-            file.close();
-            FREE(i2s_read_buff);
-            FREE(flash_wr_buff);
-
-            // Send file to server
-            startTime = millis();
-            Server_UploadFile(fileName);
-            endTime = millis();
-
-            LOGL("Response time: %" PRIu32 "", endTime - startTime);
-            
-            if(audioBuffer){
-                // Free the previous sound object
-                FREE(Sound);
-                Sound = new XT_Wav_Class(audioBuffer);
-                Sound->Speed = 0.65f;
-                DACAudio->Play(Sound);
-            }
-        }
-        else{
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
+        VoiceAssistant_RunTurn(stats);
+        Connectivity_Logging();
     }
     vTaskDelete(NULL);
 }
 
 /**
- * @name I2S_DACScale
- * 
- * @brief Adjusts (scales) audio data from an I2S input buffer for DAC output.
- * 
- * This function reads 16-bit audio samples from the source buffer `s_buff`, scales them to match the
- * DAC output range, and stores the adjusted values in the destination buffer `d_buff`.
- * 
- * @param d_buff Pointer to the destination buffer where scaled DAC data will be stored.
- * @param s_buff Pointer to the source buffer containing the original 16-bit I2S audio data.
- * @param len Length of the source buffer in bytes.
- * 
- * @details
- * - The function reads two bytes (16 bits) at a time from `s_buff` to form a 12-bit audio sample.
- * - Only the 12 lowest bits of each 16-bit sample are used for DAC output.
- * - The scaled value is calculated by multiplying the sample by `256 / 2048` to adjust the
- *   amplitude range and then stored in `d_buff`.
- * - Each sample in `d_buff` is represented by two bytes where the first byte is set to 0
- *   and the second byte holds the scaled DAC value.
+ * @brief Logs one file of the file system listing.
  */
-void I2S_DACScale(uint8_t *d_buff, uint8_t *s_buff, uint32_t len)
+void File_LogEntry(const char *name, size_t size)
 {
-    uint32_t j = 0;
-    uint32_t dac_value = 0;
-    for (uint32_t i = 0; i < len; i += 2)
-    {
-        dac_value = ((((uint16_t)(s_buff[i + 1] & 0xF) << 8) | ((s_buff[i]))));
-        d_buff[j++] = 0;
-        d_buff[j++] = dac_value * 256 / 2048;
+    static bool flag = true;
+    // Print log once
+    if(flag){
+        LOGL("Listing files in directory:");
+        flag = false;
     }
-}
-
-/**
- * @brief Sets the current state of the application.
- * 
- * This function updates the global variable that tracks the 
- * current state of the app to the specified state.
- * 
- * @param state The new state to set for the application.
- * @return None
- */
-void App_SetState(APP_STATE state){
-    appState = state;
-}
-
-/**
- * @brief Retrieves the current state of the application.
- * 
- * This function returns the current state of the app as 
- * stored in the global variable.
- * 
- * @return The current state of the application.
- */
-APP_STATE App_GetState(void){
-    return appState;
-}
-
-/**
- * @brief Converts the application state to a string representation.
- * 
- * This function takes an application state enum value and 
- * returns a corresponding string that indicates the state. 
- * If the state does not match any known values, it returns an 
- * empty string.
- * 
- * @param state The state of the application to convert.
- * @return A string representation of the app state.
- */
-String App_ToString(APP_STATE state)
-{
-    switch (state)
-    {
-    case SETUP:
-        return "Setup";
-    case PAIRING:
-        return "Pairing";
-    case RUNNING:
-        return "Running";
-    case IDLE:
-        return "IDLE";
-    case END:
-        return "End";
-    }
-    return "";
+    LOGL("\tFILE: %s, SIZE: %u", name, (unsigned)size);
 }
 
 /**
@@ -447,128 +210,7 @@ String App_ToString(APP_STATE state)
  */
 void File_ListFiles()
 {
-    File root = FILESYSTEM.open("/");
-    File file = root.openNextFile();
-    bool flag = true;
-    while (file)
-    {
-        // Print log once
-        if(flag){
-            LOGL("Listing files in directory:");
-            flag = false;   
-        }
-        LOGL("\tFILE: %s, SIZE: %d", file.name(), file.size());
-        file = root.openNextFile();
-    }
-}
-
-/**
- * @brief Uploads recorded audio to the server and receives the response audio.
- * 
- * This function connects to the WiFi (if not already connected) and sends a POST 
- * request to the specified server with the audio file located at the provided 
- * file path. It handles the file upload and processes the server's response, 
- * which is expected to be an audio file. The function logs the size of the 
- * uploaded file and the received response.
- * 
- * @param filePath The path to the audio file to be uploaded.
- */
-void Server_UploadFile(const char *filePath)
-{
-    // Reconnect to WiFi if necessary
-    if (WiFi.status() != WL_CONNECTED)
-    {
-        WiFi_reconnect();
-    }
-    //open audio file to read
-    file = FILESYSTEM.open(filePath, FILE_READ);
-    if (!file)
-    {
-        return;
-    }
-    size_t fileSize = file.size();
-
-    //create HTTP object
-    HTTPClient http;
-    http.setTimeout(15000);
-    http.setReuse(true);
-    http.begin(serverName);
-    http.addHeader("Content-Type", "audio/wav");
-    
-    //send file to PC
-    LOGL("Sending audio to server. File size: %zu", fileSize);
-    int httpResponseCode = http.sendRequest("POST", &file, fileSize);
-    file.close();
-    Heap_Record();
-
-    //handle the response
-    if (httpResponseCode > 0)
-    {
-        int contentLength = http.getSize(); // Get the size of the response
-
-        if (contentLength > 0)
-        {
-            //audio file received, read the file and store to buffer
-            // LOGL("Content length: %u", contentLength);
-            WiFiClient *stream = http.getStreamPtr();
-            FREE(audioBuffer);
-            audioBuffer = new uint8_t[contentLength];
-            audioSize = 0;
-            Heap_Record();
-            if(audioBuffer){
-                while (http.connected() && audioSize < contentLength)
-                {
-                    size_t availableData = stream->available();
-                    if (availableData > 0)
-                    {
-                        uint8_t buffer[512];
-                        int bytesRead = stream->readBytes(buffer, min(sizeof(buffer), contentLength - audioSize));
-                        if (audioSize + bytesRead <= contentLength) {
-                            memcpy(audioBuffer + audioSize, buffer, bytesRead * sizeof(uint8_t));
-                            audioSize += bytesRead;
-                        } else {
-                            break; //Stop if there is a risk of exceeding the size
-                        }
-                    }
-                }
-
-                LOGL("\tReceived response WAV file, size: %d bytes", audioSize);
-                Buffer_WriteWavHeader(audioBuffer, audioSize);
-            }
-            else{
-                LOGL("audioBuffer can not be allocated with size: %zu", contentLength);
-            }
-        }
-        else
-        {
-            LOGL("Content length is invalid");
-        }
-    }
-    else
-    {
-        LOGL("Error on HTTP request: %s", http.errorToString(httpResponseCode).c_str());
-    }
-    http.end();
-}
-
-/**
- * @brief Reconnects to the WiFi router.
- * 
- * This function attempts to establish a connection to the specified WiFi network using the 
- * provided SSID and password. It will retry the connection every 2 seconds until it is 
- * successfully connected, logging progress every three attempts. 
- */
-void WiFi_reconnect(void) {
-    WiFi.begin(ssid, password);
-    uint8_t tryCount = 0;
-    while (WiFi.status() != WL_CONNECTED) {
-        tryCount++;
-        if (tryCount % 3 == 0) {
-            LOGL("WiFi connecting... Attemps: %d", tryCount / 3 + 1);
-        }
-        delay(2000);
-    }
-    LOGL("WiFi connected.");
+    storage.List(File_LogEntry);
 }
 
 /**
@@ -582,6 +224,7 @@ void Heap_Init() {
     size_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
     heapSize = freeHeap;
     neverUseHeapSize = heapSize;
+    minLargestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
 }
 
 /**
@@ -589,10 +232,15 @@ void Heap_Init() {
  * 
  * This function checks the current available heap memory and updates `heapSize` with the 
  * latest free heap size. It also compares the current `heapSize` with `neverUseHeapSize` to 
- * track the minimum heap usage observed.
+ * track the minimum heap usage observed, and tracks the smallest largest free block to detect
+ * fragmentation.
  */
 void Heap_Record() {
     size_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    uint32_t largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    if (minLargestFreeBlock == 0 || largestFreeBlock < minLargestFreeBlock) {
+        minLargestFreeBlock = largestFreeBlock;
+    }
     if (heapSize == 0) {
         heapSize = freeHeap;
         neverUseHeapSize = heapSize;
@@ -607,6 +255,7 @@ void Heap_Record() {
  * 
  * This function logs the current available heap memory (`freeHeap`), the difference between 
  * the initial and current heap size, and the minimum observed heap size (`neverUseHeapSize`).
+ * The largest free block and the statistics of the per-turn arena (Arena.h) are logged as well.
  * The `index` parameter is used to customize log labels for easier tracking of heap usage.
  * 
  * @param index The label identifier for the log entry.
@@ -623,4 +272,8 @@ void Heap_Logging(uint8_t index) {
     heapSize = freeHeap;
     neverUseHeapSize = min(heapSize, neverUseHeapSize);
     LOGL("\tMinimum free heap: %zu bytes", neverUseHeapSize);
+    uint32_t largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    minLargestFreeBlock = min(largestFreeBlock, minLargestFreeBlock);
+    LOGL("\tLargest free block: %u bytes (minimum %u bytes)", (unsigned)largestFreeBlock, (unsigned)minLargestFreeBlock);
+    Arena_Logging();
 }
\ No newline at end of file
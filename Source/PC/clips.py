@@ -0,0 +1,36 @@
+# Response clip cache of the ESP32 (see Source/ESP32/include/ClipCache.h).
+#
+# The device advertises the clips it holds in "X-Cached-Clips: <id>, <id>". A response either
+# refers to one of them ("X-Clip-Action: play", empty body) or asks the device to keep the body
+# ("X-Clip-Action: store"). Ids are 32-bit hex values chosen by the server.
+
+import zlib
+
+MAX_CLIP = 32 * 1024  # CLIP_CACHE_MAX_CLIP of the device, larger bodies are not offered
+
+
+def clip_id(key):
+    # Stable id of a response, from its text or its encoded audio
+    if isinstance(key, str):
+        key = key.encode('utf-8')
+    return zlib.crc32(key) & 0xFFFFFFFF
+
+
+def cached_ids(header):
+    ids = set()
+    for value in (header or '').split(','):
+        try:
+            ids.add(int(value.strip(), 16))
+        except ValueError:
+            pass
+    return ids
+
+
+def play_headers(clip):
+    return {'X-Clip-Id': f"{clip:08x}", 'X-Clip-Action': 'play'}
+
+
+def store_headers(clip, body):
+    if len(body) > MAX_CLIP:
+        return {}
+    return {'X-Clip-Id': f"{clip:08x}", 'X-Clip-Action': 'store'}
@@ -0,0 +1,188 @@
+import struct
+from array import array
+
+# Audio codecs shared with the ESP32 (see Source/ESP32/include/Codec.h).
+# The codec of a body is carried in the X-Audio-Codec header, the codecs the ESP32 can
+# decode are listed in X-Accept-Codec (in order of preference). X-Accept-Format gives the
+# format the ESP32 plays ("rate/bits/channels", see Source/ESP32/include/AudioFormat.h); answering
+# at that rate spares the device any resampling.
+# PHONEMES bodies carry no audio but units for the synthesizer of the device (phonemes.py), which
+# only devices built with SYNTH_ENABLE accept.
+# LOGMEL and LOGMEL8 uploads carry log-mel frames of the device front end instead of audio
+# (features.py decodes them); they are never sent as responses.
+PCM = 'pcm'
+MULAW = 'mulaw'
+IMA_ADPCM = 'ima-adpcm'
+PHONEMES = 'phonemes'
+LOGMEL = 'logmel'
+LOGMEL8 = 'logmel8'
+SUPPORTED_CODECS = [PHONEMES, IMA_ADPCM, MULAW, PCM]
+FEATURE_CODECS = [LOGMEL, LOGMEL8]
+
+LOGMEL8_FLOOR = 0  # log2 value of code 0, in 1/256 (see Source/ESP32/include/Codec.h)
+LOGMEL8_STEP = 48  # log2 step of one code, in 1/256
+
+DEFAULT_FORMAT = (8000, 8, 1)  # Response format of devices that do not send X-Accept-Format
+
+MULAW_BIAS = 0x84
+MULAW_CLIP = 32635
+
+IMA_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767]
+IMA_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def mulaw_decode_sample(value):
+    value = ~value & 0xFF
+    magnitude = ((((value & 0x0F) << 3) + MULAW_BIAS) << ((value & 0x70) >> 4)) - MULAW_BIAS
+    return -magnitude if value & 0x80 else magnitude
+
+
+def mulaw_encode_sample(sample):
+    sign = 0
+    if sample < 0:
+        sample = -sample
+        sign = 0x80
+    sample = min(sample, MULAW_CLIP) + MULAW_BIAS
+    exponent = sample.bit_length() - 8
+    mantissa = (sample >> (exponent + 3)) & 0x0F
+    return ~(sign | (exponent << 4) | mantissa) & 0xFF
+
+
+MULAW_DECODE_TABLE = [mulaw_decode_sample(v) for v in range(256)]
+MULAW_ENCODE_TABLE = bytes(mulaw_encode_sample(v) for v in range(-32768, 32768))
+
+
+def mulaw_decode(data):
+    return array('h', (MULAW_DECODE_TABLE[b] for b in data))
+
+
+def mulaw_encode(samples):
+    table = MULAW_ENCODE_TABLE
+    return bytes(table[s + 32768] for s in samples)
+
+
+def adpcm_decode(data):
+    # Headerless IMA-ADPCM stream: predictor/index start at 0, first sample in the low nibble
+    predictor, index = 0, 0
+    out = array('h', bytes(len(data) * 4))
+    i = 0
+    for byte in data:
+        for code in (byte & 0x0F, byte >> 4):
+            step = IMA_STEP_TABLE[index]
+            vpdiff = step >> 3
+            if code & 4:
+                vpdiff += step
+            if code & 2:
+                vpdiff += step >> 1
+            if code & 1:
+                vpdiff += step >> 2
+            predictor += -vpdiff if code & 8 else vpdiff
+            predictor = max(-32768, min(32767, predictor))
+            index = max(0, min(88, index + IMA_INDEX_TABLE[code]))
+            out[i] = predictor
+            i += 1
+    return out
+
+
+def adpcm_encode(samples):
+    predictor, index = 0, 0
+    codes = []
+    for sample in samples:
+        step = IMA_STEP_TABLE[index]
+        diff = sample - predictor
+        code = 0
+        if diff < 0:
+            code = 8
+            diff = -diff
+        vpdiff = step >> 3
+        if diff >= step:
+            code |= 4
+            diff -= step
+            vpdiff += step
+        step >>= 1
+        if diff >= step:
+            code |= 2
+            diff -= step
+            vpdiff += step
+        step >>= 1
+        if diff >= step:
+            code |= 1
+            vpdiff += step
+        predictor += -vpdiff if code & 8 else vpdiff
+        predictor = max(-32768, min(32767, predictor))
+        index = max(0, min(88, index + IMA_INDEX_TABLE[code]))
+        codes.append(code)
+    if len(codes) % 2:
+        codes.append(0)
+    return bytes(codes[i] | (codes[i + 1] << 4) for i in range(0, len(codes), 2))
+
+
+def decode(codec, data):
+    # Returns 16-bit little-endian PCM bytes, none for the feature codecs
+    if codec == MULAW:
+        return mulaw_decode(data).tobytes()
+    if codec == IMA_ADPCM:
+        return adpcm_decode(data).tobytes()
+    if codec in FEATURE_CODECS:
+        return b''
+    return data
+
+
+def encode(codec, pcm16):
+    # pcm16: 16-bit little-endian PCM bytes
+    samples = array('h', pcm16[:len(pcm16) & ~1])
+    if codec == MULAW:
+        return mulaw_encode(samples)
+    if codec == IMA_ADPCM:
+        return adpcm_encode(samples)
+    return pcm16
+
+
+def negotiate(accept_header):
+    # Pick the first codec of X-Accept-Codec that is supported, PCM when the header is missing
+    if accept_header:
+        for name in accept_header.split(','):
+            name = name.strip().lower()
+            if name in SUPPORTED_CODECS:
+                return name
+    return PCM
+
+
+def parse_format(accept_format):
+    # X-Accept-Format "16000/8/1" -> (16000, 8, 1), DEFAULT_FORMAT when missing or malformed
+    try:
+        rate, bits, channels = (int(part) for part in accept_format.split('/'))
+        if rate > 0 and bits in (8, 16) and channels > 0:
+            return rate, bits, channels
+    except (AttributeError, ValueError):
+        pass
+    return DEFAULT_FORMAT
+
+
+def resample(pcm16, from_rate, to_rate):
+    # Linear interpolation of 16-bit mono PCM bytes, enough for test replies
+    if from_rate == to_rate:
+        return pcm16
+    samples = array('h', pcm16[:len(pcm16) & ~1])
+    count = len(samples) * to_rate // from_rate
+    out = array('h', bytes(count * 2))
+    for i in range(count):
+        position = i * from_rate / to_rate
+        j = int(position)
+        frac = position - j
+        nxt = samples[j + 1] if j + 1 < len(samples) else samples[j]
+        out[i] = int(round(samples[j] + (nxt - samples[j]) * frac))
+    return out.tobytes()
+
+
+def wav_header(sample_rate, sample_bits, channels, data_size):
+    byte_rate = sample_rate * channels * sample_bits // 8
+    return struct.pack('<4sI4s4sIHHIIHH4sI', b'RIFF', 36 + data_size, b'WAVE', b'fmt ', 16, 1,
+                       channels, sample_rate, byte_rate, channels * sample_bits // 8, sample_bits,
+                       b'data', data_size)
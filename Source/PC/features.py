@@ -0,0 +1,153 @@
+import cmath
+import math
+from array import array
+
+import codec
+
+# Log-mel uploads (codec.LOGMEL, codec.LOGMEL8): decoder and float reference of the device front end
+# (Source/ESP32/include/Features.h). A body is the usual 44-byte WAV header (describing the captured
+# audio) followed by frames of `bands` values, one frame every `hop` samples of `frame_len` samples;
+# X-Feature-Format gives "bands/frame_len/hop". Values are log2 band energies: int16 in 1/256 for
+# LOGMEL, byte codes LOGMEL8_FLOOR + code * LOGMEL8_STEP (same unit) for LOGMEL8.
+# The reference runs the same steps in floating point (pre-emphasis 1 - 31/32 z^-1, Hamming window,
+# FFT, triangular mel bands between LOW_HZ and HIGH_HZ, log2), so an upload can be compared with the
+# WAV file the device was fed.
+
+DEFAULT_FORMAT = (20, 512, 256)  # bands, frame length, hop of devices that do not send X-Feature-Format
+LOW_HZ = 125
+HIGH_HZ = 7000
+DB_PER_LOG2 = 10 * math.log10(2)
+
+
+def parse_format(feature_format):
+    # X-Feature-Format "20/512/256" -> (20, 512, 256), DEFAULT_FORMAT when missing or malformed
+    try:
+        bands, frame_len, hop = (int(part) for part in feature_format.split('/'))
+        if bands > 0 and frame_len > 0 and frame_len & (frame_len - 1) == 0 and 0 < hop <= frame_len:
+            return bands, frame_len, hop
+    except (AttributeError, ValueError):
+        pass
+    return DEFAULT_FORMAT
+
+
+def decode(upload_codec, data, bands):
+    # Payload after the WAV header -> list of frames of log2 band energies
+    if upload_codec == codec.LOGMEL8:
+        values = [(codec.LOGMEL8_FLOOR + code * codec.LOGMEL8_STEP) / 256 for code in data]
+    else:
+        values = [value / 256 for value in array('h', data[:len(data) & ~1])]
+    return [values[i:i + bands] for i in range(0, len(values) - bands + 1, bands)]
+
+
+def fft(x):
+    # Iterative radix-2 FFT of a list of complex numbers (length a power of two)
+    n = len(x)
+    j = 0
+    x = list(x)
+    for i in range(1, n):
+        bit = n >> 1
+        while j & bit:
+            j ^= bit
+            bit >>= 1
+        j |= bit
+        if i < j:
+            x[i], x[j] = x[j], x[i]
+    size = 2
+    while size <= n:
+        step = cmath.exp(-2j * math.pi / size)
+        for start in range(0, n, size):
+            w = 1
+            for k in range(size // 2):
+                a, b = x[start + k], x[start + k + size // 2] * w
+                x[start + k], x[start + k + size // 2] = a + b, a - b
+                w *= step
+        size <<= 1
+    return x
+
+
+def band_edges(sample_rate, bands, frame_len):
+    # FFT bins of the band edges, placed as the device places them
+    def hz_to_mel(hz):
+        return 2595 * math.log10(1 + hz / 700)
+
+    def mel_to_hz(mel):
+        return 700 * (10 ** (mel / 2595) - 1)
+
+    low, high = hz_to_mel(LOW_HZ), hz_to_mel(min(HIGH_HZ, sample_rate / 2))
+    bins = frame_len // 2 + 1
+    edges = []
+    for b in range(bands + 2):
+        edge = round(mel_to_hz(low + (high - low) * b / (bands + 1)) * frame_len / sample_rate)
+        if edges and edge <= edges[-1]:
+            edge = edges[-1] + 1
+        edges.append(min(edge, bins - 1))
+    return edges
+
+
+def reference(pcm16, sample_rate, feature_format=DEFAULT_FORMAT):
+    # 16-bit PCM bytes -> list of frames of log2 band energies, None for silent bands
+    bands, frame_len, hop = feature_format
+    samples = array('h', pcm16[:len(pcm16) & ~1])
+    emphasized = [s - 31 / 32 * p for s, p in zip(samples, [0] + list(samples[:-1]))]
+    window = [0.54 - 0.46 * math.cos(2 * math.pi * i / (frame_len - 1)) for i in range(frame_len)]
+    edges = band_edges(sample_rate, bands, frame_len)
+    frames = []
+    for start in range(0, len(emphasized) - frame_len + 1, hop):
+        spectrum = fft([emphasized[start + i] * window[i] for i in range(frame_len)])
+        power = [abs(spectrum[k]) ** 2 for k in range(frame_len // 2 + 1)]
+        energy = [0.0] * (bands + 1)
+        for b in range(bands + 1):
+            span = max(edges[b + 1] - edges[b], 1)
+            for k in range(edges[b], edges[b + 1]):
+                rising = (k - edges[b]) / span
+                energy[b] += power[k] * rising
+                if b > 0:
+                    energy[b - 1] += power[k] * (1 - rising)
+        frames.append([math.log2(e) if e >= 1 else None for e in energy[:bands]])
+    return frames
+
+
+def references(pcm16, sample_rate, feature_format=DEFAULT_FORMAT, steps=8):
+    # Reference frames for `steps` starts within the first hop, as [(start sample, frames)]: the device
+    # starts its frames where the VAD found speech, anywhere between two hops of the file
+    hop = feature_format[2]
+    samples = array('h', pcm16[:len(pcm16) & ~1])
+    return [(start, reference(samples[start:].tobytes(), sample_rate, feature_format))
+            for start in range(0, hop, max(hop // steps, 1))]
+
+
+def compare(frames, reference_sets, hop, max_offset=64, range_db=50):
+    # Aligns the upload on the references and returns (start sample, mean and max absolute error in dB,
+    # compared values), None without overlap. Bands more than range_db below the loudest value of the
+    # reference are left out, as in the device check (FeatureTool.h).
+    best = None
+    for start, reference_frames in reference_sets:
+        loudest = max((ref for frame in reference_frames for ref in frame if ref is not None), default=0)
+        floor = loudest - range_db / DB_PER_LOG2
+        for offset in range(min(max_offset, len(reference_frames)) + 1):
+            errors = []
+            for frame, expected in zip(frames, reference_frames[offset:]):
+                errors.extend(abs(value - ref) * DB_PER_LOG2 for value, ref in zip(frame, expected)
+                              if ref is not None and ref >= floor)
+            if errors:
+                mean = sum(errors) / len(errors)
+                if best is None or mean < best[1]:
+                    best = (start + offset * hop, mean, max(errors), len(errors))
+    return best
+
+
+def envelope_tone(frames, hop, sample_rate, response_rate, hz=440):
+    # 16-bit PCM reply for a feature upload: a tone following the loudness of the frames
+    if not frames:
+        return b''
+    levels = [sum(frame) / len(frame) for frame in frames]
+    loudest = max(levels)
+    per_frame = max(hop * response_rate // sample_rate, 1)
+    out = array('h')
+    phase = 0.0
+    for level in levels:
+        amplitude = 12000 * 2 ** ((level - loudest) / 2)  # power -> amplitude
+        for _ in range(per_frame):
+            out.append(int(amplitude * math.sin(phase)))
+            phase += 2 * math.pi * hz / response_rate
+    return out.tobytes()
@@ -0,0 +1,118 @@
+# Turns the binary log of the ESP32 (LOG_BINARY, see Source/ESP32/include/Log.h) back into text.
+#
+#   python log_decode.py serial.bin                 capture of the serial port, raw bytes
+#   python log_decode.py - < serial.bin             same, from stdin
+#   python log_decode.py --time native.log          prefix every event with its timestamp (ms)
+#
+# Bytes outside the frames (boot messages, Hal_Log lines) are copied as they are. Formats are sent
+# once per boot, before their first event: start the capture before resetting the device.
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_SYNC = 0x1E
+STATES = ['Setup', 'Pairing', 'IDLE', 'Running', 'End']   # APP_STATE
+LEVELS = ['', 'E', 'W', 'I', 'D']                         # LOG_LEVEL_*
+SPEC = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t|L)?([diouxXcsfFeEgGaA%])')
+
+
+def read_args(data, count):
+    args = []
+    offset = 0
+    while len(args) < count and offset < len(data):
+        tag = chr(data[offset])
+        offset += 1
+        if tag == 'i':
+            args.append(('i', struct.unpack_from('<i', data, offset)[0]))
+            offset += 4
+        elif tag == 'l':
+            args.append(('l', struct.unpack_from('<q', data, offset)[0]))
+            offset += 8
+        elif tag == 'd':
+            args.append(('d', struct.unpack_from('<d', data, offset)[0]))
+            offset += 8
+        elif tag == 's':
+            length = data[offset]
+            args.append(('s', data[offset + 1:offset + 1 + length].decode('utf-8', 'replace')))
+            offset += 1 + length
+        else:
+            break
+    return args
+
+
+def apply_format(fmt, args):
+    # Same rules as Log_Format(): the stored type decides the length, a missing argument is '?'
+    args = list(args)
+
+    def convert(match):
+        flags, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        if not args:
+            return '?'
+        tag, value = args.pop(0)
+        if conversion == 's' and tag == 's':
+            return ('%' + flags + 's') % value
+        if conversion in 'diouxXc' and tag in 'il':
+            if conversion in 'ouxX' and value < 0:
+                value += 1 << (32 if tag == 'i' else 64)
+            if conversion == 'u':
+                conversion = 'd'
+            return ('%' + flags + conversion) % value
+        if conversion in 'fFeEgGaA' and tag == 'd':
+            return ('%' + flags + (conversion if conversion not in 'aA' else 'e')) % value
+        args.clear()
+        return '?'
+
+    return SPEC.sub(convert, fmt)
+
+
+def decode(data, out, show_time):
+    formats = {}
+    offset = 0
+    text_start = 0
+    while offset + 4 <= len(data):
+        if data[offset] != FRAME_SYNC or chr(data[offset + 1]) not in 'FED':
+            offset += 1
+            continue
+        length = struct.unpack_from('<H', data, offset + 2)[0]
+        if offset + 4 + length > len(data):
+            break
+        out.write(data[text_start:offset].decode('utf-8', 'replace'))
+        kind = chr(data[offset + 1])
+        payload = data[offset + 4:offset + 4 + length]
+        offset += 4 + length
+        text_start = offset
+        if kind == 'F':
+            formats[struct.unpack_from('<I', payload, 0)[0]] = payload[4:].decode('utf-8', 'replace')
+        elif kind == 'D':
+            out.write(f"Log: {struct.unpack_from('<I', payload, 0)[0]} events dropped\n")
+        else:
+            format_id, time_us, level, state, argc = struct.unpack_from('<IIBBB', payload, 0)
+            fmt = formats.get(format_id)
+            if fmt is None:
+                out.write(f"<unknown format {format_id:08x}>\n")
+                continue
+            prefix = f"{time_us / 1000:10.3f} {LEVELS[level] if level < len(LEVELS) else level} " if show_time else ''
+            state_name = STATES[state] if state < len(STATES) else str(state)
+            out.write(f"{prefix}{state_name} -> {apply_format(fmt, read_args(payload[11:], argc))}")
+    out.write(data[text_start:].decode('utf-8', 'replace'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the binary log of the ESP32 voice assistant')
+    parser.add_argument('path', help="raw capture of the log output, '-' for stdin")
+    parser.add_argument('--time', action='store_true', help='prefix events with their time (ms) and level')
+    args = parser.parse_args()
+    if args.path == '-':
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.path, 'rb') as file:
+            data = file.read()
+    decode(data, sys.stdout, args.time)
+
+
+if __name__ == '__main__':
+    main()
@@ -6,7 +6,13 @@ import speech_recognition as sr
 import google.generativeai as genai
 import secret
 import wave
+import struct
 from pydub import AudioSegment
+import codec
+import clips
+import features
+import phonemes
+import session
 
 genai.configure(api_key=secret.GEMINI_API_KEY)
 
@@ -16,6 +22,7 @@ CWD = os.path.dirname(os.path.realpath(__file__))
 upload_path = CWD + "/uploads"
 app = Flask(__name__)
 PROMPT_PARAMS = ["Tóm tắt tối đa trong 20 từ"]  # additional prompts to ensure the response length fits the ESP32 memory capability
+PHONEME_PROMPT_PARAMS = ["Tóm tắt tối đa trong 60 từ"]  # phoneme replies are streamed as a few bytes per sound, so they can be longer
 
 def read_wav_to_bytesio(file_path):
     # Create a BytesIO object
@@ -31,8 +38,8 @@ def read_wav_to_bytesio(file_path):
 
     return byte_io
 
-def TextToSpeech(text):
-    # convert text and return an audio object in wav format
+def TextToSpeech(text, sample_width=1, sample_rate=8000):
+    # convert text and return an audio object in wav format (unsigned 8-bit by default, signed 16-bit with sample_width=2)
     audio_buffer = io.BytesIO()
     try:
         tts = gTTS(text=text, lang='vi')  # Keep language as Vietnamese (change if needed)
@@ -40,9 +47,9 @@ def TextToSpeech(text):
         
         # Convert MP3 to WAV with optimized parameters
         audio = AudioSegment.from_mp3(upload_path + "/temp.mp3")
-        audio = audio.set_frame_rate(8000)  # Reduce sample rate to 8000 Hz
+        audio = audio.set_frame_rate(sample_rate)  # Rate the ESP32 plays (X-Accept-Format), 8000 Hz by default
         audio = audio.set_channels(1)  # Use only 1 channel (mono)
-        audio = audio.set_sample_width(1)  # Set encoding to Unsigned 8-bit PCM
+        audio = audio.set_sample_width(sample_width)  # Set encoding to Unsigned 8-bit PCM (or 16-bit before compression)
         
         audio.export(audio_buffer, format="wav")  # Export in WAV format
         audio_buffer.seek(0)  # Reset pointer to the beginning of the buffer
@@ -52,10 +59,10 @@ def TextToSpeech(text):
         print("Error TextToSpeech: ", e)
         return audio_buffer  # empty buffer
 
-def chatbot_response(prompt):
+def chatbot_response(prompt, prompt_params=PROMPT_PARAMS):
     try:
         # start_time = time.time()
-        response = model.generate_content(prompt + '. '.join(PROMPT_PARAMS),
+        response = model.generate_content(prompt + '. '.join(prompt_params),
             generation_config=genai.GenerationConfig(
                 max_output_tokens=1000,
                 temperature=0.1,
@@ -82,6 +89,34 @@ def SpeechToText(audio_data):
         except sr.RequestError as e:
             return f"Error: {e}"
 
+def fix_wav_header(wav_data):
+    # Streamed uploads are sent before their length is known, so the ESP32 writes 0xFFFFFFFF
+    # into the RIFF and data sizes (streaming WAV convention). Patch them from the received length.
+    if len(wav_data) < 44 or wav_data[0:4] != b'RIFF' or wav_data[36:40] != b'data':
+        return wav_data
+    data_size = len(wav_data) - 44
+    header = bytearray(wav_data[0:44])
+    struct.pack_into('<I', header, 4, 36 + data_size)
+    struct.pack_into('<I', header, 40, data_size)
+    return bytes(header) + wav_data[44:]
+
+def decode_wav(wav_data, audio_codec):
+    # Uploads are sent as a PCM WAV header followed by the encoded payload, rebuild a plain 16-bit WAV
+    if audio_codec == codec.PCM or len(wav_data) < 44:
+        return wav_data
+    channels, sample_rate = struct.unpack_from('<HI', wav_data, 22)
+    pcm = codec.decode(audio_codec, wav_data[44:])
+    return codec.wav_header(sample_rate, 16, channels, len(pcm)) + pcm
+
+def encode_wav(wav_buffer, audio_codec):
+    # Encode a 16-bit WAV for the ESP32: the header describes the decoded audio, the payload is compressed
+    with wave.open(wav_buffer, 'rb') as wav_file:
+        sample_rate = wav_file.getframerate()
+        channels = wav_file.getnchannels()
+        pcm = wav_file.readframes(wav_file.getnframes())
+    payload = codec.encode(audio_codec, pcm)
+    return io.BytesIO(codec.wav_header(sample_rate, 16, channels, len(payload)) + payload)
+
 def check_wav_file(file_path):
     with wave.open(file_path, 'rb') as wav_file:
         params = wav_file.getparams()
@@ -91,20 +126,33 @@ def check_wav_file(file_path):
         print("Number of frames:", params.nframes)
         print("Compression type:", params.comptype)
 
-@app.route('/upload', methods=['POST'])
-def upload_wav():
-    # Check Content-Type
-    if request.content_type != 'audio/wav':
-        print('Invalid Content-Type')
-        return 'Invalid Content-Type', 400
-
-    # Read raw data from request
-    wav_data = request.data
+def save_features(wav_data, upload_codec, feature_format):
+    # Log-mel uploads (features.py) are kept as CSV, one frame of log2 band energies per line
+    bands = features.parse_format(feature_format)[0]
+    frames = features.decode(upload_codec, wav_data[44:], bands)
+    if not os.path.exists(upload_path):
+        os.makedirs(upload_path)
+    with open(os.path.join(upload_path, 'uploaded_features.csv'), 'w') as csv_file:
+        for frame in frames:
+            csv_file.write(','.join(f"{value:.3f}" for value in frame) + '\n')
+    return len(frames)
+
+def process_turn(wav_data, upload_codec, accept_codec, cached_clips=None, accept_format=None, feature_format=None):
+    # One turn, shared by the HTTP upload and the session (session.py): returns (status, response codec, body, extra headers)
+    response_codec = codec.negotiate(accept_codec)
+    response_rate = codec.parse_format(accept_format)[0]
+    wav_data = fix_wav_header(wav_data)
+    print(f"Received {len(wav_data)} bytes ({upload_codec}), response codec: {response_codec}")
+    if upload_codec in codec.FEATURE_CODECS:
+        # Google speech recognition only takes audio: a feature upload needs a recognizer fed with log-mel frames
+        print(f"Saved {save_features(wav_data, upload_codec, feature_format)} log-mel frames, no feature recognizer configured")
+        return 415, response_codec, b'', {}
+    wav_data = decode_wav(wav_data, upload_codec)
 
     # Check if there is data
     if not wav_data:
         print('No data received')
-        return 'No data received', 400
+        return 400, response_codec, b'', {}
     file_path = os.path.join(upload_path, 'uploaded_audio.wav')  # Define your file name
 
     with open(file_path, 'wb') as wav_file:
@@ -117,9 +165,21 @@ def upload_wav():
     prompt = SpeechToText(wav_file)
     print("SpeechToText: " + prompt)
 
-    response = chatbot_response(prompt)
+    response = chatbot_response(prompt, PHONEME_PROMPT_PARAMS if response_codec == codec.PHONEMES else PROMPT_PARAMS)
 
-    response_file = TextToSpeech(response)  # This function returns a WAV file object (not saved on disk)
+    # Repeated responses (error prompts, confirmations) are replayed from the ESP32 clip cache without text-to-speech
+    clip = clips.clip_id(f"{response_codec}:{response_rate}:{response}")
+    if clip in clips.cached_ids(cached_clips):
+        print(f"Response: {response} (cached clip {clip:08x})")
+        return 200, response_codec, b'', clips.play_headers(clip)
+
+    if response_codec == codec.PHONEMES:
+        # The device synthesizes the reply itself: no text-to-speech
+        print("Response: " + response)
+        body = phonemes.response_wav(response, response_rate)
+        return 200, response_codec, body, clips.store_headers(clip, body)
+
+    response_file = TextToSpeech(response, 1 if response_codec == codec.PCM else 2, response_rate)  # This function returns a WAV file object (not saved on disk)
     response_file_path = os.path.join(upload_path, 'response_audio.wav')  # Define the response file path
     if not os.path.exists(upload_path):
         os.makedirs(upload_path)
@@ -131,9 +191,32 @@ def upload_wav():
 
     # Add code to send response file to ESP32
     response_file.seek(0)  # Reset pointer to the beginning of the file to prepare for sending
-    return send_file(response_file, mimetype='audio/wav', as_attachment=True, download_name='response_audio.wav')
+    if response_codec != codec.PCM and response_file.getbuffer().nbytes > 0:
+        response_file = encode_wav(response_file, response_codec)
+    body = response_file.getvalue()
+    return 200, response_codec, body, clips.store_headers(clip, body)
+
+@app.route('/upload', methods=['POST'])
+def upload_wav():
+    # Check Content-Type
+    if request.content_type != 'audio/wav':
+        print('Invalid Content-Type')
+        return 'Invalid Content-Type', 400
 
-    return 'File has been processed successfully', 200
+    # Read raw data from request (chunked bodies are de-chunked by the server)
+    status, response_codec, body, headers = process_turn(request.get_data(),
+                                                         request.headers.get('X-Audio-Codec', codec.PCM).lower(),
+                                                         request.headers.get('X-Accept-Codec'),
+                                                         request.headers.get('X-Cached-Clips'),
+                                                         request.headers.get('X-Accept-Format'),
+                                                         request.headers.get('X-Feature-Format'))
+    if status != 200:
+        return 'No data received', status
+    http_response = send_file(io.BytesIO(body), mimetype='audio/wav', as_attachment=True, download_name='response_audio.wav')
+    http_response.headers['X-Audio-Codec'] = response_codec
+    http_response.headers.update(headers)
+    return http_response
 
 if __name__ == '__main__':
+    session.serve(5001, process_turn)  # persistent sessions of devices built with SERVER_SESSION
     app.run(host='0.0.0.0', port=5000)
@@ -0,0 +1,207 @@
+# Phoneme responses for the formant synthesizer of the ESP32 (see Source/ESP32/include/Synth.h).
+#
+# Instead of audio, the body is a WAV header describing the audio the device renders (16-bit mono
+# at the X-Accept-Format rate) followed by units of 4 bytes:
+#     symbol (ASCII), duration (5 ms), start pitch, end pitch (2 Hz, 0 keeps the previous pitch)
+# The text is read syllable by syllable with the Vietnamese spelling rules (Northern accent): the
+# tone marks become pitch contours, punctuation becomes pauses, the pitch declines over a phrase.
+#
+#   python phonemes.py "Xin chào các bạn"                   print the units
+#   python phonemes.py "Xin chào các bạn" --out reply.wav   write a response body, for `program synth`
+
+import argparse
+import struct
+import unicodedata
+
+import codec
+
+UNIT_MS = 5
+PITCH_STEP = 2
+BASE_PITCH = 120.0                 # Hz, male voice like the formant targets of the device
+
+TONE_MARKS = {'̀': 'huyen', '́': 'sac', '̉': 'hoi', '̃': 'nga', '̣': 'nang'}
+QUALITY_MARKS = {('a', '̆'): 'ă', ('a', '̂'): 'â', ('e', '̂'): 'ê', ('o', '̂'): 'ô',
+                 ('o', '̛'): 'ơ', ('u', '̛'): 'ư'}
+# Pitch contours over the rhyme, as factors of the phrase pitch; two points per part
+TONES = {
+    'ngang': [(1.0, 0.97)],
+    'huyen': [(0.88, 0.72)],
+    'sac': [(1.0, 1.35)],
+    'hoi': [(0.9, 0.72), (0.72, 0.88)],
+    'nga': [(1.0, 0.9), (1.1, 1.4)],
+    'nang': [(0.85, 0.62)],
+}
+# Longest spellings first
+INITIALS = [('ngh', 'N'), ('ng', 'N'), ('nh', 'J'), ('ch', 'c'), ('tr', 'c'), ('th', 'T'), ('ph', 'f'),
+            ('kh', 'x'), ('gh', 'G'), ('gi', 'z'), ('qu', 'kw'), ('đ', 'd'), ('d', 'z'), ('r', 'z'),
+            ('s', 's'), ('x', 's'), ('c', 'k'), ('k', 'k'), ('q', 'k'), ('g', 'G'), ('h', 'h'), ('b', 'b'),
+            ('m', 'm'), ('n', 'n'), ('l', 'l'), ('t', 't'), ('v', 'v'), ('p', 'p'), ('f', 'f'), ('j', 'z'),
+            ('z', 'z'), ('w', 'w')]
+FINALS = [('ng', 'N'), ('nh', 'J'), ('ch', 'k'), ('c', 'k'), ('t', 't'), ('p', 'p'), ('m', 'm'), ('n', 'n')]
+# Nuclei, longest first: (spelling, phonemes, short)
+NUCLEI = [('iê', 'i@', False), ('yê', 'i@', False), ('ia', 'i@', False), ('ya', 'i@', False),
+          ('uô', 'u@', False), ('ươ', 'U@', False), ('ưa', 'U@', False), ('ua', 'u@', False),
+          ('oa', 'wa', False), ('oă', 'wa', True), ('oe', 'wE', False), ('uâ', 'w7', True),
+          ('uê', 'we', False), ('uy', 'wi', False), ('uơ', 'w7', False), ('uyê', 'wi@', False),
+          ('uya', 'wi@', False),
+          ('a', 'a', False), ('ă', 'a', True), ('â', '7', True), ('e', 'E', False), ('ê', 'e', False),
+          ('i', 'i', False), ('y', 'i', False), ('o', 'O', False), ('ô', 'o', False), ('ơ', '7', False),
+          ('u', 'u', False), ('ư', 'U', False)]
+VOWELS = set('aăâeêioôơuưy')
+PAUSES = {',': 150, ';': 200, ':': 200, '.': 350, '!': 350, '?': 350}
+
+# Durations (ms)
+CONSONANT_MS = {'stop': 80, 'fricative': 90, 'other': 60}
+STOPS = set('ptTkcbd')
+FRICATIVES = set('vzGfsxh')
+GLIDE_MS = 40
+NUCLEUS_MS = 170
+SHORT_NUCLEUS_MS = 110
+OPEN_SYLLABLE_MS = 60              # Added to the nucleus without a final
+FINAL_MS = 70
+
+
+def split_word(word):
+    # NFD word -> letters with their vowel quality marks, and the tone
+    letters = ''
+    tone = 'ngang'
+    for char in unicodedata.normalize('NFD', word.lower()):
+        if char in TONE_MARKS:
+            tone = TONE_MARKS[char]
+        elif unicodedata.combining(char):
+            if letters and (letters[-1], char) in QUALITY_MARKS:
+                letters = letters[:-1] + QUALITY_MARKS[(letters[-1], char)]
+        elif char.isalpha():
+            letters += char
+    return letters, tone
+
+
+def parse_syllable(letters):
+    # -> (initial phonemes, nucleus phonemes, short, final phoneme), None if it cannot be read
+    initial = ''
+    if letters.startswith('gi') and not any(c in VOWELS for c in letters[2:]):
+        initial, letters = 'z', letters[1:]      # "gì", "gìn": the i is the vowel
+    else:
+        for spelling, phonemes in INITIALS:
+            if letters.startswith(spelling):
+                initial, letters = phonemes, letters[len(spelling):]
+                break
+    final = ''
+    for spelling, phoneme in FINALS:
+        if letters.endswith(spelling) and len(letters) > len(spelling):
+            final, letters = phoneme, letters[:-len(spelling)]
+            break
+    # Off-glides: "ai", "ao", "êu", "uôi"..., but not the nuclei "uy", "ia", "ua", "oa"
+    if not final and len(letters) >= 2 and letters[-1] in 'iyou' and letters not in ('uy', 'oa', 'oe'):
+        if letters.endswith(('ay', 'au')):
+            letters = letters[:-2] + 'ă' + letters[-1]      # "ay", "au" have the short a
+        final, letters = ('j' if letters[-1] in 'iy' else 'w'), letters[:-1]
+    for spelling, phonemes, short in NUCLEI:
+        if letters == spelling:
+            return initial, phonemes, short, final
+    return None
+
+
+def units(text, base_pitch=BASE_PITCH):
+    # -> list of (symbol, milliseconds, start pitch, end pitch)
+    out = []
+    phrases = []
+    current = []
+    word = ''
+    for char in text + ' ':
+        if char.isalpha() or unicodedata.combining(char):
+            word += char
+            continue
+        if word:
+            current.append(word)
+            word = ''
+        if char in PAUSES:
+            phrases.append((current, PAUSES[char]))
+            current = []
+    if current:
+        phrases.append((current, PAUSES['.']))
+
+    for words, pause in phrases:
+        syllables = [parse_syllable(split_word(w)[0]) for w in words]
+        tones = [split_word(w)[1] for w in words]
+        count = len(syllables)
+        for index, (syllable, tone) in enumerate(zip(syllables, tones)):
+            if syllable is None:
+                continue
+            initial, nucleus, short, final = syllable
+            # Declination over the phrase, lengthening of its last syllable
+            pitch = base_pitch * (1.05 - 0.15 * index / max(count - 1, 1))
+            stretch = 1.3 if index == count - 1 else 1.0
+            if tone == 'nang':
+                stretch *= 0.75
+            contour = TONES[tone]
+            start = pitch * contour[0][0]
+            for phoneme in initial:
+                kind = 'stop' if phoneme in STOPS else ('fricative' if phoneme in FRICATIVES else 'other')
+                ms = GLIDE_MS if phoneme == 'w' else CONSONANT_MS[kind]
+                out.append((phoneme, ms, start, start))
+            vowels = nucleus
+            if vowels.startswith('w'):
+                out.append(('w', GLIDE_MS, start, start))
+                vowels = vowels[1:]
+            length = (SHORT_NUCLEUS_MS if short else NUCLEUS_MS) + (0 if final else OPEN_SYLLABLE_MS)
+            length *= stretch
+            # The contour runs over the vowels and the final; each part covers an equal share
+            pieces = [(v, length / len(vowels)) for v in vowels]
+            if final:
+                pieces.append((final, FINAL_MS * stretch))
+            total = sum(ms for _, ms in pieces)
+            elapsed = 0.0
+            for symbol, ms in pieces:
+                begin, end = elapsed / total, (elapsed + ms) / total
+                out.append((symbol, ms, pitch * contour_at(contour, begin), pitch * contour_at(contour, end)))
+                elapsed += ms
+        out.append(('_', pause, 0, 0))
+    return out
+
+
+def contour_at(contour, position):
+    # Factor of the contour at a position of the rhyme (0-1)
+    parts = len(contour)
+    part = min(int(position * parts), parts - 1)
+    local = position * parts - part
+    start, end = contour[part]
+    return start + (end - start) * local
+
+
+def encode_units(unit_list):
+    body = bytearray()
+    for symbol, ms, start, end in unit_list:
+        steps = max(1, round(ms / UNIT_MS))
+        while steps > 0:
+            piece = min(steps, 255)    # longer pauses are split
+            body += struct.pack('<BBBB', ord(symbol), piece,
+                                min(255, round(start / PITCH_STEP)), min(255, round(end / PITCH_STEP)))
+            steps -= piece
+    return bytes(body)
+
+
+def response_wav(text, sample_rate):
+    # Body of a phoneme response: the header describes the 16-bit audio rendered by the device
+    body = encode_units(units(text))
+    return codec.wav_header(sample_rate, 16, 1, len(body)) + body
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Text to phoneme units of the ESP32 synthesizer')
+    parser.add_argument('text')
+    parser.add_argument('--rate', type=int, default=16000, help='sample rate in the header (X-Accept-Format)')
+    parser.add_argument('--out', help='write the response body (WAV header and units)')
+    args = parser.parse_args()
+    unit_list = units(args.text)
+    for symbol, ms, start, end in unit_list:
+        print(f"{symbol} {ms:6.0f} ms {start:6.1f} -> {end:6.1f} Hz")
+    body = response_wav(args.text, args.rate)
+    print(f"{len(unit_list)} units, {len(body)} bytes, {sum(u[1] for u in unit_list) / 1000:.2f} s")
+    if args.out:
+        with open(args.out, 'wb') as file:
+            file.write(body)
+
+
+if __name__ == '__main__':
+    main()
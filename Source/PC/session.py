@@ -0,0 +1,110 @@
+# Persistent framed TCP session with the ESP32 (see Source/ESP32/include/Session.h).
+#
+# Frame: type (1 byte) | flags (1 byte) | payload length (2 bytes, little-endian) | payload
+# Control payloads are "Key: value" lines with the same keys as the HTTP headers, so a turn
+# received over a session is handled by the same process_turn() as an HTTP upload.
+
+import socket
+import socketserver
+import struct
+import threading
+
+FRAME_HELLO = 1
+FRAME_PING = 2
+FRAME_PONG = 3
+FRAME_TURN_BEGIN = 4
+FRAME_AUDIO_UP = 5
+FRAME_TURN_END = 6
+FRAME_RESPONSE_BEGIN = 7
+FRAME_AUDIO_DOWN = 8
+FRAME_RESPONSE_END = 9
+FRAME_TURN_CANCEL = 10
+
+HEADER = struct.Struct('<BBH')
+DEFAULT_MAX_FRAME = 1024
+
+
+def read_exact(sock_file, size):
+    data = sock_file.read(size)
+    if data is None or len(data) < size:
+        raise ConnectionError('session closed')
+    return data
+
+
+def read_frame(sock_file):
+    frame_type, _, length = HEADER.unpack(read_exact(sock_file, HEADER.size))
+    return frame_type, read_exact(sock_file, length) if length else b''
+
+
+def write_frame(sock, frame_type, payload=b''):
+    sock.sendall(HEADER.pack(frame_type, 0, len(payload)) + payload)
+
+
+def format_headers(headers):
+    return ''.join(f"{key}: {value}\r\n" for key, value in headers.items()).encode()
+
+
+def parse_headers(payload):
+    headers = {}
+    for line in payload.decode('latin-1').split('\r\n'):
+        key, sep, value = line.partition(':')
+        if sep:
+            headers[key.strip().lower()] = value.strip()
+    return headers
+
+
+class SessionHandler(socketserver.BaseRequestHandler):
+    # process_turn(wav_data, upload_codec, accept_codec, cached_clips, accept_format, feature_format) -> (status, response_codec, body, headers)
+    process_turn = None
+
+    def handle(self):
+        self.request.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        sock_file = self.request.makefile('rb')
+        max_frame = DEFAULT_MAX_FRAME
+        turn_headers, upload = None, bytearray()
+        print(f"Session opened by {self.client_address[0]}")
+        try:
+            while True:
+                frame_type, payload = read_frame(sock_file)
+                if frame_type == FRAME_HELLO:
+                    hello = parse_headers(payload)
+                    max_frame = int(hello.get('x-max-frame', DEFAULT_MAX_FRAME))
+                    write_frame(self.request, FRAME_HELLO, format_headers({'X-Max-Frame': max_frame}))
+                elif frame_type == FRAME_PING:
+                    write_frame(self.request, FRAME_PONG)
+                elif frame_type == FRAME_TURN_BEGIN:
+                    turn_headers, upload = parse_headers(payload), bytearray()
+                elif frame_type == FRAME_AUDIO_UP:
+                    upload += payload
+                elif frame_type == FRAME_TURN_END and turn_headers is not None:
+                    self.respond(turn_headers, bytes(upload), max_frame)
+                    turn_headers, upload = None, bytearray()
+                elif frame_type == FRAME_TURN_CANCEL:
+                    turn_headers, upload = None, bytearray()  # no speech on the device, nothing to answer
+        except ConnectionError:
+            pass
+        print(f"Session closed by {self.client_address[0]}")
+
+    def respond(self, turn_headers, wav_data, max_frame):
+        status, response_codec, body, headers = type(self).process_turn(
+            wav_data, turn_headers.get('x-audio-codec', 'pcm').lower(), turn_headers.get('x-accept-codec'),
+            turn_headers.get('x-cached-clips'), turn_headers.get('x-accept-format'), turn_headers.get('x-feature-format'))
+        write_frame(self.request, FRAME_RESPONSE_BEGIN, format_headers(
+            {'Status': status, 'X-Audio-Codec': response_codec, 'Content-Length': len(body), **headers}))
+        for offset in range(0, len(body), max_frame):
+            write_frame(self.request, FRAME_AUDIO_DOWN, body[offset:offset + max_frame])
+        write_frame(self.request, FRAME_RESPONSE_END)
+
+
+class SessionServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def serve(port, process_turn, host='0.0.0.0'):
+    # Accepts sessions on a background thread, returns the server
+    handler = type('Handler', (SessionHandler,), {'process_turn': staticmethod(process_turn)})
+    server = SessionServer((host, port), handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print(f"Session server listening on {host}:{port}")
+    return server
@@ -0,0 +1,215 @@
+# Stand-in for main.py that needs no speech recognition, chatbot or text-to-speech service.
+# It speaks the same protocols as main.py (HTTP chunked or Content-Length upload, framed session,
+# codec negotiation) and answers with deterministic audio, so the device or the native build can be
+# benchmarked alone.
+#
+#   python standin_server.py [--port 5000] [--session-port 5001] [--delay 0.5] [--response reply.wav] [--clips]
+#                            [--text "..."] [--reference utterance.wav]
+#
+# Replies are sent at the rate the device asks for in X-Accept-Format (8kHz without it). Without
+# --response, the reply is the uploaded audio resampled to that rate. Devices that accept the
+# phonemes codec (SYNTH_ENABLE) get --text as phoneme units instead (phonemes.py).
+# Log-mel uploads (UPLOAD_CODEC CODEC_LOGMEL or CODEC_LOGMEL8) are decoded and, with --reference,
+# compared with the float reference front end run over the WAV file the device was fed (features.py);
+# without --response they are answered with a tone following the loudness of the frames.
+# With --clips, replies are offered to the device clip cache (clips.py) and replayed from it when
+# the same reply comes again, so cache hits can be measured.
+
+import argparse
+import io
+import struct
+import time
+import wave
+from array import array
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+import clips
+import codec
+import features
+import phonemes
+import session
+
+def fix_wav_header(wav_data):
+    # Same as main.py: patch the 0xFFFFFFFF sizes of a streamed upload
+    if len(wav_data) < 44 or wav_data[0:4] != b'RIFF' or wav_data[36:40] != b'data':
+        return wav_data
+    data_size = len(wav_data) - 44
+    header = bytearray(wav_data[0:44])
+    struct.pack_into('<I', header, 4, 36 + data_size)
+    struct.pack_into('<I', header, 40, data_size)
+    return bytes(header) + wav_data[44:]
+
+
+def echo_response(wav_data, upload_codec, response_rate):
+    # 16-bit PCM at response_rate built from the upload
+    if len(wav_data) < 44:
+        return b''
+    sample_rate = struct.unpack_from('<I', wav_data, 24)[0]
+    pcm = codec.decode(upload_codec, wav_data[44:])
+    return codec.resample(pcm, sample_rate, response_rate)
+
+
+def recorded_samples(pcm):
+    # The device records the high byte of each I2S sample (Kernel_DacScale), the native build feeds
+    # its fixture the same way: the reference of a log-mel upload sees the same samples
+    return array('h', (s & ~0xFF for s in memoryview(pcm).cast('h'))).tobytes()
+
+
+def load_response(path):
+    with wave.open(path, 'rb') as wav_file:
+        if wav_file.getsampwidth() != 2 or wav_file.getnchannels() != 1:
+            raise SystemExit(f"{path}: expected 16-bit mono PCM")
+        return wav_file.getframerate(), wav_file.readframes(wav_file.getnframes())
+
+
+def encode_response(pcm, sample_rate, response_codec):
+    # Same layout as main.py: PCM responses are unsigned 8-bit, compressed ones carry a 16-bit header
+    if response_codec == codec.PCM:
+        payload = bytes((((s >> 8) + 128) & 0xFF) for s in memoryview(pcm).cast('h'))
+        return codec.wav_header(sample_rate, 8, 1, len(payload)) + payload
+    payload = codec.encode(response_codec, pcm)
+    return codec.wav_header(sample_rate, 16, 1, len(payload)) + payload
+
+
+def feature_response(wav_data, upload_codec, feature_format, response_rate):
+    # Decodes a log-mel upload, compares it with the reference and returns a reply (16-bit PCM at response_rate)
+    if len(wav_data) < 44:
+        return b''
+    sample_rate = struct.unpack_from('<I', wav_data, 24)[0]
+    bands, frame_len, hop = features.parse_format(feature_format)
+    frames = features.decode(upload_codec, wav_data[44:], bands)
+    print(f"{len(frames)} log-mel frames of {bands} bands ({len(frames) * hop * 1000 // sample_rate} ms), "
+          f"{len(wav_data) - 44} bytes")
+    if Turn.reference:
+        ref_rate, ref_pcm = Turn.reference
+        key = (ref_rate, bands, frame_len, hop)
+        if key not in Turn.reference_frames:
+            Turn.reference_frames[key] = features.references(ref_pcm, ref_rate, (bands, frame_len, hop))
+        result = features.compare(frames, Turn.reference_frames[key], hop)
+        if result:
+            start, mean, largest, count = result
+            print(f"Reference: aligned at {start * 1000 // ref_rate} ms, error mean {mean:.2f} dB, max {largest:.2f} dB "
+                  f"over {count} bands")
+    return features.envelope_tone(frames, hop, sample_rate, response_rate)
+
+
+class Turn:
+    delay = 0.0
+    response = None
+    clips = False
+    text = ''
+    reference = None          # (rate, 16-bit PCM) the log-mel uploads are compared with
+    reference_frames = {}     # Its reference features at several starts, per feature format
+
+    @staticmethod
+    def process(wav_data, upload_codec, accept_codec, cached_clips=None, accept_format=None, feature_format=None):
+        # Same contract as main.process_turn: returns (status, response codec, body, extra headers)
+        start = time.monotonic()
+        response_codec = codec.negotiate(accept_codec)
+        response_rate = codec.parse_format(accept_format)[0]
+        wav_data = fix_wav_header(wav_data)
+
+        # Stands for speech recognition, chatbot and text-to-speech
+        if Turn.delay:
+            time.sleep(Turn.delay)
+        if upload_codec in codec.FEATURE_CODECS:
+            pcm = feature_response(wav_data, upload_codec, feature_format, response_rate)
+        if response_codec == codec.PHONEMES:
+            body = phonemes.response_wav(Turn.text, response_rate)
+        else:
+            if Turn.response:
+                sample_rate, pcm = Turn.response
+                pcm = codec.resample(pcm, sample_rate, response_rate)
+            elif upload_codec not in codec.FEATURE_CODECS:
+                pcm = echo_response(wav_data, upload_codec, response_rate)
+            body = encode_response(pcm, response_rate, response_codec)
+        headers = {}
+        if Turn.clips:
+            clip = clips.clip_id(body)
+            if clip in clips.cached_ids(cached_clips):
+                body, headers = b'', clips.play_headers(clip)
+            else:
+                headers = clips.store_headers(clip, body)
+        print(f"{len(wav_data)} bytes ({upload_codec}), processed in {1000 * (time.monotonic() - start):.0f} ms, "
+              f"replied {len(body)} bytes ({response_codec}, {response_rate} Hz) {headers.get('X-Clip-Action', '')}")
+        return 200, response_codec, body, headers
+
+
+class UploadHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def read_body(self):
+        if self.headers.get('Transfer-Encoding', '').lower() == 'chunked':
+            body = io.BytesIO()
+            while True:
+                line = self.rfile.readline()
+                if not line:
+                    return None  # closed before the last chunk: the device cancelled the turn
+                size = int(line.split(b';')[0].strip() or b'0', 16)
+                if size == 0:
+                    # Skip optional trailers up to the blank line
+                    while self.rfile.readline() not in (b'\r\n', b'\n', b''):
+                        pass
+                    return body.getvalue()
+                body.write(self.rfile.read(size))
+                self.rfile.readline()
+        return self.rfile.read(int(self.headers.get('Content-Length', 0)))
+
+    def do_POST(self):
+        if self.path != '/upload' or self.headers.get('Content-Type') != 'audio/wav':
+            self.send_error(400, 'Expected audio/wav on /upload')
+            return
+        upload = self.read_body()
+        if upload is None:
+            self.close_connection = True
+            return
+        status, response_codec, body, headers = Turn.process(upload,
+                                                             self.headers.get('X-Audio-Codec', codec.PCM).lower(),
+                                                             self.headers.get('X-Accept-Codec'),
+                                                             self.headers.get('X-Cached-Clips'),
+                                                             self.headers.get('X-Accept-Format'),
+                                                             self.headers.get('X-Feature-Format'))
+        self.send_response(status)
+        self.send_header('Content-Type', 'audio/wav')
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('X-Audio-Codec', response_codec)
+        for key, value in headers.items():
+            self.send_header(key, value)
+        self.send_header('Connection', 'close')
+        self.end_headers()
+        self.wfile.write(body)
+        self.close_connection = True
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stand-in voice server for benchmarks')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=5000)
+    parser.add_argument('--session-port', type=int, default=5001, help='framed session port (0 to disable)')
+    parser.add_argument('--delay', type=float, default=0.0, help='simulated processing time in seconds')
+    parser.add_argument('--response', help='16-bit mono WAV sent as the reply instead of the echo')
+    parser.add_argument('--clips', action='store_true', help='let the device cache replies and replay them')
+    parser.add_argument('--text', default='Xin chào, tôi là trợ lý ảo. Hôm nay trời đẹp quá!',
+                        help='reply read to devices that accept phonemes')
+    parser.add_argument('--reference', help='16-bit mono WAV fed to the device, compared with its log-mel uploads')
+    args = parser.parse_args()
+    Turn.delay = args.delay
+    Turn.clips = args.clips
+    Turn.text = args.text
+    if args.response:
+        Turn.response = load_response(args.response)
+    if args.reference:
+        rate, pcm = load_response(args.reference)
+        Turn.reference = (rate, recorded_samples(pcm))
+    if args.session_port:
+        session.serve(args.session_port, Turn.process, args.host)
+    server = ThreadingHTTPServer((args.host, args.port), UploadHandler)
+    print(f"Stand-in server listening on {args.host}:{args.port}")
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+# Per-stage latency report from the traces of the ESP32 (see Source/ESP32/include/Trace.h).
+#
+#   python trace_report.py serial.log [more.log ...]      TRACE lines captured from the serial monitor
+#   python trace_report.py trace.bin                      binary blob (Trace_Export, native --trace)
+#
+# Every turn is split into stages between two trace events; the report lists p50/p95/p99 per stage.
+
+import argparse
+import struct
+import sys
+
+TRACE_MAGIC = 0x43525456
+EVENTS = ['button_press', 'first_block', 'record_end', 'first_byte_sent', 'last_byte_sent',
+          'first_response_byte', 'last_response_byte', 'playback_start', 'playback_end', 'barge_in']
+
+# name, from event, to event
+STAGES = [
+    ('mic_start', 'button_press', 'first_block'),            # I2S start and warm-up
+    ('capture', 'button_press', 'record_end'),               # Speaking time
+    ('upload_tail', 'record_end', 'last_byte_sent'),         # Upload left after the end of speech
+    ('server', 'last_byte_sent', 'first_response_byte'),     # Speech to text, chatbot, text to speech
+    ('download', 'first_response_byte', 'last_response_byte'),
+    ('prebuffer', 'first_response_byte', 'playback_start'),  # Player watermark
+    ('first_audio', 'record_end', 'playback_start'),         # Latency heard by the user
+    ('playback', 'playback_start', 'playback_end'),
+    ('turnaround', 'record_end', 'playback_end'),
+    ('interrupt', 'barge_in', 'playback_end'),               # Barge-in to the speaker stopped
+]
+
+
+def read_blob(data):
+    magic, version, record_size, count, dropped = struct.unpack_from('<IHHII', data, 0)
+    if magic != TRACE_MAGIC or version != 1:
+        raise ValueError('not a trace blob')
+    if dropped:
+        print(f"warning: {dropped} records were overwritten before the export", file=sys.stderr)
+    offset = struct.calcsize('<IHHII')
+    for i in range(count):
+        time_us, turn, event, _, value = struct.unpack_from('<QHBBi', data, offset + i * record_size)
+        yield turn, EVENTS[event] if event < len(EVENTS) else str(event), time_us, value
+
+
+def read_log(text):
+    for line in text.splitlines():
+        fields = line[line.find('TRACE '):].split() if 'TRACE ' in line else []
+        if len(fields) >= 4:
+            yield int(fields[1]), fields[2], int(fields[3]), int(fields[4]) if len(fields) > 4 else 0
+
+
+def load_turns(paths):
+    # Turn ids restart at every boot, a new session starts when a turn id is seen again
+    turns = []
+    for path in paths:
+        with open(path, 'rb') as file:
+            data = file.read()
+        records = read_blob(data) if data[:4] == struct.pack('<I', TRACE_MAGIC) \
+            else read_log(data.decode('utf-8', 'replace'))
+        current = {}
+        for turn, event, time_us, value in records:
+            if event == 'button_press' or turn not in current:
+                current[turn] = {}
+                turns.append(current[turn])
+            current[turn].setdefault(event, time_us)  # keep the first occurrence (re-buffering restarts playback)
+    return turns
+
+
+def percentile(values, p):
+    # Linear interpolation between the closest ranks
+    values = sorted(values)
+    position = (len(values) - 1) * p / 100
+    low = int(position)
+    high = min(low + 1, len(values) - 1)
+    return values[low] + (values[high] - values[low]) * (position - low)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Per-stage latency percentiles from ESP32 traces')
+    parser.add_argument('files', nargs='+')
+    args = parser.parse_args()
+
+    turns = load_turns(args.files)
+    print(f"{len(turns)} turns")
+    print(f"{'stage (ms)':<12} {'n':>5} {'p50':>9} {'p95':>9} {'p99':>9} {'max':>9}")
+    for name, start, end in STAGES:
+        values = [(t[end] - t[start]) / 1000 for t in turns if start in t and end in t]
+        if not values:
+            continue
+        print(f"{name:<12} {len(values):>5} {percentile(values, 50):>9.1f} {percentile(values, 95):>9.1f} "
+              f"{percentile(values, 99):>9.1f} {max(values):>9.1f}")
+
+
+if __name__ == '__main__':
+    main()